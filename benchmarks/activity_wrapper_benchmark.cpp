@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// Benchmark for the storage of GPU activity wrappers. Compares one heap
+// allocation per wrapper (the previous std::vector<std::unique_ptr<>> layout)
+// against the slab storage in ActivityBuffers, reporting time and heap
+// allocations per record for creating, iterating and destroying wrappers.
+//
+// CMake usage:
+//   mkdir build && cd build
+//   cmake .. -DKINETO_BUILD_BENCHMARKS=ON
+//   make activity_wrapper_benchmark
+//   ./benchmarks/activity_wrapper_benchmark --records=1000000
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "ActivityBuffers.h"
+#include "ITraceActivity.h"
+#include "TraceSpan.h"
+
+namespace {
+
+std::atomic<int64_t> allocationCount{0};
+
+} // namespace
+
+// Count every heap allocation made by the benchmark.
+void* operator new(size_t size) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, size_t /*size*/) noexcept {
+  std::free(p);
+}
+
+namespace {
+
+using namespace libkineto;
+
+struct BenchmarkOptions {
+  int64_t records = 1000000;
+  int iterations = 5;
+};
+
+void printUsage(const char* progname) {
+  fmt::print("Usage: {} [options]\n", progname);
+  fmt::print("Options:\n");
+  fmt::print(
+      "  --records=<n>      Wrappers created per iteration (default: 1000000)\n");
+  fmt::print("  --iterations=<n>   Iterations per layout (default: 5)\n");
+  fmt::print("  --help             Show this help\n");
+}
+
+BenchmarkOptions parseArgs(int argc, char* argv[]) {
+  BenchmarkOptions opts;
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (strncmp(arg, "--records=", 10) == 0) {
+      opts.records = std::atoll(arg + 10);
+    } else if (strncmp(arg, "--iterations=", 13) == 0) {
+      opts.iterations = std::atoi(arg + 13);
+    } else if (strcmp(arg, "--help") == 0) {
+      printUsage(argv[0]);
+      std::exit(0);
+    } else {
+      fmt::print(stderr, "Unknown argument: {}\n", arg);
+      printUsage(argv[0]);
+      std::exit(1);
+    }
+  }
+  return opts;
+}
+
+// Stand-in for a raw CUPTI / roctracer record in an activity buffer.
+struct RawRecord {
+  int64_t start;
+  int64_t end;
+  int64_t device;
+  int64_t stream;
+  int32_t correlationId;
+};
+
+// Shaped like the GPU activity wrappers: a reference to the raw record and
+// the linked runtime activity.
+struct MockGpuActivity : public ITraceActivity {
+  MockGpuActivity(const RawRecord& raw, const ITraceActivity* linked)
+      : raw_(raw), linked_(linked) {}
+
+  int64_t deviceId() const override {
+    return raw_.device;
+  }
+  int64_t resourceId() const override {
+    return raw_.stream;
+  }
+  int32_t getThreadId() const override {
+    return 0;
+  }
+  int64_t timestamp() const override {
+    return raw_.start;
+  }
+  int64_t duration() const override {
+    return raw_.end - raw_.start;
+  }
+  int64_t correlationId() const override {
+    return raw_.correlationId;
+  }
+  int flowType() const override {
+    return 0;
+  }
+  int64_t flowId() const override {
+    return raw_.correlationId;
+  }
+  bool flowStart() const override {
+    return false;
+  }
+  ActivityType type() const override {
+    return ActivityType::CONCURRENT_KERNEL;
+  }
+  const std::string name() const override {
+    return "kernel";
+  }
+  const ITraceActivity* linkedActivity() const override {
+    return linked_;
+  }
+  const TraceSpan* traceSpan() const override {
+    return nullptr;
+  }
+  void log(ActivityLogger& /*logger*/) const override {}
+  const std::string metadataJson() const override {
+    return "";
+  }
+
+  const RawRecord& raw_;
+  const ITraceActivity* linked_;
+};
+
+struct Result {
+  double createMs{0};
+  double iterateMs{0};
+  double destroyMs{0};
+  int64_t allocations{0};
+};
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+// Touches every wrapper the way a logger does, so that the cost of scattered
+// heap objects shows up.
+int64_t sumDurations(const std::vector<const ITraceActivity*>& activities) {
+  int64_t sum = 0;
+  for (const auto* act : activities) {
+    sum += act->duration() + act->deviceId();
+  }
+  return sum;
+}
+
+Result runUniquePtr(const std::vector<RawRecord>& records) {
+  Result result;
+  std::vector<const ITraceActivity*> activities;
+  activities.reserve(records.size());
+
+  const int64_t allocsBefore = allocationCount.load();
+  auto start = Clock::now();
+  std::vector<std::unique_ptr<const ITraceActivity>> wrappers;
+  const ITraceActivity* linked = nullptr;
+  for (const auto& raw : records) {
+    wrappers.push_back(std::make_unique<MockGpuActivity>(raw, linked));
+    activities.push_back(wrappers.back().get());
+    linked = activities.back();
+  }
+  result.createMs = elapsedMs(start);
+  result.allocations = allocationCount.load() - allocsBefore;
+
+  start = Clock::now();
+  volatile int64_t sink = sumDurations(activities);
+  (void)sink;
+  result.iterateMs = elapsedMs(start);
+
+  start = Clock::now();
+  wrappers.clear();
+  wrappers.shrink_to_fit();
+  result.destroyMs = elapsedMs(start);
+  return result;
+}
+
+Result runActivityBuffers(const std::vector<RawRecord>& records) {
+  Result result;
+  std::vector<const ITraceActivity*> activities;
+  activities.reserve(records.size());
+
+  const int64_t allocsBefore = allocationCount.load();
+  auto start = Clock::now();
+  auto buffers = std::make_unique<ActivityBuffers>();
+  const ITraceActivity* linked = nullptr;
+  for (const auto& raw : records) {
+    linked = &buffers->emplaceActivityWrapper<MockGpuActivity>(raw, linked);
+    activities.push_back(linked);
+  }
+  result.createMs = elapsedMs(start);
+  result.allocations = allocationCount.load() - allocsBefore;
+
+  start = Clock::now();
+  volatile int64_t sink = sumDurations(activities);
+  (void)sink;
+  result.iterateMs = elapsedMs(start);
+
+  start = Clock::now();
+  buffers.reset();
+  result.destroyMs = elapsedMs(start);
+  return result;
+}
+
+template <class Fn>
+void runLayout(
+    const char* name,
+    Fn fn,
+    const std::vector<RawRecord>& records,
+    int iterations) {
+  Result best;
+  for (int i = 0; i < iterations; i++) {
+    Result r = fn(records);
+    if (i == 0 || r.createMs + r.destroyMs < best.createMs + best.destroyMs) {
+      best = r;
+    }
+  }
+  const auto n = static_cast<double>(records.size());
+  fmt::print(
+      "{:<16} create {:8.2f} ms  iterate {:8.2f} ms  destroy {:8.2f} ms  "
+      "{:8.2f} ns/record  {:.4f} allocs/record\n",
+      name,
+      best.createMs,
+      best.iterateMs,
+      best.destroyMs,
+      (best.createMs + best.destroyMs) * 1e6 / n,
+      static_cast<double>(best.allocations) / n);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  BenchmarkOptions opts = parseArgs(argc, argv);
+  if (opts.records <= 0 || opts.iterations <= 0) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  std::vector<RawRecord> records;
+  records.reserve(opts.records);
+  for (int64_t i = 0; i < opts.records; i++) {
+    records.push_back(
+        {1000 * i, 1000 * i + 500, i % 8, 7 + i % 4, static_cast<int32_t>(i)});
+  }
+
+  fmt::print(
+      "Activity wrapper benchmark: {} records, best of {} iterations\n",
+      opts.records,
+      opts.iterations);
+  runLayout("unique_ptr", runUniquePtr, records, opts.iterations);
+  runLayout("ActivityBuffers", runActivityBuffers, records, opts.iterations);
+  return 0;
+}
@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// Benchmark for the cost of LOG() on the logging threads, in synchronous and
+// asynchronous mode (Logger::setAsyncLogging()). Several threads log
+// messages at once, as on verbose runs or on bursts of errors from activity
+// callbacks, with a counting observer registered. Reports the latency of
+// LOG() calls, the throughput seen by the logging threads, the time to write
+// out what was still queued afterwards, and dropped messages. The terminal
+// output goes to /dev/null.
+//
+// CMake usage:
+//   mkdir build && cd build
+//   cmake .. -DKINETO_BUILD_BENCHMARKS=ON
+//   make async_logging_benchmark
+//   ./benchmarks/async_logging_benchmark --threads=8 --messages=20000
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "ILoggerObserver.h"
+#include "Logger.h"
+
+namespace {
+
+using namespace libkineto;
+
+struct BenchmarkOptions {
+  int threads = 8;
+  // Messages logged per thread.
+  int messages = 20000;
+  // Pause between messages, to log in bursts rather than flat out.
+  int pauseUs = 0;
+};
+
+void printUsage(const char* progname) {
+  fmt::print("Usage: {} [options]\n", progname);
+  fmt::print("Options:\n");
+  fmt::print("  --threads=<n>     Most logging threads (default: 8)\n");
+  fmt::print("  --messages=<n>    Messages per thread (default: 20000)\n");
+  fmt::print("  --pause_us=<n>    Pause between messages (default: 0)\n");
+  fmt::print("  --help            Show this help\n");
+}
+
+BenchmarkOptions parseArgs(int argc, char* argv[]) {
+  BenchmarkOptions opts;
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (strncmp(arg, "--threads=", 10) == 0) {
+      opts.threads = std::atoi(arg + 10);
+    } else if (strncmp(arg, "--messages=", 11) == 0) {
+      opts.messages = std::atoi(arg + 11);
+    } else if (strncmp(arg, "--pause_us=", 11) == 0) {
+      opts.pauseUs = std::atoi(arg + 11);
+    } else if (strcmp(arg, "--help") == 0) {
+      printUsage(argv[0]);
+      std::exit(0);
+    } else {
+      fmt::print(stderr, "Unknown argument: {}\n", arg);
+      printUsage(argv[0]);
+      std::exit(1);
+    }
+  }
+  return opts;
+}
+
+using Clock = std::chrono::steady_clock;
+
+// Counts messages, like a LoggerCollector without keeping them.
+class CountingObserver : public ILoggerObserver {
+ public:
+  void write(const std::string& message, LoggerOutputType /*ot*/) override {
+    count += 1;
+    bytes += message.size();
+  }
+  const std::map<LoggerOutputType, std::vector<std::string>>
+  extractCollectorMetadata() override {
+    return {};
+  }
+  void reset() override {}
+  void addDevice(const int64_t /*device*/) override {}
+  void setTraceDurationMS(const int64_t /*duration*/) override {}
+  void addEventCount(const int64_t /*count*/) override {}
+  void addDestination(const std::string& /*dest*/) override {}
+  void addMetadata(
+      const std::string& /*key*/,
+      const std::string& /*value*/) override {}
+
+  uint64_t count{0};
+  uint64_t bytes{0};
+};
+
+struct Result {
+  // Wall time until all threads finished logging.
+  double loggingMs{0};
+  // Time to write out the messages still queued afterwards.
+  double flushMs{0};
+  double p50Ns{0};
+  double p99Ns{0};
+  double maxNs{0};
+};
+
+Result run(const BenchmarkOptions& opts, int threads) {
+  std::atomic<bool> go{false};
+  std::vector<std::vector<int64_t>> latencies(threads);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      auto& samples = latencies[t];
+      samples.reserve(opts.messages);
+      while (!go.load(std::memory_order_acquire)) {
+      }
+      for (int i = 0; i < opts.messages; i++) {
+        const auto start = Clock::now();
+        LOG(ERROR) << "Activity callback failed for correlation " << i
+                   << " on thread " << t << ": CUPTI_ERROR_NOT_READY";
+        samples.push_back((Clock::now() - start).count());
+        if (opts.pauseUs > 0) {
+          std::this_thread::sleep_for(std::chrono::microseconds(opts.pauseUs));
+        }
+      }
+    });
+  }
+  const auto start = Clock::now();
+  go.store(true, std::memory_order_release);
+  for (auto& w : workers) {
+    w.join();
+  }
+  const auto logged = Clock::now();
+  Logger::flush();
+  const auto flushed = Clock::now();
+
+  std::vector<int64_t> all;
+  for (const auto& samples : latencies) {
+    all.insert(all.end(), samples.begin(), samples.end());
+  }
+  std::sort(all.begin(), all.end());
+  Result result;
+  result.loggingMs =
+      std::chrono::duration<double, std::milli>(logged - start).count();
+  result.flushMs =
+      std::chrono::duration<double, std::milli>(flushed - logged).count();
+  result.p50Ns = static_cast<double>(all[all.size() / 2]);
+  result.p99Ns = static_cast<double>(all[all.size() * 99 / 100]);
+  result.maxNs = static_cast<double>(all.back());
+  return result;
+}
+
+void print(const char* mode, int threads, int messages, const Result& r) {
+  const double total = static_cast<double>(threads) * messages;
+  fmt::print(
+      "{:3} threads  {:5}  p50 {:7.0f} ns  p99 {:8.0f} ns  max {:9.0f} ns  "
+      "{:6.2f} Mmsg/s  flush {:7.2f} ms\n",
+      threads,
+      mode,
+      r.p50Ns,
+      r.p99Ns,
+      r.maxNs,
+      total / r.loggingMs / 1e3,
+      r.flushMs);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  BenchmarkOptions opts = parseArgs(argc, argv);
+  if (opts.threads <= 0 || opts.messages <= 0 || opts.pauseUs < 0) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  fmt::print(
+      "Logging benchmark: {} messages per thread, {} us apart\n",
+      opts.messages,
+      opts.pauseUs);
+
+  std::ofstream devNull("/dev/null");
+  auto* stderrBuf = std::cerr.rdbuf(devNull.rdbuf());
+  CountingObserver observer;
+  Logger::addLoggerObserver(&observer);
+
+  std::vector<int> threadCounts;
+  for (int threads = 1; threads < opts.threads; threads *= 2) {
+    threadCounts.push_back(threads);
+  }
+  threadCounts.push_back(opts.threads);
+  for (int threads : threadCounts) {
+    Logger::setAsyncLogging(false);
+    const Result sync = run(opts, threads);
+    Logger::setAsyncLogging(true);
+    const Result async = run(opts, threads);
+    Logger::setAsyncLogging(false);
+    print("sync", threads, opts.messages, sync);
+    print("async", threads, opts.messages, async);
+  }
+
+  Logger::removeLoggerObserver(&observer);
+  std::cerr.rdbuf(stderrBuf);
+  const uint64_t logged = std::accumulate(
+      threadCounts.begin(), threadCounts.end(), uint64_t{0}) *
+      2 * opts.messages;
+  fmt::print(
+      "Observed {} of {} messages, {} dropped\n",
+      observer.count,
+      logged,
+      Logger::droppedMessages());
+  return 0;
+}
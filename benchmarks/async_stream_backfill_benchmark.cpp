@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// Benchmark for assigning streams to the async kernel and copy rows of a
+// ROCm trace, as detail::backfillAsyncStreams() does after collection. Every
+// GPU op has a runtime launch row and an async row, in loosely mixed order.
+// Compares the previous implementation, with several passes over all rows and
+// std::unordered_maps keyed by correlation id and queue, against
+// detail::backfillStreams(). The row type stands in for the rocprof rows
+// without the HIP types, so this builds without ROCm.
+//
+// CMake usage:
+//   mkdir build && cd build
+//   cmake .. -DKINETO_BUILD_BENCHMARKS=ON
+//   make async_stream_backfill_benchmark
+//   ./benchmarks/async_stream_backfill_benchmark --ops=1000000,10000000
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "AsyncStreamBackfill.h"
+
+namespace {
+
+using namespace libkineto;
+
+struct BenchmarkOptions {
+  std::vector<int64_t> ops = {100000, 1000000};
+  int iterations = 3;
+  int streams = 16;
+  int devices = 8;
+};
+
+void printUsage(const char* progname) {
+  fmt::print("Usage: {} [options]\n", progname);
+  fmt::print("Options:\n");
+  fmt::print("  --ops=<n,...>       GPU ops (default: 100000,1000000)\n");
+  fmt::print("  --iterations=<n>    Iterations per size (default: 3)\n");
+  fmt::print("  --streams=<n>       HIP streams (default: 16)\n");
+  fmt::print("  --devices=<n>       Devices (default: 8)\n");
+  fmt::print("  --help              Show this help\n");
+}
+
+BenchmarkOptions parseArgs(int argc, char* argv[]) {
+  BenchmarkOptions opts;
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (strncmp(arg, "--ops=", 6) == 0) {
+      opts.ops.clear();
+      std::stringstream ss(arg + 6);
+      std::string count;
+      while (std::getline(ss, count, ',')) {
+        opts.ops.push_back(std::atoll(count.c_str()));
+      }
+    } else if (strncmp(arg, "--iterations=", 13) == 0) {
+      opts.iterations = std::atoi(arg + 13);
+    } else if (strncmp(arg, "--streams=", 10) == 0) {
+      opts.streams = std::atoi(arg + 10);
+    } else if (strncmp(arg, "--devices=", 10) == 0) {
+      opts.devices = std::atoi(arg + 10);
+    } else if (strcmp(arg, "--help") == 0) {
+      printUsage(argv[0]);
+      std::exit(0);
+    } else {
+      fmt::print(stderr, "Unknown argument: {}\n", arg);
+      printUsage(argv[0]);
+      std::exit(1);
+    }
+  }
+  return opts;
+}
+
+using Clock = std::chrono::steady_clock;
+
+enum RowType { kRuntime, kKernelLaunch, kAsync };
+
+// About the size of the rocprof rows, with the fields the backfill reads.
+struct Row {
+  uint64_t id;
+  uint64_t begin;
+  uint64_t end;
+  uint32_t domain;
+  RowType type;
+  uint64_t launchStream;
+  int device;
+  uint64_t queue;
+  uint64_t stream;
+  char payload[48];
+};
+
+uint64_t launchStream(const Row* row) {
+  return row->type == kKernelLaunch ? row->launchStream : 0;
+}
+
+Row* asyncOp(Row* row) {
+  return row->type == kAsync ? row : nullptr;
+}
+
+// The previous implementation.
+void backfillWithMaps(std::vector<Row*>& rows) {
+  std::unordered_map<uint64_t, uint64_t> streamByCorrelation;
+  for (const auto* item : rows) {
+    const uint64_t sid = launchStream(item);
+    if (sid != 0) {
+      streamByCorrelation[item->id] = sid;
+    }
+  }
+  if (streamByCorrelation.empty()) {
+    return;
+  }
+  for (auto* item : rows) {
+    auto* async = asyncOp(item);
+    if (async == nullptr || async->stream != 0) {
+      continue;
+    }
+    const auto it = streamByCorrelation.find(async->id);
+    if (it != streamByCorrelation.end()) {
+      async->stream = it->second;
+    }
+  }
+  std::unordered_map<uint64_t, uint64_t> streamByQueue;
+  std::unordered_set<uint64_t> ambiguousQueues;
+  for (auto* item : rows) {
+    const auto* async = asyncOp(item);
+    if (async == nullptr || async->stream == 0 || async->queue == 0) {
+      continue;
+    }
+    if (ambiguousQueues.count(async->queue) > 0) {
+      continue;
+    }
+    const auto [it, inserted] =
+        streamByQueue.emplace(async->queue, async->stream);
+    if (!inserted && it->second != async->stream) {
+      streamByQueue.erase(it);
+      ambiguousQueues.insert(async->queue);
+    }
+  }
+  for (auto* item : rows) {
+    auto* async = asyncOp(item);
+    if (async == nullptr || async->stream != 0) {
+      continue;
+    }
+    const auto it = streamByQueue.find(async->queue);
+    if (it != streamByQueue.end()) {
+      async->stream = it->second;
+    }
+  }
+  constexpr uint64_t kQueueKeyTag = uint64_t{1} << 63;
+  std::unordered_map<int, std::unordered_map<uint64_t, uint64_t>>
+      deviceStreamToIndex;
+  for (auto* item : rows) {
+    auto* async = asyncOp(item);
+    if (async == nullptr) {
+      continue;
+    }
+    uint64_t key;
+    if (async->stream != 0) {
+      key = async->stream;
+    } else if (async->queue != 0) {
+      key = async->queue | kQueueKeyTag;
+    } else {
+      continue;
+    }
+    auto& mapping = deviceStreamToIndex[async->device];
+    auto [it, inserted] = mapping.emplace(key, mapping.size() + 1);
+    async->stream = it->second;
+  }
+}
+
+void backfillDense(std::vector<Row*>& rows) {
+  detail::backfillStreams(rows, launchStream, asyncOp);
+}
+
+// One kernel launch, one other runtime call and one async row per op. Async
+// rows arrive in batches from the completion callback, so they trail their
+// launches; one in twenty is an internal op without a launch.
+std::vector<Row> makeTrace(const BenchmarkOptions& opts, int64_t ops) {
+  std::mt19937_64 rng(42);
+  std::vector<Row> rows;
+  rows.reserve(ops * 3);
+  std::vector<Row> pending;
+  for (int64_t i = 0; i < ops; i++) {
+    const uint64_t id = 1 + 2 * i;
+    const uint64_t streamIndex = rng() % opts.streams;
+    const uint64_t stream = 0x7f0000001000 + streamIndex * 0x40;
+    Row runtime{};
+    runtime.id = id + 1;
+    runtime.type = kRuntime;
+    rows.push_back(runtime);
+    const bool internal = rng() % 20 == 0;
+    if (!internal) {
+      Row launch{};
+      launch.id = id;
+      launch.type = kKernelLaunch;
+      launch.launchStream = stream;
+      rows.push_back(launch);
+    }
+    Row async{};
+    async.id = id;
+    async.type = kAsync;
+    async.device = static_cast<int>(streamIndex % opts.devices);
+    async.queue = 0x100 + streamIndex;
+    pending.push_back(async);
+    if (pending.size() == 256) {
+      rows.insert(rows.end(), pending.begin(), pending.end());
+      pending.clear();
+    }
+  }
+  rows.insert(rows.end(), pending.begin(), pending.end());
+  return rows;
+}
+
+template <class Backfill>
+double run(
+    const std::vector<Row>& trace,
+    int iterations,
+    Backfill backfill,
+    std::vector<uint64_t>& streams) {
+  double best = 1e30;
+  for (int i = 0; i < iterations; i++) {
+    std::vector<Row> rows = trace;
+    std::vector<Row*> ptrs;
+    ptrs.reserve(rows.size());
+    for (Row& row : rows) {
+      ptrs.push_back(&row);
+    }
+    const auto start = Clock::now();
+    backfill(ptrs);
+    const double ms =
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count();
+    best = std::min(best, ms);
+    streams.clear();
+    for (const Row& row : rows) {
+      streams.push_back(row.stream);
+    }
+  }
+  return best;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  BenchmarkOptions opts = parseArgs(argc, argv);
+  if (opts.iterations <= 0 || opts.streams <= 0 || opts.devices <= 0) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  fmt::print(
+      "Async stream backfill benchmark: {} streams on {} devices, "
+      "best of {}\n",
+      opts.streams,
+      opts.devices,
+      opts.iterations);
+  for (int64_t ops : opts.ops) {
+    const std::vector<Row> trace = makeTrace(opts, ops);
+    std::vector<uint64_t> mapStreams;
+    std::vector<uint64_t> denseStreams;
+    const double mapMs =
+        run(trace, opts.iterations, backfillWithMaps, mapStreams);
+    const double denseMs =
+        run(trace, opts.iterations, backfillDense, denseStreams);
+    fmt::print(
+        "{:>10} ops {:>10} rows  maps {:9.2f} ms  dense {:9.2f} ms  "
+        "({:.1f}x){}\n",
+        ops,
+        trace.size(),
+        mapMs,
+        denseMs,
+        mapMs / denseMs,
+        mapStreams == denseStreams ? "" : "  MISMATCH");
+  }
+  return 0;
+}
@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// Benchmark for the correlation maps used while processing GPU records.
+// Replays the access pattern of GenericActivityProfiler: CPU ops are indexed
+// by external id, CUDA runtime correlation ids are mapped to external ids,
+// and every GPU record then resolves its CPU op through both maps
+// (linkedActivity()) and checks the runtime <-> GPU pairing
+// (checkTimestampOrder()). Compares std::unordered_map against FlatHashMap.
+//
+// CMake usage:
+//   mkdir build && cd build
+//   cmake .. -DKINETO_BUILD_BENCHMARKS=ON
+//   make correlation_map_benchmark
+//   ./benchmarks/correlation_map_benchmark --records=1000000,10000000,100000000
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "FlatHashMap.h"
+
+namespace {
+
+using namespace libkineto;
+
+struct BenchmarkOptions {
+  std::vector<int64_t> records = {1000000, 10000000};
+  int iterations = 3;
+  bool presize = true;
+};
+
+void printUsage(const char* progname) {
+  fmt::print("Usage: {} [options]\n", progname);
+  fmt::print("Options:\n");
+  fmt::print(
+      "  --records=<n,...>   GPU record counts (default: 1000000,10000000)\n");
+  fmt::print("  --iterations=<n>    Iterations per size (default: 3)\n");
+  fmt::print("  --no_presize        Do not reserve the maps up front\n");
+  fmt::print("  --help              Show this help\n");
+}
+
+BenchmarkOptions parseArgs(int argc, char* argv[]) {
+  BenchmarkOptions opts;
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (strncmp(arg, "--records=", 10) == 0) {
+      opts.records.clear();
+      std::stringstream ss(arg + 10);
+      std::string count;
+      while (std::getline(ss, count, ',')) {
+        opts.records.push_back(std::atoll(count.c_str()));
+      }
+    } else if (strncmp(arg, "--iterations=", 13) == 0) {
+      opts.iterations = std::atoi(arg + 13);
+    } else if (strcmp(arg, "--no_presize") == 0) {
+      opts.presize = false;
+    } else if (strcmp(arg, "--help") == 0) {
+      printUsage(argv[0]);
+      std::exit(0);
+    } else {
+      fmt::print(stderr, "Unknown argument: {}\n", arg);
+      printUsage(argv[0]);
+      std::exit(1);
+    }
+  }
+  return opts;
+}
+
+// Stand-in for the activities the maps point to.
+struct Activity {
+  int64_t id;
+};
+
+// A GPU record as seen by the correlation code: its CUDA correlation id.
+// Several kernels are launched per CPU op.
+struct Workload {
+  std::vector<Activity> cpuOps;
+  std::vector<int64_t> correlationIds;
+  std::vector<int64_t> externalIds;
+  // GPU records, in the order they come out of the activity buffers.
+  std::vector<int64_t> gpuRecords;
+};
+
+Workload makeWorkload(int64_t records) {
+  constexpr int64_t kLaunchesPerOp = 4;
+  Workload w;
+  const int64_t ops = std::max<int64_t>(1, records / kLaunchesPerOp);
+  w.cpuOps.reserve(ops);
+  for (int64_t i = 0; i < ops; i++) {
+    // External ids are sparse sequence numbers.
+    w.cpuOps.push_back({1000 + 3 * i});
+  }
+  w.correlationIds.reserve(records);
+  w.externalIds.reserve(records);
+  for (int64_t i = 0; i < records; i++) {
+    w.correlationIds.push_back(i + 1);
+    w.externalIds.push_back(w.cpuOps[i / kLaunchesPerOp].id);
+  }
+  // GPU records complete mostly in order, but interleaved across streams.
+  w.gpuRecords = w.correlationIds;
+  std::mt19937_64 rng(42);
+  constexpr size_t kWindow = 64;
+  for (size_t i = 0; i + kWindow < w.gpuRecords.size(); i += kWindow) {
+    std::shuffle(
+        w.gpuRecords.begin() + i, w.gpuRecords.begin() + i + kWindow, rng);
+  }
+  return w;
+}
+
+struct Result {
+  double buildMs{0};
+  double lookupMs{0};
+  int64_t found{0};
+};
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+template <class IdMap, class ActivityMap>
+Result run(const Workload& w, bool presize) {
+  Result result;
+  ActivityMap activityMap;
+  IdMap cpuCorrelationMap;
+  ActivityMap correlatedActivities;
+
+  auto start = Clock::now();
+  if (presize) {
+    activityMap.reserve(w.cpuOps.size());
+    cpuCorrelationMap.reserve(w.correlationIds.size());
+    correlatedActivities.reserve(w.gpuRecords.size());
+  }
+  for (const auto& op : w.cpuOps) {
+    activityMap[op.id] = &op;
+  }
+  for (size_t i = 0; i < w.correlationIds.size(); i++) {
+    cpuCorrelationMap[w.correlationIds[i]] = w.externalIds[i];
+  }
+  result.buildMs = elapsedMs(start);
+
+  start = Clock::now();
+  for (int64_t correlationId : w.gpuRecords) {
+    const Activity* linked = nullptr;
+    auto it = cpuCorrelationMap.find(correlationId);
+    if (it != cpuCorrelationMap.end()) {
+      auto it2 = activityMap.find(it->second);
+      if (it2 != activityMap.end()) {
+        linked = it2->second;
+      }
+    }
+    if (correlatedActivities.find(correlationId) ==
+        correlatedActivities.end()) {
+      correlatedActivities.insert({correlationId, linked});
+    }
+    result.found += linked != nullptr;
+  }
+  result.lookupMs = elapsedMs(start);
+  return result;
+}
+
+template <class IdMap, class ActivityMap>
+void runMap(
+    const char* name,
+    const Workload& w,
+    const BenchmarkOptions& opts) {
+  Result best;
+  for (int i = 0; i < opts.iterations; i++) {
+    Result r = run<IdMap, ActivityMap>(w, opts.presize);
+    if (i == 0 || r.buildMs + r.lookupMs < best.buildMs + best.lookupMs) {
+      best = r;
+    }
+  }
+  const auto n = static_cast<double>(w.gpuRecords.size());
+  fmt::print(
+      "  {:<20} build {:9.2f} ms  lookup {:9.2f} ms  {:7.2f} ns/record  "
+      "({} linked)\n",
+      name,
+      best.buildMs,
+      best.lookupMs,
+      (best.buildMs + best.lookupMs) * 1e6 / n,
+      best.found);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  BenchmarkOptions opts = parseArgs(argc, argv);
+  if (opts.records.empty() || opts.iterations <= 0) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  fmt::print(
+      "Correlation map benchmark: best of {} iterations, {}\n",
+      opts.iterations,
+      opts.presize ? "pre-sized" : "growing");
+  for (int64_t records : opts.records) {
+    if (records <= 0) {
+      continue;
+    }
+    const Workload w = makeWorkload(records);
+    fmt::print("{} GPU records, {} CPU ops\n", records, w.cpuOps.size());
+    runMap<
+        std::unordered_map<int64_t, int64_t>,
+        std::unordered_map<int64_t, const Activity*>>(
+        "std::unordered_map", w, opts);
+    runMap<
+        FlatHashMap<int64_t, int64_t>,
+        FlatHashMap<int64_t, const Activity*>>("FlatHashMap", w, opts);
+  }
+  return 0;
+}
@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// Benchmark for handing CPU trace buffers from client threads to the
+// profiler, as transferCpuTrace() does. Many producer threads hand over
+// buffers while the profiler thread periodically collects them. Compares the
+// previous scheme, where each transfer takes the profiler mutex and the
+// profiler holds that mutex while it works, against the lock-free MpscQueue.
+// Reports the producer-side latency distribution of a single transfer.
+//
+// CMake usage:
+//   mkdir build && cd build
+//   cmake .. -DKINETO_BUILD_BENCHMARKS=ON
+//   make cpu_trace_ingestion_benchmark
+//   ./benchmarks/cpu_trace_ingestion_benchmark --threads=64
+//       --hold_us=500
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "MpscQueue.h"
+#include "libkineto.h"
+
+namespace {
+
+using namespace libkineto;
+
+struct BenchmarkOptions {
+  int threads = 64;
+  int transfers = 2000;
+  // Work a producer does between transfers, e.g. running the next step.
+  int workUs = 20;
+  // How often the profiler thread collects buffers, and how long it then
+  // keeps the mutex, e.g. while processing a trace or flushing activities.
+  int drainIntervalUs = 1000;
+  int holdUs = 200;
+};
+
+void printUsage(const char* progname) {
+  fmt::print("Usage: {} [options]\n", progname);
+  fmt::print("Options:\n");
+  fmt::print("  --threads=<n>          Producer threads (default: 64)\n");
+  fmt::print(
+      "  --transfers=<n>        Transfers per producer (default: 2000)\n");
+  fmt::print(
+      "  --work_us=<n>          Producer work between transfers "
+      "(default: 20)\n");
+  fmt::print(
+      "  --drain_interval_us=<n> Profiler collection interval "
+      "(default: 1000)\n");
+  fmt::print(
+      "  --hold_us=<n>          Time the profiler works per collection "
+      "(default: 200)\n");
+  fmt::print("  --help                 Show this help\n");
+}
+
+BenchmarkOptions parseArgs(int argc, char* argv[]) {
+  BenchmarkOptions opts;
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (strncmp(arg, "--threads=", 10) == 0) {
+      opts.threads = std::atoi(arg + 10);
+    } else if (strncmp(arg, "--transfers=", 12) == 0) {
+      opts.transfers = std::atoi(arg + 12);
+    } else if (strncmp(arg, "--work_us=", 10) == 0) {
+      opts.workUs = std::atoi(arg + 10);
+    } else if (strncmp(arg, "--drain_interval_us=", 20) == 0) {
+      opts.drainIntervalUs = std::atoi(arg + 20);
+    } else if (strncmp(arg, "--hold_us=", 10) == 0) {
+      opts.holdUs = std::atoi(arg + 10);
+    } else if (strcmp(arg, "--help") == 0) {
+      printUsage(argv[0]);
+      std::exit(0);
+    } else {
+      fmt::print(stderr, "Unknown argument: {}\n", arg);
+      printUsage(argv[0]);
+      std::exit(1);
+    }
+  }
+  return opts;
+}
+
+using Clock = std::chrono::steady_clock;
+
+std::unique_ptr<CpuTraceBuffer> makeCpuTrace(const std::string& name) {
+  auto trace = std::make_unique<CpuTraceBuffer>();
+  trace->span = TraceSpan(0, 0, name);
+  trace->gpuOpCount = 0;
+  return trace;
+}
+
+// Busy-waits, standing in for work done between transfers or collections.
+void spinFor(std::chrono::microseconds duration) {
+  const auto end = Clock::now() + duration;
+  while (Clock::now() < end) {
+  }
+}
+
+// Transfer as before: under the profiler mutex, numbering the iteration and
+// appending to the trace buffers.
+class MutexIngestion {
+ public:
+  void transfer(std::unique_ptr<CpuTraceBuffer> trace) {
+    std::lock_guard<std::recursive_mutex> guard(mutex_);
+    trace->span.iteration = iterationCountMap_[trace->span.name]++;
+    cpu_.push_back(std::move(trace));
+  }
+
+  size_t collect(std::chrono::microseconds hold) {
+    std::lock_guard<std::recursive_mutex> guard(mutex_);
+    spinFor(hold);
+    const size_t count = cpu_.size();
+    cpu_.clear();
+    return count;
+  }
+
+ private:
+  std::recursive_mutex mutex_;
+  std::unordered_map<std::string, int> iterationCountMap_;
+  std::vector<std::unique_ptr<CpuTraceBuffer>> cpu_;
+};
+
+// Transfer through the lock-free queue; iterations are numbered when the
+// profiler drains it.
+class QueueIngestion {
+ public:
+  void transfer(std::unique_ptr<CpuTraceBuffer> trace) {
+    queue_.push(std::move(trace));
+  }
+
+  size_t collect(std::chrono::microseconds hold) {
+    std::lock_guard<std::recursive_mutex> guard(mutex_);
+    spinFor(hold);
+    queue_.drain([this](std::unique_ptr<CpuTraceBuffer>&& trace) {
+      trace->span.iteration = iterationCountMap_[trace->span.name]++;
+      cpu_.push_back(std::move(trace));
+    });
+    const size_t count = cpu_.size();
+    cpu_.clear();
+    return count;
+  }
+
+ private:
+  MpscQueue<std::unique_ptr<CpuTraceBuffer>> queue_;
+  std::recursive_mutex mutex_;
+  std::unordered_map<std::string, int> iterationCountMap_;
+  std::vector<std::unique_ptr<CpuTraceBuffer>> cpu_;
+};
+
+double percentile(const std::vector<int64_t>& sorted, double p) {
+  const auto index = static_cast<size_t>(p * (sorted.size() - 1));
+  return static_cast<double>(sorted[index]) / 1000.0;
+}
+
+template <class Ingestion>
+void runVariant(const char* name, const BenchmarkOptions& opts) {
+  Ingestion ingestion;
+  std::vector<std::vector<int64_t>> latencies(opts.threads);
+  std::vector<std::string> spanNames;
+  for (int t = 0; t < opts.threads; t++) {
+    // A few span names shared between threads, as for ProfilerStep.
+    spanNames.push_back("span" + std::to_string(t % 4));
+  }
+
+  std::atomic<bool> go{false};
+  std::atomic<int> running{opts.threads};
+  std::vector<std::thread> producers;
+  for (int t = 0; t < opts.threads; t++) {
+    producers.emplace_back([&, t] {
+      auto& samples = latencies[t];
+      samples.reserve(opts.transfers);
+      while (!go.load(std::memory_order_acquire)) {
+      }
+      for (int i = 0; i < opts.transfers; i++) {
+        spinFor(std::chrono::microseconds(opts.workUs));
+        auto trace = makeCpuTrace(spanNames[t]);
+        const auto start = Clock::now();
+        ingestion.transfer(std::move(trace));
+        samples.push_back(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now() - start)
+                .count());
+      }
+      running--;
+    });
+  }
+
+  const auto start = Clock::now();
+  go.store(true, std::memory_order_release);
+  size_t collected = 0;
+  while (running > 0) {
+    std::this_thread::sleep_for(
+        std::chrono::microseconds(opts.drainIntervalUs));
+    collected += ingestion.collect(std::chrono::microseconds(opts.holdUs));
+  }
+  for (auto& p : producers) {
+    p.join();
+  }
+  collected += ingestion.collect(std::chrono::microseconds(0));
+  const double wallMs =
+      std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+  std::vector<int64_t> all;
+  for (const auto& samples : latencies) {
+    all.insert(all.end(), samples.begin(), samples.end());
+  }
+  std::sort(all.begin(), all.end());
+  fmt::print(
+      "{:<14} p50 {:9.2f} us  p90 {:9.2f} us  p99 {:9.2f} us  "
+      "p99.9 {:9.2f} us  max {:9.2f} us  ({} buffers, {:.1f} ms)\n",
+      name,
+      percentile(all, 0.5),
+      percentile(all, 0.9),
+      percentile(all, 0.99),
+      percentile(all, 0.999),
+      percentile(all, 1.0),
+      collected,
+      wallMs);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  BenchmarkOptions opts = parseArgs(argc, argv);
+  if (opts.threads <= 0 || opts.transfers <= 0 || opts.workUs < 0 ||
+      opts.drainIntervalUs < 0 || opts.holdUs < 0) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  fmt::print(
+      "CPU trace ingestion benchmark: {} producers x {} transfers every "
+      "{} us, profiler collects every {} us and works for {} us\n",
+      opts.threads,
+      opts.transfers,
+      opts.workUs,
+      opts.drainIntervalUs,
+      opts.holdUs);
+  runVariant<MutexIngestion>("mutex", opts);
+  runVariant<QueueIngestion>("MpscQueue", opts);
+  return 0;
+}
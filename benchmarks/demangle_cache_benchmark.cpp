@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// Benchmark for demangling kernel names, as done whenever a kernel record is
+// named. Replays a stream of lookups in which a few hundred kernels recur
+// with a Zipf-like frequency, the way the kernels of a training step do, and
+// compares demangling every name against the DemangleCache. Reports the time
+// per lookup and the cache's hit and miss counts.
+//
+// CMake usage:
+//   mkdir build && cd build
+//   cmake .. -DKINETO_BUILD_BENCHMARKS=ON
+//   make demangle_cache_benchmark
+//   ./benchmarks/demangle_cache_benchmark --kernels=500 --threads=4
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "Demangle.h"
+
+namespace {
+
+using namespace libkineto;
+
+struct BenchmarkOptions {
+  int kernels = 300;
+  int lookups = 1000000;
+  int threads = 1;
+  // Exponent of the Zipf distribution of kernel launches.
+  double skew = 1.1;
+  int capacity = static_cast<int>(DemangleCache::kDefaultCapacity);
+};
+
+void printUsage(const char* progname) {
+  fmt::print("Usage: {} [options]\n", progname);
+  fmt::print("Options:\n");
+  fmt::print("  --kernels=<n>          Distinct kernel names (default: 300)\n");
+  fmt::print(
+      "  --lookups=<n>          Lookups per thread (default: 1000000)\n");
+  fmt::print(
+      "  --threads=<n>          Threads looking up names (default: 1)\n");
+  fmt::print(
+      "  --skew=<x>             Zipf exponent of the name distribution "
+      "(default: 1.1)\n");
+  fmt::print(
+      "  --capacity=<n>         Cache capacity (default: {})\n",
+      DemangleCache::kDefaultCapacity);
+  fmt::print("  --help                 Show this help\n");
+}
+
+BenchmarkOptions parseArgs(int argc, char* argv[]) {
+  BenchmarkOptions opts;
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (strncmp(arg, "--kernels=", 10) == 0) {
+      opts.kernels = std::atoi(arg + 10);
+    } else if (strncmp(arg, "--lookups=", 10) == 0) {
+      opts.lookups = std::atoi(arg + 10);
+    } else if (strncmp(arg, "--threads=", 10) == 0) {
+      opts.threads = std::atoi(arg + 10);
+    } else if (strncmp(arg, "--skew=", 7) == 0) {
+      opts.skew = std::atof(arg + 7);
+    } else if (strncmp(arg, "--capacity=", 11) == 0) {
+      opts.capacity = std::atoi(arg + 11);
+    } else if (strcmp(arg, "--help") == 0) {
+      printUsage(argv[0]);
+      std::exit(0);
+    } else {
+      fmt::print(stderr, "Unknown argument: {}\n", arg);
+      printUsage(argv[0]);
+      std::exit(1);
+    }
+  }
+  return opts;
+}
+
+using Clock = std::chrono::steady_clock;
+
+// Mangled names of templated kernels in the style of ATen's, e.g.
+// void at::native::reduce_kernel<512, 1>().
+std::vector<std::string> makeKernelNames(int count) {
+  static const char* kBases[] = {
+      "reduce_kernel",
+      "vectorized_elementwise_kernel",
+      "unrolled_elementwise_kernel",
+      "indexSelectLargeIndex",
+      "batch_norm_collect_statistics_kernel",
+      "cunn_SoftMaxForward",
+      "fused_dropout_kernel",
+      "elementwise_kernel",
+  };
+  constexpr size_t kNumBases = sizeof(kBases) / sizeof(kBases[0]);
+  std::vector<std::string> names;
+  names.reserve(count);
+  for (int i = 0; i < count; i++) {
+    const std::string base = kBases[i % kNumBases];
+    names.push_back(fmt::format(
+        "_ZN2at6native{}{}ILi{}ELi{}EEEvv",
+        base.size(),
+        base,
+        128 << (i % 4),
+        i / kNumBases));
+  }
+  return names;
+}
+
+// Indices into the kernel names, in launch order.
+std::vector<int> makeLaunches(const BenchmarkOptions& opts, int seed) {
+  std::vector<double> weights;
+  for (int i = 0; i < opts.kernels; i++) {
+    weights.push_back(1.0 / std::pow(i + 1, opts.skew));
+  }
+  std::discrete_distribution<int> distribution(weights.begin(), weights.end());
+  std::mt19937 rng(seed);
+  std::vector<int> launches;
+  launches.reserve(opts.lookups);
+  for (int i = 0; i < opts.lookups; i++) {
+    launches.push_back(distribution(rng));
+  }
+  return launches;
+}
+
+template <class Demangler>
+double run(
+    const std::vector<std::string>& names,
+    const std::vector<std::vector<int>>& launches,
+    Demangler&& demangler) {
+  const auto start = Clock::now();
+  std::vector<std::thread> threads;
+  std::vector<size_t> lengths(launches.size());
+  for (size_t t = 0; t < launches.size(); t++) {
+    threads.emplace_back([&, t] {
+      size_t length = 0;
+      for (int index : launches[t]) {
+        length += demangler(names[index].c_str()).size();
+      }
+      lengths[t] = length;
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  return std::chrono::duration<double, std::nano>(Clock::now() - start)
+      .count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  BenchmarkOptions opts = parseArgs(argc, argv);
+  if (opts.kernels <= 0 || opts.lookups <= 0 || opts.threads <= 0 ||
+      opts.capacity <= 0) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  const auto names = makeKernelNames(opts.kernels);
+  std::vector<std::vector<int>> launches;
+  for (int t = 0; t < opts.threads; t++) {
+    launches.push_back(makeLaunches(opts, t));
+  }
+  const double lookups = static_cast<double>(opts.lookups) * opts.threads;
+
+  fmt::print(
+      "Demangle benchmark: {} kernels, {} lookups x {} threads, skew {}\n",
+      opts.kernels,
+      opts.lookups,
+      opts.threads,
+      opts.skew);
+
+  const double uncachedNs = run(names, launches, demangleUncached);
+  fmt::print("{:<10} {:8.1f} ns/lookup\n", "uncached", uncachedNs / lookups);
+
+  DemangleCache cache(opts.capacity);
+  const double cachedNs = run(
+      names, launches, [&](const char* name) -> const std::string& {
+        return cache.demangle(name);
+      });
+  const DemangleCacheStats stats = cache.stats();
+  fmt::print(
+      "{:<10} {:8.1f} ns/lookup  ({:.1f}x)  hits {} misses {} "
+      "uncached {} size {}\n",
+      "cached",
+      cachedNs / lookups,
+      uncachedNs / cachedNs,
+      stats.hits,
+      stats.misses,
+      stats.uncached,
+      stats.size);
+  return 0;
+}
@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// Benchmark for the sample storage and percentiles of the event profiler.
+//
+// The first part replays what Event does for each report: samples with a
+// value per SM are added, summed per SM over each slice of the report, the
+// SM percentiles of each slice are computed, and the reported samples are
+// erased. It compares the previous std::list of per-sample vectors with
+// std::nth_element percentiles against SampleBuffer with QuantileSketch.
+//
+// The second part computes percentiles of a stream of n values, kept in a
+// vector for std::nth_element or added to a QuantileSketch, and reports the
+// values held and the rank error of the sketch.
+//
+// CMake usage:
+//   mkdir build && cd build
+//   cmake .. -DKINETO_BUILD_BENCHMARKS=ON
+//   make event_percentiles_benchmark
+//   ./benchmarks/event_percentiles_benchmark --instances=132 --reports=1000
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <list>
+#include <numeric>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "QuantileSketch.h"
+#include "SampleBuffer.h"
+
+namespace {
+
+using namespace libkineto;
+
+struct BenchmarkOptions {
+  // Domain instances, e.g. SMs.
+  int instances = 80;
+  int samplesPerReport = 100;
+  int slicesPerReport = 10;
+  int reports = 1000;
+  int64_t values = 10000000;
+};
+
+void printUsage(const char* progname) {
+  fmt::print("Usage: {} [options]\n", progname);
+  fmt::print("Options:\n");
+  fmt::print("  --instances=<n>   Values per sample (default: 80)\n");
+  fmt::print("  --samples=<n>     Samples per report (default: 100)\n");
+  fmt::print("  --slices=<n>      Slices per report (default: 10)\n");
+  fmt::print("  --reports=<n>     Reports (default: 1000)\n");
+  fmt::print("  --values=<n>      Most streamed values (default: 10000000)\n");
+  fmt::print("  --help            Show this help\n");
+}
+
+BenchmarkOptions parseArgs(int argc, char* argv[]) {
+  BenchmarkOptions opts;
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (strncmp(arg, "--instances=", 12) == 0) {
+      opts.instances = std::atoi(arg + 12);
+    } else if (strncmp(arg, "--samples=", 10) == 0) {
+      opts.samplesPerReport = std::atoi(arg + 10);
+    } else if (strncmp(arg, "--slices=", 9) == 0) {
+      opts.slicesPerReport = std::atoi(arg + 9);
+    } else if (strncmp(arg, "--reports=", 10) == 0) {
+      opts.reports = std::atoi(arg + 10);
+    } else if (strncmp(arg, "--values=", 9) == 0) {
+      opts.values = std::atoll(arg + 9);
+    } else if (strcmp(arg, "--help") == 0) {
+      printUsage(argv[0]);
+      std::exit(0);
+    } else {
+      fmt::print(stderr, "Unknown argument: {}\n", arg);
+      printUsage(argv[0]);
+      std::exit(1);
+    }
+  }
+  return opts;
+}
+
+using Clock = std::chrono::steady_clock;
+using Timestamp = std::chrono::time_point<std::chrono::system_clock>;
+
+const std::vector<int> kPercents = {5, 10, 50, 90, 95};
+
+double msSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+// The previous percentiles() helper.
+std::vector<int64_t> nthElementPercentiles(std::vector<int64_t> values) {
+  std::vector<int64_t> result;
+  const size_t size = values.size();
+  for (int p : kPercents) {
+    const size_t idx = std::min(size - 1, (p * size) / 100);
+    std::nth_element(values.begin(), values.begin() + idx, values.end());
+    result.push_back(values[idx]);
+  }
+  return result;
+}
+
+std::vector<int64_t> sketchPercentiles(const std::vector<int64_t>& values) {
+  QuantileSketch<int64_t> sketch;
+  for (int64_t value : values) {
+    sketch.add(value);
+  }
+  return sketch.percentiles(kPercents);
+}
+
+// The previous Event storage.
+class ListEvent {
+ public:
+  void addSample(Timestamp t, const std::vector<int64_t>& values) {
+    samples_.emplace_back(t, values);
+  }
+
+  int64_t sumInstance(int i, size_t begin, size_t count) const {
+    auto start = samples_.cbegin();
+    std::advance(start, begin);
+    auto end = start;
+    std::advance(end, count);
+    return std::accumulate(
+        start, end, int64_t{0}, [i](int64_t a, const Sample& b) {
+          return a + b.second[i];
+        });
+  }
+
+  void eraseSamples(size_t count) {
+    auto end = samples_.begin();
+    std::advance(end, count);
+    samples_.erase(samples_.begin(), end);
+  }
+
+ private:
+  using Sample = std::pair<Timestamp, std::vector<int64_t>>;
+  std::list<Sample> samples_;
+};
+
+class BufferEvent {
+ public:
+  void addSample(Timestamp t, const std::vector<int64_t>& values) {
+    samples_.push(t, values);
+  }
+
+  int64_t sumInstance(int i, size_t begin, size_t count) const {
+    return samples_.sum(i, begin, count);
+  }
+
+  void eraseSamples(size_t count) {
+    samples_.popFront(count);
+  }
+
+ private:
+  SampleBuffer samples_;
+};
+
+// Adds a report's worth of samples, reports each slice and erases the
+// samples. Returns a checksum of the percentiles.
+template <class Event, class Percentiles>
+int64_t runReports(
+    const BenchmarkOptions& opts,
+    const std::vector<std::vector<int64_t>>& samples,
+    Percentiles percentiles) {
+  Event event;
+  const auto t = std::chrono::system_clock::now();
+  const size_t sliceSize = opts.samplesPerReport / opts.slicesPerReport;
+  int64_t checksum = 0;
+  size_t next = 0;
+  std::vector<int64_t> perInstance(opts.instances);
+  for (int r = 0; r < opts.reports; r++) {
+    for (int s = 0; s < opts.samplesPerReport; s++) {
+      event.addSample(t, samples[next++ % samples.size()]);
+    }
+    for (int slice = 0; slice < opts.slicesPerReport; slice++) {
+      for (int i = 0; i < opts.instances; i++) {
+        perInstance[i] = event.sumInstance(i, slice * sliceSize, sliceSize);
+      }
+      for (int64_t value : percentiles(perInstance)) {
+        checksum += value;
+      }
+    }
+    event.eraseSamples(opts.samplesPerReport);
+  }
+  return checksum;
+}
+
+// Fraction of the values between the rank asked for and the estimate.
+double maxRankError(
+    const std::vector<int64_t>& sorted,
+    const std::vector<int64_t>& estimates) {
+  const double n = static_cast<double>(sorted.size());
+  double worst = 0;
+  for (size_t i = 0; i < kPercents.size(); i++) {
+    const double rank = std::min(
+        n - 1, static_cast<double>(kPercents[i] * sorted.size() / 100));
+    const auto range =
+        std::equal_range(sorted.begin(), sorted.end(), estimates[i]);
+    const double lo = static_cast<double>(range.first - sorted.begin());
+    const double hi = static_cast<double>(range.second - sorted.begin()) - 1;
+    const double error = rank < lo ? lo - rank : rank > hi ? rank - hi : 0;
+    worst = std::max(worst, error / n);
+  }
+  return worst;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  BenchmarkOptions opts = parseArgs(argc, argv);
+  if (opts.instances <= 0 || opts.slicesPerReport <= 0 ||
+      opts.samplesPerReport < opts.slicesPerReport || opts.reports <= 0 ||
+      opts.values <= 0) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  std::mt19937_64 rng(42);
+  std::vector<std::vector<int64_t>> samples(1024);
+  for (auto& sample : samples) {
+    for (int i = 0; i < opts.instances; i++) {
+      sample.push_back(static_cast<int64_t>(rng() % 100000));
+    }
+  }
+  fmt::print(
+      "Event reports: {} instances, {} samples in {} slices, {} reports\n",
+      opts.instances,
+      opts.samplesPerReport,
+      opts.slicesPerReport,
+      opts.reports);
+  auto start = Clock::now();
+  const int64_t listSum =
+      runReports<ListEvent>(opts, samples, nthElementPercentiles);
+  const double listMs = msSince(start);
+  start = Clock::now();
+  const int64_t bufferSum =
+      runReports<BufferEvent>(opts, samples, sketchPercentiles);
+  const double bufferMs = msSince(start);
+  fmt::print(
+      "  list + nth_element {:9.2f} ms  buffer + sketch {:9.2f} ms  "
+      "({:.1f}x){}\n",
+      listMs,
+      bufferMs,
+      listMs / bufferMs,
+      listSum == bufferSum ? "" : "  MISMATCH");
+
+  fmt::print("Streamed percentiles ({} percentiles):\n", kPercents.size());
+  for (int64_t n = 1000; n <= opts.values; n *= 10) {
+    std::vector<int64_t> values(n);
+    std::exponential_distribution<double> exponential(1e-4);
+    for (auto& value : values) {
+      value = static_cast<int64_t>(exponential(rng));
+    }
+    start = Clock::now();
+    const auto exact = nthElementPercentiles(values);
+    const double exactMs = msSince(start);
+    start = Clock::now();
+    QuantileSketch<int64_t> sketch;
+    for (int64_t value : values) {
+      sketch.add(value);
+    }
+    const auto estimates = sketch.percentiles(kPercents);
+    const double sketchMs = msSince(start);
+    std::sort(values.begin(), values.end());
+    fmt::print(
+        "{:>10} values  nth_element {:8.2f} ms, {:>9} held  "
+        "sketch {:8.2f} ms, {:>4} held, rank error {:.2f}%{}\n",
+        n,
+        exactMs,
+        values.size(),
+        sketchMs,
+        sketch.retained(),
+        100 * maxRankError(values, estimates),
+        maxRankError(values, exact) == 0 ? "" : "  MISMATCH");
+  }
+  return 0;
+}
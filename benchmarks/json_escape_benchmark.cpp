@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// Benchmark for escaping event names for the JSON trace. Compares the
+// previous multi-pass escaping (sanitizeStrForJSON(),
+// sanitizeForNonReadableChars() and escapeQuotesForJSON() on a copy of the
+// name) against the single-pass escapeJsonName() on several kinds of names:
+// short op names, Python call stacks, dynamo names with quoted dicts, and
+// long quote-heavy module hierarchies. Reports throughput and time per name.
+//
+// CMake usage:
+//   mkdir build && cd build
+//   cmake .. -DKINETO_BUILD_BENCHMARKS=ON
+//   make json_escape_benchmark
+//   ./benchmarks/json_escape_benchmark --bytes=100000000
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fmt/core.h>
+#include <fmt/format.h>
+
+#include "JsonEscape.h"
+
+namespace {
+
+using namespace libkineto;
+
+struct BenchmarkOptions {
+  // Input bytes escaped per workload and variant.
+  int64_t bytes = 50000000;
+  int runs = 3;
+};
+
+void printUsage(const char* progname) {
+  fmt::print("Usage: {} [options]\n", progname);
+  fmt::print("Options:\n");
+  fmt::print(
+      "  --bytes=<n>            Bytes escaped per workload (default: "
+      "50000000)\n");
+  fmt::print("  --runs=<n>             Runs, best is reported (default: 3)\n");
+  fmt::print("  --help                 Show this help\n");
+}
+
+BenchmarkOptions parseArgs(int argc, char* argv[]) {
+  BenchmarkOptions opts;
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (strncmp(arg, "--bytes=", 8) == 0) {
+      opts.bytes = std::atoll(arg + 8);
+    } else if (strncmp(arg, "--runs=", 7) == 0) {
+      opts.runs = std::atoi(arg + 7);
+    } else if (strcmp(arg, "--help") == 0) {
+      printUsage(argv[0]);
+      std::exit(0);
+    } else {
+      fmt::print(stderr, "Unknown argument: {}\n", arg);
+      printUsage(argv[0]);
+      std::exit(1);
+    }
+  }
+  return opts;
+}
+
+using Clock = std::chrono::steady_clock;
+
+struct Workload {
+  const char* name;
+  std::vector<std::string> names;
+};
+
+std::vector<Workload> makeWorkloads() {
+  std::vector<Workload> workloads;
+  workloads.push_back(
+      {"op names",
+       {"aten::addmm",
+        "aten::linear",
+        "aten::native_layer_norm",
+        "cudaLaunchKernel",
+        "void at::native::vectorized_elementwise_kernel<4>"}});
+
+  std::string stack;
+  for (int i = 0; i < 6; i++) {
+    stack += fmt::format(
+        "torch/nn/modules/module.py({}): _call_impl\n"
+        "model\\layers\\block_{}.py({}): forward\n",
+        1500 + i,
+        i,
+        40 + i);
+  }
+  workloads.push_back({"call stack", {stack}});
+
+  workloads.push_back(
+      {"dynamo name",
+       {R"(torch/_dynamo/eval_frame.py(632): _fn {"device": "cuda", )"
+        R"("dtype": "float32", "requires_grad": false}(12): run)"}});
+
+  std::string hierarchy;
+  for (int i = 0; i < 64; i++) {
+    hierarchy += fmt::format(
+        R"(nn.Module: {{"name": "layers.{}", "type": "TransformerBlock"}};)",
+        i);
+  }
+  workloads.push_back({"module hierarchy", {hierarchy}});
+  return workloads;
+}
+
+std::string escapeMultiPass(const std::string& name) {
+  std::string value = name;
+  sanitizeStrForJSON(value);
+  sanitizeForNonReadableChars(value);
+  escapeQuotesForJSON(value);
+  return value;
+}
+
+template <class Escape>
+double run(
+    const BenchmarkOptions& opts,
+    const Workload& workload,
+    int64_t& iterations,
+    Escape&& escape) {
+  int64_t bytesPerPass = 0;
+  for (const auto& name : workload.names) {
+    bytesPerPass += static_cast<int64_t>(name.size());
+  }
+  iterations = std::max<int64_t>(1, opts.bytes / bytesPerPass);
+  double best = 1e30;
+  for (int r = 0; r < opts.runs; r++) {
+    size_t sink = 0;
+    const auto start = Clock::now();
+    for (int64_t i = 0; i < iterations; i++) {
+      for (const auto& name : workload.names) {
+        sink += escape(name);
+      }
+    }
+    best = std::min(
+        best,
+        std::chrono::duration<double, std::nano>(Clock::now() - start)
+            .count());
+    if (sink == 42) {
+      fmt::print("");
+    }
+  }
+  return best;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  BenchmarkOptions opts = parseArgs(argc, argv);
+  if (opts.bytes <= 0 || opts.runs <= 0) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  fmt::print("JSON name escaping benchmark: {} bytes per run\n", opts.bytes);
+  for (const Workload& workload : makeWorkloads()) {
+    int64_t bytes = 0;
+    for (const auto& name : workload.names) {
+      bytes += static_cast<int64_t>(name.size());
+    }
+    int64_t iterations = 0;
+    const double multiNs = run(
+        opts, workload, iterations, [](const std::string& name) {
+          return escapeMultiPass(name).size();
+        });
+    fmt::memory_buffer out;
+    const double singleNs = run(
+        opts, workload, iterations, [&out](const std::string& name) {
+          out.clear();
+          appendEscapedJsonName(out, name);
+          return out.size();
+        });
+    const double names =
+        static_cast<double>(iterations) * workload.names.size();
+    const double mb = static_cast<double>(iterations) * bytes / 1e6;
+    fmt::print(
+        "{:<17} {:5} bytes/name  multi-pass {:7.1f} ns/name {:7.0f} MB/s  "
+        "single-pass {:7.1f} ns/name {:7.0f} MB/s  ({:.1f}x)\n",
+        workload.name,
+        bytes / static_cast<int64_t>(workload.names.size()),
+        multiNs / names,
+        mb / (multiNs / 1e9),
+        singleNs / names,
+        mb / (singleNs / 1e9),
+        multiNs / singleNs);
+  }
+  return 0;
+}
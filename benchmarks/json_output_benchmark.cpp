@@ -8,6 +8,8 @@
 
 // Benchmark for measuring JSON output file writing performance in Kineto.
 // Tests small (<1KB), medium (~1MB), and large (~1GB) JSON file scenarios.
+// --format=perfetto writes the same activities as a binary Perfetto trace
+// instead, to compare write time and file size.
 //
 // CMake usage:
 //   mkdir build && cd build
@@ -22,6 +24,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <filesystem>
+#include <memory>
 #include <numeric>
 #include <random>
 #include <ratio>
@@ -37,6 +40,7 @@
 #include "GenericTraceActivity.h"
 #include "TraceSpan.h"
 #include "output_json.h"
+#include "output_perfetto.h"
 #include "time_since_epoch.h"
 
 namespace {
@@ -47,6 +51,7 @@ using namespace libkineto;
 struct BenchmarkOptions {
   std::string scenario = "all";
   std::string output_dir = "/tmp";
+  std::string format = "json";
   int small_iterations = 100;
   int medium_iterations = 20;
   int large_iterations = 5;
@@ -60,6 +65,8 @@ void printUsage(const char* progname) {
       "  --scenario=<small|medium|large|all>  Scenario to run (default: all)\n");
   fmt::print(
       "  --output_dir=<path>                  Output directory (default: /tmp)\n");
+  fmt::print(
+      "  --format=<json|perfetto>             Trace format (default: json)\n");
   fmt::print(
       "  --small_iterations=<n>               Iterations for small (default: 100)\n");
   fmt::print(
@@ -79,6 +86,8 @@ BenchmarkOptions parseArgs(int argc, char* argv[]) {
       opts.scenario = arg.substr(11);
     } else if (arg.starts_with("--output_dir=")) {
       opts.output_dir = arg.substr(13);
+    } else if (arg.starts_with("--format=")) {
+      opts.format = arg.substr(9);
     } else if (arg.starts_with("--small_iterations=")) {
       opts.small_iterations = std::stoi(arg.substr(19));
     } else if (arg.starts_with("--medium_iterations=")) {
@@ -213,15 +222,26 @@ std::vector<GenericTraceActivity> generateActivities(
   return activities;
 }
 
+std::unique_ptr<ActivityLogger> makeLogger(
+    const std::string& format,
+    const std::string& outputPath) {
+  if (format == "perfetto") {
+    return std::make_unique<PerfettoTraceLogger>(outputPath);
+  }
+  return std::make_unique<ChromeTraceLogger>(outputPath);
+}
+
 // Run a single benchmark iteration, returns time in milliseconds
 double runBenchmarkIteration(
     const std::vector<GenericTraceActivity>& activities,
     const TraceSpan& span,
+    const std::string& format,
     const std::string& outputPath) {
   auto start = std::chrono::steady_clock::now();
 
   {
-    ChromeTraceLogger logger(outputPath);
+    auto loggerPtr = makeLogger(format, outputPath);
+    ActivityLogger& logger = *loggerPtr;
 
     // Initialize the trace with empty metadata
     std::unordered_map<std::string, std::string> metadata;
@@ -302,6 +322,7 @@ void runScenario(
     const std::string& name,
     size_t activityCount,
     int iterations,
+    const std::string& format,
     const std::string& outputDir,
     bool keepFiles) {
   fmt::print(
@@ -320,12 +341,14 @@ void runScenario(
   // Generate activities once (not included in timing)
   auto activities = generateActivities(span, activityCount, rng);
 
-  std::string outputPath = outputDir + "/benchmark_" + name + ".json";
+  std::string outputPath = outputDir + "/benchmark_" + name +
+      (format == "perfetto" ? ".pftrace" : ".json");
   std::vector<double> times;
   times.reserve(iterations);
 
   for (int i = 0; i < iterations; ++i) {
-    times.push_back(runBenchmarkIteration(activities, span, outputPath));
+    times.push_back(
+        runBenchmarkIteration(activities, span, format, outputPath));
   }
 
   // Get file size from last iteration
@@ -354,6 +377,11 @@ int main(int argc, char* argv[]) {
   // Initialize ChromeTraceBaseTime singleton
   ChromeTraceBaseTime::singleton().init();
 
+  if (opts.format != "json" && opts.format != "perfetto") {
+    fmt::print("Unknown format: {}\n", opts.format);
+    printUsage(argv[0]);
+    return 1;
+  }
   fmt::print("Output directory: {}\n", opts.output_dir);
 
   const bool runSmall = opts.scenario == "all" || opts.scenario == "small";
@@ -363,7 +391,12 @@ int main(int argc, char* argv[]) {
   // Small: ~5 activities, targeting <1KB
   if (runSmall) {
     runScenario(
-        "small", 5, opts.small_iterations, opts.output_dir, opts.keep_files);
+        "small",
+        5,
+        opts.small_iterations,
+        opts.format,
+        opts.output_dir,
+        opts.keep_files);
   }
 
   // Medium: ~6000 activities, targeting ~1MB
@@ -372,6 +405,7 @@ int main(int argc, char* argv[]) {
         "medium",
         6000,
         opts.medium_iterations,
+        opts.format,
         opts.output_dir,
         opts.keep_files);
   }
@@ -384,6 +418,7 @@ int main(int argc, char* argv[]) {
         "large",
         6000000,
         opts.large_iterations,
+        opts.format,
         opts.output_dir,
         opts.keep_files);
   }
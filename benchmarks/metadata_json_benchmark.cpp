@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// Benchmark for writing the metadata of metadata-heavy events to a JSON
+// trace. Logs CPU ops carrying the metadata the PyTorch profiler records for
+// them (input shapes, strides and types, ids, call stack) through the
+// ChromeTraceLogger, and compares streaming the typed metadata into the event
+// args against rendering metadataJson() into a string and sanitizing it
+// first, as was done before. Reports time, heap allocations and bytes per
+// event.
+//
+// CMake usage:
+//   mkdir build && cd build
+//   cmake .. -DKINETO_BUILD_BENCHMARKS=ON
+//   make metadata_json_benchmark
+//   ./benchmarks/metadata_json_benchmark --events=200000 --output_dir=/tmp
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "Config.h"
+#include "GenericTraceActivity.h"
+#include "MetadataFieldCatalog.h"
+#include "TraceSpan.h"
+#include "output_json.h"
+
+namespace {
+
+std::atomic<int64_t> allocationCount{0};
+std::atomic<int64_t> allocatedBytes{0};
+
+} // namespace
+
+// Count every heap allocation made by the benchmark.
+void* operator new(size_t size) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  allocatedBytes.fetch_add(
+      static_cast<int64_t>(size), std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+// Not inlined: GCC would otherwise pair the std::free() here with the
+// operator new at inlined call sites and flag a mismatched deallocation.
+[[gnu::noinline]] void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+[[gnu::noinline]] void operator delete(void* p, size_t /*size*/) noexcept {
+  std::free(p);
+}
+
+namespace {
+
+using namespace libkineto;
+namespace Fields = GenericMetadataFields;
+
+struct BenchmarkOptions {
+  int events = 100000;
+  int runs = 3;
+  std::string outputDir = "/tmp";
+};
+
+void printUsage(const char* progname) {
+  fmt::print("Usage: {} [options]\n", progname);
+  fmt::print("Options:\n");
+  fmt::print("  --events=<n>           Events per trace (default: 100000)\n");
+  fmt::print("  --runs=<n>             Runs, best is reported (default: 3)\n");
+  fmt::print("  --output_dir=<path>    Trace directory (default: /tmp)\n");
+  fmt::print("  --help                 Show this help\n");
+}
+
+BenchmarkOptions parseArgs(int argc, char* argv[]) {
+  BenchmarkOptions opts;
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (strncmp(arg, "--events=", 9) == 0) {
+      opts.events = std::atoi(arg + 9);
+    } else if (strncmp(arg, "--runs=", 7) == 0) {
+      opts.runs = std::atoi(arg + 7);
+    } else if (strncmp(arg, "--output_dir=", 13) == 0) {
+      opts.outputDir = arg + 13;
+    } else if (strcmp(arg, "--help") == 0) {
+      printUsage(argv[0]);
+      std::exit(0);
+    } else {
+      fmt::print(stderr, "Unknown argument: {}\n", arg);
+      printUsage(argv[0]);
+      std::exit(1);
+    }
+  }
+  return opts;
+}
+
+using Clock = std::chrono::steady_clock;
+
+// An activity whose metadata the logger renders through metadataJson(), the
+// way all metadata was written before it was streamed. The logger only
+// streams the metadata of GenericTraceActivity itself, not of subclasses.
+class MaterializedActivity : public GenericTraceActivity {
+ public:
+  using GenericTraceActivity::GenericTraceActivity;
+};
+
+// Metadata of an aten::addmm call as recorded by the PyTorch profiler.
+template <class Activity>
+std::vector<Activity> makeEvents(const TraceSpan& span, int count) {
+  const InputShapes inputDims{
+      std::vector<int64_t>{512},
+      std::vector<int64_t>{64, 1024},
+      std::vector<int64_t>{1024, 512}};
+  const InputShapes inputStrides{
+      std::vector<int64_t>{1},
+      std::vector<int64_t>{1024, 1},
+      std::vector<int64_t>{1, 1024}};
+  const std::vector<std::string> inputTypes{
+      "float", "float", "float", "Scalar"};
+  const std::vector<std::string> concreteInputs{"", "", "", "1"};
+
+  std::vector<Activity> events;
+  events.reserve(count);
+  for (int i = 0; i < count; i++) {
+    Activity& act =
+        events.emplace_back(span, ActivityType::CPU_OP, "aten::addmm");
+    act.startTime = span.startTime + 1000L * i;
+    act.endTime = act.startTime + 800;
+    act.id = i + 1;
+    act.device = 1234;
+    act.resource = 5678;
+    act.addMetadata(Fields::kInputDims, inputDims);
+    act.addMetadata(Fields::kInputStrides, inputStrides);
+    act.addMetadata(Fields::kInputType, inputTypes);
+    act.addMetadata(Fields::kConcreteInputs, concreteInputs);
+    act.addMetadata(Fields::kSequenceNumber, int64_t{i});
+    act.addMetadata(Fields::kFwdThreadId, uint64_t{1});
+    act.addMetadata(Fields::kRecordFunctionId, static_cast<uint64_t>(i));
+    act.addMetadata(Fields::kEvIdx, int64_t{i});
+    act.addMetadata(
+        "Call stack",
+        "\"model.py(42): forward;nn/modules/linear.py(125): forward\"");
+  }
+  return events;
+}
+
+struct Result {
+  double ms{1e30};
+  int64_t allocations{0};
+  int64_t bytes{0};
+  uintmax_t fileSize{0};
+};
+
+template <class Activity>
+Result run(const BenchmarkOptions& opts, const std::string& name) {
+  const TraceSpan span(0, 1000L * opts.events, "metadata");
+  const auto events = makeEvents<Activity>(span, opts.events);
+  const std::string path = opts.outputDir + "/metadata_json_" + name + ".json";
+  Result best;
+  for (int run = 0; run < opts.runs; run++) {
+    const int64_t allocsBefore = allocationCount.load();
+    const int64_t bytesBefore = allocatedBytes.load();
+    const auto start = Clock::now();
+    {
+      ChromeTraceLogger logger(path);
+      logger.handleTraceStart({}, "");
+      for (const auto& event : events) {
+        event.log(logger);
+      }
+      logger.finalizeTrace(Config(), nullptr, span.endTime);
+    }
+    const double ms =
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count();
+    if (ms < best.ms) {
+      best.ms = ms;
+      best.allocations = allocationCount.load() - allocsBefore;
+      best.bytes = allocatedBytes.load() - bytesBefore;
+    }
+  }
+  best.fileSize = std::filesystem::file_size(path);
+  std::filesystem::remove(path);
+  return best;
+}
+
+void printResult(const char* name, const Result& result, int events) {
+  fmt::print(
+      "{:<13} {:7.1f} ns/event  {:5.1f} allocs/event  {:7.1f} bytes/event  "
+      "file {} bytes\n",
+      name,
+      result.ms * 1e6 / events,
+      static_cast<double>(result.allocations) / events,
+      static_cast<double>(result.bytes) / events,
+      result.fileSize);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  BenchmarkOptions opts = parseArgs(argc, argv);
+  if (opts.events <= 0 || opts.runs <= 0) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  ChromeTraceBaseTime::singleton().init();
+  fmt::print(
+      "Metadata JSON benchmark: {} events, {} runs\n", opts.events, opts.runs);
+  printResult(
+      "materialized",
+      run<MaterializedActivity>(opts, "materialized"),
+      opts.events);
+  printResult(
+      "streamed", run<GenericTraceActivity>(opts, "streamed"), opts.events);
+  return 0;
+}
@@ -0,0 +1,299 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// Benchmark for the metadata storage of GenericTraceActivity. Attaches the
+// metadata of a typical PyTorch CPU op (input shapes and types, sequence
+// number, thread and record function ids, ...) to many activities, both
+// through the typed MetadataField overloads and as string-keyed JSON, and
+// compares the previous std::unordered_map<std::string, TypedValue> layout
+// against interned keys in MetadataStorage. Reports time per op for adding,
+// looking up and destroying the metadata, and heap allocations and bytes per
+// op.
+//
+// CMake usage:
+//   mkdir build && cd build
+//   cmake .. -DKINETO_BUILD_BENCHMARKS=ON
+//   make metadata_storage_benchmark
+//   ./benchmarks/metadata_storage_benchmark --ops=1000000
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "GenericTraceActivity.h"
+#include "MetadataFieldCatalog.h"
+#include "TraceSpan.h"
+
+namespace {
+
+std::atomic<int64_t> allocationCount{0};
+std::atomic<int64_t> allocatedBytes{0};
+
+} // namespace
+
+// Count every heap allocation made by the benchmark.
+void* operator new(size_t size) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  allocatedBytes.fetch_add(
+      static_cast<int64_t>(size), std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+// Not inlined: GCC would otherwise pair the std::free() here with the
+// operator new at inlined call sites and flag a mismatched deallocation.
+[[gnu::noinline]] void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+[[gnu::noinline]] void operator delete(void* p, size_t /*size*/) noexcept {
+  std::free(p);
+}
+
+namespace {
+
+using namespace libkineto;
+namespace Fields = GenericMetadataFields;
+
+struct BenchmarkOptions {
+  int ops = 200000;
+  int runs = 3;
+};
+
+void printUsage(const char* progname) {
+  fmt::print("Usage: {} [options]\n", progname);
+  fmt::print("Options:\n");
+  fmt::print("  --ops=<n>              Activities (default: 200000)\n");
+  fmt::print("  --runs=<n>             Runs, best is reported (default: 3)\n");
+  fmt::print("  --help                 Show this help\n");
+}
+
+BenchmarkOptions parseArgs(int argc, char* argv[]) {
+  BenchmarkOptions opts;
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (strncmp(arg, "--ops=", 6) == 0) {
+      opts.ops = std::atoi(arg + 6);
+    } else if (strncmp(arg, "--runs=", 7) == 0) {
+      opts.runs = std::atoi(arg + 7);
+    } else if (strcmp(arg, "--help") == 0) {
+      printUsage(argv[0]);
+      std::exit(0);
+    } else {
+      fmt::print(stderr, "Unknown argument: {}\n", arg);
+      printUsage(argv[0]);
+      std::exit(1);
+    }
+  }
+  return opts;
+}
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+// The previous layout, with the same insertion semantics.
+struct MapMetadata {
+  template <typename T, typename V>
+  void addMetadata(const MetadataField<T>& field, const V& value) {
+    metadata.emplace(std::string{field.name}, TypedValue{value});
+  }
+  void addMetadata(const std::string& key, const std::string& value) {
+    metadata.emplace(key, RawJson{fmt::format("{}", value)});
+  }
+  std::string getMetadataValue(const std::string& key) const {
+    const auto it = metadata.find(key);
+    if (it == metadata.end()) {
+      return "";
+    }
+    const auto* raw = std::get_if<RawJson>(&it->second);
+    return raw != nullptr ? raw->value : "";
+  }
+  template <typename T>
+  std::optional<T> getMetadataValue(const MetadataField<T>& field) const {
+    const auto it = metadata.find(std::string{field.name});
+    if (it != metadata.end()) {
+      if (const T* value = std::get_if<T>(&it->second)) {
+        return *value;
+      }
+    }
+    return std::nullopt;
+  }
+
+  std::unordered_map<std::string, TypedValue> metadata;
+};
+
+// Metadata of an aten::addmm call as recorded by the PyTorch profiler.
+struct OpMetadata {
+  InputShapes inputDims{
+      std::vector<int64_t>{512},
+      std::vector<int64_t>{64, 1024},
+      std::vector<int64_t>{1024, 512}};
+  InputShapes inputStrides{
+      std::vector<int64_t>{1},
+      std::vector<int64_t>{1024, 1},
+      std::vector<int64_t>{1, 1024}};
+  std::vector<std::string> inputTypes{"float", "float", "float", "Scalar"};
+  std::vector<std::string> concreteInputs{"", "", "", "1"};
+};
+
+template <class Activity>
+void addTypedMetadata(Activity& act, const OpMetadata& op, int i) {
+  act.addMetadata(Fields::kInputDims, op.inputDims);
+  act.addMetadata(Fields::kInputStrides, op.inputStrides);
+  act.addMetadata(Fields::kInputType, op.inputTypes);
+  act.addMetadata(Fields::kConcreteInputs, op.concreteInputs);
+  act.addMetadata(Fields::kSequenceNumber, int64_t{i});
+  act.addMetadata(Fields::kFwdThreadId, uint64_t{1});
+  act.addMetadata(Fields::kRecordFunctionId, static_cast<uint64_t>(i));
+  act.addMetadata(Fields::kEvIdx, int64_t{i});
+}
+
+template <class Activity>
+void addStringMetadata(Activity& act, int i) {
+  act.addMetadata("Input Dims", "[[512], [64, 1024], [1024, 512]]");
+  act.addMetadata("Input type", "[\"float\", \"float\", \"float\"]");
+  act.addMetadata("Sequence number", std::to_string(i));
+  act.addMetadata("Fwd thread id", "1");
+  act.addMetadata("Record function id", std::to_string(i));
+  act.addMetadata("Ev Idx", std::to_string(i));
+}
+
+struct Result {
+  double addMs{1e30};
+  double lookupMs{1e30};
+  double destroyMs{1e30};
+  int64_t allocations{0};
+  int64_t bytes{0};
+};
+
+template <class Activity, class Add, class Lookup>
+Result runVariant(const BenchmarkOptions& opts, Add&& add, Lookup&& lookup) {
+  Result best;
+  for (int run = 0; run < opts.runs; run++) {
+    // Created up front so that only the metadata is measured.
+    auto activities = std::make_unique<std::vector<Activity>>(opts.ops);
+    const int64_t allocsBefore = allocationCount.load();
+    const int64_t bytesBefore = allocatedBytes.load();
+    auto start = Clock::now();
+    for (int i = 0; i < opts.ops; i++) {
+      add((*activities)[i], i);
+    }
+    best.addMs = std::min(best.addMs, elapsedMs(start));
+    best.allocations = allocationCount.load() - allocsBefore;
+    best.bytes = allocatedBytes.load() - bytesBefore;
+
+    start = Clock::now();
+    int64_t sink = 0;
+    for (int i = 0; i < opts.ops; i++) {
+      sink += lookup((*activities)[i]);
+    }
+    best.lookupMs = std::min(best.lookupMs, elapsedMs(start));
+    if (sink == 42) {
+      fmt::print("");
+    }
+
+    start = Clock::now();
+    activities.reset();
+    best.destroyMs = std::min(best.destroyMs, elapsedMs(start));
+  }
+  return best;
+}
+
+void printResult(
+    const char* workload,
+    const char* name,
+    const Result& result,
+    int ops) {
+  const double perOp = 1e6 / ops;
+  fmt::print(
+      "{:<7} {:<22} add {:7.1f} ns/op  lookup {:6.1f} ns/op  "
+      "destroy {:6.1f} ns/op  {:5.1f} allocs/op  {:6.1f} bytes/op\n",
+      workload,
+      name,
+      result.addMs * perOp,
+      result.lookupMs * perOp,
+      result.destroyMs * perOp,
+      static_cast<double>(result.allocations) / ops,
+      static_cast<double>(result.bytes) / ops);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  BenchmarkOptions opts = parseArgs(argc, argv);
+  if (opts.ops <= 0 || opts.runs <= 0) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  fmt::print(
+      "Metadata storage benchmark: {} ops, sizeof(GenericTraceActivity) = {}\n",
+      opts.ops,
+      sizeof(GenericTraceActivity));
+  const OpMetadata op;
+
+  const auto typedLookup = [](const auto& act) {
+    return act.getMetadataValue(Fields::kSequenceNumber).value_or(0) +
+        act.getMetadataValue(Fields::kEvIdx).value_or(0);
+  };
+  printResult(
+      "typed",
+      "unordered_map",
+      runVariant<MapMetadata>(
+          opts,
+          [&](MapMetadata& act, int i) { addTypedMetadata(act, op, i); },
+          typedLookup),
+      opts.ops);
+  printResult(
+      "typed",
+      "MetadataStorage",
+      runVariant<GenericTraceActivity>(
+          opts,
+          [&](GenericTraceActivity& act, int i) {
+            addTypedMetadata(act, op, i);
+          },
+          typedLookup),
+      opts.ops);
+
+  const auto stringLookup = [](const auto& act) {
+    return static_cast<int64_t>(
+        act.getMetadataValue("Sequence number").size() +
+        act.getMetadataValue("Ev Idx").size());
+  };
+  printResult(
+      "string",
+      "unordered_map",
+      runVariant<MapMetadata>(
+          opts,
+          [](MapMetadata& act, int i) { addStringMetadata(act, i); },
+          stringLookup),
+      opts.ops);
+  printResult(
+      "string",
+      "MetadataStorage",
+      runVariant<GenericTraceActivity>(
+          opts,
+          [](GenericTraceActivity& act, int i) { addStringMetadata(act, i); },
+          stringLookup),
+      opts.ops);
+  return 0;
+}
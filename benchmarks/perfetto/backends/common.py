@@ -16,6 +16,10 @@ from .. import BENCHMARK_DATA_DIR
 
 
 def _get_input_path(input_name):
+    # Inputs may also be paths to trace files, e.g. a binary trace written with
+    # a perfetto:// log url, to compare load times across trace formats.
+    if os.path.isfile(input_name):
+        return input_name
     input_name = f"{input_name}.json"
     return os.path.join(BENCHMARK_DATA_DIR, "torchbench_traces", input_name)
 
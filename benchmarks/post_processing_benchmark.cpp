@@ -0,0 +1,418 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// End-to-end benchmark for the trace post-processing pipeline. Drives a
+// GenericActivityProfiler through a full trace with a synthetic workload:
+// client threads hand over CPU spans with transferCpuTrace(), and a derived
+// profiler replays synthetic GPU runtime and kernel records, correlated with
+// the CPU ops, the way the CUPTI and roctracer profilers do. The trace is
+// processed into a MemoryTraceLogger, which is then replayed to a JSON file.
+//
+// For every stage, prints one JSON object per line with the wall time, the
+// number and size of heap allocations and the peak RSS so far:
+//   generate     building the CPU spans on the client threads (not kineto)
+//   transfer     transferCpuTrace() from all client threads
+//   stop         stopTrace()
+//   process_cpu  processTrace() up to the GPU records: draining the CPU
+//                spans, processCpuTrace() and the CPU-side correlation maps
+//   correlate    building the external correlation map for the GPU records
+//   process_gpu  linking and logging the GPU records
+//   finalize     the rest of processTrace(), mostly finalizeTrace()
+//   replay       replaying the MemoryTraceLogger into a ChromeTraceLogger
+//   reset        reset()
+//
+// CMake usage:
+//   mkdir build && cd build
+//   cmake .. -DKINETO_BUILD_BENCHMARKS=ON
+//   make post_processing_benchmark
+//   ./benchmarks/post_processing_benchmark --threads=8 --ops_per_span=1000
+//       --metadata=8
+
+#include <sys/resource.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "Config.h"
+#include "GenericActivityProfiler.h"
+#include "libkineto.h"
+#include "output_json.h"
+#include "output_membuf.h"
+#include "time_since_epoch.h"
+
+namespace {
+
+std::atomic<int64_t> allocationCount{0};
+std::atomic<int64_t> allocatedBytes{0};
+
+} // namespace
+
+// Count every heap allocation made by the benchmark.
+void* operator new(size_t size) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  allocatedBytes.fetch_add(
+      static_cast<int64_t>(size), std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+// Not inlined: GCC would otherwise pair the std::free() here with the
+// operator new at inlined call sites and flag a mismatched deallocation.
+[[gnu::noinline]] void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+[[gnu::noinline]] void operator delete(void* p, size_t /*size*/) noexcept {
+  std::free(p);
+}
+
+namespace {
+
+using namespace libkineto;
+using namespace std::chrono;
+
+struct BenchmarkOptions {
+  int threads = 4;
+  int spans = 16;
+  int opsPerSpan = 1000;
+  // Metadata entries per CPU op.
+  int metadata = 4;
+  // GPU kernels launched per CPU op, each with a runtime record.
+  int kernelsPerOp = 1;
+  int runs = 3;
+  std::string outputDir = "/tmp";
+};
+
+void printUsage(const char* progname) {
+  fmt::print("Usage: {} [options]\n", progname);
+  fmt::print("Options:\n");
+  fmt::print("  --threads=<n>          Client threads (default: 4)\n");
+  fmt::print("  --spans=<n>            Spans per thread (default: 16)\n");
+  fmt::print("  --ops_per_span=<n>     CPU ops per span (default: 1000)\n");
+  fmt::print("  --metadata=<n>         Metadata entries per op (default: 4)\n");
+  fmt::print(
+      "  --kernels_per_op=<n>   GPU kernels launched per op (default: 1)\n");
+  fmt::print("  --runs=<n>             Traces to run (default: 3)\n");
+  fmt::print(
+      "  --output_dir=<path>    Directory for the replayed trace "
+      "(default: /tmp)\n");
+  fmt::print("  --help                 Show this help\n");
+}
+
+BenchmarkOptions parseArgs(int argc, char* argv[]) {
+  BenchmarkOptions opts;
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (strncmp(arg, "--threads=", 10) == 0) {
+      opts.threads = std::atoi(arg + 10);
+    } else if (strncmp(arg, "--spans=", 8) == 0) {
+      opts.spans = std::atoi(arg + 8);
+    } else if (strncmp(arg, "--ops_per_span=", 15) == 0) {
+      opts.opsPerSpan = std::atoi(arg + 15);
+    } else if (strncmp(arg, "--metadata=", 11) == 0) {
+      opts.metadata = std::atoi(arg + 11);
+    } else if (strncmp(arg, "--kernels_per_op=", 17) == 0) {
+      opts.kernelsPerOp = std::atoi(arg + 17);
+    } else if (strncmp(arg, "--runs=", 7) == 0) {
+      opts.runs = std::atoi(arg + 7);
+    } else if (strncmp(arg, "--output_dir=", 13) == 0) {
+      opts.outputDir = arg + 13;
+    } else if (strcmp(arg, "--help") == 0) {
+      printUsage(argv[0]);
+      std::exit(0);
+    } else {
+      fmt::print(stderr, "Unknown argument: {}\n", arg);
+      printUsage(argv[0]);
+      std::exit(1);
+    }
+  }
+  return opts;
+}
+
+using Clock = std::chrono::steady_clock;
+
+// Resource usage at a point in the pipeline.
+struct Mark {
+  Clock::time_point time;
+  int64_t allocations;
+  int64_t allocatedBytes;
+  long peakRssKb;
+};
+
+Mark mark() {
+  struct rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return Mark{
+      Clock::now(),
+      allocationCount.load(std::memory_order_relaxed),
+      allocatedBytes.load(std::memory_order_relaxed),
+      usage.ru_maxrss};
+}
+
+void printStage(
+    int run,
+    const char* stage,
+    const Mark& begin,
+    const Mark& end) {
+  fmt::print(
+      "{{\"run\": {}, \"stage\": \"{}\", \"wall_ms\": {:.3f}, "
+      "\"allocations\": {}, \"allocated_bytes\": {}, \"peak_rss_kb\": {}}}\n",
+      run,
+      stage,
+      duration<double, std::milli>(end.time - begin.time).count(),
+      end.allocations - begin.allocations,
+      end.allocatedBytes - begin.allocatedBytes,
+      end.peakRssKb);
+}
+
+// A GPU activity record as a tracing library reports it: correlated with the
+// CPU op that launched it through an external correlation record.
+struct GpuRecord {
+  int64_t correlationId;
+  int64_t externalId;
+  int64_t startTime;
+  int64_t endTime;
+  int32_t threadId;
+  int32_t stream;
+  bool runtime;
+};
+
+// Profiler with a synthetic GPU backend. processGpuActivities() handles the
+// records set with setGpuRecords() the way the device profilers handle their
+// activity buffers, and marks where each of its stages begins and ends.
+class SyntheticGpuProfiler : public GenericActivityProfiler {
+ public:
+  SyntheticGpuProfiler() : GenericActivityProfiler(/*cpuOnly=*/false) {}
+
+  void setGpuRecords(std::vector<GpuRecord> records) {
+    records_ = std::move(records);
+  }
+
+  Mark gpuBegin;
+  Mark correlated;
+  Mark gpuEnd;
+
+ protected:
+  void processGpuActivities(ActivityLogger& logger) override {
+    gpuBegin = mark();
+    reserveCorrelationState(records_.size());
+    for (const auto& record : records_) {
+      if (record.runtime) {
+        cpuCorrelationMap_[record.correlationId] = record.externalId;
+      }
+    }
+    correlated = mark();
+
+    // Like the device profilers' activity wrappers, these have to stay alive
+    // until the trace is reset: the correlation state points at them.
+    static const TraceSpan kGpuSpan(0, 0, "");
+    for (const auto& record : records_) {
+      auto& act = activities_.emplace_back(
+          kGpuSpan,
+          record.runtime ? ActivityType::CUDA_RUNTIME
+                         : ActivityType::CONCURRENT_KERNEL,
+          record.runtime ? "cudaLaunchKernel" : "synthetic_kernel");
+      act.startTime = record.startTime;
+      act.endTime = record.endTime;
+      act.id = static_cast<int32_t>(record.correlationId);
+      act.device = record.runtime ? 0 : 1;
+      act.resource = record.runtime ? record.threadId : record.stream;
+      act.linked = linkedActivity(
+          static_cast<int32_t>(record.correlationId), cpuCorrelationMap_);
+      handleGpuActivity(act, &logger);
+    }
+    gpuEnd = mark();
+  }
+
+  void onResetTraceData() override {
+    activities_.clear();
+  }
+
+ private:
+  std::vector<GpuRecord> records_;
+  std::deque<GenericTraceActivity> activities_;
+};
+
+// Correlation ids of CPU ops handed out by one client thread.
+int64_t opCorrelationId(const BenchmarkOptions& opts, int thread, int op) {
+  return 1 + int64_t{thread} * opts.spans * opts.opsPerSpan + op;
+}
+
+std::vector<std::unique_ptr<CpuTraceBuffer>> makeCpuTraces(
+    const BenchmarkOptions& opts,
+    int thread,
+    int64_t baseTime) {
+  std::vector<std::unique_ptr<CpuTraceBuffer>> traces;
+  const int64_t spanDuration = int64_t{opts.opsPerSpan} * 10'000;
+  int op = 0;
+  for (int s = 0; s < opts.spans; s++) {
+    auto trace = std::make_unique<CpuTraceBuffer>();
+    const int64_t spanStart = baseTime + s * spanDuration;
+    trace->span =
+        TraceSpan(spanStart, spanStart + spanDuration, "ProfilerStep");
+    trace->gpuOpCount = opts.opsPerSpan * opts.kernelsPerOp;
+    for (int i = 0; i < opts.opsPerSpan; i++, op++) {
+      GenericTraceActivity act(
+          trace->span, ActivityType::CPU_OP, fmt::format("aten::op{}", i % 64));
+      act.startTime = spanStart + int64_t{i} * 10'000;
+      act.endTime = act.startTime + 5'000;
+      act.id = static_cast<int32_t>(opCorrelationId(opts, thread, op));
+      act.device = 0;
+      act.resource = thread + 1;
+      act.threadId = thread + 1;
+      for (int m = 0; m < opts.metadata; m++) {
+        if (m % 2 == 0) {
+          act.addMetadata(fmt::format("Sequence number {}", m), i + m);
+        } else {
+          act.addMetadataQuoted(
+              fmt::format("Input type {}", m), "float, float, int64_t");
+        }
+      }
+      trace->emplace_activity(std::move(act));
+    }
+    traces.push_back(std::move(trace));
+  }
+  return traces;
+}
+
+// A runtime record and a kernel for every kernel launched by a CPU op, with
+// the kernel running on the device after the launch.
+std::vector<GpuRecord> makeGpuRecords(
+    const BenchmarkOptions& opts,
+    int64_t baseTime) {
+  std::vector<GpuRecord> records;
+  records.reserve(
+      size_t{2} * opts.threads * opts.spans * opts.opsPerSpan *
+      opts.kernelsPerOp);
+  int64_t launchId = 0;
+  for (int t = 0; t < opts.threads; t++) {
+    for (int op = 0; op < opts.spans * opts.opsPerSpan; op++) {
+      const int64_t opStart = baseTime + int64_t{op} * 10'000;
+      for (int k = 0; k < opts.kernelsPerOp; k++) {
+        const int64_t externalId = opCorrelationId(opts, t, op);
+        const int64_t launch = opStart + 1'000 + k * 100;
+        launchId++;
+        records.push_back(
+            {launchId, externalId, launch, launch + 50, t + 1, 0, true});
+        records.push_back(
+            {launchId,
+             externalId,
+             launch + 2'000,
+             launch + 3'000,
+             t + 1,
+             7 + (t % 4),
+             false});
+      }
+    }
+  }
+  return records;
+}
+
+void runTrace(int run, const BenchmarkOptions& opts, const Config& config) {
+  SyntheticGpuProfiler profiler;
+  const auto startTime = system_clock::now();
+  const int64_t baseTime = timeSinceEpoch(startTime) + 1'000'000;
+  // The synthetic workload ends long before this.
+  const auto stopTime = startTime + hours(1);
+  profiler.configure(config, startTime);
+  profiler.startTrace(startTime);
+  profiler.setGpuRecords(makeGpuRecords(opts, baseTime));
+
+  std::atomic<int> built{0};
+  std::atomic<bool> go{false};
+  std::vector<std::thread> clients;
+  const Mark generateBegin = mark();
+  for (int t = 0; t < opts.threads; t++) {
+    clients.emplace_back([&, t] {
+      auto traces = makeCpuTraces(opts, t, baseTime);
+      built++;
+      while (!go.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      for (auto& trace : traces) {
+        profiler.transferCpuTrace(std::move(trace));
+      }
+    });
+  }
+  while (built < opts.threads) {
+    std::this_thread::yield();
+  }
+  const Mark transferBegin = mark();
+  go.store(true, std::memory_order_release);
+  for (auto& client : clients) {
+    client.join();
+  }
+  const Mark transferEnd = mark();
+
+  profiler.stopTrace(stopTime);
+  const Mark stopEnd = mark();
+
+  MemoryTraceLogger memoryLogger(config);
+  profiler.processTrace(memoryLogger);
+  const Mark processEnd = mark();
+
+  {
+    ChromeTraceLogger jsonLogger(
+        fmt::format("{}/post_processing_benchmark.json", opts.outputDir));
+    memoryLogger.log(jsonLogger);
+  }
+  const Mark replayEnd = mark();
+
+  profiler.reset();
+  const Mark resetEnd = mark();
+
+  printStage(run, "generate", generateBegin, transferBegin);
+  printStage(run, "transfer", transferBegin, transferEnd);
+  printStage(run, "stop", transferEnd, stopEnd);
+  printStage(run, "process_cpu", stopEnd, profiler.gpuBegin);
+  printStage(run, "correlate", profiler.gpuBegin, profiler.correlated);
+  printStage(run, "process_gpu", profiler.correlated, profiler.gpuEnd);
+  printStage(run, "finalize", profiler.gpuEnd, processEnd);
+  printStage(run, "replay", processEnd, replayEnd);
+  printStage(run, "reset", replayEnd, resetEnd);
+  printStage(run, "total", transferBegin, resetEnd);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  BenchmarkOptions opts = parseArgs(argc, argv);
+  if (opts.threads <= 0 || opts.spans <= 0 || opts.opsPerSpan <= 0 ||
+      opts.metadata < 0 || opts.kernelsPerOp < 0 || opts.runs <= 0) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  Config config;
+  config.validate(system_clock::now());
+
+  fmt::print(
+      "{{\"threads\": {}, \"spans\": {}, \"ops_per_span\": {}, "
+      "\"metadata\": {}, \"kernels_per_op\": {}, \"cpu_ops\": {}}}\n",
+      opts.threads,
+      opts.spans,
+      opts.opsPerSpan,
+      opts.metadata,
+      opts.kernelsPerOp,
+      int64_t{opts.threads} * opts.spans * opts.opsPerSpan);
+  for (int run = 0; run < opts.runs; run++) {
+    runTrace(run, opts, config);
+  }
+  return 0;
+}
@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// Benchmark for recording rows from the ROCm runtime API callbacks, as
+// RocprofLogger::insert_row_to_buffer() does. Many threads record runtime
+// rows, every fourth a kernel launch, and the rows are then collected.
+// Compares the previous scheme, where every row is allocated with new and
+// appended to one vector under a mutex, against PerThreadRowBuffer. The row
+// types mirror rocprofRow and rocprofKernelRow without the HIP types, so
+// this builds without ROCm. Reports time per row and aggregate throughput
+// for increasing thread counts.
+//
+// CMake usage:
+//   mkdir build && cd build
+//   cmake .. -DKINETO_BUILD_BENCHMARKS=ON
+//   make rocprof_row_buffer_benchmark
+//   ./benchmarks/rocprof_row_buffer_benchmark --threads=16 --rows=200000
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "PerThreadRowBuffer.h"
+
+namespace {
+
+using namespace libkineto;
+
+struct BenchmarkOptions {
+  int threads = 16;
+  // Rows recorded per thread.
+  int rows = 200000;
+  int runs = 3;
+};
+
+void printUsage(const char* progname) {
+  fmt::print("Usage: {} [options]\n", progname);
+  fmt::print("Options:\n");
+  fmt::print(
+      "  --threads=<n>          Most recording threads (default: 16)\n");
+  fmt::print("  --rows=<n>             Rows per thread (default: 200000)\n");
+  fmt::print("  --runs=<n>             Runs, best is reported (default: 3)\n");
+  fmt::print("  --help                 Show this help\n");
+}
+
+BenchmarkOptions parseArgs(int argc, char* argv[]) {
+  BenchmarkOptions opts;
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (strncmp(arg, "--threads=", 10) == 0) {
+      opts.threads = std::atoi(arg + 10);
+    } else if (strncmp(arg, "--rows=", 7) == 0) {
+      opts.rows = std::atoi(arg + 7);
+    } else if (strncmp(arg, "--runs=", 7) == 0) {
+      opts.runs = std::atoi(arg + 7);
+    } else if (strcmp(arg, "--help") == 0) {
+      printUsage(argv[0]);
+      std::exit(0);
+    } else {
+      fmt::print(stderr, "Unknown argument: {}\n", arg);
+      printUsage(argv[0]);
+      std::exit(1);
+    }
+  }
+  return opts;
+}
+
+using Clock = std::chrono::steady_clock;
+
+// Layouts of rocprofBase, rocprofRow and rocprofKernelRow.
+struct RowBase {
+  RowBase(uint64_t id, uint32_t domain, uint64_t begin, uint64_t end)
+      : id(id), begin(begin), end(end), domain(domain) {}
+  uint64_t id;
+  uint64_t begin;
+  uint64_t end;
+  uint32_t domain;
+  int type{0};
+};
+
+struct Row : RowBase {
+  Row(uint64_t id,
+      uint32_t domain,
+      uint32_t cid,
+      uint32_t pid,
+      uint32_t tid,
+      uint64_t begin,
+      uint64_t end)
+      : RowBase(id, domain, begin, end), cid(cid), pid(pid), tid(tid) {}
+  uint32_t cid;
+  uint32_t pid;
+  uint32_t tid;
+};
+
+struct KernelRow : Row {
+  KernelRow(
+      uint64_t id,
+      uint32_t domain,
+      uint32_t cid,
+      uint32_t pid,
+      uint32_t tid,
+      uint64_t begin,
+      uint64_t end,
+      unsigned int gx,
+      void* stream)
+      : Row(id, domain, cid, pid, tid, begin, end), gridX(gx), stream(stream) {}
+  const void* functionAddr{nullptr};
+  void* function{nullptr};
+  unsigned int gridX;
+  unsigned int gridY{1};
+  unsigned int gridZ{1};
+  unsigned int workgroupX{256};
+  unsigned int workgroupY{1};
+  unsigned int workgroupZ{1};
+  size_t groupSegmentSize{0};
+  void* stream;
+};
+
+constexpr size_t kMaxRows = 1000000000;
+
+// Recording as before: one allocation per row, appended under a mutex.
+class MutexRows {
+ public:
+  ~MutexRows() {
+    for (RowBase* row : rows_) {
+      delete row;
+    }
+  }
+
+  template <class T, class... Args>
+  void insert(Args&&... args) {
+    T* row = new T(std::forward<Args>(args)...);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (rows_.size() >= kMaxRows) {
+      delete row;
+      return;
+    }
+    rows_.push_back(row);
+  }
+
+  size_t collect() {
+    return rows_.size();
+  }
+
+ private:
+  std::vector<RowBase*> rows_;
+  std::mutex mutex_;
+};
+
+class PerThreadRows {
+ public:
+  template <class T, class... Args>
+  void insert(Args&&... args) {
+    buffer_.emplace<T>(std::forward<Args>(args)...);
+  }
+
+  size_t collect() {
+    std::vector<RowBase*> rows;
+    return buffer_.drain(rows);
+  }
+
+ private:
+  PerThreadRowBuffer<RowBase> buffer_{kMaxRows};
+};
+
+template <class Rows>
+double run(int threads, int rowsPerThread, size_t& collected) {
+  Rows rows;
+  std::atomic<bool> go{false};
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      while (!go.load(std::memory_order_acquire)) {
+      }
+      const auto tid = static_cast<uint32_t>(t);
+      for (int i = 0; i < rowsPerThread; i++) {
+        const auto id = static_cast<uint64_t>(t) * rowsPerThread + i;
+        if (i % 4 == 0) {
+          rows.template insert<KernelRow>(
+              id, 1u, 42u, 1234u, tid, id * 10, id * 10 + 5, 128u, nullptr);
+        } else {
+          rows.template insert<Row>(
+              id, 1u, 7u, 1234u, tid, id * 10, id * 10 + 5);
+        }
+      }
+    });
+  }
+  const auto start = Clock::now();
+  go.store(true, std::memory_order_release);
+  for (auto& w : workers) {
+    w.join();
+  }
+  collected = rows.collect();
+  return std::chrono::duration<double, std::nano>(Clock::now() - start)
+      .count();
+}
+
+template <class Rows>
+double best(const BenchmarkOptions& opts, int threads, size_t& collected) {
+  double ns = 1e30;
+  for (int r = 0; r < opts.runs; r++) {
+    ns = std::min(ns, run<Rows>(threads, opts.rows, collected));
+  }
+  return ns;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  BenchmarkOptions opts = parseArgs(argc, argv);
+  if (opts.threads <= 0 || opts.rows <= 0 || opts.runs <= 0) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  fmt::print(
+      "ROCm row buffer benchmark: {} rows per thread, best of {} runs\n",
+      opts.rows,
+      opts.runs);
+  std::vector<int> threadCounts;
+  for (int threads = 1; threads < opts.threads; threads *= 2) {
+    threadCounts.push_back(threads);
+  }
+  threadCounts.push_back(opts.threads);
+  for (int threads : threadCounts) {
+    size_t mutexRows = 0;
+    size_t perThreadRows = 0;
+    const double mutexNs = best<MutexRows>(opts, threads, mutexRows);
+    const double perThreadNs =
+        best<PerThreadRows>(opts, threads, perThreadRows);
+    const double total = static_cast<double>(threads) * opts.rows;
+    fmt::print(
+        "{:3} threads  mutex {:7.1f} ns/row {:7.1f} Mrows/s  "
+        "per-thread {:7.1f} ns/row {:7.1f} Mrows/s  ({:.1f}x, {} rows)\n",
+        threads,
+        mutexNs / total,
+        total / mutexNs * 1e3,
+        perThreadNs / total,
+        total / perThreadNs * 1e3,
+        mutexNs / perThreadNs,
+        perThreadRows == mutexRows ? perThreadRows : 0);
+  }
+  return 0;
+}
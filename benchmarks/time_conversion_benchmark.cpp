@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+// Benchmark for converting approximate (TSC) timestamps to unix time.
+// Compares the std::function returned by makeConverter(), applied on every
+// timestamp()/duration() call as the CUPTI wrappers used to, against the
+// inline ApproximateClockConversion applied once per record and the batch
+// conversion of a contiguous array.
+//
+// CMake usage:
+//   mkdir build && cd build
+//   cmake .. -DKINETO_BUILD_BENCHMARKS=ON
+//   make time_conversion_benchmark
+//   ./benchmarks/time_conversion_benchmark --records=10000000
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "ApproximateClock.h"
+
+namespace {
+
+using namespace libkineto;
+
+struct BenchmarkOptions {
+  int64_t records = 10000000;
+  int iterations = 5;
+  // timestamp() and duration() calls per record, e.g. one per logger.
+  int reads = 2;
+};
+
+void printUsage(const char* progname) {
+  fmt::print("Usage: {} [options]\n", progname);
+  fmt::print("Options:\n");
+  fmt::print(
+      "  --records=<n>      Records per iteration (default: 10000000)\n");
+  fmt::print("  --iterations=<n>   Iterations per variant (default: 5)\n");
+  fmt::print(
+      "  --reads=<n>        timestamp()/duration() reads per record "
+      "(default: 2)\n");
+  fmt::print("  --help             Show this help\n");
+}
+
+BenchmarkOptions parseArgs(int argc, char* argv[]) {
+  BenchmarkOptions opts;
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (strncmp(arg, "--records=", 10) == 0) {
+      opts.records = std::atoll(arg + 10);
+    } else if (strncmp(arg, "--iterations=", 13) == 0) {
+      opts.iterations = std::atoi(arg + 13);
+    } else if (strncmp(arg, "--reads=", 8) == 0) {
+      opts.reads = std::atoi(arg + 8);
+    } else if (strcmp(arg, "--help") == 0) {
+      printUsage(argv[0]);
+      std::exit(0);
+    } else {
+      fmt::print(stderr, "Unknown argument: {}\n", arg);
+      printUsage(argv[0]);
+      std::exit(1);
+    }
+  }
+  return opts;
+}
+
+// Start and end of an activity record, in approximate time until converted.
+struct Record {
+  approx_time_t start;
+  approx_time_t end;
+};
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+// Reads each record the way loggers do: timestamp() and duration().
+template <class TimestampFn, class DurationFn>
+int64_t readRecords(
+    const std::vector<Record>& records,
+    int reads,
+    TimestampFn timestamp,
+    DurationFn duration) {
+  int64_t sum = 0;
+  for (int r = 0; r < reads; r++) {
+    for (const auto& record : records) {
+      sum += timestamp(record) + duration(record);
+    }
+  }
+  return sum;
+}
+
+template <class Fn>
+void runVariant(const char* name, int iterations, int64_t items, Fn fn) {
+  double best = 0;
+  int64_t check = 0;
+  for (int i = 0; i < iterations; i++) {
+    auto start = Clock::now();
+    check = fn();
+    const double ms = elapsedMs(start);
+    if (i == 0 || ms < best) {
+      best = ms;
+    }
+  }
+  fmt::print(
+      "{:<28} {:9.2f} ms  {:6.2f} ns/record  (checksum {})\n",
+      name,
+      best,
+      best * 1e6 / static_cast<double>(items),
+      check);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  BenchmarkOptions opts = parseArgs(argc, argv);
+  if (opts.records <= 0 || opts.iterations <= 0 || opts.reads <= 0) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  ApproximateClockToUnixTimeConverter clockConverter;
+  const ApproximateClockConversion conversion =
+      clockConverter.makeConversion();
+  const std::function<time_t(approx_time_t)> function =
+      clockConverter.makeConverter();
+
+  std::vector<Record> records;
+  records.reserve(opts.records);
+  approx_time_t t = getApproximateTime();
+  for (int64_t i = 0; i < opts.records; i++) {
+    records.push_back({t, t + 3000 + i % 1000});
+    t += 5000;
+  }
+
+  fmt::print(
+      "Time conversion benchmark: {} records, {} reads each, best of {}\n",
+      opts.records,
+      opts.reads,
+      opts.iterations);
+
+  runVariant("std::function per read", opts.iterations, opts.records, [&] {
+    return readRecords(
+        records,
+        opts.reads,
+        [&](const Record& r) { return function(r.start); },
+        [&](const Record& r) {
+          return function(r.end) - function(r.start);
+        });
+  });
+
+  runVariant("inline convert per read", opts.iterations, opts.records, [&] {
+    return readRecords(
+        records,
+        opts.reads,
+        [&](const Record& r) { return conversion.convert(r.start); },
+        [&](const Record& r) {
+          return conversion.convert(r.end) - conversion.convert(r.start);
+        });
+  });
+
+  // Convert every record once, then read raw timestamps. Writes to a second
+  // array so that each iteration starts from approximate time.
+  std::vector<Record> converted(records.size());
+  runVariant("convert once + raw reads", opts.iterations, opts.records, [&] {
+    for (size_t i = 0; i < records.size(); i++) {
+      converted[i] = {
+          static_cast<approx_time_t>(conversion.convert(records[i].start)),
+          static_cast<approx_time_t>(conversion.convert(records[i].end))};
+    }
+    return readRecords(
+        converted,
+        opts.reads,
+        [](const Record& r) { return static_cast<time_t>(r.start); },
+        [](const Record& r) { return static_cast<time_t>(r.end - r.start); });
+  });
+
+  // Contiguous timestamps, as for a column of start times.
+  std::vector<approx_time_t> starts;
+  starts.reserve(records.size());
+  for (const auto& r : records) {
+    starts.push_back(r.start);
+  }
+  std::vector<time_t> out(starts.size());
+  runVariant("batch convert (array)", opts.iterations, opts.records, [&] {
+    conversion.convert(starts, out);
+    return out.back();
+  });
+  runVariant("std::function (array)", opts.iterations, opts.records, [&] {
+    for (size_t i = 0; i < starts.size(); i++) {
+      out[i] = function(starts[i]);
+    }
+    return out.back();
+  });
+  return 0;
+}
@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <future>
 #include <memory>
 #include <set>
 #include <thread>
@@ -107,6 +108,34 @@ class ActivityProfilerInterface {
       [[maybe_unused]] const std::string& assertion,
       [[maybe_unused]] const std::string& error,
       [[maybe_unused]] const std::string& group_profile_id = "") {}
+
+  // New virtual functions go below this line, so that the vtable layout
+  // of the functions above does not change for existing binaries.
+
+  // Stop the trace and return once collection has stopped. The trace is
+  // processed on a background thread, and the profiler stays busy until the
+  // future is ready.
+  virtual std::future<std::unique_ptr<ActivityTraceInterface>>
+  stopTraceAsync() {
+    std::promise<std::unique_ptr<ActivityTraceInterface>> trace;
+    trace.set_value(stopTrace());
+    return trace.get_future();
+  }
+
+  // Write the window retained by a running flight recorder (see
+  // ACTIVITIES_FLIGHT_RECORDER) to the log file given by configStr, without
+  // stopping it. Returns false if the flight recorder is not running or
+  // another dump is pending.
+  virtual bool dumpFlightRecorder(
+      [[maybe_unused]] const std::string& configStr) {
+    return false;
+  }
+
+  // Stop a running flight recorder, discarding its window. Returns false if
+  // it is not running.
+  virtual bool stopFlightRecorder() {
+    return false;
+  }
 };
 
 } // namespace libkineto
@@ -233,6 +233,84 @@ class Config : public AbstractConfig {
     return activitiesWarmupIterations_;
   }
 
+  // Number of threads used to decode GPU activity buffers and to serialize
+  // the collected trace. 1 (the default) does both on the post-processing
+  // thread.
+  [[nodiscard]] int activitiesSerializationThreads() const {
+    return activitiesSerializationThreads_;
+  }
+
+  // Flight recorder mode: keep tracing continuously and retain only the most
+  // recent window of activity, until a dump is requested.
+  [[nodiscard]] bool flightRecorderEnabled() const {
+    return flightRecorderEnabled_;
+  }
+
+  // Length of the retained window. Counted in iterations when
+  // flightRecorderWindowIterations() is set, otherwise in time.
+  [[nodiscard]] std::chrono::seconds flightRecorderWindow() const {
+    return flightRecorderWindow_;
+  }
+
+  [[nodiscard]] int flightRecorderWindowIterations() const {
+    return flightRecorderWindowIterations_;
+  }
+
+  // The window is recorded in this many segments. The oldest segment is
+  // evicted as a whole, so more segments track the window more closely at
+  // the cost of processing the trace more often. Nothing is recorded while
+  // a segment is processed (see FlightRecorder).
+  [[nodiscard]] int flightRecorderSegments() const {
+    return flightRecorderSegments_;
+  }
+
+  // Upper bound on the number of events retained by the flight recorder.
+  [[nodiscard]] int64_t flightRecorderMaxEvents() const {
+    return flightRecorderMaxEvents_;
+  }
+
+  // A request to write out the window retained by a running flight recorder.
+  [[nodiscard]] bool flightRecorderDump() const {
+    return flightRecorderDump_;
+  }
+
+  // A request to stop a running flight recorder, discarding its window.
+  [[nodiscard]] bool flightRecorderStop() const {
+    return flightRecorderStop_;
+  }
+
+  // Filter applied to the collected activities before they are logged. An
+  // activity is kept only if it matches every option that is set. Device
+  // and stream filters apply to activities on a GPU, e.g. kernels, and do
+  // not drop host side activities.
+  [[nodiscard]] const std::set<ActivityType>& activitiesFilterTypes() const {
+    return activitiesFilterTypes_;
+  }
+
+  // Drop activities shorter than this.
+  [[nodiscard]] std::chrono::nanoseconds activitiesFilterMinDuration() const {
+    return activitiesFilterMinDuration_;
+  }
+
+  // Keep activities with names containing a match for this ECMAScript regex.
+  [[nodiscard]] const std::string& activitiesFilterNameRegex() const {
+    return activitiesFilterNameRegex_;
+  }
+
+  // Keep activities with names starting with one of these prefixes.
+  [[nodiscard]] const std::vector<std::string>& activitiesFilterNamePrefixes()
+      const {
+    return activitiesFilterNamePrefixes_;
+  }
+
+  [[nodiscard]] const std::set<int64_t>& activitiesFilterDevices() const {
+    return activitiesFilterDevices_;
+  }
+
+  [[nodiscard]] const std::set<int64_t>& activitiesFilterStreams() const {
+    return activitiesFilterStreams_;
+  }
+
   // Show CUDA Synchronization Stream Wait Events
   [[nodiscard]] bool activitiesCudaSyncWaitEvents() const {
     return activitiesCudaSyncWaitEvents_;
@@ -347,6 +425,18 @@ class Config : public AbstractConfig {
     return cuptiDeviceBufferPoolLimit_;
   }
 
+  // Number of 4MB host buffers for CUPTI activity records that are
+  // pre-faulted when tracing is configured and kept for reuse once a trace
+  // is done with them. 0 (the default) allocates and frees every buffer.
+  [[nodiscard]] int cuptiHostBufferPoolSize() const {
+    return cuptiHostBufferPoolSize_;
+  }
+
+  // Back the pooled host buffers with transparent huge pages.
+  [[nodiscard]] bool cuptiHostBufferHugePages() const {
+    return cuptiHostBufferHugePages_;
+  }
+
   [[nodiscard]] bool memoryProfilerEnabled() const {
     return memoryProfilerEnabled_;
   }
@@ -465,6 +555,24 @@ class Config : public AbstractConfig {
   std::chrono::seconds activitiesWarmupDuration_;
   int activitiesWarmupIterations_;
   bool activitiesCudaSyncWaitEvents_;
+  int activitiesSerializationThreads_;
+
+  // Activity filter
+  std::set<ActivityType> activitiesFilterTypes_;
+  std::chrono::nanoseconds activitiesFilterMinDuration_{0};
+  std::string activitiesFilterNameRegex_;
+  std::vector<std::string> activitiesFilterNamePrefixes_;
+  std::set<int64_t> activitiesFilterDevices_;
+  std::set<int64_t> activitiesFilterStreams_;
+
+  // Flight recorder
+  bool flightRecorderEnabled_{false};
+  std::chrono::seconds flightRecorderWindow_;
+  int flightRecorderWindowIterations_{0};
+  int flightRecorderSegments_;
+  int64_t flightRecorderMaxEvents_;
+  bool flightRecorderDump_{false};
+  bool flightRecorderStop_{false};
 
   // Enable Profiler Config Options
   // Temporarily disable shape collection until we re-roll out the feature for
@@ -510,6 +618,8 @@ class Config : public AbstractConfig {
   // CUPTI Device Buffer
   size_t cuptiDeviceBufferSize_;
   size_t cuptiDeviceBufferPoolLimit_;
+  int cuptiHostBufferPoolSize_{0};
+  bool cuptiHostBufferHugePages_{false};
 
   // CUPTI Timestamp Format
   bool useTSCTimestamp_{true};
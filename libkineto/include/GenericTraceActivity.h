@@ -20,6 +20,7 @@
 #include <vector>
 
 #include "ITraceActivity.h"
+#include "MetadataStorage.h"
 #include "ThreadUtil.h"
 #include "TraceSpan.h"
 #include "TypedMetadata.h"
@@ -105,7 +106,8 @@ class GenericTraceActivity : public ITraceActivity {
   // Encode client side metadata as a key/value (as a JSON fragment)
   template <typename ValType>
   void addMetadata(const std::string& key, const ValType& value) {
-    metadataMap_.emplace(key, RawJson{fmt::format("{}", value)});
+    metadata_.emplace(
+        MetadataKeys::intern(key), RawJson{fmt::format("{}", value)});
   }
 
   // Typed metadata: the value is stored as the field's declared type
@@ -114,18 +116,18 @@ class GenericTraceActivity : public ITraceActivity {
     static_assert(
         std::is_same_v<T, std::decay_t<V>>,
         "value type must match field's declared type");
-    metadataMap_.emplace(std::string{field.name}, TypedValue{value});
+    metadata_.emplace(MetadataKeys::intern(field.name), TypedValue{value});
   }
 
   // Adds typed metadata dynamically by key. Catalog registration is not
   // required.
   void addTypedMetadata(std::string_view key, TypedValue value) {
-    metadataMap_.emplace(std::string{key}, std::move(value));
+    metadata_.emplace(MetadataKeys::intern(key), std::move(value));
   }
 
   // The value is a plain string to be emitted quoted in JSON.
   void addMetadataQuoted(const std::string& key, const std::string& value) {
-    metadataMap_.emplace(key, value);
+    metadata_.emplace(MetadataKeys::intern(key), value);
   }
 
   // Store a typed counter value. Preferred over addMetadata for counter
@@ -146,10 +148,13 @@ class GenericTraceActivity : public ITraceActivity {
   // Typed read-back
   template <typename T>
   std::optional<T> getMetadataValue(const MetadataField<T>& field) const {
-    const auto it = metadataMap_.find(std::string{field.name});
-    if (it != metadataMap_.end()) {
-      if (const T* value = std::get_if<T>(&it->second)) {
-        return *value;
+    const auto key = MetadataKeys::find(field.name);
+    if (!key) {
+      return std::nullopt;
+    }
+    if (const TypedValue* value = metadata_.find(*key)) {
+      if (const T* typed = std::get_if<T>(value)) {
+        return *typed;
       }
     }
     return std::nullopt;
@@ -158,14 +163,16 @@ class GenericTraceActivity : public ITraceActivity {
   const std::string metadataJson() const override;
 
   void visitTypedMetadata(ITypedMetadataVisitor& visitor) const override {
-    // Dynamically build a MetadataField during visit
-    for (const auto& kv : metadataMap_) {
+    // Dynamically build a MetadataField during visit, in insertion order
+    for (const auto& entry : metadata_) {
       std::visit(
           [&](const auto& v) {
             visitor.visit(
-                MetadataField<std::decay_t<decltype(v)>>{kv.first}, v);
+                MetadataField<std::decay_t<decltype(v)>>{
+                    MetadataKeys::name(entry.key)},
+                v);
           },
-          kv.second);
+          entry.value);
     }
   }
 
@@ -192,7 +199,7 @@ class GenericTraceActivity : public ITraceActivity {
 
  private:
   const TraceSpan* traceSpan_;
-  std::unordered_map<std::string, TypedValue> metadataMap_;
+  MetadataStorage metadata_;
   // Typed counter values: (name, double) to avoid round-tripping though string
   std::vector<std::pair<std::string, double>> counterValues_;
 };
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+#include "TypedMetadata.h"
+
+namespace libkineto {
+
+// Process-wide intern table for metadata keys.
+//
+// Activities carry the same few dozen keys (see MetadataFieldCatalog.h)
+// millions of times, so they store a small integer id per key instead of a
+// copy of the string. Ids are assigned on first use and never reused; names
+// stay valid for the life of the process. Thread-safe; name() does not lock.
+class MetadataKeys {
+ public:
+  // Returns the id for key, adding it to the table if it is new.
+  static uint32_t intern(std::string_view key);
+
+  // Returns the id for key if it has been interned.
+  static std::optional<uint32_t> find(std::string_view key);
+
+  // The key with the given id, which must have come from intern().
+  static std::string_view name(uint32_t id);
+};
+
+// Metadata of a GenericTraceActivity: (key id, value) pairs in insertion
+// order. The first entries are stored inline in the activity and the rest in
+// a single heap array, so a typical op costs at most one allocation for its
+// metadata besides the values themselves. Lookups are linear, which beats
+// hashing for the handful of entries an activity has.
+class MetadataStorage {
+ public:
+  struct Entry {
+    uint32_t key;
+    TypedValue value;
+  };
+
+  static constexpr uint32_t kInlineCapacity = 2;
+  // First heap allocation; enough for most ops.
+  static constexpr uint32_t kMinHeapCapacity = 8;
+
+  MetadataStorage() = default;
+
+  MetadataStorage(const MetadataStorage& other) {
+    reserve(other.size_);
+    std::uninitialized_copy(other.begin(), other.end(), data());
+    size_ = other.size_;
+  }
+
+  MetadataStorage(MetadataStorage&& other) noexcept {
+    take(other);
+  }
+
+  MetadataStorage& operator=(const MetadataStorage& other) {
+    if (this != &other) {
+      *this = MetadataStorage(other);
+    }
+    return *this;
+  }
+
+  MetadataStorage& operator=(MetadataStorage&& other) noexcept {
+    if (this != &other) {
+      release();
+      take(other);
+    }
+    return *this;
+  }
+
+  ~MetadataStorage() {
+    release();
+  }
+
+  // Adds value under key unless key is already present, like
+  // std::unordered_map::emplace(). Returns whether it was added.
+  bool emplace(uint32_t key, TypedValue value) {
+    if (find(key) != nullptr) {
+      return false;
+    }
+    if (size_ == capacity_) {
+      reserve(std::max(capacity_ * 2, kMinHeapCapacity));
+    }
+    new (data() + size_) Entry{key, std::move(value)};
+    size_++;
+    return true;
+  }
+
+  [[nodiscard]] const TypedValue* find(uint32_t key) const {
+    for (const Entry& entry : *this) {
+      if (entry.key == key) {
+        return &entry.value;
+      }
+    }
+    return nullptr;
+  }
+
+  [[nodiscard]] const Entry* begin() const {
+    return data();
+  }
+  [[nodiscard]] const Entry* end() const {
+    return data() + size_;
+  }
+  [[nodiscard]] size_t size() const {
+    return size_;
+  }
+  [[nodiscard]] bool empty() const {
+    return size_ == 0;
+  }
+
+ private:
+  Entry* inlineData() {
+    return reinterpret_cast<Entry*>(inline_);
+  }
+  const Entry* inlineData() const {
+    return reinterpret_cast<const Entry*>(inline_);
+  }
+  Entry* data() {
+    return heap_ != nullptr ? heap_ : inlineData();
+  }
+  const Entry* data() const {
+    return heap_ != nullptr ? heap_ : inlineData();
+  }
+
+  void reserve(uint32_t capacity) {
+    if (capacity <= capacity_) {
+      return;
+    }
+    Entry* heap = std::allocator<Entry>().allocate(capacity);
+    std::uninitialized_move(data(), data() + size_, heap);
+    std::destroy(data(), data() + size_);
+    if (heap_ != nullptr) {
+      std::allocator<Entry>().deallocate(heap_, capacity_);
+    }
+    heap_ = heap;
+    capacity_ = capacity;
+  }
+
+  void release() {
+    std::destroy(data(), data() + size_);
+    if (heap_ != nullptr) {
+      std::allocator<Entry>().deallocate(heap_, capacity_);
+    }
+    heap_ = nullptr;
+    size_ = 0;
+    capacity_ = kInlineCapacity;
+  }
+
+  // Moves other's entries here, leaving other empty. This must be empty.
+  void take(MetadataStorage& other) noexcept {
+    if (other.heap_ != nullptr) {
+      heap_ = other.heap_;
+      capacity_ = other.capacity_;
+      other.heap_ = nullptr;
+      other.capacity_ = kInlineCapacity;
+    } else {
+      std::uninitialized_move(
+          other.inlineData(), other.inlineData() + other.size_, inlineData());
+      std::destroy(other.inlineData(), other.inlineData() + other.size_);
+    }
+    size_ = other.size_;
+    other.size_ = 0;
+  }
+
+  alignas(Entry) unsigned char inline_[kInlineCapacity * sizeof(Entry)];
+  Entry* heap_{nullptr};
+  uint32_t size_{0};
+  uint32_t capacity_{kInlineCapacity};
+};
+
+} // namespace libkineto
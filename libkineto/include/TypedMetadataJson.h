@@ -35,141 +35,169 @@
 
 namespace libkineto::internal {
 
-class JsonTypedMetadataVisitor final : public ITypedMetadataVisitor {
- public:
-  JsonTypedMetadataVisitor() {
-    json_.reserve(kInitialJsonCapacity);
-  }
+// Base of the activity classes whose metadataJson() is exactly the JSON
+// rendering of the fields visited by visitTypedMetadata(), so that loggers can
+// stream the fields instead of building the string.
+struct TypedMetadataJsonActivity {};
 
-  [[nodiscard]] std::string json() && {
-    return std::move(json_);
-  }
+// Writes the visited fields into out, which is a std::string or an
+// fmt::memory_buffer, as the members of a JSON object without the braces.
+//
+// With Sanitize, keys and string values are rewritten as by
+// sanitizeStrForJSON(): backslashes become forward slashes and newlines are
+// dropped. Only they can hold those characters, so the output is the same as
+// sanitizing the rendered string.
+template <class Sink, bool Sanitize = false>
+class JsonTypedMetadataWriter : public ITypedMetadataVisitor {
+ public:
+  // leadingComma separates the first field from what is already in out.
+  explicit JsonTypedMetadataWriter(Sink& out, bool leadingComma = false)
+      : out_(out), leadingComma_(leadingComma) {}
 
   // Public so GenericTraceActivity's metadata serialization can render
   // collections without duplicating this logic.
   template <typename T>
-  static void appendArray(std::string& json, const std::vector<T>& values) {
-    json += '[';
+  static void appendArray(Sink& json, const std::vector<T>& values) {
+    json.push_back('[');
     bool first = true;
     for (const auto& value : values) {
       if (!first) {
-        json += ", ";
+        append(json, ", ");
       }
       appendArrayValue(json, value);
       first = false;
     }
-    json += ']';
+    json.push_back(']');
   }
 
  private:
-  // Sized to hold the largest common CUDA activity (kernels) in one allocation,
-  // with some buffer
-  static constexpr size_t kInitialJsonCapacity = 1024;
-
   // Widest int64_t is "-9223372036854775808" (20 chars)
   static constexpr size_t kMaxInt64Chars = 20;
 
   void visitValue(const MetadataField<int64_t>& field, int64_t value) override {
-    appendField(field, [&](std::string& json) { appendIntValue(json, value); });
+    appendField(field, [&](Sink& json) { appendIntValue(json, value); });
   }
 
   void visitValue(const MetadataField<double>& field, double value) override {
-    appendField(
-        field, [&](std::string& json) { appendDoubleValue(json, value); });
+    appendField(field, [&](Sink& json) { appendDoubleValue(json, value); });
   }
 
   void visitValue(const MetadataField<bool>& field, bool value) override {
     appendField(
-        field, [&](std::string& json) { json += value ? "true" : "false"; });
+        field, [&](Sink& json) { append(json, value ? "true" : "false"); });
   }
 
   void visitValue(
       const MetadataField<std::string>& field,
       std::string_view value) override {
-    appendField(field, [&](std::string& json) { appendQuoted(json, value); });
+    appendField(field, [&](Sink& json) { appendQuoted(json, value); });
   }
 
   void visitValue(
       const MetadataField<std::vector<int64_t>>& field,
       const std::vector<int64_t>& value) override {
-    appendField(field, [&](std::string& json) { appendArray(json, value); });
+    appendField(field, [&](Sink& json) { appendArray(json, value); });
   }
 
   void visitValue(
       const MetadataField<std::vector<std::string>>& field,
       const std::vector<std::string>& value) override {
-    appendField(field, [&](std::string& json) { appendArray(json, value); });
+    appendField(field, [&](Sink& json) { appendArray(json, value); });
   }
 
   void visitValue(const MetadataField<RawJson>& field, const RawJson& value)
       override {
-    appendField(field, [&](std::string& json) { json += value.value; });
+    appendField(field, [&](Sink& json) { appendText(json, value.value); });
   }
 
   void visitValue(const MetadataField<uint64_t>& field, uint64_t value)
       override {
-    appendField(
-        field, [&](std::string& json) { appendUIntValue(json, value); });
+    appendField(field, [&](Sink& json) { appendUIntValue(json, value); });
   }
 
   void visitValue(
       const MetadataField<InputShapes>& field,
       const InputShapes& value) override {
-    appendField(field, [&](std::string& json) { appendArray(json, value); });
+    appendField(field, [&](Sink& json) { appendArray(json, value); });
   }
 
   // Emit a visible placeholder rather than silently dropping a metadata type
   // the JSON serializer doesn't handle, so the gap shows up in the trace.
   void visitUnsupported(std::string_view name) override {
     appendKey(name);
-    appendQuoted(json_, "<unsupported metadata type>");
+    appendQuoted(out_, "<unsupported metadata type>");
   }
 
   void beginDict(std::string_view name) override {
     appendKey(name);
-    json_ += '{';
+    out_.push_back('{');
     firstEntry_ = true;
   }
 
   void endDict() override {
-    json_ += '}';
+    out_.push_back('}');
     firstEntry_ = false;
   }
 
   template <typename T, typename WriteValue>
   void appendField(const MetadataField<T>& field, WriteValue writeValue) {
     appendKey(field.name);
-    writeValue(json_);
+    writeValue(out_);
   }
 
   void appendKey(std::string_view key) {
     if (!firstEntry_) {
-      json_ += ", ";
+      append(out_, ", ");
+    } else if (leadingComma_) {
+      out_.push_back(',');
     }
     firstEntry_ = false;
-    appendQuoted(json_, key);
-    json_ += ": ";
+    leadingComma_ = false;
+    appendQuoted(out_, key);
+    append(out_, ": ");
+  }
+
+  static void append(Sink& json, std::string_view text) {
+    json.append(text.data(), text.data() + text.size());
+  }
+
+  static void appendText(Sink& json, std::string_view text) {
+    if constexpr (!Sanitize) {
+      append(json, text);
+    } else {
+      size_t start = 0;
+      for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '\\' || text[i] == '\n') {
+          append(json, text.substr(start, i - start));
+          if (text[i] == '\\') {
+            json.push_back('/');
+          }
+          start = i + 1;
+        }
+      }
+      append(json, text.substr(start));
+    }
   }
 
-  static void appendQuoted(std::string& json, std::string_view value) {
-    json += '"';
-    json += value;
-    json += '"';
+  static void appendQuoted(Sink& json, std::string_view value) {
+    json.push_back('"');
+    appendText(json, value);
+    json.push_back('"');
   }
 
-  static void appendIntValue(std::string& json, int64_t value) {
+  static void appendIntValue(Sink& json, int64_t value) {
     char buf[kMaxInt64Chars];
     const auto result = std::to_chars(buf, buf + sizeof(buf), value);
-    json.append(buf, static_cast<size_t>(result.ptr - buf));
+    append(json, std::string_view(buf, result.ptr - buf));
   }
 
-  static void appendUIntValue(std::string& json, uint64_t value) {
+  static void appendUIntValue(Sink& json, uint64_t value) {
     char buf[kMaxInt64Chars];
     const auto result = std::to_chars(buf, buf + sizeof(buf), value);
-    json.append(buf, static_cast<size_t>(result.ptr - buf));
+    append(json, std::string_view(buf, result.ptr - buf));
   }
 
-  static void appendDoubleValue(std::string& json, double value) {
+  static void appendDoubleValue(Sink& json, double value) {
     if (std::isfinite(value)) {
       fmt::format_to(std::back_inserter(json), "{}", value);
       return;
@@ -177,31 +205,50 @@ class JsonTypedMetadataVisitor final : public ITypedMetadataVisitor {
     appendQuoted(json, fmt::format("{}", value));
   }
 
-  static void appendArrayValue(std::string& json, int64_t value) {
+  static void appendArrayValue(Sink& json, int64_t value) {
     appendIntValue(json, value);
   }
 
-  static void appendArrayValue(std::string& json, const std::string& value) {
+  static void appendArrayValue(Sink& json, const std::string& value) {
     appendQuoted(json, value);
   }
 
   // Nested-array entries so InputShapes serializes through the appendArray
   // recursion
-  static void appendArrayValue(
-      std::string& json,
-      const std::vector<int64_t>& value) {
+  static void appendArrayValue(Sink& json, const std::vector<int64_t>& value) {
     appendArray(json, value);
   }
 
   static void appendArrayValue(
-      std::string& json,
+      Sink& json,
       const std::variant<std::vector<int64_t>, TensorListShapes>& value) {
     std::visit(
         [&json](const auto& shapes) { appendArray(json, shapes); }, value);
   }
 
-  std::string json_;
+  Sink& out_;
+  bool leadingComma_;
   bool firstEntry_ = true;
 };
 
+// Renders the visited fields into a string of its own.
+class JsonTypedMetadataVisitor final
+    : public JsonTypedMetadataWriter<std::string> {
+ public:
+  JsonTypedMetadataVisitor() : JsonTypedMetadataWriter(json_) {
+    json_.reserve(kInitialJsonCapacity);
+  }
+
+  [[nodiscard]] std::string json() && {
+    return std::move(json_);
+  }
+
+ private:
+  // Sized to hold the largest common CUDA activity (kernels) in one allocation,
+  // with some buffer
+  static constexpr size_t kInitialJsonCapacity = 1024;
+
+  std::string json_;
+};
+
 } // namespace libkineto::internal
@@ -10,6 +10,7 @@
 
 #include <fstream>
 #include <map>
+#include <memory>
 #include <ostream>
 #include <thread>
 #include <unordered_map>
@@ -63,6 +64,13 @@ class ActivityLogger {
     handleTraceStart(std::unordered_map<std::string, std::string>(), "");
   }
 
+  // Trace metadata that is only known once the activities have been
+  // handled, e.g. how many were filtered out. The value is a JSON value, as
+  // for handleTraceStart(). Called before finalizeTrace().
+  virtual void handleTraceMetadata(
+      const std::string& /*key*/,
+      const std::string& /*value*/) {}
+
   virtual void finalizeMemoryTrace(const std::string&, const Config&) = 0;
 
   virtual void finalizeTrace(
@@ -70,6 +78,19 @@ class ActivityLogger {
       std::unique_ptr<ActivityBuffers> buffers,
       int64_t endTime) = 0;
 
+  // Optional support for parallel serialization. A logger that can render
+  // activities independently of one another returns a new, empty shard that
+  // accepts handleActivity / handleGenericActivity and keeps its output in
+  // memory. Each shard is driven by a single thread; the shards
+  // are then merged back into this logger, in order, with mergeShard().
+  // Loggers without this support return nullptr and are always driven from
+  // one thread.
+  virtual std::unique_ptr<ActivityLogger> createShard() {
+    return nullptr;
+  }
+
+  virtual void mergeShard(ActivityLogger& /*shard*/) {}
+
  protected:
   ActivityLogger() = default;
 };
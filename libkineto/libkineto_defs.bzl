@@ -49,27 +49,39 @@ def get_libkineto_xpupti_srcs(with_api = True):
 def get_libkineto_cpu_only_srcs(with_api = True):
     return [
         "src/AbstractConfig.cpp",
+        "src/ActivityFilter.cpp",
         "src/ApproximateClock.cpp",
         "src/GenericActivityProfiler.cpp",
         "src/ActivityProfilerController.cpp",
         "src/ActivityProfilerProxy.cpp",
         "src/AsyncActivityProfilerHandler.cpp",
+        "src/AsyncLogWriter.cpp",
         "src/SyncActivityProfilerHandler.cpp",
         "src/ActivityType.cpp",
         "src/Config.cpp",
+        "src/ConfigFileWatcher.cpp",
         "src/ConfigLoader.cpp",
+        "src/CuptiActivityBufferPool.cpp",
         "src/DaemonConfigLoader.cpp",
         "src/Demangle.cpp",
         "src/DeviceProperties.cpp",
         "src/DeviceUtil.cpp",
+        "src/FlightRecorder.cpp",
         "src/GenericTraceActivity.cpp",
+        "src/GzipTraceFileWriter.cpp",
         "src/ILoggerObserver.cpp",
         "src/IpcFabricConfigClient.cpp",
+        "src/JsonEscape.cpp",
         "src/Logger.cpp",
         "src/LoggingAPI.cpp",
+        "src/MetadataStorage.cpp",
+        "src/ParallelActivityLogger.cpp",
+        "src/SampleBuffer.cpp",
+        "src/WorkerPool.cpp",
         "src/init.cpp",
         "src/output_csv.cpp",
         "src/output_json.cpp",
+        "src/output_perfetto.cpp",
     ] + (get_libkineto_api_srcs() if with_api else [])
 
 def get_libkineto_public_headers():
@@ -86,6 +98,7 @@ def get_libkineto_public_headers():
         "include/ITraceActivity.h",
         "include/LoggingAPI.h",
         "include/MetadataFieldCatalog.h",
+        "include/MetadataStorage.h",
         "include/TraceSpan.h",
         "include/ThreadUtil.h",
         "include/TypedMetadata.h",
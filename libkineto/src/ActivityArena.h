@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace KINETO_NAMESPACE {
+
+// Typed slab storage for objects that live as long as the arena, such as the
+// activity wrappers created while processing a trace. Objects are constructed
+// in place in slabs of kSlabBytes that hold objects of a single type, so there
+// is one allocation per slab rather than per object. Objects never move once
+// constructed; they are all destroyed, and the slabs freed, with the arena.
+//
+// Not thread-safe.
+class ActivityArena {
+ public:
+  static constexpr size_t kSlabBytes = 64 * 1024;
+
+  ActivityArena() = default;
+  ActivityArena(const ActivityArena&) = delete;
+  ActivityArena& operator=(const ActivityArena&) = delete;
+  ActivityArena(ActivityArena&&) = default;
+  ActivityArena& operator=(ActivityArena&&) = default;
+  ~ActivityArena() = default;
+
+  template <class T, class... Args>
+  T& emplace(Args&&... args) {
+    return pool<T>().emplace(std::forward<Args>(args)...);
+  }
+
+  // Number of objects in the arena.
+  [[nodiscard]] size_t size() const {
+    size_t total = 0;
+    for (const auto& pool : pools_) {
+      total += pool ? pool->size() : 0;
+    }
+    return total;
+  }
+
+  // Number of slabs allocated, across all types.
+  [[nodiscard]] size_t slabCount() const {
+    size_t total = 0;
+    for (const auto& pool : pools_) {
+      total += pool ? pool->slabCount() : 0;
+    }
+    return total;
+  }
+
+ private:
+  class PoolBase {
+   public:
+    virtual ~PoolBase() = default;
+    [[nodiscard]] virtual size_t size() const = 0;
+    [[nodiscard]] virtual size_t slabCount() const = 0;
+  };
+
+  template <class T>
+  class Pool final : public PoolBase {
+   public:
+    static constexpr size_t kObjectsPerSlab =
+        std::max<size_t>(1, kSlabBytes / sizeof(T));
+
+    Pool() = default;
+    Pool(const Pool&) = delete;
+    Pool& operator=(const Pool&) = delete;
+
+    ~Pool() override {
+      // Destroy in reverse order of construction, like a container would.
+      std::allocator<T> alloc;
+      for (size_t i = slabs_.size(); i-- > 0;) {
+        size_t count = i + 1 == slabs_.size() ? used_ : kObjectsPerSlab;
+        std::destroy_n(std::reverse_iterator(slabs_[i] + count), count);
+        alloc.deallocate(slabs_[i], kObjectsPerSlab);
+      }
+    }
+
+    template <class... Args>
+    T& emplace(Args&&... args) {
+      if (slabs_.empty() || used_ == kObjectsPerSlab) {
+        slabs_.reserve(slabs_.size() + 1);
+        slabs_.push_back(std::allocator<T>().allocate(kObjectsPerSlab));
+        used_ = 0;
+      }
+      // Only counted once constructed, so a throwing constructor leaves
+      // nothing to destroy.
+      T* obj = std::construct_at(
+          slabs_.back() + used_, std::forward<Args>(args)...);
+      used_++;
+      return *obj;
+    }
+
+    [[nodiscard]] size_t size() const override {
+      return slabs_.empty() ? 0
+                            : (slabs_.size() - 1) * kObjectsPerSlab + used_;
+    }
+
+    [[nodiscard]] size_t slabCount() const override {
+      return slabs_.size();
+    }
+
+   private:
+    std::vector<T*> slabs_;
+    // Objects constructed in the last slab.
+    size_t used_{0};
+  };
+
+  // Dense ids for the types stored in arenas, assigned on first use.
+  static size_t nextTypeId() {
+    static std::atomic<size_t> next{0};
+    return next++;
+  }
+
+  template <class T>
+  static size_t typeId() {
+    static const size_t id = nextTypeId();
+    return id;
+  }
+
+  template <class T>
+  Pool<T>& pool() {
+    const size_t id = typeId<T>();
+    if (id >= pools_.size()) {
+      pools_.resize(id + 1);
+    }
+    if (!pools_[id]) {
+      pools_[id] = std::make_unique<Pool<T>>();
+    }
+    return static_cast<Pool<T>&>(*pools_[id]);
+  }
+
+  // Indexed by typeId(); null for types not stored in this arena.
+  std::vector<std::unique_ptr<PoolBase>> pools_;
+};
+
+} // namespace KINETO_NAMESPACE
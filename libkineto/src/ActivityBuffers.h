@@ -10,7 +10,9 @@
 
 #include <list>
 #include <memory>
+#include <utility>
 
+#include "ActivityArena.h"
 #include "CuptiActivityBuffer.h"
 #include "libkineto.h"
 
@@ -23,12 +25,23 @@ struct ActivityBuffers {
   // Add a wrapper object to the underlying struct stored in the buffer
   template <class T>
   const ITraceActivity& addActivityWrapper(const T& act) {
-    wrappers_.push_back(std::make_unique<T>(act));
-    return *wrappers_.back().get();
+    return wrappers_.emplace<T>(act);
+  }
+
+  // Same as addActivityWrapper, constructing the wrapper in place.
+  template <class T, class... Args>
+  const ITraceActivity& emplaceActivityWrapper(Args&&... args) {
+    return wrappers_.emplace<T>(std::forward<Args>(args)...);
+  }
+
+  [[nodiscard]] size_t activityWrapperCount() const {
+    return wrappers_.size();
   }
 
  private:
-  std::vector<std::unique_ptr<const ITraceActivity>> wrappers_;
+  // Wrappers are referenced by address from loggers and from each other
+  // (linked activities), and all go away together with the buffers.
+  ActivityArena wrappers_;
 };
 
 } // namespace KINETO_NAMESPACE
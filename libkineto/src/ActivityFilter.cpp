@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ActivityFilter.h"
+
+#include <fmt/format.h>
+
+#include <string_view>
+
+#include "Config.h"
+
+namespace KINETO_NAMESPACE {
+
+// Activities that run on a device stream, where deviceId() is the GPU and
+// resourceId() the stream. Host side activities have a pid and tid there
+// instead, and are not subject to the device and stream filters.
+static bool onDeviceStream(ActivityType type) {
+  switch (type) {
+    case ActivityType::CONCURRENT_KERNEL:
+    case ActivityType::GPU_MEMCPY:
+    case ActivityType::GPU_MEMSET:
+    case ActivityType::GPU_USER_ANNOTATION:
+    case ActivityType::CUDA_SYNC:
+    case ActivityType::CUDA_EVENT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void ActivityFilter::configure(const Config& config) {
+  filterTypes_ = !config.activitiesFilterTypes().empty();
+  types_.reset();
+  for (ActivityType type : config.activitiesFilterTypes()) {
+    types_.set(static_cast<size_t>(type));
+  }
+  minDurationNs_ = config.activitiesFilterMinDuration().count();
+  nameRegex_.reset();
+  if (!config.activitiesFilterNameRegex().empty()) {
+    // Validated by Config.
+    nameRegex_.emplace(
+        config.activitiesFilterNameRegex(),
+        std::regex::ECMAScript | std::regex::optimize);
+  }
+  namePrefixes_ = config.activitiesFilterNamePrefixes();
+  devices_ = config.activitiesFilterDevices();
+  streams_ = config.activitiesFilterStreams();
+  enabled_ = filterTypes_ || minDurationNs_ > 0 || nameRegex_ ||
+      !namePrefixes_.empty() || !devices_.empty() || !streams_.empty();
+
+  droppedType_ = 0;
+  droppedDuration_ = 0;
+  droppedName_ = 0;
+  droppedDevice_ = 0;
+  droppedStream_ = 0;
+}
+
+bool ActivityFilter::keep(const ITraceActivity& act) {
+  if (!enabled_) {
+    return true;
+  }
+  const ActivityType type = act.type();
+  if (filterTypes_ && !types_.test(static_cast<size_t>(type))) {
+    droppedType_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  if (act.duration() < minDurationNs_) {
+    droppedDuration_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  if (onDeviceStream(type)) {
+    if (!devices_.empty() && !devices_.contains(act.deviceId())) {
+      droppedDevice_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    if (!streams_.empty() && !streams_.contains(act.resourceId())) {
+      droppedStream_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+  }
+  if ((nameRegex_ || !namePrefixes_.empty()) && !keepName(act.name())) {
+    droppedName_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+bool ActivityFilter::keepName(const std::string& name) const {
+  if (!namePrefixes_.empty()) {
+    const std::string_view view(name);
+    bool match = false;
+    for (const auto& prefix : namePrefixes_) {
+      if (view.starts_with(prefix)) {
+        match = true;
+        break;
+      }
+    }
+    if (!match) {
+      return false;
+    }
+  }
+  return !nameRegex_ || std::regex_search(name, *nameRegex_);
+}
+
+ActivityFilter::DropCounts ActivityFilter::dropCounts() const {
+  return {
+      .type = droppedType_.load(std::memory_order_relaxed),
+      .duration = droppedDuration_.load(std::memory_order_relaxed),
+      .name = droppedName_.load(std::memory_order_relaxed),
+      .device = droppedDevice_.load(std::memory_order_relaxed),
+      .stream = droppedStream_.load(std::memory_order_relaxed)};
+}
+
+std::string ActivityFilter::dropCountsJson() const {
+  const DropCounts counts = dropCounts();
+  return fmt::format(
+      R"JSON({{"total": {}, "type": {}, "duration": {}, "name": {}, "device": {}, "stream": {}}})JSON",
+      counts.total(),
+      counts.type,
+      counts.duration,
+      counts.name,
+      counts.device,
+      counts.stream);
+}
+
+} // namespace KINETO_NAMESPACE
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+#include <optional>
+#include <regex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "ActivityType.h"
+#include "ITraceActivity.h"
+
+namespace KINETO_NAMESPACE {
+
+class Config;
+
+using namespace libkineto;
+
+// Drops activities from a trace before they are logged, according to the
+// ACTIVITIES_FILTER_* options of a Config. The options are compiled once per
+// trace by configure(); keep() then runs on every collected activity, so it
+// checks the cheap predicates first and the name last.
+//
+// keep() may be called from several threads at once.
+class ActivityFilter {
+ public:
+  // Activities dropped by a trace, by the first predicate that failed.
+  struct DropCounts {
+    uint64_t type{0};
+    uint64_t duration{0};
+    uint64_t name{0};
+    uint64_t device{0};
+    uint64_t stream{0};
+
+    [[nodiscard]] uint64_t total() const {
+      return type + duration + name + device + stream;
+    }
+  };
+
+  ActivityFilter() = default;
+  ActivityFilter(const ActivityFilter&) = delete;
+  ActivityFilter& operator=(const ActivityFilter&) = delete;
+
+  // Replaces the predicates with those of config, and clears the counts.
+  void configure(const Config& config);
+
+  // Whether any predicate is set. keep() is true for everything if not.
+  [[nodiscard]] bool enabled() const {
+    return enabled_;
+  }
+
+  // Whether act goes into the trace. Dropped activities are counted.
+  bool keep(const ITraceActivity& act);
+
+  [[nodiscard]] DropCounts dropCounts() const;
+
+  // The drop counts as a JSON object, for the trace metadata.
+  [[nodiscard]] std::string dropCountsJson() const;
+
+ private:
+  bool keepName(const std::string& name) const;
+
+  bool enabled_{false};
+  bool filterTypes_{false};
+  std::bitset<activityTypeCount> types_;
+  int64_t minDurationNs_{0};
+  std::optional<std::regex> nameRegex_;
+  std::vector<std::string> namePrefixes_;
+  std::set<int64_t> devices_;
+  std::set<int64_t> streams_;
+
+  std::atomic<uint64_t> droppedType_{0};
+  std::atomic<uint64_t> droppedDuration_{0};
+  std::atomic<uint64_t> droppedName_{0};
+  std::atomic<uint64_t> droppedDevice_{0};
+  std::atomic<uint64_t> droppedStream_{0};
+};
+
+} // namespace KINETO_NAMESPACE
@@ -26,8 +26,10 @@
 
 #endif
 
+#include "GzipTraceFileWriter.h"
 #include "output_json.h"
 #include "output_membuf.h"
+#include "output_perfetto.h"
 
 #include "Logger.h"
 
@@ -108,11 +110,18 @@ ActivityProfilerController::~ActivityProfilerController() {
 ActivityLoggerFactory& ActivityProfilerController::loggerFactory() {
   static ActivityLoggerFactory factory;
   // Technique to ensure we register the ChromeTraceLogger as the file
-  // protocol once and only once on the static instance.
+  // protocol (and file+gz, when built with zlib) and the PerfettoTraceLogger
+  // as the perfetto protocol once and only once on the static instance.
   [[maybe_unused]] static const bool kFileProtocolRegistered = [] {
     factory.addProtocol("file", [](const std::string& url) {
       return std::unique_ptr<ActivityLogger>(new ChromeTraceLogger(url));
     });
+#ifdef HAS_ZLIB
+    factory.addProtocol(kGzipFileProtocol, makeGzipChromeTraceLogger);
+#endif
+    factory.addProtocol(kPerfettoFileProtocol, [](const std::string& url) {
+      return std::unique_ptr<ActivityLogger>(new PerfettoTraceLogger(url));
+    });
     return true;
   }();
   return factory;
@@ -201,12 +210,18 @@ void ActivityProfilerController::logInvariantViolation(
   }
 }
 
+// A running flight recorder keeps the profiler active, but still takes
+// dump and stop requests; the async handler turns down any other request.
+bool ActivityProfilerController::isBusy() {
+  return isActive() && !asyncHandler_->isFlightRecording();
+}
+
 // ConfigLoader::ConfigHandler callback API.
 bool ActivityProfilerController::canAcceptConfig() {
-  return !isActive();
+  return !isBusy();
 }
 bool ActivityProfilerController::acceptConfig(const Config& config) {
-  if (isActive()) {
+  if (isBusy()) {
     logRequestCancellation(config, "Ignored request - profiler busy");
     return false;
   }
@@ -215,7 +230,7 @@ bool ActivityProfilerController::acceptConfig(const Config& config) {
 
 // These API are used for On-Demand Tracing.
 void ActivityProfilerController::asyncScheduleTrace(const Config& config) {
-  if (isActive()) {
+  if (isBusy()) {
     logRequestCancellation(config, "Ignored request - profiler busy");
     return;
   }
@@ -225,6 +240,14 @@ void ActivityProfilerController::asyncStep() {
   asyncHandler_->step();
 }
 
+// These API are used for the flight recorder.
+bool ActivityProfilerController::dumpFlightRecorder(const Config& config) {
+  return asyncHandler_->requestFlightRecorderDump(config);
+}
+bool ActivityProfilerController::stopFlightRecorder() {
+  return asyncHandler_->stopFlightRecorder();
+}
+
 // These API are used for Synchronous Tracing.
 void ActivityProfilerController::syncPrepareTrace(const Config& config) {
   // Sync-trace requests preempt any active trace.
@@ -246,6 +269,10 @@ std::unique_ptr<ActivityTraceInterface> ActivityProfilerController::
     syncStopTrace() {
   return syncHandler_->stopTrace();
 }
+std::future<std::unique_ptr<ActivityTraceInterface>>
+ActivityProfilerController::syncStopTraceAsync() {
+  return syncHandler_->stopTraceAsync();
+}
 
 } // namespace KINETO_NAMESPACE
 
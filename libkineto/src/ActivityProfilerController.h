@@ -11,6 +11,7 @@
 #include <atomic>
 #include <cstdint>
 #include <functional>
+#include <future>
 #include <memory>
 #include <vector>
 
@@ -61,11 +62,17 @@ class ActivityProfilerController : public ConfigLoader::ConfigHandler {
   void asyncScheduleTrace(const Config& config);
   void asyncStep();
 
+  // These API are used for the flight recorder, and return false if it is
+  // not running. A dump is written to the log file of config.
+  bool dumpFlightRecorder(const Config& config);
+  bool stopFlightRecorder();
+
   // These API are used for Synchronous Tracing.
   void syncPrepareTrace(const Config& config);
   void syncToggleCollectionDynamic(const bool enable);
   void syncStartTrace();
   std::unique_ptr<ActivityTraceInterface> syncStopTrace();
+  std::future<std::unique_ptr<ActivityTraceInterface>> syncStopTraceAsync();
 
   bool isActive();
   bool isStopped() const;
@@ -97,6 +104,8 @@ class ActivityProfilerController : public ConfigLoader::ConfigHandler {
   static ActivityLoggerFactory& loggerFactory();
 
  private:
+  bool isBusy();
+
   std::unique_ptr<GenericActivityProfiler> profiler_;
   std::vector<std::shared_ptr<LoggerCollector>> loggerCollectors_;
   ConfigLoader& configLoader_;
@@ -100,6 +100,24 @@ std::unique_ptr<ActivityTraceInterface> ActivityProfilerProxy::stopTrace() {
   return controller_->syncStopTrace();
 }
 
+std::future<std::unique_ptr<ActivityTraceInterface>> ActivityProfilerProxy::
+    stopTraceAsync() {
+  return controller_->syncStopTraceAsync();
+}
+
+// Flight recorder functions.
+bool ActivityProfilerProxy::dumpFlightRecorder(const std::string& configStr) {
+  Config config;
+  if (!config.parse(configStr)) {
+    LOG(WARNING) << "Failed to parse config : " << configStr;
+  }
+  return controller_->dumpFlightRecorder(config);
+}
+
+bool ActivityProfilerProxy::stopFlightRecorder() {
+  return controller_->stopFlightRecorder();
+}
+
 // TraceActivity API.
 void ActivityProfilerProxy::pushCorrelationId(uint64_t id) {
   controller_->pushCorrelationId(id);
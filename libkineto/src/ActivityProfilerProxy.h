@@ -10,6 +10,7 @@
 
 #include "ActivityProfilerInterface.h"
 
+#include <future>
 #include <memory>
 #include <set>
 #include <vector>
@@ -61,6 +62,12 @@ class ActivityProfilerProxy : public ActivityProfilerInterface {
 
   void startTrace() override;
   std::unique_ptr<ActivityTraceInterface> stopTrace() override;
+  std::future<std::unique_ptr<ActivityTraceInterface>> stopTraceAsync()
+      override;
+
+  // These API are used for the flight recorder.
+  bool dumpFlightRecorder(const std::string& configStr) override;
+  bool stopFlightRecorder() override;
 
   // TraceActivity API.
   void pushCorrelationId(uint64_t id) override;
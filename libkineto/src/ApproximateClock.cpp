@@ -44,8 +44,8 @@ ApproximateClockToUnixTimeConverter::measurePairs() {
   return out;
 }
 
-std::function<time_t(approx_time_t)> ApproximateClockToUnixTimeConverter::
-    makeConverter() {
+ApproximateClockConversion ApproximateClockToUnixTimeConverter::
+    makeConversion() {
   auto end_times = measurePairs();
 
   // Compute the real time that passes for each tick of the approximate clock.
@@ -80,22 +80,25 @@ std::function<time_t(approx_time_t)> ApproximateClockToUnixTimeConverter::
   t0 += static_cast<time_t>(
       t0_correction[t0_correction.size() / 2 + 1]); // NOLINT
 
-  return [=](approx_time_t t_approx) {
-    // See above for why this is more stable than `A * t_approx + B`.
-    return t_approx > t0_approx
-        ? static_cast<time_t>(
-              static_cast<double>(t_approx - t0_approx) * scale_factor) +
-            t0
-        : 0;
+  return ApproximateClockConversion{
+      .t0_approx = t0_approx,
+      .t0 = t0,
+      .scale_factor = static_cast<double>(scale_factor),
+      .identity = false};
+}
+
+std::function<time_t(approx_time_t)> ApproximateClockToUnixTimeConverter::
+    makeConverter() {
+  return [conversion = makeConversion()](approx_time_t t_approx) {
+    return conversion.convert(t_approx);
   };
 }
 
 // Sets the timestamp converter. If nothing is set then the converter just
 // returns the input. For this reason, until we add profiler impl of passing in
 // TSC converter we just need to guard the callback itself
-std::function<time_t(approx_time_t)>& get_time_converter() {
-  static std::function<time_t(approx_time_t)> _time_converter =
-      [](approx_time_t t) { return t; };
+ApproximateTimeConverter& get_time_converter() {
+  static ApproximateTimeConverter _time_converter;
   return _time_converter;
 }
 
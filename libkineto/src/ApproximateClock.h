@@ -10,13 +10,16 @@
 
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <ctime>
 #include <functional>
+#include <span>
 #include <type_traits>
+#include <utility>
 
 #if defined(__i386__) || defined(__x86_64__) || defined(__amd64__)
 #define KINETO_RDTSC
@@ -100,12 +103,105 @@ static_assert(
         std::is_same_v<approx_time_t, uint64_t>,
     "Expected either int64_t (`getTime`) or uint64_t (some TSC reads).");
 
-std::function<time_t(approx_time_t)>& get_time_converter();
+// Linear mapping from approximate time to nanoseconds since unix epoch, as
+// measured by ApproximateClockToUnixTimeConverter. Plain data so that the
+// conversion inlines into the loops that apply it; a default-constructed
+// conversion is the identity.
+struct ApproximateClockConversion {
+  approx_time_t t0_approx{0};
+  time_t t0{0};
+  double scale_factor{1.0};
+  bool identity{true};
+
+  time_t convert(approx_time_t t_approx) const {
+    if (identity) {
+      return static_cast<time_t>(t_approx);
+    }
+    // Offsetting by `t0_approx` first is more stable than
+    // `A * t_approx + B`, see makeConversion().
+    return t_approx > t0_approx
+        ? static_cast<time_t>(
+              static_cast<double>(t_approx - t0_approx) * scale_factor) +
+            t0
+        : 0;
+  }
+
+  // Converts in[i] into out[i]; in and out may be the same array. The loop
+  // body is branch-free, so the compiler can vectorize it.
+  void convert(std::span<const approx_time_t> in, std::span<time_t> out)
+      const {
+    const size_t n = std::min(in.size(), out.size());
+    if (identity) {
+      for (size_t i = 0; i < n; i++) {
+        out[i] = static_cast<time_t>(in[i]);
+      }
+      return;
+    }
+    for (size_t i = 0; i < n; i++) {
+      const approx_time_t t_approx = in[i];
+      const bool after = t_approx > t0_approx;
+      const approx_time_t delta = after ? t_approx - t0_approx : 0;
+      const time_t t =
+          static_cast<time_t>(static_cast<double>(delta) * scale_factor) + t0;
+      out[i] = after ? t : 0;
+    }
+  }
+};
+
+// Converts approximate timestamps to unix time. Normally applies an
+// ApproximateClockConversion inline; it can also hold an arbitrary function
+// instead, as tests do to control timestamps.
+class ApproximateTimeConverter {
+ public:
+  time_t operator()(approx_time_t t_approx) const {
+    return function_ ? function_(t_approx) : conversion_.convert(t_approx);
+  }
+
+  // Batch version of operator(), see ApproximateClockConversion::convert.
+  void convert(std::span<const approx_time_t> in, std::span<time_t> out)
+      const {
+    if (!function_) {
+      conversion_.convert(in, out);
+      return;
+    }
+    const size_t n = std::min(in.size(), out.size());
+    for (size_t i = 0; i < n; i++) {
+      out[i] = function_(in[i]);
+    }
+  }
+
+  ApproximateTimeConverter& operator=(
+      const ApproximateClockConversion& conversion) {
+    conversion_ = conversion;
+    function_ = nullptr;
+    return *this;
+  }
+
+  ApproximateTimeConverter& operator=(
+      std::function<time_t(approx_time_t)> function) {
+    conversion_ = ApproximateClockConversion();
+    function_ = std::move(function);
+    return *this;
+  }
+
+  // True if timestamps are returned as they are.
+  [[nodiscard]] bool isIdentity() const {
+    return !function_ && conversion_.identity;
+  }
+
+ private:
+  ApproximateClockConversion conversion_;
+  std::function<time_t(approx_time_t)> function_;
+};
+
+ApproximateTimeConverter& get_time_converter();
 
 // Convert `getCount` results to Nanoseconds since unix epoch.
 class ApproximateClockToUnixTimeConverter final {
  public:
   ApproximateClockToUnixTimeConverter();
+  ApproximateClockConversion makeConversion();
+  // Same as makeConversion(), wrapped in a function.
   std::function<time_t(approx_time_t)> makeConverter();
 
   struct UnixAndApproximateTimePair {
@@ -8,6 +8,7 @@
 
 #include "AsyncActivityProfilerHandler.h"
 
+#include <algorithm>
 #include <chrono>
 #include <exception>
 #include <string>
@@ -18,6 +19,7 @@
 #include "Logger.h"
 #include "ThreadUtil.h"
 #include "output_membuf.h"
+#include "time_since_epoch.h"
 
 using namespace std::chrono;
 
@@ -32,14 +34,20 @@ static void logRequestCancellation(
 }
 
 AsyncActivityProfilerHandler::AsyncActivityProfilerHandler(
-    GenericActivityProfiler& profiler)
-    : profiler_(profiler) {}
+    GenericActivityProfiler& profiler,
+    RunLoopClock& clock)
+    : clock_(clock),
+      loopWaker_(clock),
+      memoryLoopWaker_(clock),
+      profiler_(profiler) {}
 
 AsyncActivityProfilerHandler::~AsyncActivityProfilerHandler() {
   for (auto& profilerThread : profilerThreads_) {
     if (profilerThread != nullptr) {
       // signaling termination of the profiler loop
       stopRunloop_ = true;
+      loopWaker_.wake();
+      memoryLoopWaker_.wake();
       profilerThread->join();
       profilerThread.reset();
     }
@@ -58,6 +66,25 @@ bool AsyncActivityProfilerHandler::acceptConfig(const Config& config) {
 bool AsyncActivityProfilerHandler::scheduleTrace(const Config& config) {
   VLOG(1) << "scheduleTrace";
 
+  if (config.flightRecorderDump()) {
+    return requestFlightRecorderDump(config);
+  }
+  if (config.flightRecorderStop()) {
+    if (!stopFlightRecorder()) {
+      logRequestCancellation(
+          config,
+          "Ignored flight recorder stop request - the flight recorder is not running.");
+      return false;
+    }
+    return true;
+  }
+  if (isFlightRecording()) {
+    logRequestCancellation(
+        config,
+        "Ignored request - the flight recorder is running, request a dump instead.");
+    return false;
+  }
+
   int64_t currentIter = iterationCount_;
   std::unique_ptr<Config> configToSchedule;
 
@@ -95,7 +122,8 @@ bool AsyncActivityProfilerHandler::scheduleTrace(const Config& config) {
     return false;
   }
 
-  // start a profilerLoop() thread to handle request
+  // start a profilerLoop() thread to handle request, or wake it up to
+  // schedule the request
 
   if (config.memoryProfilerEnabled()) {
     auto thread_type = ThreadType::MEMORY_SNAPSHOT;
@@ -103,12 +131,14 @@ bool AsyncActivityProfilerHandler::scheduleTrace(const Config& config) {
       profilerThreads_[thread_type] = std::make_unique<std::thread>(
           &AsyncActivityProfilerHandler::memoryProfilerLoop, this);
     }
+    memoryLoopWaker_.wake();
   } else {
     auto thread_type = ThreadType::KINETO;
     if (profilerThreads_[thread_type] == nullptr) {
       profilerThreads_[thread_type] = std::make_unique<std::thread>(
           &AsyncActivityProfilerHandler::profilerLoop, this);
     }
+    loopWaker_.wake();
   }
   return true;
 }
@@ -122,17 +152,23 @@ void AsyncActivityProfilerHandler::step() {
   // Perform Double-checked locking to reduce overhead of taking lock.
   if (asyncRequestConfig_ && !isAsyncActive()) {
     std::scoped_lock lock(asyncConfigLock_);
-    auto now = system_clock::now();
+    auto now = clock_.now();
     if (asyncRequestConfig_ && !isAsyncActive() &&
         shouldActivateIterationConfig(currentIter)) {
       activateConfig(now);
+      // The loop is waiting for the request to start.
+      loopWaker_.wake();
     }
   }
   if (isAsyncActive() && !isCollectingMemorySnapshot()) {
-    auto now = system_clock::now();
+    auto now = clock_.now();
     auto next_wakeup_time = now + Config::kControllerIntervalMsecs;
     performRunLoopStep(now, next_wakeup_time, currentIter);
   }
+  // The flight recorder segment is over, and the loop ends it.
+  if (currentIter >= segmentEndIteration_) {
+    loopWaker_.wake();
+  }
 }
 
 bool AsyncActivityProfilerHandler::shouldActivateTimestampConfig(
@@ -143,14 +179,7 @@ bool AsyncActivityProfilerHandler::shouldActivateTimestampConfig(
   if (asyncRequestConfig_->memoryProfilerEnabled()) {
     return false;
   }
-  // Note on now + Config::kControllerIntervalMsecs:
-  // Profiler interval does not align perfectly up to startTime - warmup.
-  // Waiting until the next tick won't allow sufficient time for the
-  // profiler to warm up. So check if we are very close to the warmup time
-  // and trigger warmup.
-  if (now + Config::kControllerIntervalMsecs >=
-      (asyncRequestConfig_->requestTimestamp() -
-       asyncRequestConfig_->activitiesWarmupDuration())) {
+  if (now >= requestActivationTime()) {
     LOG(INFO)
         << "Received on-demand activity trace request by "
         << " profile timestamp = "
@@ -160,6 +189,20 @@ bool AsyncActivityProfilerHandler::shouldActivateTimestampConfig(
   return false;
 }
 
+// This function should only be called when holding the configLock_.
+time_point<system_clock> AsyncActivityProfilerHandler::requestActivationTime() {
+  if (!asyncRequestConfig_ || asyncRequestConfig_->hasProfileStartIteration() ||
+      asyncRequestConfig_->memoryProfilerEnabled()) {
+    return RunLoopWaker::kNever;
+  }
+  // Activate a little before the warmup is due to start, so that the loop
+  // waking up late does not leave too little time for the profiler to warm
+  // up.
+  return asyncRequestConfig_->requestTimestamp() -
+      asyncRequestConfig_->activitiesWarmupDuration() -
+      Config::kControllerIntervalMsecs;
+}
+
 bool AsyncActivityProfilerHandler::shouldActivateIterationConfig(
     int64_t currentIter) {
   if (!asyncRequestConfig_->hasProfileStartIteration()) {
@@ -206,21 +249,16 @@ bool AsyncActivityProfilerHandler::shouldActivateIterationConfig(
   return true;
 }
 
+// Sleeps until there is something to do: a new request, a request or
+// trace deadline, a state change made on another thread, or a flight
+// recorder command. Without a request it does not wake up at all.
 void AsyncActivityProfilerHandler::profilerLoop() {
   setThreadName("Kineto Activity Profiler");
   VLOG(0) << "Entering activity profiler loop";
 
-  auto now = system_clock::now();
-  auto next_wakeup_time = now + Config::kControllerIntervalMsecs;
-
   while (!stopRunloop_) {
-    now = system_clock::now();
-
-    while (now < next_wakeup_time) {
-      /* sleep override */
-      std::this_thread::sleep_for(next_wakeup_time - now);
-      now = system_clock::now();
-    }
+    auto now = clock_.now();
+    auto next_wakeup_time = RunLoopWaker::kNever;
 
     // Perform Double-checked locking to reduce overhead of taking lock.
     if (asyncRequestConfig_ && !isAsyncActive()) {
@@ -231,16 +269,24 @@ void AsyncActivityProfilerHandler::profilerLoop() {
       }
     }
 
-    while (next_wakeup_time < now) {
-      next_wakeup_time += Config::kControllerIntervalMsecs;
-    }
-
     if (isAsyncActive() && !isCollectingMemorySnapshot()) {
-      next_wakeup_time = performRunLoopStep(now, next_wakeup_time);
+      const RunloopState state = currentRunloopState_;
+      next_wakeup_time =
+          performRunLoopStep(now, now + Config::kControllerIntervalMsecs);
       VLOG(1) << "Profiler loop: "
-              << duration_cast<milliseconds>(system_clock::now() - now).count()
+              << duration_cast<milliseconds>(clock_.now() - now).count()
               << "ms";
+      // Carry on in the new state, e.g. process a trace as soon as it has
+      // been collected.
+      if (currentRunloopState_ != state) {
+        continue;
+      }
     }
+    if (!isAsyncActive()) {
+      std::scoped_lock lock(asyncConfigLock_);
+      next_wakeup_time = std::min(next_wakeup_time, requestActivationTime());
+    }
+    loopWaker_.waitUntil(next_wakeup_time);
   }
 
   // On teardown the destructor sets stopRunloop_ and joins this thread; if
@@ -272,6 +318,7 @@ void AsyncActivityProfilerHandler::completePendingTrace() {
 
 void AsyncActivityProfilerHandler::memoryProfilerLoop() {
   while (!stopRunloop_) {
+    memoryLoopWaker_.waitUntil(RunLoopWaker::kNever);
     // Perform Double-checked locking to reduce overhead of taking lock.
     if (asyncRequestConfig_ && !isAsyncActive()) {
       std::scoped_lock lock(asyncConfigLock_);
@@ -301,6 +348,14 @@ void AsyncActivityProfilerHandler::configure(
   LOGGER_OBSERVER_RESET();
   LOGGER_OBSERVER_SET_TRIGGER_ON_DEMAND();
   profiler_.configure(config, now);
+  if (config.flightRecorderEnabled()) {
+    flightRecorder_ = std::make_unique<FlightRecorder>(config);
+    flightRecorderConfig_ = config.clone();
+    flightRecorderRunning_ = true;
+  } else {
+    flightRecorder_ = nullptr;
+    flightRecorderConfig_ = nullptr;
+  }
   VLOG(0) << "WaitForRequest -> Warmup";
   currentRunloopState_ = RunloopState::Warmup;
 }
@@ -346,6 +401,7 @@ time_point<system_clock> AsyncActivityProfilerHandler::performRunLoopStep(
             << profiler_.activitiesMaxGpuBufferSizeMB() << "MB)";
         UST_LOGGER_MARK_COMPLETED(kWarmUpStage);
         VLOG(0) << "Warmup -> WaitForRequest";
+        flightRecorderRunning_ = false;
         currentRunloopState_ = RunloopState::WaitForRequest;
         break;
       }
@@ -367,6 +423,15 @@ time_point<system_clock> AsyncActivityProfilerHandler::performRunLoopStep(
         if (currentRunloopState_ == RunloopState::Cancelling) {
           break;
         }
+        if (flightRecorder_) {
+          VLOG(0) << "Warmup -> FlightRecord";
+          currentRunloopState_ = RunloopState::FlightRecord;
+          startFlightRecorderSegment(now);
+          if (libkineto::api().client() != nullptr) {
+            libkineto::api().client()->start();
+          }
+          break;
+        }
         VLOG(0) << "Warmup -> CollectTrace";
         currentRunloopState_ = RunloopState::CollectTrace;
         if (libkineto::api().client() != nullptr) {
@@ -444,6 +509,59 @@ time_point<system_clock> AsyncActivityProfilerHandler::performRunLoopStep(
       completePendingTrace();
       break;
     }
+
+    case RunloopState::FlightRecord: {
+      VLOG(1) << "State: FlightRecord";
+      // As for ProcessTrace, only the profiler loop processes segments.
+      if (currentIter >= 0) {
+        return new_wakeup_time;
+      }
+      std::unique_ptr<Config> dumpConfig;
+      {
+        std::scoped_lock lock(flightRecorderLock_);
+        dumpConfig = std::move(pendingFlightRecorderDump_);
+      }
+      const bool stop = stopFlightRecorder_.exchange(false);
+      const bool gpuStopped = profiler_.isGpuCollectionStopped();
+      if (stop || gpuStopped) {
+        endFlightRecorderSegment(now);
+        if (currentRunloopState_ == RunloopState::Cancelling) {
+          break;
+        }
+        if (!stop) {
+          // GPU tracing stopped at its buffer limit, and only comes back
+          // with a new configuration.
+          LOG(WARNING) << "Flight recorder restarted: GPU buffers are full";
+          profiler_.configure(*flightRecorderConfig_, now);
+          profiler_.startTrace(now);
+          startFlightRecorderSegment(now);
+          if (libkineto::api().client() != nullptr) {
+            libkineto::api().client()->start();
+          }
+        }
+      } else if (dumpConfig || isFlightRecorderSegmentDone(now)) {
+        rotateFlightRecorderSegment(now);
+      }
+      // Written after the next segment has started, so that recording
+      // continues while the dump is being written.
+      if (dumpConfig) {
+        dumpFlightRecorder(*dumpConfig);
+      }
+      if (stop) {
+        LOG(INFO) << "Flight recorder stopped";
+        flightRecorder_ = nullptr;
+        flightRecorderConfig_ = nullptr;
+        flightRecorderRunning_ = false;
+        segmentEndIteration_ = INT64_MAX;
+        VLOG(0) << "FlightRecord -> WaitForRequest";
+        currentRunloopState_ = RunloopState::WaitForRequest;
+      } else if (!flightRecorder_->isIterationBased()) {
+        new_wakeup_time = std::min(
+            nextWakeupTime,
+            segmentStartTime_ + flightRecorder_->segmentDuration());
+      }
+      break;
+    }
   }
 
   return new_wakeup_time;
@@ -461,6 +579,9 @@ void AsyncActivityProfilerHandler::collectTrace(
   }
   VLOG(0) << "CollectTrace -> ProcessTrace";
   currentRunloopState_ = RunloopState::ProcessTrace;
+  // Only the loop processes the trace, and when step() collected it the loop
+  // is still waiting for its next deadline.
+  loopWaker_.wake();
 }
 
 void AsyncActivityProfilerHandler::performMemoryLoop(
@@ -482,12 +603,114 @@ void AsyncActivityProfilerHandler::performMemoryLoop(
   currentRunloopState_ = RunloopState::WaitForRequest;
 }
 
+bool AsyncActivityProfilerHandler::requestFlightRecorderDump(
+    const Config& config) {
+  if (!isFlightRecording()) {
+    logRequestCancellation(
+        config,
+        "Ignored flight recorder dump request - the flight recorder is not running.");
+    return false;
+  }
+  std::scoped_lock lock(flightRecorderLock_);
+  if (pendingFlightRecorderDump_) {
+    logRequestCancellation(
+        config,
+        "Ignored flight recorder dump request - another dump is pending.");
+    return false;
+  }
+  LOG(INFO) << "Received flight recorder dump request";
+  pendingFlightRecorderDump_ = config.clone();
+  loopWaker_.wake();
+  return true;
+}
+
+bool AsyncActivityProfilerHandler::stopFlightRecorder() {
+  if (!isFlightRecording()) {
+    return false;
+  }
+  LOG(INFO) << "Received flight recorder stop request";
+  stopFlightRecorder_ = true;
+  loopWaker_.wake();
+  return true;
+}
+
+void AsyncActivityProfilerHandler::startFlightRecorderSegment(
+    const time_point<system_clock>& now) {
+  segmentStartTime_ = now;
+  segmentStartIteration_ = iterationCount_;
+  segmentEndIteration_ = flightRecorder_->isIterationBased()
+      ? segmentStartIteration_ + flightRecorder_->segmentIterations()
+      : INT64_MAX;
+}
+
+// Hands the segment to the flight recorder and starts the next one, with
+// tracing left enabled. Only the client is stopped and started again, as
+// that is how it hands over the CPU events it has recorded.
+void AsyncActivityProfilerHandler::rotateFlightRecorderSegment(
+    const time_point<system_clock>& now) {
+  if (libkineto::api().client() != nullptr) {
+    libkineto::api().client()->stop();
+    libkineto::api().client()->start();
+  }
+  auto trace = std::make_unique<MemoryTraceLogger>(profiler_.config());
+  profiler_.rotateTrace(*trace, now);
+  addFlightRecorderSegment(std::move(trace), now);
+  startFlightRecorderSegment(now);
+}
+
+// Stops tracing and hands the last segment to the flight recorder, leaving
+// the profiler reset.
+void AsyncActivityProfilerHandler::endFlightRecorderSegment(
+    const time_point<system_clock>& now) {
+  if (libkineto::api().client() != nullptr) {
+    libkineto::api().client()->stop();
+  }
+  profiler_.stopTrace(now);
+  auto trace = std::make_unique<MemoryTraceLogger>(profiler_.config());
+  profiler_.completeTrace(*trace);
+  addFlightRecorderSegment(std::move(trace), now);
+}
+
+void AsyncActivityProfilerHandler::addFlightRecorderSegment(
+    std::unique_ptr<MemoryTraceLogger> trace,
+    const time_point<system_clock>& now) {
+  VLOG(0) << "Flight recorder segment with " << trace->eventCount()
+          << " events";
+  flightRecorder_->addSegment(
+      {.trace = std::move(trace),
+       .startTime = libkineto::timeSinceEpoch(segmentStartTime_),
+       .endTime = libkineto::timeSinceEpoch(now),
+       .startIteration = segmentStartIteration_,
+       .endIteration = iterationCount_});
+}
+
+bool AsyncActivityProfilerHandler::isFlightRecorderSegmentDone(
+    const time_point<system_clock>& now) const {
+  if (flightRecorder_->isIterationBased()) {
+    return iterationCount_ - segmentStartIteration_ >=
+        flightRecorder_->segmentIterations();
+  }
+  return now >= segmentStartTime_ + flightRecorder_->segmentDuration();
+}
+
+void AsyncActivityProfilerHandler::dumpFlightRecorder(const Config& config) {
+  auto logger = ActivityProfilerController::makeLogger(config);
+  if (!flightRecorder_ || !flightRecorder_->dump(*logger, config)) {
+    LOG(WARNING) << "Flight recorder has nothing to dump";
+    return;
+  }
+  LOG(INFO) << "Flight recorder dumped " << flightRecorder_->eventCount()
+            << " events from " << flightRecorder_->segmentCount()
+            << " segments to " << config.activitiesLogFile();
+}
+
 bool AsyncActivityProfilerHandler::getCollectTraceState() {
   std::scoped_lock guard(collectTraceStateMutex_);
   return isCollectingTrace_;
 }
 
 void AsyncActivityProfilerHandler::ensureCollectTraceDone() {
+  std::scoped_lock lock(collectTraceThreadMutex_);
   if (collectTraceThread_ && collectTraceThread_->joinable()) {
     collectTraceThread_->join();
     collectTraceThread_.reset(nullptr);
@@ -504,6 +727,8 @@ void AsyncActivityProfilerHandler::cancel() {
   }
 
   currentRunloopState_ = RunloopState::Cancelling;
+  flightRecorderRunning_ = false;
+  segmentEndIteration_ = INT64_MAX;
 
   LOG(ERROR) << "Cancelling current trace request in order to start "
              << "higher priority synchronous request";
@@ -513,12 +738,13 @@ void AsyncActivityProfilerHandler::cancel() {
   if (libkineto::api().client() != nullptr) {
     libkineto::api().client()->stop();
   }
-  profiler_.cancelTrace(std::chrono::system_clock::now());
+  profiler_.cancelTrace(clock_.now());
   VLOG(0) << "Cancelled from state == "
           << static_cast<std::underlying_type_t<RunloopState>>(
                  currentRunloopState_.load())
           << " -> WaitForRequest";
   currentRunloopState_ = RunloopState::WaitForRequest;
+  loopWaker_.wake();
 }
 
 } // namespace KINETO_NAMESPACE
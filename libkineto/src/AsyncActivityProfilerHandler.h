@@ -11,12 +11,15 @@
 #include <array>
 #include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <memory>
 #include <mutex>
 #include <thread>
 
 #include "ActivityLoggerFactory.h"
+#include "FlightRecorder.h"
 #include "GenericActivityProfiler.h"
+#include "RunLoopWaker.h"
 
 namespace KINETO_NAMESPACE {
 
@@ -30,7 +33,9 @@ class Config;
 
 class AsyncActivityProfilerHandler {
  public:
-  explicit AsyncActivityProfilerHandler(GenericActivityProfiler& profiler);
+  explicit AsyncActivityProfilerHandler(
+      GenericActivityProfiler& profiler,
+      RunLoopClock& clock = RunLoopClock::system());
   AsyncActivityProfilerHandler(const AsyncActivityProfilerHandler&) = delete;
   AsyncActivityProfilerHandler& operator=(const AsyncActivityProfilerHandler&) =
       delete;
@@ -58,15 +63,45 @@ class AsyncActivityProfilerHandler {
 
   void cancel();
 
+  // Flight recorder mode, started by a config with
+  // ACTIVITIES_FLIGHT_RECORDER=true: instead of collecting a single trace,
+  // the profiler keeps tracing and retains only the most recent window.
+  [[nodiscard]] bool isFlightRecording() const {
+    return flightRecorderRunning_;
+  }
+
+  // Writes the retained window to the log file of the given config. The dump
+  // is carried out at the next step of the profiler loop, which first ends
+  // the segment being recorded so that the dump is up to date. Returns false
+  // if the flight recorder is not running or a dump is already pending.
+  bool requestFlightRecorderDump(const Config& config);
+
+  // Stops the flight recorder at the next step of the profiler loop,
+  // discarding the retained window. Returns false if the flight recorder is
+  // not running.
+  bool stopFlightRecorder();
+
+  // Only safe to use on the thread driving performRunLoopStep().
+  [[nodiscard]] const FlightRecorder* flightRecorder() const {
+    return flightRecorder_.get();
+  }
+
   void configure(
       const Config& config,
       std::chrono::time_point<std::chrono::system_clock> now);
 
-  // Invoke at a regular interval to perform profiling activities.
-  // When not active, an interval of 1-5 seconds is probably fine,
-  // depending on required warm-up time and delayed start time.
-  // When active, it's a good idea to invoke more frequently to stay below
-  // memory usage limit (ACTIVITIES_MAX_GPU_BUFFER_SIZE_MB) during warmup.
+  // Number of times the profiler loop has woken up. The loop sleeps until a
+  // request, a state change or the next deadline of the trace, so it does not
+  // wake up at all while idle.
+  [[nodiscard]] uint64_t runLoopWakeups() const {
+    return loopWaker_.wakeups();
+  }
+
+  // Performs profiling activities due at now, and returns when to be called
+  // next, no later than nextWakeupTime. The profiler loop calls it with
+  // nextWakeupTime Config::kControllerIntervalMsecs ahead while a trace is
+  // active, to stay below the memory usage limit
+  // (ACTIVITIES_MAX_GPU_BUFFER_SIZE_MB) during warmup.
   std::chrono::time_point<std::chrono::system_clock> performRunLoopStep(
       const std::chrono::time_point<std::chrono::system_clock>& now,
       const std::chrono::time_point<std::chrono::system_clock>& nextWakeupTime,
@@ -78,11 +113,27 @@ class AsyncActivityProfilerHandler {
   bool shouldActivateIterationConfig(int64_t currentIter);
   bool shouldActivateTimestampConfig(
       const std::chrono::time_point<std::chrono::system_clock>& now);
+  // When the loop should wake up to activate the pending request, if it
+  // has a start time.
+  std::chrono::time_point<std::chrono::system_clock> requestActivationTime();
   void profilerLoop();
   void memoryProfilerLoop();
   void completePendingTrace();
   void activateConfig(std::chrono::time_point<std::chrono::system_clock> now);
 
+  void startFlightRecorderSegment(
+      const std::chrono::time_point<std::chrono::system_clock>& now);
+  void rotateFlightRecorderSegment(
+      const std::chrono::time_point<std::chrono::system_clock>& now);
+  void endFlightRecorderSegment(
+      const std::chrono::time_point<std::chrono::system_clock>& now);
+  void addFlightRecorderSegment(
+      std::unique_ptr<MemoryTraceLogger> trace,
+      const std::chrono::time_point<std::chrono::system_clock>& now);
+  bool isFlightRecorderSegmentDone(
+      const std::chrono::time_point<std::chrono::system_clock>& now) const;
+  void dumpFlightRecorder(const Config& config);
+
   std::unique_ptr<Config> asyncRequestConfig_;
   std::mutex asyncConfigLock_;
   std::array<std::unique_ptr<std::thread>, ThreadType::THREAD_MAX_COUNT>
@@ -90,6 +141,11 @@ class AsyncActivityProfilerHandler {
   std::atomic_bool stopRunloop_{false};
   std::atomic<std::int64_t> iterationCount_{-1};
 
+  RunLoopClock& clock_;
+  // Wake up profilerLoop() and memoryProfilerLoop().
+  RunLoopWaker loopWaker_;
+  RunLoopWaker memoryLoopWaker_;
+
   GenericActivityProfiler& profiler_;
   std::unique_ptr<ActivityLogger> logger_;
 
@@ -99,6 +155,7 @@ class AsyncActivityProfilerHandler {
     CollectTrace,
     ProcessTrace,
     CollectMemorySnapshot,
+    FlightRecord,
     Cancelling,
   };
 
@@ -116,7 +173,23 @@ class AsyncActivityProfilerHandler {
 
   std::atomic<RunloopState> currentRunloopState_{RunloopState::WaitForRequest};
   std::unique_ptr<std::thread> collectTraceThread_{nullptr};
+  // Both the loop and cancel() may join collectTraceThread_.
+  std::mutex collectTraceThreadMutex_;
   std::recursive_mutex collectTraceStateMutex_;
   bool isCollectingTrace_{false};
+
+  // Flight recorder state. Everything but the atomics and the pending dump
+  // is only used by the thread driving performRunLoopStep().
+  std::unique_ptr<FlightRecorder> flightRecorder_;
+  std::unique_ptr<Config> flightRecorderConfig_;
+  std::chrono::time_point<std::chrono::system_clock> segmentStartTime_;
+  int64_t segmentStartIteration_{0};
+  // Iteration at which an iteration based segment ends, for step() to wake
+  // up the loop.
+  std::atomic<int64_t> segmentEndIteration_{INT64_MAX};
+  std::atomic_bool flightRecorderRunning_{false};
+  std::atomic_bool stopFlightRecorder_{false};
+  std::mutex flightRecorderLock_;
+  std::unique_ptr<Config> pendingFlightRecorderDump_;
 };
 } // namespace KINETO_NAMESPACE
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "AsyncLogWriter.h"
+
+#if !USE_GOOGLE_LOG
+
+#include <algorithm>
+#include <utility>
+
+#include "ILoggerObserver.h"
+#include "ThreadUtil.h"
+
+namespace KINETO_NAMESPACE {
+
+namespace {
+
+uint64_t nextWriterId() {
+  static std::atomic<uint64_t> next{1};
+  return next++;
+}
+
+} // namespace
+
+// Single-producer, single-consumer ring of records.
+class AsyncLogWriter::Ring {
+ public:
+  explicit Ring(size_t size) : slots_(size) {}
+
+  // Producer only.
+  bool push(LogRecord&& record) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == slots_.size()) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    slots_[head % slots_.size()] = std::move(record);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Producer only.
+  [[nodiscard]] bool halfFull() const {
+    return head_.load(std::memory_order_relaxed) -
+        tail_.load(std::memory_order_relaxed) ==
+        slots_.size() / 2;
+  }
+
+  // Consumer only. Moves the records pushed so far to out.
+  void drain(std::vector<LogRecord>& out) {
+    const size_t head = head_.load(std::memory_order_acquire);
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    for (; tail != head; tail++) {
+      out.push_back(std::move(slots_[tail % slots_.size()]));
+    }
+    tail_.store(tail, std::memory_order_release);
+  }
+
+  [[nodiscard]] uint64_t dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  // Set when the producer thread has exited.
+  std::atomic<bool> retired{false};
+
+ private:
+  std::vector<LogRecord> slots_;
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+  std::atomic<uint64_t> dropped_{0};
+};
+
+AsyncLogWriter::AsyncLogWriter(
+    Output output,
+    size_t ringSize,
+    std::chrono::milliseconds flushInterval)
+    : id_(nextWriterId()),
+      output_(std::move(output)),
+      ringSize_(std::max<size_t>(ringSize, 2)),
+      flushInterval_(flushInterval),
+      thread_([this] { run(); }) {}
+
+AsyncLogWriter::~AsyncLogWriter() {
+  {
+    std::lock_guard<std::mutex> guard(wakeMutex_);
+    stop_ = true;
+  }
+  wake_.notify_one();
+  thread_.join();
+  flush();
+}
+
+AsyncLogWriter::Ring& AsyncLogWriter::localRing() {
+  // The rings of this thread, by writer. Retired when the thread exits.
+  struct LocalRings {
+    ~LocalRings() {
+      for (auto& [id, ring] : rings) {
+        ring->retired.store(true, std::memory_order_release);
+      }
+    }
+    std::vector<std::pair<uint64_t, std::shared_ptr<Ring>>> rings;
+  };
+  thread_local LocalRings local;
+  for (auto& [id, ring] : local.rings) {
+    if (id == id_) {
+      return *ring;
+    }
+  }
+  auto ring = std::make_shared<Ring>(ringSize_);
+  {
+    std::lock_guard<std::mutex> guard(ringsMutex_);
+    rings_.push_back(ring);
+  }
+  local.rings.emplace_back(id_, ring);
+  return *ring;
+}
+
+bool AsyncLogWriter::push(LogRecord&& record) {
+  Ring& ring = localRing();
+  if (!ring.push(std::move(record))) {
+    return false;
+  }
+  // Wake the writer early rather than drop records in a burst.
+  if (ring.halfFull() && !wakeRequested_.exchange(true)) {
+    wake_.notify_one();
+  }
+  return true;
+}
+
+void AsyncLogWriter::flush() {
+  std::lock_guard<std::mutex> flushGuard(flushMutex_);
+  uint64_t dropped = 0;
+  {
+    std::lock_guard<std::mutex> guard(ringsMutex_);
+    // A retired ring gets no more records, so it can go once drained.
+    std::erase_if(rings_, [this](const std::shared_ptr<Ring>& ring) {
+      const bool retired = ring->retired.load(std::memory_order_acquire);
+      ring->drain(batch_);
+      if (retired) {
+        retiredDropped_ += ring->dropped();
+      }
+      return retired;
+    });
+    dropped = retiredDropped_;
+    for (const auto& ring : rings_) {
+      dropped += ring->dropped();
+    }
+  }
+  // Rings are drained one after the other, so merge them by time.
+  std::stable_sort(
+      batch_.begin(),
+      batch_.end(),
+      [](const LogRecord& a, const LogRecord& b) { return a.time < b.time; });
+  if (dropped > reportedDropped_) {
+    LogRecord warning{
+        std::chrono::system_clock::now(),
+        processId(false),
+        systemThreadId(false),
+        __FILE__,
+        __LINE__,
+        WARNING,
+        "Dropped " + std::to_string(dropped - reportedDropped_) +
+            " log messages, queued faster than they could be written"};
+    batch_.insert(batch_.begin(), std::move(warning));
+    reportedDropped_ = dropped;
+  }
+  if (!batch_.empty()) {
+    output_(batch_);
+    batch_.clear();
+  }
+}
+
+uint64_t AsyncLogWriter::dropped() const {
+  std::lock_guard<std::mutex> guard(ringsMutex_);
+  uint64_t dropped = retiredDropped_;
+  for (const auto& ring : rings_) {
+    dropped += ring->dropped();
+  }
+  return dropped;
+}
+
+void AsyncLogWriter::run() {
+  setThreadName("Kineto Log Writer");
+  std::unique_lock<std::mutex> lock(wakeMutex_);
+  while (!stop_) {
+    wake_.wait_for(lock, flushInterval_, [this] {
+      return stop_ || wakeRequested_.load();
+    });
+    wakeRequested_ = false;
+    lock.unlock();
+    flush();
+    lock.lock();
+  }
+}
+
+} // namespace KINETO_NAMESPACE
+
+#endif // !USE_GOOGLE_LOG
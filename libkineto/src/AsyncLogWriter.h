@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#if !USE_GOOGLE_LOG
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace KINETO_NAMESPACE {
+
+// A log message as captured on the logging thread. The prefix with the
+// time, ids and location is only formatted when the message is written.
+struct LogRecord {
+  std::chrono::system_clock::time_point time;
+  int32_t pid{0};
+  int32_t tid{0};
+  const char* file{nullptr};
+  int line{0};
+  int severity{0};
+  std::string message;
+};
+
+// Takes log messages off the logging threads and writes them from a
+// background thread.
+//
+// Each logging thread pushes its records to its own fixed-size ring, which
+// only that thread writes and only the writer reads, so push() takes no lock
+// and does not allocate once the ring is set up. If the ring is full the
+// record is dropped and counted. The background thread wakes up every
+// flushInterval, or when a ring is half full, and passes the records queued
+// so far to the output function in one batch, ordered by time. The batch
+// after records were dropped starts with a warning with their number.
+//
+// flush() writes out the records queued before the call on the calling
+// thread. Batches are never passed to the output concurrently.
+class AsyncLogWriter {
+ public:
+  using Output = std::function<void(std::vector<LogRecord>&)>;
+
+  static constexpr size_t kDefaultRingSize = 1024;
+  static constexpr std::chrono::milliseconds kDefaultFlushInterval{50};
+
+  AsyncLogWriter(
+      Output output,
+      size_t ringSize = kDefaultRingSize,
+      std::chrono::milliseconds flushInterval = kDefaultFlushInterval);
+  // Stops the background thread and writes out the queued records.
+  ~AsyncLogWriter();
+
+  AsyncLogWriter(const AsyncLogWriter&) = delete;
+  AsyncLogWriter& operator=(const AsyncLogWriter&) = delete;
+
+  // Queues a record on the calling thread's ring. Returns false if the ring
+  // was full and the record was dropped.
+  bool push(LogRecord&& record);
+
+  void flush();
+
+  // Records dropped so far because a ring was full.
+  [[nodiscard]] uint64_t dropped() const;
+
+ private:
+  class Ring;
+
+  Ring& localRing();
+  void run();
+
+  const uint64_t id_;
+  const Output output_;
+  const size_t ringSize_;
+  const std::chrono::milliseconds flushInterval_;
+
+  // Guards rings_ and retiredDropped_.
+  mutable std::mutex ringsMutex_;
+  std::vector<std::shared_ptr<Ring>> rings_;
+  // Drops on rings of threads that have exited.
+  uint64_t retiredDropped_{0};
+
+  // Held while draining the rings and writing a batch.
+  std::mutex flushMutex_;
+  uint64_t reportedDropped_{0};
+  std::vector<LogRecord> batch_;
+
+  std::mutex wakeMutex_;
+  std::condition_variable wake_;
+  std::atomic<bool> wakeRequested_{false};
+  bool stop_{false};
+  std::thread thread_;
+};
+
+} // namespace KINETO_NAMESPACE
+
+#endif // !USE_GOOGLE_LOG
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include "FlatHashMap.h"
+
+namespace KINETO_NAMESPACE {
+namespace detail {
+
+// Launch streams are looked up in an array indexed by correlation id if the
+// ids span fewer than kDenseIdsPerLaunch per launch plus kDenseIdSlack.
+constexpr uint64_t kDenseIdSlack = 4096;
+constexpr uint64_t kDenseIdsPerLaunch = 4;
+
+// Assigns logical stream ids to async GPU ops, such as the ROCm kernel and
+// copy rows, in a single pass over the rows followed by two passes over the
+// async ops only.
+//
+// launchStream(const Row*) returns the raw stream of a runtime row that
+// launched an async op, or 0 for other rows. asyncOp(Row*) returns the async
+// op to assign a stream to, or nullptr. Rows have a correlation id member
+// `id`; async ops also have `device`, `queue` and a `stream` to assign.
+//
+// An async op with no stream yet takes the stream of the launch with the
+// same correlation id, the last one if there are several. Failing that, it
+// takes the stream of its queue, if all async ops on that queue with a
+// stream agree on it. Streams are then remapped to small indices per
+// device, in order of first use, so that traces do not show raw 64-bit
+// pointers. Async ops with no stream but a queue are given a stream of
+// their own per queue. Nothing is assigned if there are no launches.
+//
+// Correlation ids are dense, so launch streams are looked up in an array
+// indexed by correlation id, unless the ids are too sparse for that.
+template <class Row, class LaunchStream, class AsyncOp>
+void backfillStreams(
+    std::vector<Row*>& rows,
+    LaunchStream launchStream,
+    AsyncOp asyncOp) {
+  using Async = std::remove_pointer_t<std::invoke_result_t<AsyncOp&, Row*>>;
+  struct Launch {
+    uint64_t id;
+    uint64_t stream;
+  };
+
+  std::vector<Launch> launches;
+  std::vector<Async*> asyncs;
+  uint64_t minId = std::numeric_limits<uint64_t>::max();
+  uint64_t maxId = 0;
+  for (Row* row : rows) {
+    if (Async* async = asyncOp(row)) {
+      asyncs.push_back(async);
+      continue;
+    }
+    const uint64_t stream = launchStream(row);
+    if (stream != 0) {
+      launches.push_back({row->id, stream});
+      minId = std::min(minId, row->id);
+      maxId = std::max(maxId, row->id);
+    }
+  }
+  if (launches.empty()) {
+    return;
+  }
+
+  // Set stream from the correlated launch. Failing that (e.g. ROCm-internal
+  // dispatches like __amd_rocclr_copyBuffer), the stream is inferred from the
+  // HSA queue, given the queue maps directly to a HIP stream, so record the
+  // stream of each queue on the way.
+  struct QueueStream {
+    uint64_t stream{0};
+    bool ambiguous{false};
+  };
+  // Queues and streams are pointers.
+  FlatHashMap<uint64_t, QueueStream, MixedKeyHash> streamByQueue;
+  auto setLaunchStreams = [&asyncs, &streamByQueue](auto launchStreamById) {
+    for (Async* async : asyncs) {
+      if (async->stream == 0) {
+        async->stream = launchStreamById(async->id);
+      }
+      if (async->stream == 0 || async->queue == 0) {
+        continue;
+      }
+      auto [it, inserted] =
+          streamByQueue.emplace(async->queue, QueueStream{async->stream});
+      if (!inserted && it->second.stream != async->stream) {
+        it->second.ambiguous = true;
+      }
+    }
+  };
+  const uint64_t idRange = maxId - minId;
+  if (idRange < kDenseIdSlack + kDenseIdsPerLaunch * launches.size()) {
+    std::vector<uint64_t> streamById(idRange + 1, 0);
+    for (const Launch& launch : launches) {
+      streamById[launch.id - minId] = launch.stream;
+    }
+    setLaunchStreams([&](uint64_t id) -> uint64_t {
+      return id >= minId && id <= maxId ? streamById[id - minId] : 0;
+    });
+  } else {
+    // The ids are too sparse here for the sequential hash.
+    FlatHashMap<uint64_t, uint64_t, MixedKeyHash> streamById(launches.size());
+    for (const Launch& launch : launches) {
+      streamById[launch.id] = launch.stream;
+    }
+    setLaunchStreams([&](uint64_t id) -> uint64_t {
+      const auto it = streamById.find(id);
+      return it != streamById.end() ? it->second : 0;
+    });
+  }
+
+  // Remap raw streams to small per-device indices. If still no stream, use
+  // the queue tagged with the high bit to avoid collisions with streams.
+  constexpr uint64_t kQueueKeyTag = uint64_t{1} << 63;
+  FlatHashMap<int, FlatHashMap<uint64_t, uint64_t, MixedKeyHash>>
+      deviceStreamToIndex;
+  for (Async* async : asyncs) {
+    if (async->stream == 0 && async->queue != 0) {
+      const auto it = streamByQueue.find(async->queue);
+      if (it != streamByQueue.end() && !it->second.ambiguous) {
+        async->stream = it->second.stream;
+      }
+    }
+    uint64_t key;
+    if (async->stream != 0) {
+      key = async->stream;
+    } else if (async->queue != 0) {
+      key = async->queue | kQueueKeyTag;
+    } else {
+      continue;
+    }
+    auto& mapping = deviceStreamToIndex[async->device];
+    auto [it, inserted] = mapping.emplace(key, mapping.size() + 1);
+    async->stream = it->second;
+  }
+}
+
+} // namespace detail
+} // namespace KINETO_NAMESPACE
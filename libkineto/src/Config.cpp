@@ -15,11 +15,14 @@
 #include <fmt/ostream.h>
 #include <fmt/ranges.h>
 
+#include <algorithm>
 #include <chrono>
 #include <ctime>
 #include <functional>
 #include <mutex>
 #include <ostream>
+#include <regex>
+#include <stdexcept>
 #include <string_view>
 #include <utility>
 
@@ -42,6 +45,12 @@ constexpr milliseconds kDefaultMultiplexPeriodMsecs(1000);
 constexpr milliseconds kDefaultActivitiesProfileDurationMSecs(500);
 constexpr int64_t kDefaultActivitiesMaxGpuBufferSize(128 * 1024 * 1024);
 constexpr seconds kDefaultActivitiesWarmupDurationSecs(5);
+constexpr int kDefaultActivitiesSerializationThreads(1);
+constexpr int kMaxActivitiesSerializationThreads(64);
+constexpr seconds kDefaultFlightRecorderWindowSecs(30);
+constexpr int kDefaultFlightRecorderSegments(4);
+constexpr int kMaxFlightRecorderSegments(64);
+constexpr int64_t kDefaultFlightRecorderMaxEvents(1000000);
 constexpr seconds kDefaultReportPeriodSecs(1);
 constexpr int kDefaultSamplesPerReport(1);
 constexpr int kDefaultMaxEventProfilersPerGpu(1);
@@ -52,6 +61,7 @@ constexpr seconds kDefaultOnDemandConfigUpdateIntervalSecs(5);
 constexpr size_t kDefaultCuptiDeviceBufferSize(3200000);
 // Default value set by CUPTI is 250
 constexpr size_t kDefaultCuptiDeviceBufferPoolLimit(20);
+constexpr int kMaxCuptiHostBufferPoolSize(1024);
 
 // Event Profiler
 constexpr char kEventsKey[] = "EVENTS";
@@ -71,6 +81,9 @@ constexpr char kHeartbeatMonitorPeriodKey[] =
 constexpr char kActivitiesEnabledKey[] = "ACTIVITIES_ENABLED";
 constexpr char kCuptiPerThreadBufferEnabledKey[] =
     "CUPTI_PER_THREAD_BUFFER_ENABLED";
+constexpr char kCuptiHostBufferPoolSizeKey[] = "CUPTI_HOST_BUFFER_POOL_SIZE";
+constexpr char kCuptiHostBufferHugePagesKey[] =
+    "CUPTI_HOST_BUFFER_HUGE_PAGES";
 constexpr char kActivityTypesKey[] = "ACTIVITY_TYPES";
 constexpr char kActivitiesLogFileKey[] = "ACTIVITIES_LOG_FILE";
 constexpr char kActivitiesDurationKey[] = "ACTIVITIES_DURATION_SECS";
@@ -81,6 +94,28 @@ constexpr char kActivitiesMaxGpuBufferSizeKey[] =
     "ACTIVITIES_MAX_GPU_BUFFER_SIZE_MB";
 constexpr char kActivitiesDisplayCudaSyncWaitEvents[] =
     "ACTIVITIES_DISPLAY_CUDA_SYNC_WAIT_EVENTS";
+constexpr char kActivitiesSerializationThreadsKey[] =
+    "ACTIVITIES_SERIALIZATION_THREADS";
+constexpr char kActivitiesFilterTypesKey[] = "ACTIVITIES_FILTER_TYPES";
+constexpr char kActivitiesFilterMinDurationKey[] =
+    "ACTIVITIES_FILTER_MIN_DURATION_US";
+constexpr char kActivitiesFilterNameRegexKey[] =
+    "ACTIVITIES_FILTER_NAME_REGEX";
+constexpr char kActivitiesFilterNamePrefixesKey[] =
+    "ACTIVITIES_FILTER_NAME_PREFIXES";
+constexpr char kActivitiesFilterDevicesKey[] = "ACTIVITIES_FILTER_DEVICES";
+constexpr char kActivitiesFilterStreamsKey[] = "ACTIVITIES_FILTER_STREAMS";
+constexpr char kFlightRecorderKey[] = "ACTIVITIES_FLIGHT_RECORDER";
+constexpr char kFlightRecorderWindowSecsKey[] =
+    "ACTIVITIES_FLIGHT_RECORDER_WINDOW_SECS";
+constexpr char kFlightRecorderWindowIterationsKey[] =
+    "ACTIVITIES_FLIGHT_RECORDER_WINDOW_ITERATIONS";
+constexpr char kFlightRecorderSegmentsKey[] =
+    "ACTIVITIES_FLIGHT_RECORDER_SEGMENTS";
+constexpr char kFlightRecorderMaxEventsKey[] =
+    "ACTIVITIES_FLIGHT_RECORDER_MAX_EVENTS";
+constexpr char kFlightRecorderDumpKey[] = "ACTIVITIES_FLIGHT_RECORDER_DUMP";
+constexpr char kFlightRecorderStopKey[] = "ACTIVITIES_FLIGHT_RECORDER_STOP";
 
 // Client Interface
 // TODO: keep supporting these older config options, deprecate in the future
@@ -267,6 +302,10 @@ Config::Config()
       activitiesWarmupDuration_(kDefaultActivitiesWarmupDurationSecs),
       activitiesWarmupIterations_(0),
       activitiesCudaSyncWaitEvents_(true),
+      activitiesSerializationThreads_(kDefaultActivitiesSerializationThreads),
+      flightRecorderWindow_(kDefaultFlightRecorderWindowSecs),
+      flightRecorderSegments_(kDefaultFlightRecorderSegments),
+      flightRecorderMaxEvents_(kDefaultFlightRecorderMaxEvents),
       activitiesDuration_(kDefaultActivitiesProfileDurationMSecs),
       activitiesRunIterations_(0),
       activitiesOnDemandTimestamp_(milliseconds(0)),
@@ -415,6 +454,11 @@ bool Config::handleOption(const std::string& name, std::string& val) {
     activityProfilerEnabled_ = toBool(val);
   } else if (!name.compare(kCuptiPerThreadBufferEnabledKey)) {
     perThreadBufferEnabled_ = toBool(val);
+  } else if (!name.compare(kCuptiHostBufferPoolSizeKey)) {
+    cuptiHostBufferPoolSize_ =
+        std::clamp(toInt32(val), 0, kMaxCuptiHostBufferPoolSize);
+  } else if (!name.compare(kCuptiHostBufferHugePagesKey)) {
+    cuptiHostBufferHugePages_ = toBool(val);
   } else if (!name.compare(kProfileMemory)) {
     memoryProfilerEnabled_ = toBool(val);
     if (memoryProfilerEnabled_) {
@@ -452,6 +496,62 @@ bool Config::handleOption(const std::string& name, std::string& val) {
     activitiesWarmupIterations_ = toInt32(val);
   } else if (!name.compare(kActivitiesDisplayCudaSyncWaitEvents)) {
     activitiesCudaSyncWaitEvents_ = toBool(val);
+  } else if (!name.compare(kActivitiesSerializationThreadsKey)) {
+    activitiesSerializationThreads_ =
+        std::clamp(toInt32(val), 1, kMaxActivitiesSerializationThreads);
+  } else if (!name.compare(kActivitiesFilterTypesKey)) {
+    activitiesFilterTypes_.clear();
+    for (const auto& type : splitAndTrim(toLower(val), ',')) {
+      if (!type.empty()) {
+        activitiesFilterTypes_.insert(toActivityType(type));
+      }
+    }
+  } else if (!name.compare(kActivitiesFilterMinDurationKey)) {
+    activitiesFilterMinDuration_ =
+        microseconds(std::max(toInt64(val), int64_t{0}));
+  } else if (!name.compare(kActivitiesFilterNameRegexKey)) {
+    try {
+      std::regex(val, std::regex::ECMAScript);
+    } catch (const std::regex_error& e) {
+      throw std::invalid_argument(fmt::format(
+          "Invalid {}: '{}' - {}",
+          kActivitiesFilterNameRegexKey,
+          val,
+          e.what()));
+    }
+    activitiesFilterNameRegex_ = val;
+  } else if (!name.compare(kActivitiesFilterNamePrefixesKey)) {
+    activitiesFilterNamePrefixes_.clear();
+    for (auto& prefix : splitAndTrim(val, ',')) {
+      if (!prefix.empty()) {
+        activitiesFilterNamePrefixes_.push_back(std::move(prefix));
+      }
+    }
+  } else if (!name.compare(kActivitiesFilterDevicesKey)) {
+    activitiesFilterDevices_.clear();
+    for (const auto& device : splitAndTrim(val, ',')) {
+      activitiesFilterDevices_.insert(toInt64(device));
+    }
+  } else if (!name.compare(kActivitiesFilterStreamsKey)) {
+    activitiesFilterStreams_.clear();
+    for (const auto& stream : splitAndTrim(val, ',')) {
+      activitiesFilterStreams_.insert(toInt64(stream));
+    }
+  } else if (!name.compare(kFlightRecorderKey)) {
+    flightRecorderEnabled_ = toBool(val);
+  } else if (!name.compare(kFlightRecorderWindowSecsKey)) {
+    flightRecorderWindow_ = seconds(std::max(toInt32(val), 1));
+  } else if (!name.compare(kFlightRecorderWindowIterationsKey)) {
+    flightRecorderWindowIterations_ = std::max(toInt32(val), 0);
+  } else if (!name.compare(kFlightRecorderSegmentsKey)) {
+    flightRecorderSegments_ =
+        std::clamp(toInt32(val), 1, kMaxFlightRecorderSegments);
+  } else if (!name.compare(kFlightRecorderMaxEventsKey)) {
+    flightRecorderMaxEvents_ = std::max(toInt64(val), int64_t{1});
+  } else if (!name.compare(kFlightRecorderDumpKey)) {
+    flightRecorderDump_ = toBool(val);
+  } else if (!name.compare(kFlightRecorderStopKey)) {
+    flightRecorderStop_ = toBool(val);
   } else if (!name.compare(kRequestTraceID)) {
     requestTraceID_ = val;
   } else if (!name.compare(kRequestGroupTraceID)) {
@@ -623,6 +723,69 @@ void Config::printActivityProfilerConfig(std::ostream& s) const {
       "  Max GPU buffer size: {:.0f}MB\n",
       static_cast<double>(activitiesMaxGpuBufferSize()) / 1024.0 / 1024.0);
 
+  if (activitiesSerializationThreads() > 1) {
+    fmt::print(
+        s, "  Serialization threads: {}\n", activitiesSerializationThreads());
+  }
+
+  if (!activitiesFilterTypes_.empty()) {
+    std::vector<const char*> types;
+    for (ActivityType type : activitiesFilterTypes_) {
+      types.push_back(toString(type));
+    }
+    fmt::print(s, "  Filter types: {}\n", fmt::join(types, ","));
+  }
+  if (activitiesFilterMinDuration_.count() > 0) {
+    fmt::print(
+        s,
+        "  Filter min duration: {}us\n",
+        duration_cast<microseconds>(activitiesFilterMinDuration_).count());
+  }
+  if (!activitiesFilterNameRegex_.empty()) {
+    fmt::print(s, "  Filter name regex: {}\n", activitiesFilterNameRegex_);
+  }
+  if (!activitiesFilterNamePrefixes_.empty()) {
+    fmt::print(
+        s,
+        "  Filter name prefixes: {}\n",
+        fmt::join(activitiesFilterNamePrefixes_, ","));
+  }
+  if (!activitiesFilterDevices_.empty()) {
+    fmt::print(
+        s, "  Filter devices: {}\n", fmt::join(activitiesFilterDevices_, ","));
+  }
+  if (!activitiesFilterStreams_.empty()) {
+    fmt::print(
+        s, "  Filter streams: {}\n", fmt::join(activitiesFilterStreams_, ","));
+  }
+
+  if (cuptiHostBufferPoolSize() > 0) {
+    fmt::print(
+        s,
+        "  Host buffer pool: {} buffers{}\n",
+        cuptiHostBufferPoolSize(),
+        cuptiHostBufferHugePages() ? " (huge pages)" : "");
+  }
+
+  if (flightRecorderEnabled()) {
+    if (flightRecorderWindowIterations() > 0) {
+      fmt::print(
+          s,
+          "  Flight recorder window: {} iterations\n",
+          flightRecorderWindowIterations());
+    } else {
+      fmt::print(
+          s,
+          "  Flight recorder window: {}s\n",
+          flightRecorderWindow().count());
+    }
+    fmt::print(
+        s,
+        "  Flight recorder segments: {}, max events: {}\n",
+        flightRecorderSegments(),
+        flightRecorderMaxEvents());
+  }
+
   std::vector<std::string> activities;
   activities.reserve(selectedActivityTypes_.size());
   for (const auto& activity : selectedActivityTypes_) {
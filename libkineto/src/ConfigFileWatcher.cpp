@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ConfigFileWatcher.h"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "Logger.h"
+#include "ThreadUtil.h"
+
+namespace KINETO_NAMESPACE {
+
+#ifdef __linux__
+
+constexpr uint32_t kWatchMask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE |
+    IN_MOVED_FROM | IN_MOVED_TO;
+
+ConfigFileWatcher::ConfigFileWatcher(
+    const std::string& path,
+    std::function<void()> onChange)
+    : onChange_(std::move(onChange)) {
+  std::string dir = ".";
+  fileName_ = path;
+  const size_t slash = path.rfind('/');
+  if (slash != std::string::npos) {
+    dir = slash == 0 ? "/" : path.substr(0, slash);
+    fileName_ = path.substr(slash + 1);
+  }
+
+  inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotifyFd_ < 0) {
+    VLOG(0) << "inotify unavailable: " << strerror(errno);
+    return;
+  }
+  if (inotify_add_watch(inotifyFd_, dir.c_str(), kWatchMask) < 0) {
+    VLOG(0) << "Failed to watch " << dir << ": " << strerror(errno);
+    close(inotifyFd_);
+    inotifyFd_ = -1;
+    return;
+  }
+  stopFd_ = eventfd(0, EFD_CLOEXEC);
+  if (stopFd_ < 0) {
+    VLOG(0) << "eventfd failed: " << strerror(errno);
+    close(inotifyFd_);
+    inotifyFd_ = -1;
+    return;
+  }
+  active_ = true;
+  thread_ = std::thread([this] { run(); });
+}
+
+ConfigFileWatcher::~ConfigFileWatcher() {
+  if (thread_.joinable()) {
+    const uint64_t one = 1;
+    if (write(stopFd_, &one, sizeof(one)) != sizeof(one)) {
+      LOG(ERROR) << "Failed to stop config file watcher: " << strerror(errno);
+    }
+    thread_.join();
+  }
+  if (stopFd_ >= 0) {
+    close(stopFd_);
+  }
+  if (inotifyFd_ >= 0) {
+    close(inotifyFd_);
+  }
+}
+
+void ConfigFileWatcher::run() {
+  setThreadName("Kineto Config Watcher");
+  alignas(struct inotify_event) char buf[4096];
+  pollfd fds[2] = {{inotifyFd_, POLLIN, 0}, {stopFd_, POLLIN, 0}};
+  while (active_) {
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG(ERROR) << "Config file watcher failed: " << strerror(errno);
+      break;
+    }
+    if (fds[1].revents != 0) {
+      break;
+    }
+    bool changed = false;
+    // Drain the events queued so far, and report them as one change.
+    for (;;) {
+      const ssize_t len = read(inotifyFd_, buf, sizeof(buf));
+      if (len <= 0) {
+        break;
+      }
+      for (ssize_t i = 0; i < len;) {
+        const auto* event = reinterpret_cast<const inotify_event*>(buf + i);
+        if (event->mask & IN_IGNORED) {
+          // The directory is gone, and the file with it.
+          active_ = false;
+          changed = true;
+        } else if (event->len > 0 && fileName_ == event->name) {
+          changed = true;
+        }
+        i += sizeof(inotify_event) + event->len;
+      }
+    }
+    if (changed) {
+      onChange_();
+    }
+  }
+  active_ = false;
+}
+
+#else // __linux__
+
+ConfigFileWatcher::ConfigFileWatcher(
+    const std::string& /*path*/,
+    std::function<void()> onChange)
+    : onChange_(std::move(onChange)) {}
+
+ConfigFileWatcher::~ConfigFileWatcher() = default;
+
+void ConfigFileWatcher::run() {}
+
+#endif // __linux__
+
+} // namespace KINETO_NAMESPACE
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace KINETO_NAMESPACE {
+
+// Calls a function from a background thread when a file is written, created,
+// replaced or removed, using inotify. The directory of the file is watched
+// rather than the file itself, so the file may not exist yet and may be
+// replaced by a rename, as editors and config management tools do. Several
+// changes in quick succession may result in one call or several.
+//
+// Where inotify is not available (not Linux, the directory does not exist,
+// or the watch limit is reached) active() is false and the function is never
+// called, and the caller should poll the file instead. active() also turns
+// false if the directory is removed.
+class ConfigFileWatcher {
+ public:
+  ConfigFileWatcher(const std::string& path, std::function<void()> onChange);
+  ~ConfigFileWatcher();
+
+  ConfigFileWatcher(const ConfigFileWatcher&) = delete;
+  ConfigFileWatcher& operator=(const ConfigFileWatcher&) = delete;
+
+  [[nodiscard]] bool active() const {
+    return active_;
+  }
+
+ private:
+  void run();
+
+  const std::function<void()> onChange_;
+  std::string fileName_;
+  int inotifyFd_{-1};
+  // Written to stop the thread.
+  int stopFd_{-1};
+  std::atomic_bool active_{false};
+  std::thread thread_;
+};
+
+} // namespace KINETO_NAMESPACE
@@ -15,6 +15,7 @@
 #include <memory>
 #include <utility>
 
+#include "ConfigFileWatcher.h"
 #include "DaemonConfigLoader.h"
 
 #include "Logger.h"
@@ -89,7 +90,8 @@ int ConfigLoader::contextCountForGpu(uint32_t device) {
 }
 
 ConfigLoader::ConfigLoader()
-    : configUpdateIntervalSecs_(kConfigUpdateIntervalSecs),
+    : baseConfigHash_(std::hash<std::string>{}("")),
+      configUpdateIntervalSecs_(kConfigUpdateIntervalSecs),
       // on-demand config will be overwritten by the value read from the regular
       // config so the initial value is not important
       onDemandConfigUpdateIntervalSecs_(kConfigUpdateIntervalSecs),
@@ -177,10 +179,13 @@ void ConfigLoader::updateBaseConfig() {
     // then try the daemon
     config_str = daemonConfigLoader()->readBaseConfig();
   }
-  if (config_str != config_->source()) {
+  // Only parse when the text changed, as it usually has not when polling.
+  const size_t hash = std::hash<std::string>{}(config_str);
+  if (hash != baseConfigHash_) {
     std::scoped_lock lock(configLock_);
     config_ = std::make_unique<Config>();
     config_->parse(config_str);
+    baseConfigHash_ = hash;
     if (daemonConfigLoader()) {
       daemonConfigLoader()->setCommunicationFabric(config_->ipcFabricEnabled());
     }
@@ -224,6 +229,19 @@ void ConfigLoader::updateConfigThread() {
   auto prev_on_demand_load_time = prev_config_load_time;
   auto onDemandConfig = std::make_unique<Config>();
 
+  // Watch the config file before it is first read, so that no change is
+  // missed. Without inotify, changes are picked up by polling.
+  configFileWatcher_ =
+      std::make_unique<ConfigFileWatcher>(configFileName(), [this]() {
+        std::scoped_lock lock(updateThreadMutex_);
+        configFileChanged_ = true;
+        updateThreadCondVar_.notify_one();
+      });
+  if (!configFileWatcher_->active()) {
+    VLOG(0) << "Polling " << configFileName() << " for changes every "
+            << configUpdateIntervalSecs_.count() << "s";
+  }
+
   // This can potentially sleep for long periods of time, so allow
   // the destructor to wake it to avoid a 5-minute long destruct period.
   for (;;) {
@@ -232,15 +250,22 @@ void ConfigLoader::updateConfigThread() {
             configUpdateIntervalSecs_ + prev_config_load_time,
             onDemandConfigUpdateIntervalSecs_ + prev_on_demand_load_time) -
         system_clock::now();
-    if (interval.count() > 0) {
+    bool config_file_changed = false;
+    {
       std::unique_lock<std::mutex> lock(updateThreadMutex_);
-      updateThreadCondVar_.wait_for(lock, interval);
+      if (interval.count() > 0) {
+        updateThreadCondVar_.wait_for(lock, interval, [this]() {
+          return stopFlag_ || configFileChanged_;
+        });
+      }
+      config_file_changed = std::exchange(configFileChanged_, false);
     }
     if (stopFlag_) {
       break;
     }
     auto now = system_clock::now();
-    if (now > prev_config_load_time + configUpdateIntervalSecs_) {
+    if (config_file_changed ||
+        now > prev_config_load_time + configUpdateIntervalSecs_) {
       updateBaseConfig();
       onDemandConfigUpdateIntervalSecs_ =
           config_->onDemandConfigUpdateIntervalSecs();
@@ -260,6 +285,7 @@ void ConfigLoader::updateConfigThread() {
           onDemandConfig->verboseLogModules());
     }
   }
+  configFileWatcher_ = nullptr;
 }
 
 bool ConfigLoader::hasNewConfig(const Config& oldConfig) {
@@ -12,7 +12,9 @@
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <cstddef>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
@@ -26,6 +28,7 @@ class LibkinetoApi;
 namespace KINETO_NAMESPACE {
 
 using namespace libkineto;
+class ConfigFileWatcher;
 class IDaemonConfigLoader;
 
 class ConfigLoader {
@@ -120,6 +123,8 @@ class ConfigLoader {
 
   std::mutex configLock_;
   std::unique_ptr<Config> config_;
+  // Hash of the base config text config_ was parsed from.
+  size_t baseConfigHash_;
   std::unique_ptr<IDaemonConfigLoader> daemonConfigLoader_;
   std::map<ConfigKind, std::vector<ConfigHandler*>> handlers_;
 
@@ -129,6 +134,11 @@ class ConfigLoader {
   std::condition_variable updateThreadCondVar_;
   std::mutex updateThreadMutex_;
   std::atomic_bool stopFlag_{false};
+  // Wakes the update thread when the config file changes, if inotify is
+  // available. The base config is still polled, as the daemon is.
+  std::unique_ptr<ConfigFileWatcher> configFileWatcher_;
+  // Set by the watcher, guarded by updateThreadMutex_.
+  bool configFileChanged_{false};
 };
 
 } // namespace KINETO_NAMESPACE
@@ -44,37 +44,22 @@ bool& use_cupti_tsc();
 // into subclasses of ITraceActivity so that they can all be accessed
 // using the ITraceActivity interface and logged via ActivityLogger.
 
-// Abstract base class, templated on Cupti activity type
+// Abstract base class, templated on Cupti activity type.
+// Subclasses render metadataJson() with JsonTypedMetadataVisitor.
 template <class T>
-struct CuptiActivity : public ITraceActivity {
+struct CuptiActivity : public ITraceActivity,
+                       public libkineto::internal::TypedMetadataJsonActivity {
   explicit CuptiActivity(const T* activity, const ITraceActivity* linked)
       : activity_(*activity), linked_(linked) {}
-  // If we are running on Windows or are on a CUDA version < 11.6,
-  // we use the default system clock so no conversion needed same for all
-  // ifdefs below
+  // Record timestamps are always in ns since epoch here: TSC timestamps are
+  // converted in place, once per buffer, before records are wrapped (see
+  // CuptiActivityProfiler::decodeBuffer()).
   int64_t timestamp() const override {
-#if defined(_WIN32) || CUDA_VERSION < 11060
     return activity_.start;
-#else
-    if (use_cupti_tsc()) {
-      return get_time_converter()(activity_.start);
-    } else {
-      return activity_.start;
-    }
-#endif
   }
 
   int64_t duration() const override {
-#if defined(_WIN32) || CUDA_VERSION < 11060
     return activity_.end - activity_.start;
-#else
-    if (use_cupti_tsc()) {
-      return get_time_converter()(activity_.end) -
-          get_time_converter()(activity_.start);
-    } else {
-      return activity_.end - activity_.start;
-    }
-#endif
   }
   // TODO(T107507796): Deprecate ITraceActivity
   int64_t correlationId() const override {
@@ -172,31 +157,6 @@ struct OverheadActivity : public CuptiActivity<CUpti_ActivityOverhead> {
       int32_t threadId = 0)
       : CuptiActivity(activity, linked), threadId_(threadId) {}
 
-  int64_t timestamp() const override {
-#if defined(_WIN32) || CUDA_VERSION < 11060
-    return activity_.start;
-#else
-    if (use_cupti_tsc()) {
-      return get_time_converter()(activity_.start);
-    } else {
-      return activity_.start;
-    }
-#endif
-  }
-
-  int64_t duration() const override {
-#if defined(_WIN32) || CUDA_VERSION < 11060
-    return activity_.end - activity_.start;
-#else
-    if (use_cupti_tsc()) {
-      return get_time_converter()(activity_.end) -
-          get_time_converter()(activity_.start);
-    } else {
-      return activity_.end - activity_.start;
-    }
-#endif
-  }
-
   // TODO: Update this with PID ordering
   int64_t deviceId() const override {
     return -1;
@@ -264,15 +224,7 @@ using CUpti_ActivityCudaEventType = CUpti_ActivityCudaEvent;
 template <>
 inline int64_t CuptiActivity<CUpti_ActivityCudaEventType>::timestamp() const {
 #if CUDA_VERSION >= 12080
-#if defined(_WIN32)
   return activity_.deviceTimestamp;
-#else
-  if (use_cupti_tsc()) {
-    return get_time_converter()(activity_.deviceTimestamp);
-  } else {
-    return activity_.deviceTimestamp;
-  }
-#endif
 #else
   // For CUDA < 12.8, deviceTimestamp doesn't exist, set to 0
   return 0;
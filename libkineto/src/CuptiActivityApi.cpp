@@ -108,8 +108,19 @@ static bool nextActivityRecord(
   return record != nullptr;
 }
 
+CuptiActivityApi::CuptiActivityApi()
+    : bufferPool_(CuptiActivityBufferPool::create(kBufSize)) {}
+
 void CuptiActivityApi::setMaxBufferSize(int64_t size) {
-  maxGpuBufferCount_ = 1 + size / kBufSize;
+  bufferPool_->setMaxInFlight(1 + size / kBufSize);
+}
+
+void CuptiActivityApi::setBufferPool(size_t poolSize, bool hugePages) {
+  bufferPool_->setHugePages(hugePages);
+  bufferPool_->setHighWaterMark(poolSize);
+  // Fault the buffers in now rather than in the CUPTI callbacks, in the
+  // middle of the profiled workload.
+  bufferPool_->prefault();
 }
 
 void CuptiActivityApi::setDeviceBufferSize(size_t size) {
@@ -145,14 +156,14 @@ void CuptiActivityApi::bufferRequested(
     uint8_t** buffer,
     size_t* size,
     size_t* maxNumRecords) {
-  std::lock_guard<std::mutex> guard(mutex_);
   LOG(VERBOSE) << "CUPTI buffer requested";
-  if (static_cast<int64_t>(allocatedGpuTraceBuffers_.size()) >=
-      maxGpuBufferCount_) {
+  *buffer = bufferPool_->request(size);
+  if (!*buffer) {
     stopCollection = true;
     LOG(WARNING) << "Exceeded max GPU buffer count ("
-                 << allocatedGpuTraceBuffers_.size()
-                 << " >= " << maxGpuBufferCount_ << ") - terminating tracing";
+                 << bufferPool_->inFlight()
+                 << " >= " << bufferPool_->maxInFlight()
+                 << ") - terminating tracing";
     // Return null buffer to CUPTI. Per the CUPTI documentation for
     // CUpti_BuffersCallbackRequestFunc: "If set to NULL then no buffer is
     // returned." CUPTI will drop activity records, which are counted by
@@ -162,20 +173,13 @@ void CuptiActivityApi::bufferRequested(
     *maxNumRecords = 0;
     return;
   }
-
-  auto buf = std::make_unique<CuptiActivityBuffer>(kBufSize);
-  *buffer = buf->data();
-  *size = kBufSize;
-
-  allocatedGpuTraceBuffers_[*buffer] = std::move(buf);
-
   *maxNumRecords = 0;
 }
 
 std::unique_ptr<CuptiActivityBufferMap> CuptiActivityApi::activityBuffers() {
   {
     std::lock_guard<std::mutex> guard(mutex_);
-    if (allocatedGpuTraceBuffers_.empty()) {
+    if (bufferPool_->inFlight() == 0) {
       if (readyGpuTraceBuffers_) {
         return std::move(readyGpuTraceBuffers_);
       }
@@ -224,6 +228,14 @@ int CuptiActivityApi::processActivitiesForBuffer(
   return count;
 }
 
+int CuptiActivityApi::processBufferActivities(
+    CuptiActivityBuffer& buffer,
+    const std::function<void(const CUpti_Activity*)>& handler) {
+  // cuptiActivityGetNextRecord() keeps no state besides the record pointer,
+  // so distinct buffers can be walked in parallel.
+  return processActivitiesForBuffer(buffer.data(), buffer.size(), handler);
+}
+
 const std::pair<int, size_t> CuptiActivityApi::processActivities(
     CuptiActivityBufferMap& buffers,
     const std::function<void(const CUpti_Activity*)>& handler) {
@@ -231,7 +243,7 @@ const std::pair<int, size_t> CuptiActivityApi::processActivities(
   for (auto& pair : buffers) {
     // No lock needed - only accessed from this thread
     auto& buf = pair.second;
-    res.first += processActivitiesForBuffer(buf->data(), buf->size(), handler);
+    res.first += processBufferActivities(*buf, handler);
     res.second += buf->size();
   }
   return res;
@@ -244,19 +256,16 @@ void CuptiActivityApi::flushActivities() {
 void CuptiActivityApi::clearActivities() {
   {
     std::lock_guard<std::mutex> guard(mutex_);
-    if (allocatedGpuTraceBuffers_.empty()) {
+    if (bufferPool_->inFlight() == 0) {
       return;
     }
   }
   // Can't hold mutex_ during this call, since bufferCompleted
   // will be called by libcupti and mutex_ is acquired there.
   CUPTI_CALL(cuptiActivityFlushAll(0));
-  // FIXME: We might want to make sure we reuse
-  // the same memory during warmup and tracing.
-  // Also, try to use the amount of memory required
-  // for active tracing during warmup.
   std::lock_guard<std::mutex> guard(mutex_);
-  // Throw away ready buffers as a result of above flush
+  // Throw away ready buffers as a result of above flush; their memory goes
+  // back to the pool, so warmup and tracing reuse it.
   readyGpuTraceBuffers_ = nullptr;
 }
 
@@ -276,9 +285,11 @@ void CuptiActivityApi::bufferCompleted(
     size_t /* unused */,
     size_t validSize) {
   {
+    // Held across complete() so activityBuffers() never sees the buffer
+    // neither in flight nor ready.
     std::lock_guard<std::mutex> guard(mutex_);
-    auto it = allocatedGpuTraceBuffers_.find(buffer);
-    if (it == allocatedGpuTraceBuffers_.end()) {
+    auto buf = bufferPool_->complete(buffer, validSize);
+    if (!buf) {
       LOG(ERROR) << "bufferCompleted called with unknown buffer: "
                  << static_cast<void*>(buffer);
       return;
@@ -287,10 +298,7 @@ void CuptiActivityApi::bufferCompleted(
     if (!readyGpuTraceBuffers_) {
       readyGpuTraceBuffers_ = std::make_unique<CuptiActivityBufferMap>();
     }
-    // Set valid size of buffer before moving to ready map
-    it->second->setSize(validSize);
-    (*readyGpuTraceBuffers_)[it->first] = std::move(it->second);
-    allocatedGpuTraceBuffers_.erase(it);
+    (*readyGpuTraceBuffers_)[buffer] = std::move(buf);
   }
 
   // report any records dropped from the queue; to avoid unnecessary cupti
@@ -21,6 +21,7 @@
 // @lint-ignore-every CLANGTIDY facebook-hte-RelativeInclude
 #include "ActivityType.h"
 #include "CuptiActivityBuffer.h"
+#include "CuptiActivityBufferPool.h"
 #include "CuptiCallbackApi.h"
 
 namespace KINETO_NAMESPACE {
@@ -35,7 +36,7 @@ class CuptiActivityApi {
   std::mutex finalizeMutex_;
   std::condition_variable finalizeCond_;
 
-  CuptiActivityApi() = default;
+  CuptiActivityApi();
   CuptiActivityApi(const CuptiActivityApi&) = delete;
   CuptiActivityApi& operator=(const CuptiActivityApi&) = delete;
 
@@ -61,7 +62,19 @@ class CuptiActivityApi {
       CuptiActivityBufferMap&,
       const std::function<void(const CUpti_Activity*)>& handler);
 
+  // Calls handler for each record in buffer, in order, and returns the
+  // number of records. Safe to call concurrently for different buffers.
+  virtual int processBufferActivities(
+      CuptiActivityBuffer& buffer,
+      const std::function<void(const CUpti_Activity*)>& handler);
+
   void setMaxBufferSize(int64_t size);
+  // Keep poolSize buffers pre-faulted and recycled, see
+  // Config::cuptiHostBufferPoolSize().
+  void setBufferPool(size_t poolSize, bool hugePages);
+  [[nodiscard]] CuptiActivityBufferPool::Stats bufferPoolStats() const {
+    return bufferPool_->stats();
+  }
   void setDeviceBufferSize(size_t size);
   void setDeviceBufferPoolLimit(size_t limit);
 
@@ -74,8 +87,8 @@ class CuptiActivityApi {
   static void preConfigureCUPTI();
 
  private:
-  int64_t maxGpuBufferCount_{0};
-  CuptiActivityBufferMap allocatedGpuTraceBuffers_;
+  // Owns the buffers handed to CUPTI until they are completed.
+  std::shared_ptr<CuptiActivityBufferPool> bufferPool_;
   std::unique_ptr<CuptiActivityBufferMap> readyGpuTraceBuffers_;
   std::mutex mutex_;
   std::atomic<uint32_t> tracingEnabled_{0};
@@ -14,38 +14,68 @@
 #include <cstdlib>
 #include <map>
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include "ITraceActivity.h"
 
 namespace KINETO_NAMESPACE {
 
+// Takes back the memory of buffers handed out by a pool.
+class CuptiActivityBufferRecycler {
+ public:
+  virtual ~CuptiActivityBufferRecycler() = default;
+  virtual void recycle(uint8_t* data) = 0;
+};
+
 class CuptiActivityBuffer {
  public:
-  explicit CuptiActivityBuffer(size_t size) : size_(size) {
+  explicit CuptiActivityBuffer(size_t size) : size_(size), capacity_(size) {
     buf_.reserve(size);
+    data_ = buf_.data();
+  }
+  // Wraps memory of the given capacity owned by recycler, which gets it
+  // back when the buffer is destroyed.
+  CuptiActivityBuffer(
+      uint8_t* data,
+      size_t capacity,
+      size_t size,
+      std::shared_ptr<CuptiActivityBufferRecycler> recycler)
+      : data_(data),
+        size_(size),
+        capacity_(capacity),
+        recycler_(std::move(recycler)) {
+    assert(size <= capacity);
+  }
+  ~CuptiActivityBuffer() {
+    if (recycler_) {
+      recycler_->recycle(data_);
+    }
   }
   CuptiActivityBuffer() = delete;
   CuptiActivityBuffer& operator=(const CuptiActivityBuffer&) = delete;
   CuptiActivityBuffer(CuptiActivityBuffer&&) = default;
-  CuptiActivityBuffer& operator=(CuptiActivityBuffer&&) = default;
+  CuptiActivityBuffer& operator=(CuptiActivityBuffer&&) = delete;
 
   [[nodiscard]] size_t size() const {
     return size_;
   }
 
   void setSize(size_t size) {
-    assert(size <= buf_.capacity());
+    assert(size <= capacity_);
     size_ = size;
   }
 
   uint8_t* data() {
-    return buf_.data();
+    return data_;
   }
 
  private:
   std::vector<uint8_t> buf_;
+  uint8_t* data_;
   size_t size_;
+  size_t capacity_;
+  std::shared_ptr<CuptiActivityBufferRecycler> recycler_;
 
   std::vector<std::unique_ptr<const ITraceActivity>> wrappers_;
 };
@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "CuptiActivityBufferPool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include "Logger.h"
+
+namespace KINETO_NAMESPACE {
+
+namespace {
+
+constexpr size_t kPageSize = 4096;
+constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+
+} // namespace
+
+std::shared_ptr<CuptiActivityBufferPool> CuptiActivityBufferPool::create(
+    size_t bufferSize) {
+  return std::shared_ptr<CuptiActivityBufferPool>(
+      new CuptiActivityBufferPool(bufferSize));
+}
+
+CuptiActivityBufferPool::CuptiActivityBufferPool(size_t bufferSize)
+    : bufferSize_(bufferSize) {}
+
+CuptiActivityBufferPool::~CuptiActivityBufferPool() {
+  // Completed buffers keep the pool alive, so only these are left.
+  for (uint8_t* data : idle_) {
+    deallocate(data);
+  }
+  for (uint8_t* data : inFlight_) {
+    deallocate(data);
+  }
+}
+
+void CuptiActivityBufferPool::setMaxInFlight(int64_t count) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  maxInFlight_ = count;
+}
+
+int64_t CuptiActivityBufferPool::maxInFlight() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return maxInFlight_;
+}
+
+void CuptiActivityBufferPool::setHighWaterMark(size_t count) {
+  std::vector<uint8_t*> excess;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    highWaterMark_ = count;
+    while (idle_.size() > highWaterMark_) {
+      excess.push_back(idle_.back());
+      idle_.pop_back();
+    }
+  }
+  for (uint8_t* data : excess) {
+    deallocate(data);
+  }
+}
+
+void CuptiActivityBufferPool::setHugePages(bool enabled) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  hugePages_ = enabled;
+}
+
+void CuptiActivityBufferPool::prefault() {
+  size_t missing = 0;
+  bool hugePages = false;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    const auto maxInFlight =
+        static_cast<size_t>(std::max<int64_t>(maxInFlight_, 0));
+    const size_t target = std::min(highWaterMark_, maxInFlight);
+    missing = target - std::min(target, idle_.size());
+    hugePages = hugePages_;
+  }
+  // Allocate and touch outside the lock, so CUPTI callbacks are not held up.
+  std::vector<uint8_t*> buffers;
+  buffers.reserve(missing);
+  for (size_t i = 0; i < missing; i++) {
+    uint8_t* data = allocate(hugePages);
+    if (!data) {
+      break;
+    }
+    std::memset(data, 0, bufferSize_);
+    buffers.push_back(data);
+  }
+  std::lock_guard<std::mutex> guard(mutex_);
+  stats_.allocated += static_cast<int64_t>(buffers.size());
+  for (uint8_t* data : buffers) {
+    if (idle_.size() < highWaterMark_) {
+      idle_.push_back(data);
+    } else {
+      deallocate(data);
+    }
+  }
+  VLOG(0) << "Pre-faulted " << buffers.size() << " CUPTI buffers, "
+          << idle_.size() << " idle";
+}
+
+uint8_t* CuptiActivityBufferPool::request(size_t* size) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (static_cast<int64_t>(inFlight_.size()) >= maxInFlight_) {
+    stats_.exhausted++;
+    return nullptr;
+  }
+  uint8_t* data = nullptr;
+  if (!idle_.empty()) {
+    data = idle_.back();
+    idle_.pop_back();
+    stats_.recycled++;
+  } else {
+    data = allocate(hugePages_);
+    if (!data) {
+      return nullptr;
+    }
+    stats_.allocated++;
+  }
+  inFlight_.insert(data);
+  stats_.peakInFlight = std::max(stats_.peakInFlight, inFlight_.size());
+  *size = bufferSize_;
+  return data;
+}
+
+std::unique_ptr<CuptiActivityBuffer> CuptiActivityBufferPool::complete(
+    uint8_t* data,
+    size_t validSize) {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (inFlight_.erase(data) == 0) {
+      return nullptr;
+    }
+    stats_.completed++;
+  }
+  return std::make_unique<CuptiActivityBuffer>(
+      data, bufferSize_, validSize, shared_from_this());
+}
+
+size_t CuptiActivityBufferPool::inFlight() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return inFlight_.size();
+}
+
+CuptiActivityBufferPool::Stats CuptiActivityBufferPool::stats() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  Stats stats = stats_;
+  stats.inFlight = inFlight_.size();
+  stats.idle = idle_.size();
+  return stats;
+}
+
+void CuptiActivityBufferPool::recycle(uint8_t* data) {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    stats_.completed--;
+    if (idle_.size() < highWaterMark_) {
+      idle_.push_back(data);
+      return;
+    }
+  }
+  deallocate(data);
+}
+
+uint8_t* CuptiActivityBufferPool::allocate(bool hugePages) const {
+  const size_t alignment = hugePages ? kHugePageSize : kPageSize;
+  const size_t size = (bufferSize_ + alignment - 1) / alignment * alignment;
+#ifdef _WIN32
+  void* data = _aligned_malloc(size, alignment);
+#else
+  void* data = std::aligned_alloc(alignment, size);
+#endif
+  if (!data) {
+    LOG(ERROR) << "Failed to allocate a " << size << " byte CUPTI buffer";
+    return nullptr;
+  }
+#ifdef __linux__
+  if (hugePages && madvise(data, size, MADV_HUGEPAGE) != 0) {
+    VLOG(0) << "Transparent huge pages unavailable for CUPTI buffers: "
+            << std::strerror(errno);
+  }
+#endif
+  return static_cast<uint8_t*>(data);
+}
+
+void CuptiActivityBufferPool::deallocate(uint8_t* data) {
+#ifdef _WIN32
+  _aligned_free(data);
+#else
+  std::free(data);
+#endif
+}
+
+} // namespace KINETO_NAMESPACE
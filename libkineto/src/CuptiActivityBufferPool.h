@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#include "CuptiActivityBuffer.h"
+
+namespace KINETO_NAMESPACE {
+
+// Host buffers that CUPTI writes activity records into. Buffers are handed
+// to CUPTI by request() and taken back filled by complete(); once the trace
+// is done with a completed buffer its memory returns to the pool, which
+// keeps up to a high-water mark of them for reuse instead of freeing them.
+// prefault() allocates and touches buffers ahead of time, so that requests
+// made from the CUPTI callbacks in the middle of the profiled workload
+// neither allocate nor page fault.
+//
+// Has no CUPTI dependency, so it can be exercised without a GPU.
+class CuptiActivityBufferPool final
+    : public CuptiActivityBufferRecycler,
+      public std::enable_shared_from_this<CuptiActivityBufferPool> {
+ public:
+  struct Stats {
+    // Handed to CUPTI and not completed yet.
+    size_t inFlight{0};
+    // Completed and still held by the trace.
+    size_t completed{0};
+    // Kept in the pool for reuse.
+    size_t idle{0};
+    size_t peakInFlight{0};
+    // Requests served by a fresh allocation, from the pool, or refused
+    // because maxInFlight() buffers were in flight.
+    int64_t allocated{0};
+    int64_t recycled{0};
+    int64_t exhausted{0};
+  };
+
+  static std::shared_ptr<CuptiActivityBufferPool> create(size_t bufferSize);
+
+  ~CuptiActivityBufferPool() override;
+
+  CuptiActivityBufferPool(const CuptiActivityBufferPool&) = delete;
+  CuptiActivityBufferPool& operator=(const CuptiActivityBufferPool&) = delete;
+
+  [[nodiscard]] size_t bufferSize() const {
+    return bufferSize_;
+  }
+
+  // Limit on the number of buffers in flight; request() fails beyond it.
+  void setMaxInFlight(int64_t count);
+  [[nodiscard]] int64_t maxInFlight() const;
+
+  // Number of idle buffers kept for reuse; any beyond it are freed.
+  void setHighWaterMark(size_t count);
+
+  // Align buffers to, and advise the kernel to back them with, transparent
+  // huge pages. Applies to buffers allocated from now on.
+  void setHugePages(bool enabled);
+
+  // Allocates and faults in buffers until the high-water mark, capped by
+  // maxInFlight(), are idle. Not meant to be called from CUPTI callbacks.
+  void prefault();
+
+  // Returns a buffer for CUPTI to fill and sets size to its size, or returns
+  // nullptr if maxInFlight() buffers are in flight.
+  uint8_t* request(size_t* size);
+
+  // Takes back a buffer from request() holding validSize bytes of records.
+  // Returns nullptr if data did not come from request().
+  std::unique_ptr<CuptiActivityBuffer> complete(
+      uint8_t* data,
+      size_t validSize);
+
+  [[nodiscard]] size_t inFlight() const;
+  [[nodiscard]] Stats stats() const;
+
+  void recycle(uint8_t* data) override;
+
+ private:
+  explicit CuptiActivityBufferPool(size_t bufferSize);
+
+  uint8_t* allocate(bool hugePages) const;
+  static void deallocate(uint8_t* data);
+
+  const size_t bufferSize_;
+  mutable std::mutex mutex_;
+  int64_t maxInFlight_{0};
+  size_t highWaterMark_{0};
+  bool hugePages_{false};
+  std::unordered_set<uint8_t*> inFlight_;
+  std::vector<uint8_t*> idle_;
+  Stats stats_;
+};
+
+} // namespace KINETO_NAMESPACE
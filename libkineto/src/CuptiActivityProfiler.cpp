@@ -111,6 +111,8 @@ void CuptiActivityProfiler::logGpuVersions() {
 
 void CuptiActivityProfiler::setMaxGpuBufferSize(int64_t size) {
   cupti_.setMaxBufferSize(size);
+  cupti_.setBufferPool(
+      config().cuptiHostBufferPoolSize(), config().cuptiHostBufferHugePages());
 }
 
 void CuptiActivityProfiler::enableGpuTracing() {
@@ -171,9 +173,12 @@ void CuptiActivityProfiler::popCorrelationIdImpl(CorrelationFlowType type) {
 
 void CuptiActivityProfiler::onResetTraceData() {
   cupti_.teardownContext();
+  ctxToDeviceId().clear();
+}
+
+void CuptiActivityProfiler::onResetProcessingState() {
   KernelRegistry::singleton()->clear();
   waitEventMap().clear();
-  ctxToDeviceId().clear();
 }
 
 void CuptiActivityProfiler::onFinalizeTrace(
@@ -193,17 +198,34 @@ void CuptiActivityProfiler::processGpuActivities(ActivityLogger& logger) {
     addOverheadSample(flushOverhead_, cupti_.flushOverhead);
   }
   if (traceBuffers_->gpu) {
-    // Pass 1: Preprocess all raw records to populate correlation, event, and
-    // context lookup state.
-    buildProcessingState(*traceBuffers_->gpu);
-
-    // Pass 2: Materialize activities. buildProcessingState() has already
-    // populated correlation, event, and context lookup state;
+    // Each correlated launch takes at least a runtime API record and an
+    // external correlation record, which bounds the correlation state.
+    size_t bytes = 0;
+    for (const auto& [addr, buffer] : *traceBuffers_->gpu) {
+      bytes += buffer->size();
+    }
+    reserveCorrelationState(
+        bytes /
+        (sizeof(CUpti_ActivityAPI) +
+         sizeof(CUpti_ActivityExternalCorrelation)));
+
+    // Pass 1: Walk the buffers in parallel, converting TSC timestamps and
+    // collecting the records of each; then populate correlation, event, and
+    // context lookup state from them in buffer order.
+    auto decoded = decodeBuffers(*traceBuffers_->gpu, processingPool());
+    buildProcessingState(decoded);
+
+    // Pass 2: Materialize activities in buffer order. buildProcessingState()
+    // has already populated correlation, event, and context lookup state;
     // EXTERNAL_CORRELATION is a no-op in handleCuptiActivity.
-    const auto count_and_size = cupti_.processActivities(
-        *traceBuffers_->gpu, [this, &logger](const CUpti_Activity* record) {
-          handleCuptiActivity(record, &logger);
-        });
+    std::pair<int, size_t> count_and_size{0, 0};
+    for (const auto& buffer : decoded) {
+      for (const CUpti_Activity* record : buffer.records) {
+        handleCuptiActivity(record, &logger);
+      }
+      count_and_size.first += static_cast<int>(buffer.records.size());
+      count_and_size.second += buffer.bytes;
+    }
     logDeferredEvents();
     LOG(INFO) << "Processed " << count_and_size.first << " GPU records ("
               << count_and_size.second << " bytes)";
@@ -217,6 +239,21 @@ void CuptiActivityProfiler::processGpuActivities(ActivityLogger& logger) {
     LOGGER_OBSERVER_ADD_METADATA(
         "ResourceOverhead", std::to_string(resourceOverheadCount_));
   }
+
+  const auto pool = cupti_.bufferPoolStats();
+  VLOG(0) << "CUPTI buffer pool: " << pool.inFlight << " in flight, "
+          << pool.completed << " completed, " << pool.idle << " idle, "
+          << "peak in flight " << pool.peakInFlight << "; " << pool.allocated
+          << " allocated, " << pool.recycled << " recycled, "
+          << pool.exhausted << " refused";
+  LOGGER_OBSERVER_ADD_METADATA(
+      "GpuBufferPoolPeakInFlight", std::to_string(pool.peakInFlight));
+  LOGGER_OBSERVER_ADD_METADATA(
+      "GpuBufferPoolIdle", std::to_string(pool.idle));
+  LOGGER_OBSERVER_ADD_METADATA(
+      "GpuBufferPoolAllocated", std::to_string(pool.allocated));
+  LOGGER_OBSERVER_ADD_METADATA(
+      "GpuBufferPoolRecycled", std::to_string(pool.recycled));
 }
 
 // Populate ctxToDeviceId from a record with (contextId, deviceId) fields.
@@ -253,40 +290,154 @@ static inline void updateWaitEventMap(const CUpti_ActivityCudaEventType* act) {
   vec.insert(pos, WaitEventInfo{act->streamId, act->correlationId});
 }
 
-void CuptiActivityProfiler::buildProcessingState(
-    CuptiActivityBufferMap& buffers) {
-  cupti_.processActivities(buffers, [this](const CUpti_Activity* record) {
-    switch (record->kind) {
-      case CUPTI_ACTIVITY_KIND_EXTERNAL_CORRELATION:
-        handleCorrelationActivity(
-            reinterpret_cast<const CUpti_ActivityExternalCorrelation*>(record));
-        break;
-      case CUPTI_ACTIVITY_KIND_CONCURRENT_KERNEL:
-        updateCtxToDeviceId(
-            reinterpret_cast<const CUpti_ActivityKernelType*>(record));
-        break;
-      case CUPTI_ACTIVITY_KIND_MEMCPY:
-        updateCtxToDeviceId(
-            reinterpret_cast<const CUpti_ActivityMemcpyType*>(record));
-        break;
-      case CUPTI_ACTIVITY_KIND_MEMSET:
-        updateCtxToDeviceId(
-            reinterpret_cast<const CUpti_ActivityMemsetType*>(record));
-        break;
-      case CUPTI_ACTIVITY_KIND_MEMCPY2:
-        updateCtxToDeviceId(
-            reinterpret_cast<const CUpti_ActivityMemcpyPtoPType*>(record));
-        break;
-      case CUPTI_ACTIVITY_KIND_CUDA_EVENT:
-        updateWaitEventMap(
-            reinterpret_cast<const CUpti_ActivityCudaEventType*>(record));
-        break;
-      default:
-        break;
+// Rewrites the start and end of a record from TSC ticks to ns since epoch.
+template <class T>
+static inline void convertTimestamps(
+    CUpti_Activity* record,
+    const ApproximateTimeConverter& converter) {
+  T* act = reinterpret_cast<T*>(record);
+  act->start = converter(act->start);
+  act->end = converter(act->end);
+}
+
+// Converts the timestamps of the record kinds that are wrapped in a
+// CuptiActivity, so that the wrappers can return them as they are.
+static void convertTscTimestamps(
+    CUpti_Activity* record,
+    const ApproximateTimeConverter& converter) {
+  switch (record->kind) {
+    case CUPTI_ACTIVITY_KIND_RUNTIME:
+    case CUPTI_ACTIVITY_KIND_DRIVER:
+      convertTimestamps<CUpti_ActivityAPI>(record, converter);
+      break;
+    case CUPTI_ACTIVITY_KIND_CONCURRENT_KERNEL:
+      convertTimestamps<CUpti_ActivityKernelType>(record, converter);
+      break;
+    case CUPTI_ACTIVITY_KIND_MEMCPY:
+      convertTimestamps<CUpti_ActivityMemcpyType>(record, converter);
+      break;
+    case CUPTI_ACTIVITY_KIND_MEMCPY2:
+      convertTimestamps<CUpti_ActivityMemcpyPtoPType>(record, converter);
+      break;
+    case CUPTI_ACTIVITY_KIND_MEMSET:
+      convertTimestamps<CUpti_ActivityMemsetType>(record, converter);
+      break;
+    case CUPTI_ACTIVITY_KIND_SYNCHRONIZATION:
+      convertTimestamps<CUpti_ActivitySynchronization>(record, converter);
+      break;
+    case CUPTI_ACTIVITY_KIND_OVERHEAD:
+      convertTimestamps<CUpti_ActivityOverhead>(record, converter);
+      break;
+#if CUDA_VERSION >= 12080
+    case CUPTI_ACTIVITY_KIND_CUDA_EVENT: {
+      auto* event = reinterpret_cast<CUpti_ActivityCudaEventType*>(record);
+      event->deviceTimestamp = converter(event->deviceTimestamp);
+      break;
+    }
+#endif
+    default:
+      break;
+  }
+}
+
+// Whether buildProcessingState() needs to see records of this kind.
+static bool feedsProcessingState(CUpti_ActivityKind kind) {
+  switch (kind) {
+    case CUPTI_ACTIVITY_KIND_EXTERNAL_CORRELATION:
+    case CUPTI_ACTIVITY_KIND_CONCURRENT_KERNEL:
+    case CUPTI_ACTIVITY_KIND_MEMCPY:
+    case CUPTI_ACTIVITY_KIND_MEMSET:
+    case CUPTI_ACTIVITY_KIND_MEMCPY2:
+    case CUPTI_ACTIVITY_KIND_CUDA_EVENT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void CuptiActivityProfiler::decodeBuffer(
+    CuptiActivityBuffer& buffer,
+    DecodedBuffer& decoded) {
+  // With TSC timestamps, convert every record once here rather than on each
+  // timestamp() call of its wrapper, which every logger makes.
+#if !defined(_WIN32) && CUDA_VERSION >= 11060
+  const bool convertTsc =
+      use_cupti_tsc() && !get_time_converter().isIdentity();
+#else
+  const bool convertTsc = false;
+#endif
+  const ApproximateTimeConverter& converter = get_time_converter();
+  decoded.bytes = buffer.size();
+  cupti_.processBufferActivities(buffer, [&](const CUpti_Activity* record) {
+    if (convertTsc) {
+      // The records live in buffers, which this profiler owns.
+      convertTscTimestamps(const_cast<CUpti_Activity*>(record), converter);
+    }
+    if (record->kind == CUPTI_ACTIVITY_KIND_CONCURRENT_KERNEL) {
+      // Warm the demangle cache so that handleCuptiActivity(), which runs on
+      // a single thread, only looks the name up.
+      demangle(reinterpret_cast<const CUpti_ActivityKernelType*>(record)->name);
+    }
+    decoded.records.push_back(record);
+    if (feedsProcessingState(record->kind)) {
+      decoded.stateRecords.push_back(record);
     }
   });
 }
 
+std::vector<CuptiActivityProfiler::DecodedBuffer>
+CuptiActivityProfiler::decodeBuffers(
+    CuptiActivityBufferMap& buffers,
+    WorkerPool& pool) {
+  std::vector<CuptiActivityBuffer*> pending;
+  pending.reserve(buffers.size());
+  for (auto& [addr, buffer] : buffers) {
+    pending.push_back(buffer.get());
+  }
+  std::vector<DecodedBuffer> decoded(pending.size());
+  pool.run(pending.size(), [&pending, &decoded, this](size_t i) {
+    decodeBuffer(*pending[i], decoded[i]);
+  });
+  return decoded;
+}
+
+void CuptiActivityProfiler::buildProcessingState(
+    const std::vector<DecodedBuffer>& buffers) {
+  for (const auto& buffer : buffers) {
+    for (const CUpti_Activity* record : buffer.stateRecords) {
+      switch (record->kind) {
+        case CUPTI_ACTIVITY_KIND_EXTERNAL_CORRELATION:
+          handleCorrelationActivity(
+              reinterpret_cast<const CUpti_ActivityExternalCorrelation*>(
+                  record));
+          break;
+        case CUPTI_ACTIVITY_KIND_CONCURRENT_KERNEL:
+          updateCtxToDeviceId(
+              reinterpret_cast<const CUpti_ActivityKernelType*>(record));
+          break;
+        case CUPTI_ACTIVITY_KIND_MEMCPY:
+          updateCtxToDeviceId(
+              reinterpret_cast<const CUpti_ActivityMemcpyType*>(record));
+          break;
+        case CUPTI_ACTIVITY_KIND_MEMSET:
+          updateCtxToDeviceId(
+              reinterpret_cast<const CUpti_ActivityMemsetType*>(record));
+          break;
+        case CUPTI_ACTIVITY_KIND_MEMCPY2:
+          updateCtxToDeviceId(
+              reinterpret_cast<const CUpti_ActivityMemcpyPtoPType*>(record));
+          break;
+        case CUPTI_ACTIVITY_KIND_CUDA_EVENT:
+          updateWaitEventMap(
+              reinterpret_cast<const CUpti_ActivityCudaEventType*>(record));
+          break;
+        default:
+          break;
+      }
+    }
+  }
+}
+
 inline void CuptiActivityProfiler::handleCorrelationActivity(
     const CUpti_ActivityExternalCorrelation* correlation) {
   if (correlation->externalKind == CUPTI_EXTERNAL_CORRELATION_KIND_CUSTOM0) {
@@ -319,8 +470,12 @@ void CuptiActivityProfiler::handleRuntimeActivity(
   }
   const ITraceActivity* linked =
       linkedActivity(activity->correlationId, cpuCorrelationMap_);
+  if (!keepActivity(RuntimeActivity(activity, linked, tid))) {
+    return;
+  }
   const auto& runtime_activity =
-      traceBuffers_->addActivityWrapper(RuntimeActivity(activity, linked, tid));
+      traceBuffers_->emplaceActivityWrapper<RuntimeActivity>(
+          activity, linked, tid);
   checkTimestampOrder(&runtime_activity);
   if (outOfRange(runtime_activity)) {
     return;
@@ -347,8 +502,12 @@ void CuptiActivityProfiler::handleDriverActivity(
   }
   const ITraceActivity* linked =
       linkedActivity(activity->correlationId, cpuCorrelationMap_);
+  if (!keepActivity(DriverActivity(activity, linked, tid))) {
+    return;
+  }
   const auto& runtime_activity =
-      traceBuffers_->addActivityWrapper(DriverActivity(activity, linked, tid));
+      traceBuffers_->emplaceActivityWrapper<DriverActivity>(
+          activity, linked, tid);
   checkTimestampOrder(&runtime_activity);
   if (outOfRange(runtime_activity)) {
     return;
@@ -362,12 +521,16 @@ void CuptiActivityProfiler::handleOverheadActivity(
     ActivityLogger* logger) {
   VLOG(2) << ": CUPTI_ACTIVITY_KIND_OVERHEAD"
           << " overheadKind=" << activity->overheadKind;
-  const auto& overhead_activity =
-      traceBuffers_->addActivityWrapper(OverheadActivity(activity, nullptr));
   // Monitor memory overhead
   if (activity->overheadKind == CUPTI_ACTIVITY_OVERHEAD_CUPTI_RESOURCE) {
     resourceOverheadCount_++;
   }
+  if (!keepActivity(OverheadActivity(activity, nullptr))) {
+    return;
+  }
+  const auto& overhead_activity =
+      traceBuffers_->emplaceActivityWrapper<OverheadActivity>(
+          activity, nullptr);
 
   if (outOfRange(overhead_activity)) {
     return;
@@ -413,8 +576,12 @@ void CuptiActivityProfiler::handleCudaEventActivity(
   // Create and log the CUDA event activity
   const ITraceActivity* linked =
       linkedActivity(activity->correlationId, cpuCorrelationMap_);
+  if (!keepActivity(CudaEventActivity(activity, linked))) {
+    return;
+  }
   const auto& cuda_event_activity =
-      traceBuffers_->addActivityWrapper(CudaEventActivity(activity, linked));
+      traceBuffers_->emplaceActivityWrapper<CudaEventActivity>(
+          activity, linked);
 
   if (outOfRange(cuda_event_activity)) {
     return;
@@ -465,9 +632,13 @@ void CuptiActivityProfiler::handleCudaSyncActivity(
       [activity, src_stream, src_corrid, device_id, logger, this]() {
         const ITraceActivity* linked =
             linkedActivity(activity->correlationId, this->cpuCorrelationMap_);
+        if (!keepActivity(
+                CudaSyncActivity(activity, linked, src_stream, src_corrid))) {
+          return;
+        }
         const auto& cuda_sync_activity =
-            this->traceBuffers_->addActivityWrapper(
-                CudaSyncActivity(activity, linked, src_stream, src_corrid));
+            this->traceBuffers_->emplaceActivityWrapper<CudaSyncActivity>(
+                activity, linked, src_stream, src_corrid);
 
         if (outOfRange(cuda_sync_activity)) {
           return;
@@ -519,9 +690,14 @@ inline void CuptiActivityProfiler::handleGpuActivity(
     ActivityLogger* logger) {
   const ITraceActivity* linked =
       linkedActivity(act->correlationId, cpuCorrelationMap_);
+  // Only records that are kept and in range are copied into the trace buffers.
+  const GpuActivity<T> candidate(act, linked);
+  if (!keepActivity(candidate) || outOfRange(candidate)) {
+    return;
+  }
   const auto& gpu_activity =
-      traceBuffers_->addActivityWrapper(GpuActivity<T>(act, linked));
-  GenericActivityProfiler::handleGpuActivity(gpu_activity, logger);
+      traceBuffers_->emplaceActivityWrapper<GpuActivity<T>>(act, linked);
+  handleKeptGpuActivity(gpu_activity, logger);
 }
 
 uint32_t contextIdtoDeviceId(uint32_t contextId) {
@@ -9,6 +9,7 @@
 #pragma once
 
 #include <cupti.h>
+#include <vector>
 #include "CuptiActivity.h"
 #include "CuptiActivityApi.h"
 #include "GenericActivityProfiler.h"
@@ -34,10 +35,27 @@ class CuptiActivityProfiler : public GenericActivityProfiler {
   void pushCorrelationIdImpl(uint64_t id, CorrelationFlowType type) override;
   void popCorrelationIdImpl(CorrelationFlowType type) override;
   void onResetTraceData() override;
+  void onResetProcessingState() override;
   void onFinalizeTrace(const Config& config, ActivityLogger& logger) override;
 
  private:
-  void buildProcessingState(CuptiActivityBufferMap& buffers);
+  // The records of one activity buffer, in buffer order.
+  struct DecodedBuffer {
+    std::vector<const CUpti_Activity*> records;
+    // The records that feed buildProcessingState().
+    std::vector<const CUpti_Activity*> stateRecords;
+    size_t bytes{0};
+  };
+
+  // Walks the buffers on the threads of pool, converting TSC timestamps and
+  // collecting the records of each. The result is in buffer order.
+  std::vector<DecodedBuffer> decodeBuffers(
+      CuptiActivityBufferMap& buffers,
+      WorkerPool& pool);
+  void decodeBuffer(CuptiActivityBuffer& buffer, DecodedBuffer& decoded);
+  // Populates correlation, event, and context lookup state from the decoded
+  // buffers, in buffer order.
+  void buildProcessingState(const std::vector<DecodedBuffer>& buffers);
   // Process generic CUPTI activity
   void handleCuptiActivity(
       const CUpti_Activity* record,
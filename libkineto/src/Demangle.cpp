@@ -20,6 +20,7 @@ _Pragma("GCC diagnostic pop");
 #endif
 #endif // _MSC_VER
 
+#include <algorithm>
 #include <cstring>
 #include <string>
 
@@ -27,7 +28,7 @@ namespace KINETO_NAMESPACE {
 
 static constexpr int kMaxSymbolSize = 8192;
 
-std::string demangle(const char* name) {
+std::string demangleUncached(const char* name) {
 #ifndef _MSC_VER
   if (!name) {
     return "";
@@ -57,8 +58,78 @@ std::string demangle(const char* name) {
 #endif
 }
 
-std::string demangle(const std::string& name) {
+const std::string& demangle(const char* name) {
+  return DemangleCache::instance().demangle(name);
+}
+
+const std::string& demangle(const std::string& name) {
   return demangle(name.c_str());
 }
 
+DemangleCache::DemangleCache(size_t capacity)
+    : shardCapacity_(std::max<size_t>(capacity / kShards, 1)) {}
+
+DemangleCache& DemangleCache::instance() {
+  static DemangleCache instance;
+  return instance;
+}
+
+const std::string& DemangleCache::demangle(const char* name) {
+  static const std::string kEmpty;
+  // Names that are not cached.
+  thread_local std::string uncached;
+  if (!name) {
+    return kEmpty;
+  }
+  const std::string_view key(name);
+  if (key.size() > kMaxSymbolSize) {
+    uncached = demangleUncached(name);
+    return uncached;
+  }
+  Shard& shard = shards_[Hash()(key) % kShards];
+  {
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    if (auto it = shard.names.find(key); it != shard.names.end()) {
+      shard.hits++;
+      return it->second;
+    }
+  }
+
+  // Demangle outside the lock; if another thread gets there first, its
+  // result is kept. Values of an unordered_map do not move when it grows.
+  std::string demangled = demangleUncached(name);
+  std::lock_guard<std::mutex> guard(shard.mutex);
+  shard.misses++;
+  if (shard.names.size() >= shardCapacity_) {
+    if (auto it = shard.names.find(key); it != shard.names.end()) {
+      return it->second;
+    }
+    shard.uncached++;
+    uncached = std::move(demangled);
+    return uncached;
+  }
+  return shard.names.try_emplace(std::string(key), std::move(demangled))
+      .first->second;
+}
+
+DemangleCacheStats DemangleCache::stats() const {
+  DemangleCacheStats stats;
+  for (const auto& shard : shards_) {
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    stats.hits += shard.hits;
+    stats.misses += shard.misses;
+    stats.uncached += shard.uncached;
+    stats.size += shard.names.size();
+  }
+  return stats;
+}
+
+void DemangleCache::clear() {
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    shard.names.clear();
+    shard.hits = shard.misses = shard.uncached = 0;
+  }
+}
+
 } // namespace KINETO_NAMESPACE
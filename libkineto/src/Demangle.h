@@ -8,11 +8,92 @@
 
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 
 namespace KINETO_NAMESPACE {
 
-std::string demangle(const char* name);
-std::string demangle(const std::string& name);
+// Demangles through DemangleCache::instance(). Names that are not mangled
+// C++ symbols are returned as is. See DemangleCache::demangle() for how long
+// the result stays valid.
+const std::string& demangle(const char* name);
+const std::string& demangle(const std::string& name);
+
+// Demangles without consulting the cache.
+std::string demangleUncached(const char* name);
+
+struct DemangleCacheStats {
+  int64_t hits{0};
+  int64_t misses{0};
+  // Misses that were not added, as the cache was full.
+  int64_t uncached{0};
+  size_t size{0};
+};
+
+// Bounded, thread-safe cache of demangled names, keyed by the mangled name.
+//
+// Kernel names are demangled every time a kernel record is named, and a
+// trace launches the same few hundred kernels over and over, so nearly every
+// lookup is a hit. The cache is split into shards, each with its own lock,
+// so that threads naming records concurrently rarely contend.
+//
+// Cached names are interned: they are never evicted, so references to them
+// stay valid for the life of the cache. Once a shard reaches its share of the
+// capacity, further names in it are demangled on every lookup instead. This
+// keeps memory bounded for processes that keep loading new kernels, and
+// avoids the burst of misses that emptying a full shard would cause; the
+// names cached first, which are those of the kernels launched every
+// iteration, stay cached. stats().uncached shows when the capacity is too
+// small.
+class DemangleCache {
+ public:
+  static constexpr size_t kDefaultCapacity = 8192;
+
+  explicit DemangleCache(size_t capacity = kDefaultCapacity);
+  DemangleCache(const DemangleCache&) = delete;
+  DemangleCache& operator=(const DemangleCache&) = delete;
+
+  // Process-wide cache used by demangle().
+  static DemangleCache& instance();
+
+  // A cached name stays valid until clear() or the cache is destroyed.
+  // Names that are not cached are returned in storage owned by the calling
+  // thread, valid until its next call.
+  const std::string& demangle(const char* name);
+
+  [[nodiscard]] DemangleCacheStats stats() const;
+
+  // Drops all entries and resets the counters. Not to be called while
+  // references returned by demangle() are in use.
+  void clear();
+
+ private:
+  static constexpr size_t kShards = 16;
+
+  // Allows lookups by std::string_view without building a std::string.
+  struct Hash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const {
+      return std::hash<std::string_view>()(s);
+    }
+  };
+
+  struct Shard {
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, std::string, Hash, std::equal_to<>> names;
+    int64_t hits{0};
+    int64_t misses{0};
+    int64_t uncached{0};
+  };
+
+  size_t shardCapacity_;
+  std::array<Shard, kShards> shards_;
+};
 
 } // namespace KINETO_NAMESPACE
@@ -27,6 +27,7 @@
 #endif
 
 #include "Logger.h"
+#include "OccupancyCache.h"
 
 namespace KINETO_NAMESPACE {
 
@@ -173,6 +174,44 @@ float warpsPerSm(const CUpti_ActivityKernelType& kernel) {
       threads_per_warp;
 }
 
+namespace {
+
+// cudaOccMaxActiveBlocksPerMultiprocessor() output for one launch shape.
+struct OccupancyResult {
+  cudaOccError status = CUDA_OCC_SUCCESS;
+  cudaOccResult result = {};
+};
+
+OccupancyCache<OccupancyResult>& occupancyCache() {
+  static OccupancyCache<OccupancyResult> cache(deviceProps().size());
+  return cache;
+}
+
+OccupancyResult computeOccupancy(
+    const cudaDeviceProp& deviceProp,
+    const KernelLaunchShape& shape) {
+  cudaOccFuncAttributes occFuncAttr;
+  occFuncAttr.maxThreadsPerBlock = INT_MAX;
+  occFuncAttr.numRegs = shape.registersPerThread;
+  occFuncAttr.sharedSizeBytes = shape.staticSharedMemory;
+  occFuncAttr.partitionedGCConfig = PARTITIONED_GC_OFF;
+  occFuncAttr.shmemLimitConfig = FUNC_SHMEM_LIMIT_DEFAULT;
+  occFuncAttr.maxDynamicSharedSizeBytes = 0;
+  const cudaOccDeviceState occDeviceState = {};
+  cudaOccDeviceProp prop(deviceProp);
+  OccupancyResult occupancy;
+  occupancy.status = cudaOccMaxActiveBlocksPerMultiprocessor(
+      &occupancy.result,
+      &prop,
+      &occFuncAttr,
+      &occDeviceState,
+      static_cast<int>(shape.blockSize),
+      shape.dynamicSharedMemory);
+  return occupancy;
+}
+
+} // namespace
+
 OccupancyMetrics computeOccupancyMetrics(
     const CUpti_ActivityKernelType& kernel) {
   OccupancyMetrics metrics;
@@ -191,32 +230,25 @@ OccupancyMetrics computeOccupancyMetrics(
         static_cast<float>(sm_count);
   }
 
-  cudaOccFuncAttributes occFuncAttr;
-  occFuncAttr.maxThreadsPerBlock = INT_MAX;
-  occFuncAttr.numRegs = kernel.registersPerThread;
-  occFuncAttr.sharedSizeBytes = kernel.staticSharedMemory;
-  occFuncAttr.partitionedGCConfig = PARTITIONED_GC_OFF;
-  occFuncAttr.shmemLimitConfig = FUNC_SHMEM_LIMIT_DEFAULT;
-  occFuncAttr.maxDynamicSharedSizeBytes = 0;
-  const cudaOccDeviceState occDeviceState = {};
   int blockSize = kernel.blockX * kernel.blockY * kernel.blockZ;
-  size_t dynamicSmemSize = kernel.dynamicSharedMemory;
-  cudaOccDeviceProp prop(props[kernel.deviceId]);
-  cudaOccError status = cudaOccMaxActiveBlocksPerMultiprocessor(
-      &metrics.result,
-      &prop,
-      &occFuncAttr,
-      &occDeviceState,
-      blockSize,
-      dynamicSmemSize);
-  if (status == CUDA_OCC_SUCCESS) {
+  const KernelLaunchShape shape{
+      .registersPerThread = kernel.registersPerThread,
+      .staticSharedMemory = static_cast<uint32_t>(kernel.staticSharedMemory),
+      .dynamicSharedMemory = static_cast<uint32_t>(kernel.dynamicSharedMemory),
+      .blockSize = static_cast<uint32_t>(blockSize)};
+  const OccupancyResult occupancy =
+      occupancyCache().get(kernel.deviceId, shape, [&] {
+        return computeOccupancy(props[kernel.deviceId], shape);
+      });
+  metrics.result = occupancy.result;
+  if (occupancy.status == CUDA_OCC_SUCCESS) {
     float effectiveBlocksPerSm = std::min<float>(
         metrics.result.activeBlocksPerMultiprocessor, blocksPerSm);
     metrics.occupancy = effectiveBlocksPerSm * blockSize /
         static_cast<float>(props[kernel.deviceId].maxThreadsPerMultiProcessor);
   } else {
     LOG_EVERY_N(ERROR, 1000)
-        << "Failed to calculate occupancy, status = " << status;
+        << "Failed to calculate occupancy, status = " << occupancy.status;
   }
   return metrics;
 }
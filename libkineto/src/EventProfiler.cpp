@@ -27,7 +27,6 @@
 #include "Logger.h"
 
 using namespace std::chrono;
-using std::accumulate;
 using std::endl;
 using std::map;
 using std::ostream;
@@ -61,13 +60,7 @@ PercentileList& Event::percentiles(
 // Add up all samples for a given domain instance
 int64_t Event::sumInstance(int i, const SampleSlice& slice) const {
   auto r = toIdxRange(slice);
-  auto start = samples_.cbegin();
-  std::advance(start, r.first);
-  auto end = start;
-  std::advance(end, r.second);
-  return accumulate(start, end, 0ul, [i](int64_t a, const Sample& b) {
-    return a + b.second[i];
-  });
+  return samples_.sum(i, r.first, r.second);
 }
 
 // Add up all samples across all domain instances
@@ -86,10 +79,9 @@ void Event::printSamples(ostream& s, CUdevice device) const {
   // used for debugging, but need to keep an eye on it.
   std::lock_guard<std::mutex> lock(logMutex());
   s << "Device " << device << " " << name << ":" << endl;
-  for (const auto& sample : samples_) {
-    const auto& vals = sample.second;
-    for (int64_t val : vals) {
-      s << val << " ";
+  for (size_t j = 0; j < samples_.size(); j++) {
+    for (int i = 0; i < samples_.instanceCount(); i++) {
+      s << samples_.value(j, i) << " ";
     }
     s << endl;
   }
@@ -10,8 +10,8 @@
 
 #include <algorithm>
 #include <atomic>
+#include <cassert>
 #include <chrono>
-#include <list>
 #include <map>
 #include <set>
 #include <string>
@@ -22,19 +22,28 @@
 #include "Config.h"
 #include "CuptiEventApi.h"
 #include "CuptiMetricApi.h"
+#include "QuantileSketch.h"
+#include "SampleBuffer.h"
 #include "SampleListener.h"
 
 namespace KINETO_NAMESPACE {
 
 // Helper function for computing percentiles (nearest-rank).
-// Modifies the input.
+// Exact for fewer than QuantileSketch::kDefaultK values, e.g. one per SM.
 template <typename T>
 inline PercentileList& percentiles(std::vector<T> values, PercentileList& pcs) {
-  auto size = values.size();
-  for (auto& x : pcs) {
-    int idx = std::min(size - 1, (x.first * size) / 100);
-    std::nth_element(values.begin(), values.begin() + idx, values.end());
-    x.second = SampleValue(values[idx]);
+  QuantileSketch<T> sketch;
+  for (auto& value : values) {
+    sketch.add(std::move(value));
+  }
+  std::vector<int> percents;
+  percents.reserve(pcs.size());
+  for (const auto& x : pcs) {
+    percents.push_back(x.first);
+  }
+  auto results = sketch.percentiles(percents);
+  for (size_t i = 0; i < results.size(); i++) {
+    pcs[i].second = SampleValue(results[i]);
   }
   return pcs;
 }
@@ -74,7 +83,7 @@ class Event {
       std::chrono::time_point<std::chrono::system_clock> timestamp,
       const std::vector<int64_t>& values) {
     assert(values.size() == static_cast<size_t>(instanceCount));
-    samples_.emplace_back(timestamp, values);
+    samples_.push(timestamp, values);
   }
 
   // Sum samples for a single domain instance
@@ -88,9 +97,7 @@ class Event {
       const;
 
   void eraseSamples(int count) {
-    auto end = samples_.begin();
-    std::advance(end, count);
-    samples_.erase(samples_.begin(), end);
+    samples_.popFront(count);
   }
 
   void clearSamples() {
@@ -115,12 +122,9 @@ class Event {
     return std::make_pair(slice.offset + (slice.index * size), size);
   }
 
-  // List of collected samples, where each sample has values for
+  // Collected samples, where each sample has values for
   // one or more domain instances
-  using Sample = std::pair<
-      std::chrono::time_point<std::chrono::system_clock>,
-      std::vector<int64_t>>;
-  std::list<Sample> samples_;
+  SampleBuffer samples_;
 };
 
 class Metric {
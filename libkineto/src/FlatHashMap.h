@@ -0,0 +1,317 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace KINETO_NAMESPACE {
+
+// Hashes for FlatHashMap. A hash maps a key to a slot index, of which the
+// map uses the low log2Capacity bits.
+//
+// The default, for dense and mostly sequential keys such as correlation ids,
+// which are looked up roughly in order: neighbouring keys go to neighbouring
+// slots, as the high bits of a key are folded onto the bits that index the
+// table. Keys that only differ above a large power-of-two stride collide.
+struct SequentialKeyHash {
+  static size_t hash(uint64_t key, int log2Capacity) {
+    return static_cast<size_t>(key ^ (key >> log2Capacity));
+  }
+};
+
+// For other keys, e.g. pointers, whose low bits are all zero: every bit of
+// the key is mixed into every bit of the hash (the splitmix64 finalizer).
+struct MixedKeyHash {
+  static size_t hash(uint64_t key, [[maybe_unused]] int log2Capacity) {
+    key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+    return static_cast<size_t>(key ^ (key >> 31));
+  }
+};
+
+// Open-addressing hash map for integer keys, used for the correlation state
+// built while processing a trace: one lookup or insert per activity record,
+// for millions of records.
+//
+// Entries are stored inline in a single power-of-two array and collisions are
+// resolved by linear probing, so a lookup is typically a single cache miss.
+// The default hash suits correlation ids only (see SequentialKeyHash); use
+// MixedKeyHash for keys that are not dense, such as pointers.
+//
+// The interface is the subset of std::unordered_map used for this state, with
+// these differences:
+//  * There is no erase(); the map only grows until clear().
+//  * Inserting may move every entry, invalidating iterators and references.
+//  * clear() releases the storage.
+//  * Iteration order is unspecified, as for std::unordered_map.
+template <class Key, class Value, class Hash = SequentialKeyHash>
+class FlatHashMap {
+  static_assert(std::is_integral_v<Key>, "FlatHashMap needs integer keys");
+
+ public:
+  using key_type = Key;
+  using mapped_type = Value;
+  using value_type = std::pair<Key, Value>;
+  using size_type = size_t;
+
+  // Tables never go above 3/4 full.
+  static constexpr size_t kMaxLoadNumerator = 3;
+  static constexpr size_t kMaxLoadDenominator = 4;
+  static constexpr size_t kMinCapacity = 16;
+
+  template <bool IsConst>
+  class Iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = FlatHashMap::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer =
+        std::conditional_t<IsConst, const value_type*, value_type*>;
+    using reference =
+        std::conditional_t<IsConst, const value_type&, value_type&>;
+    using Map = std::conditional_t<IsConst, const FlatHashMap, FlatHashMap>;
+
+    Iterator() = default;
+    Iterator(Map* map, size_t index) : map_(map), index_(index) {
+      skipEmpty();
+    }
+    // Allow iterator -> const_iterator. A template, so that it is not taken
+    // for the copy constructor.
+    template <bool OtherIsConst>
+    // NOLINTNEXTLINE(google-explicit-constructor)
+    Iterator(const Iterator<OtherIsConst>& other)
+      requires(IsConst && !OtherIsConst)
+        : map_(other.map_), index_(other.index_) {}
+
+    reference operator*() const {
+      return map_->slots_[index_];
+    }
+    pointer operator->() const {
+      return &map_->slots_[index_];
+    }
+    Iterator& operator++() {
+      index_++;
+      skipEmpty();
+      return *this;
+    }
+    Iterator operator++(int) {
+      Iterator tmp = *this;
+      ++*this;
+      return tmp;
+    }
+    bool operator==(const Iterator& other) const {
+      return index_ == other.index_;
+    }
+
+   private:
+    friend class FlatHashMap;
+    friend class Iterator<!IsConst>;
+
+    void skipEmpty() {
+      while (index_ < map_->endIndex() && !map_->occupied(index_)) {
+        index_++;
+      }
+    }
+
+    Map* map_{nullptr};
+    size_t index_{0};
+  };
+
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+  FlatHashMap() = default;
+  explicit FlatHashMap(size_t expectedSize) {
+    reserve(expectedSize);
+  }
+
+  [[nodiscard]] size_t size() const {
+    return size_;
+  }
+
+  [[nodiscard]] bool empty() const {
+    return size_ == 0;
+  }
+
+  // Number of slots in the table, excluding the one for kEmptyKey.
+  [[nodiscard]] size_t capacity() const {
+    return mask_ ? mask_ + 1 : 0;
+  }
+
+  iterator begin() {
+    return iterator(this, 0);
+  }
+  iterator end() {
+    return iterator(this, endIndex());
+  }
+  const_iterator begin() const {
+    return const_iterator(this, 0);
+  }
+  const_iterator end() const {
+    return const_iterator(this, endIndex());
+  }
+
+  // Makes room for count entries in total without further rehashing.
+  void reserve(size_t count) {
+    const size_t needed = count * kMaxLoadDenominator / kMaxLoadNumerator + 1;
+    if (needed > capacity()) {
+      rehash(std::bit_ceil(std::max(needed, kMinCapacity)));
+    }
+  }
+
+  void clear() {
+    slots_ = std::vector<value_type>();
+    mask_ = 0;
+    shift_ = 0;
+    size_ = 0;
+    hasEmptyKey_ = false;
+  }
+
+  iterator find(Key key) {
+    return iterator(this, findIndex(key));
+  }
+
+  const_iterator find(Key key) const {
+    return const_iterator(this, findIndex(key));
+  }
+
+  [[nodiscard]] bool contains(Key key) const {
+    return findIndex(key) != endIndex();
+  }
+
+  [[nodiscard]] size_t count(Key key) const {
+    return contains(key) ? 1 : 0;
+  }
+
+  // Like std::unordered_map::insert, keeps the existing value if the key is
+  // already present.
+  std::pair<iterator, bool> insert(const value_type& entry) {
+    return emplace(entry.first, entry.second);
+  }
+
+  template <class... Args>
+  std::pair<iterator, bool> emplace(Key key, Args&&... args) {
+    auto [index, inserted] = findOrPrepareInsert(key);
+    if (inserted) {
+      slots_[index].second = Value(std::forward<Args>(args)...);
+    }
+    return {iterator(this, index), inserted};
+  }
+
+  Value& operator[](Key key) {
+    return slots_[findOrPrepareInsert(key).first].second;
+  }
+
+ private:
+  // Marks unused slots. An entry with this key lives in the extra slot at
+  // slots_[capacity()] instead.
+  static constexpr Key kEmptyKey = std::numeric_limits<Key>::min();
+
+  [[nodiscard]] size_t hash(Key key) const {
+    return Hash::hash(static_cast<uint64_t>(key), shift_);
+  }
+
+  // One past the last slot, including the one for kEmptyKey.
+  [[nodiscard]] size_t endIndex() const {
+    return slots_.size();
+  }
+
+  [[nodiscard]] bool occupied(size_t index) const {
+    return index < capacity() ? slots_[index].first != kEmptyKey
+                              : hasEmptyKey_;
+  }
+
+  [[nodiscard]] size_t findIndex(Key key) const {
+    if (size_ == 0) {
+      return endIndex();
+    }
+    if (key == kEmptyKey) {
+      return hasEmptyKey_ ? capacity() : endIndex();
+    }
+    for (size_t i = hash(key) & mask_;; i = (i + 1) & mask_) {
+      const Key slotKey = slots_[i].first;
+      if (slotKey == key) {
+        return i;
+      }
+      if (slotKey == kEmptyKey) {
+        return endIndex();
+      }
+    }
+  }
+
+  // Returns the slot for key and whether it was newly claimed. A new slot
+  // holds a default-constructed value.
+  std::pair<size_t, bool> findOrPrepareInsert(Key key) {
+    if ((size_ + 1) * kMaxLoadDenominator > capacity() * kMaxLoadNumerator) {
+      rehash(std::max(capacity() * 2, kMinCapacity));
+    }
+    if (key == kEmptyKey) {
+      const bool inserted = !hasEmptyKey_;
+      if (inserted) {
+        hasEmptyKey_ = true;
+        slots_[capacity()].second = Value();
+        size_++;
+      }
+      return {capacity(), inserted};
+    }
+    size_t i = hash(key) & mask_;
+    for (;; i = (i + 1) & mask_) {
+      const Key slotKey = slots_[i].first;
+      if (slotKey == key) {
+        return {i, false};
+      }
+      if (slotKey == kEmptyKey) {
+        break;
+      }
+    }
+    slots_[i].first = key;
+    size_++;
+    return {i, true};
+  }
+
+  void rehash(size_t newCapacity) {
+    std::vector<value_type> old = std::move(slots_);
+    const size_t oldCapacity = capacity();
+    slots_ = std::vector<value_type>(newCapacity + 1, {kEmptyKey, Value()});
+    mask_ = newCapacity - 1;
+    shift_ = std::countr_zero(newCapacity);
+    for (size_t i = 0; i < oldCapacity; i++) {
+      if (old[i].first == kEmptyKey) {
+        continue;
+      }
+      size_t j = hash(old[i].first) & mask_;
+      while (slots_[j].first != kEmptyKey) {
+        j = (j + 1) & mask_;
+      }
+      slots_[j] = std::move(old[i]);
+    }
+    if (hasEmptyKey_) {
+      slots_[newCapacity] = std::move(old[oldCapacity]);
+    }
+  }
+
+  // capacity() slots followed by the slot for kEmptyKey; empty until the
+  // first insert or reserve().
+  std::vector<value_type> slots_;
+  size_t mask_{0};
+  // log2(capacity())
+  int shift_{0};
+  size_t size_{0};
+  bool hasEmptyKey_{false};
+};
+
+} // namespace KINETO_NAMESPACE
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "FlightRecorder.h"
+
+#include <algorithm>
+#include <set>
+#include <utility>
+
+// TODO(T90238193)
+// @lint-ignore-every CLANGTIDY facebook-hte-RelativeInclude
+#include "Config.h"
+#include "Logger.h"
+
+using namespace std::chrono;
+
+namespace KINETO_NAMESPACE {
+
+FlightRecorder::FlightRecorder(const Config& config)
+    : window_(
+          duration_cast<nanoseconds>(config.flightRecorderWindow()).count()),
+      windowIterations_(config.flightRecorderWindowIterations()),
+      segmentDuration_(
+          duration_cast<milliseconds>(config.flightRecorderWindow()) /
+          config.flightRecorderSegments()),
+      segmentIterations_(std::max<int64_t>(
+          windowIterations_ / config.flightRecorderSegments(),
+          1)),
+      maxEvents_(static_cast<size_t>(config.flightRecorderMaxEvents())) {}
+
+void FlightRecorder::addSegment(Segment segment) {
+  eventCount_ += segment.trace->eventCount();
+  segments_.push_back(std::move(segment));
+
+  // Drop segments that lie entirely outside the window.
+  const Segment& newest = segments_.back();
+  while (segments_.size() > 1) {
+    const Segment& oldest = segments_.front();
+    const bool outside = isIterationBased()
+        ? newest.endIteration - oldest.endIteration >= windowIterations_
+        : newest.endTime - oldest.endTime >= window_;
+    if (!outside) {
+      break;
+    }
+    evictOldest();
+  }
+
+  while (eventCount_ > maxEvents_ && !segments_.empty()) {
+    if (segments_.size() == 1) {
+      LOG(WARNING) << "Flight recorder segment with " << eventCount_
+                   << " events exceeds the limit of " << maxEvents_
+                   << " - dropping it. Use more segments or a higher limit.";
+    }
+    evictOldest();
+  }
+}
+
+void FlightRecorder::evictOldest() {
+  eventCount_ -= segments_.front().trace->eventCount();
+  segments_.pop_front();
+}
+
+bool FlightRecorder::dump(ActivityLogger& logger, const Config& config) const {
+  if (segments_.empty()) {
+    return false;
+  }
+  const MemoryTraceLogger& newest = *segments_.back().trace;
+  logger.handleTraceStart(newest.metadata(), newest.deviceProperties());
+
+  // Every segment reports the same processes and threads; log each once.
+  std::set<int64_t> devices;
+  std::set<std::pair<int64_t, int64_t>> resources;
+  for (const auto& segment : segments_) {
+    for (const auto& [info, time] : segment.trace->deviceInfos()) {
+      if (devices.insert(info.id).second) {
+        logger.handleDeviceInfo(info, time);
+      }
+    }
+    for (const auto& [info, time] : segment.trace->resourceInfos()) {
+      if (resources.insert({info.deviceId, info.id}).second) {
+        logger.handleResourceInfo(info, time);
+      }
+    }
+  }
+  for (const auto& segment : segments_) {
+    segment.trace->logActivities(logger);
+  }
+  logger.finalizeTrace(config, nullptr, endTime());
+  return true;
+}
+
+} // namespace KINETO_NAMESPACE
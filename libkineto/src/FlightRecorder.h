@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+
+// TODO(T90238193)
+// @lint-ignore-every CLANGTIDY facebook-hte-RelativeInclude
+#include "output_membuf.h"
+
+namespace KINETO_NAMESPACE {
+
+class ActivityLogger;
+class Config;
+
+// Bounded history of processed traces for flight recorder mode (see
+// Config::flightRecorderEnabled()).
+//
+// The profiler records the window in segments: each segment is an ordinary
+// trace, processed into a MemoryTraceLogger when it ends. The recorder keeps
+// the newest segments that overlap the window, evicting the oldest, and at
+// most Config::flightRecorderMaxEvents() events in total. A dump combines the
+// retained segments into a single trace.
+//
+// Tracing stays enabled from one segment to the next: the recorded buffers
+// are swapped out and processed while the next segment is being recorded
+// (see GenericActivityProfiler::rotateTrace()). Only the client is stopped
+// and started again at a boundary, to hand over its CPU events. GPU
+// activities that straddle a boundary fall outside both segments.
+//
+// Not thread-safe; owned by the profiler loop.
+class FlightRecorder {
+ public:
+  struct Segment {
+    std::unique_ptr<MemoryTraceLogger> trace;
+    // Capture window, in ns since epoch.
+    int64_t startTime;
+    int64_t endTime;
+    // Value of the step() counter at the start and end of the segment.
+    int64_t startIteration;
+    int64_t endIteration;
+  };
+
+  explicit FlightRecorder(const Config& config);
+
+  // True if the window is counted in iterations rather than time.
+  [[nodiscard]] bool isIterationBased() const {
+    return windowIterations_ > 0;
+  }
+
+  // How long to record a segment for.
+  [[nodiscard]] std::chrono::milliseconds segmentDuration() const {
+    return segmentDuration_;
+  }
+
+  [[nodiscard]] int64_t segmentIterations() const {
+    return segmentIterations_;
+  }
+
+  // Adds the newest segment and evicts whatever has fallen out of the window
+  // or exceeds the event limit.
+  void addSegment(Segment segment);
+
+  // Writes the retained window to logger as one trace. Returns false if
+  // nothing has been recorded.
+  bool dump(ActivityLogger& logger, const Config& config) const;
+
+  [[nodiscard]] size_t segmentCount() const {
+    return segments_.size();
+  }
+
+  [[nodiscard]] size_t eventCount() const {
+    return eventCount_;
+  }
+
+  // Capture window of the retained segments, in ns since epoch.
+  [[nodiscard]] int64_t startTime() const {
+    return segments_.empty() ? 0 : segments_.front().startTime;
+  }
+  [[nodiscard]] int64_t endTime() const {
+    return segments_.empty() ? 0 : segments_.back().endTime;
+  }
+
+ private:
+  void evictOldest();
+
+  std::deque<Segment> segments_;
+  size_t eventCount_{0};
+  int64_t window_;
+  int64_t windowIterations_;
+  std::chrono::milliseconds segmentDuration_;
+  int64_t segmentIterations_;
+  size_t maxEvents_;
+};
+
+} // namespace KINETO_NAMESPACE
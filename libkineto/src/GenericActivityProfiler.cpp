@@ -25,7 +25,9 @@
 #include "ActivityBuffers.h"
 #include "Config.h"
 #include "DeviceProperties.h"
+#include "Demangle.h"
 #include "DeviceUtil.h"
+#include "ParallelActivityLogger.h"
 #include "output_base.h"
 #include "time_since_epoch.h"
 
@@ -107,25 +109,39 @@ GenericActivityProfiler::~GenericActivityProfiler() {}
 
 void GenericActivityProfiler::transferCpuTrace(
     std::unique_ptr<libkineto::CpuTraceBuffer> cpuTrace) {
-  std::lock_guard<std::recursive_mutex> guard(mutex_);
-  const string& trace_name = cpuTrace->span.name;
-  // acceptCpuTraces_ stays true after the synchronous processTrace() path moves
-  // traceBuffers_ out via finalizeTrace() (only completeTrace()/resetInternal()
-  // clears it), so a late span can arrive with traceBuffers_ already null.
-  // Treat either condition as "not collecting" and discard instead of
-  // dereferencing.
-  if (!acceptCpuTraces_ || traceBuffers_ == nullptr) {
+  // Read the epoch first: if a reset happens after this, the span is tagged
+  // with the old epoch and dropped when the queue is drained.
+  const uint64_t epoch = cpuTraceEpoch_.load(std::memory_order_acquire);
+  if (!acceptCpuTraces_.load(std::memory_order_acquire)) {
     VLOG(0) << "Trace collection not in progress - discarding span "
-            << trace_name;
+            << cpuTrace->span.name;
     return;
   }
+  // acceptCpuTraces_ stays true after the synchronous processTrace() path moves
+  // traceBuffers_ out via finalizeTrace() (only completeTrace()/resetInternal()
+  // clears it), so a late span can still be queued here. It stays in the
+  // queue until the next reset discards it.
+  cpuTraceQueue_.push({epoch, std::move(cpuTrace)});
+}
+
+void GenericActivityProfiler::drainCpuTraces() {
+  const uint64_t epoch = cpuTraceEpoch_.load(std::memory_order_relaxed);
+  cpuTraceQueue_.drain([this, epoch](PendingCpuTrace&& pending) {
+    auto& cpuTrace = pending.buffer;
+    const string& trace_name = cpuTrace->span.name;
+    if (pending.epoch != epoch) {
+      VLOG(0) << "Discarding span " << trace_name << " from an earlier trace";
+      return;
+    }
 
-  cpuTrace->span.iteration = iterationCountMap_[trace_name]++;
+    cpuTrace->span.iteration = iterationCountMap_[trace_name]++;
 
-  VLOG(0) << "Received iteration " << cpuTrace->span.iteration << " of span "
-          << trace_name << " (" << cpuTrace->activities.size()
-          << " activities / " << cpuTrace->gpuOpCount << " gpu activities)";
-  traceBuffers_->cpu.push_back(std::move(cpuTrace));
+    VLOG(0) << "Received iteration " << cpuTrace->span.iteration
+            << " of span " << trace_name << " ("
+            << cpuTrace->activities.size() << " activities / "
+            << cpuTrace->gpuOpCount << " gpu activities)";
+    traceBuffers_->cpu.push_back(std::move(cpuTrace));
+  });
 }
 
 namespace {
@@ -147,6 +163,8 @@ void GenericActivityProfiler::processTraceInternal(ActivityLogger& logger) {
     LOG(WARNING) << "No trace buffers to process - skipping";
     return;
   }
+  drainCpuTraces();
+  const DemangleCacheStats demangleStart = DemangleCache::instance().stats();
   LOG(INFO) << "Processing " << traceBuffers_->cpu.size() << " CPU buffers";
   VLOG(0) << "Profile time range: " << captureWindowStartTime_ << " - "
           << captureWindowEndTime_;
@@ -179,6 +197,18 @@ void GenericActivityProfiler::processTraceInternal(ActivityLogger& logger) {
       metadata_, fmt::format("{}", fmt::join(device_properties, ",")));
   setCpuActivityPresent(false);
   setGpuActivityPresent(false);
+  // With more than one serialization thread, CPU and GPU activities are
+  // rendered in parallel; everything else still goes to the logger in order.
+  ParallelActivityLogger parallelLogger(logger, processingPool());
+  ActivityLogger& activityLogger =
+      processingPool().numThreads() > 1 ? parallelLogger : logger;
+  size_t cpuActivityCount = 0;
+  for (const auto& cpu_trace : traceBuffers_->cpu) {
+    cpuActivityCount += cpu_trace->activities.size();
+  }
+  activityMap_.reserve(activityMap_.size() + cpuActivityCount);
+  clientActivityTraceMap_.reserve(
+      clientActivityTraceMap_.size() + cpuActivityCount);
   for (auto& cpu_trace : traceBuffers_->cpu) {
     string trace_name = cpu_trace->span.name;
     VLOG(0) << "Processing CPU buffer for " << trace_name << " ("
@@ -186,17 +216,21 @@ void GenericActivityProfiler::processTraceInternal(ActivityLogger& logger) {
             << cpu_trace->activities.size() << " records";
     VLOG(0) << "Span time range: " << cpu_trace->span.startTime << " - "
             << cpu_trace->span.endTime;
-    processCpuTrace(*cpu_trace, logger);
+    processCpuTrace(*cpu_trace, activityLogger);
     LOGGER_OBSERVER_ADD_EVENT_COUNT(cpu_trace->activities.size());
   }
 
   // Process GPU activities via derived class
   if (!cpuOnly_) {
-    processGpuActivities(logger);
+    processGpuActivities(activityLogger);
     if (!gpuActivityPresent()) {
       LOG(WARNING) << "GPU trace is empty!";
     }
   }
+  parallelLogger.flush();
+  if (!cpuOnly_) {
+    reportDemangleCacheStats(demangleStart);
+  }
 
   if (!traceNonEmpty()) {
     LOG(WARNING) << kEmptyTrace;
@@ -219,10 +253,33 @@ void GenericActivityProfiler::processTraceInternal(ActivityLogger& logger) {
   }
 
   LOG(INFO) << "Record counts: " << ecs_;
+  if (activityFilter_.enabled()) {
+    const std::string dropped = activityFilter_.dropCountsJson();
+    LOG(INFO) << "Filtered out: " << dropped;
+    logger.handleTraceMetadata("filteredActivities", dropped);
+  }
 
   finalizeTrace(*config_, logger);
 }
 
+// GPU kernel names are demangled while GPU activities are processed; the
+// counts show whether the cache is large enough for the workload.
+void GenericActivityProfiler::reportDemangleCacheStats(
+    const DemangleCacheStats& start) {
+  const DemangleCacheStats stats = DemangleCache::instance().stats();
+  const int64_t hits = stats.hits - start.hits;
+  const int64_t misses = stats.misses - start.misses;
+  const int64_t uncached = stats.uncached - start.uncached;
+  VLOG(0) << "Demangle cache: " << hits << " hits, " << misses << " misses, "
+          << uncached << " uncached; " << stats.size << " names";
+  LOGGER_OBSERVER_ADD_METADATA("DemangleCacheHits", std::to_string(hits));
+  LOGGER_OBSERVER_ADD_METADATA("DemangleCacheMisses", std::to_string(misses));
+  LOGGER_OBSERVER_ADD_METADATA(
+      "DemangleCacheUncached", std::to_string(uncached));
+  LOGGER_OBSERVER_ADD_METADATA(
+      "DemangleCacheSize", std::to_string(stats.size));
+}
+
 GenericActivityProfiler::CpuGpuSpanPair& GenericActivityProfiler::
     recordTraceSpan(TraceSpan& span, int gpuOpCount) {
   TraceSpan gpu_span(gpuOpCount, span.iteration, span.name, "GPU: ");
@@ -256,8 +313,20 @@ void GenericActivityProfiler::processCpuTrace(
         act->endTime = captureWindowEndTime_;
         act->addMetadata("finished", "false");
       }
+      // Dropped activities are still registered below, so that GPU
+      // activities can be correlated with them.
+      if (!keepActivity(*act)) {
+        continue;
+      }
       logger.handleActivity(*act);
     }
+  }
+  // The logger may defer rendering activities until the next non-activity
+  // event (see ParallelActivityLogger), so the span has to be logged before
+  // the activities are modified below.
+  logger.handleTraceSpan(cpu_span);
+
+  for (auto const& act : cpuTrace.activities) {
     clientActivityTraceMap_[act->correlationId()] = &span_pair;
     activityMap_[act->correlationId()] = act.get();
     if (act->deviceId() == 0) {
@@ -271,7 +340,6 @@ void GenericActivityProfiler::processCpuTrace(
     }
     recordThreadInfo(act->resourceId(), act->getThreadId(), act->deviceId());
   }
-  logger.handleTraceSpan(cpu_span);
 }
 
 static GenericTraceActivity createUserGpuSpan(
@@ -396,7 +464,7 @@ void GenericActivityProfiler::checkTimestampOrder(const ITraceActivity* act1) {
 
 const ITraceActivity* GenericActivityProfiler::linkedActivity(
     int32_t correlationId,
-    const std::unordered_map<int64_t, int64_t>& correlationMap) {
+    const CorrelationMap& correlationMap) {
   const auto& it = correlationMap.find(correlationId);
   if (it != correlationMap.end()) {
     const auto& it2 = activityMap_.find(it->second);
@@ -410,9 +478,14 @@ const ITraceActivity* GenericActivityProfiler::linkedActivity(
 void GenericActivityProfiler::handleGpuActivity(
     const ITraceActivity& act,
     ActivityLogger* logger) {
-  if (outOfRange(act)) {
-    return;
+  if (keepActivity(act) && !outOfRange(act)) {
+    handleKeptGpuActivity(act, logger);
   }
+}
+
+void GenericActivityProfiler::handleKeptGpuActivity(
+    const ITraceActivity& act,
+    ActivityLogger* logger) {
   checkTimestampOrder(&act);
   VLOG(2) << act.correlationId() << ": " << act.name();
   recordStream(act.deviceId(), act.resourceId(), "");
@@ -434,6 +507,26 @@ void GenericActivityProfiler::handleGpuActivity(
   }
 }
 
+void GenericActivityProfiler::reserveCorrelationState(size_t maxRecords) {
+  // Without a previous trace to go by, let the maps grow from this size.
+  constexpr size_t kMinRecords = 4096;
+  // 2^18 records take a few MB per map.
+  constexpr size_t kMaxRecords = size_t{1} << 18;
+  const size_t records = std::min(
+      {maxRecords, std::max(lastCorrelationCount_, kMinRecords), kMaxRecords});
+  cpuCorrelationMap_.reserve(cpuCorrelationMap_.size() + records);
+  correlatedCudaActivities_.reserve(
+      correlatedCudaActivities_.size() + records);
+}
+
+WorkerPool& GenericActivityProfiler::processingPool() {
+  const int numThreads = config_->activitiesSerializationThreads();
+  if (!processingPool_ || processingPool_->numThreads() != numThreads) {
+    processingPool_ = std::make_unique<WorkerPool>(numThreads);
+  }
+  return *processingPool_;
+}
+
 const ITraceActivity* GenericActivityProfiler::cpuActivity(
     int32_t correlationId) {
   const auto& it2 = activityMap_.find(correlationId);
@@ -471,7 +564,7 @@ void GenericActivityProfiler::configure(
     const time_point<system_clock>& now) {
   std::lock_guard<std::recursive_mutex> guard(mutex_);
   ApproximateClockToUnixTimeConverter clockConverter;
-  get_time_converter() = clockConverter.makeConverter();
+  get_time_converter() = clockConverter.makeConversion();
 
   config_ = config.clone();
 
@@ -480,6 +573,7 @@ void GenericActivityProfiler::configure(
 
   derivedConfig_.reset();
   derivedConfig_ = std::make_unique<ConfigDerivedState>(*config_);
+  activityFilter_.configure(*config_);
 
   if (LOG_IS_ON(INFO)) {
     config_->printActivityProfilerConfig(LIBKINETO_DBG_STREAM);
@@ -652,6 +746,26 @@ void GenericActivityProfiler::resetInternal() {
   resetTraceData();
 }
 
+void GenericActivityProfiler::rotateTrace(
+    ActivityLogger& logger,
+    const time_point<system_clock>& now) {
+  std::lock_guard<std::recursive_mutex> guard(mutex_);
+  captureWindowEndTime_ = libkineto::timeSinceEpoch(now);
+  // Child profiler sessions only hand over their trace once stopped, so each
+  // trace gets sessions of its own.
+  for (auto& session : sessions_) {
+    session->stop();
+  }
+  processTraceInternal(logger);
+  resetProcessingState();
+  sessions_.clear();
+  traceBuffers_ = std::make_unique<ActivityBuffers>();
+  if (!profilers_.empty()) {
+    configureChildProfilers();
+  }
+  startTraceInternal(now);
+}
+
 void GenericActivityProfiler::finalizeTrace(
     const Config& config,
     ActivityLogger& logger) {
@@ -772,17 +886,33 @@ void GenericActivityProfiler::resetTraceData() {
     clearGpuActivities();
     onResetTraceData();
   }
+  resetProcessingState();
+  // Spans still in flight are tagged with the old epoch and dropped later.
+  cpuTraceEpoch_.fetch_add(1, std::memory_order_release);
+  cpuTraceQueue_.clear();
+  traceBuffers_ = nullptr;
+  metadata_.clear();
+  sessions_.clear();
+}
+
+void GenericActivityProfiler::resetProcessingState() {
+  if (!cpuOnly_) {
+    onResetProcessingState();
+  }
   activityMap_.clear();
+  const size_t correlationCount =
+      std::max(cpuCorrelationMap_.size(), correlatedCudaActivities_.size());
+  if (correlationCount > 0) {
+    lastCorrelationCount_ = correlationCount;
+  }
   cpuCorrelationMap_.clear();
+  userCorrelationMap_.clear();
   correlatedCudaActivities_.clear();
   gpuUserEventMap_.clear();
   traceSpans_.clear();
   clientActivityTraceMap_.clear();
   seenDeviceStreams_.clear();
   logQueue_.clear();
-  traceBuffers_ = nullptr;
-  metadata_.clear();
-  sessions_.clear();
   resourceOverheadCount_ = 0;
   ecs_ = ErrorCounts{};
 }
@@ -25,10 +25,14 @@
 // TODO(T90238193)
 // @lint-ignore-every CLANGTIDY facebook-hte-RelativeInclude
 
+#include "ActivityFilter.h"
+#include "FlatHashMap.h"
 #include "GenericTraceActivity.h"
 #include "IActivityProfiler.h"
+#include "MpscQueue.h"
 #include "ThreadUtil.h"
 #include "TraceSpan.h"
+#include "WorkerPool.h"
 #include "libkineto.h"
 #include "output_base.h"
 
@@ -37,6 +41,7 @@ namespace KINETO_NAMESPACE {
 // TODO: Move ConfigDerivedState and its implemenation into separate header and
 //       source files.
 class Config;
+struct DemangleCacheStats;
 
 // This struct is a derived snapshot of the Config. And should not
 // be mutable after construction.
@@ -215,6 +220,17 @@ class GenericActivityProfiler {
     resetInternal();
   }
 
+  // Processes what was recorded since startTrace(), or since the previous
+  // rotation, into logger as a trace ending at now, and carries on recording
+  // the next one from now. Unlike stopTrace() and completeTrace(), the GPU
+  // tracers stay enabled and nothing is configured again: the recorded
+  // buffers are swapped out and processed, and only the state built up while
+  // processing them is reset. Activity recorded in the meantime goes to the
+  // next trace.
+  void rotateTrace(
+      ActivityLogger& logger,
+      const std::chrono::time_point<std::chrono::system_clock>& now);
+
   void reset() {
     std::lock_guard<std::recursive_mutex> guard(mutex_);
     resetInternal();
@@ -234,7 +250,9 @@ class GenericActivityProfiler {
   // Toggle GPU tracing during a profile instance
   void toggleCollectionDynamic(const bool enable);
 
-  // Registered with client API to pass CPU trace events over
+  // Registered with client API to pass CPU trace events over. Lock-free, so
+  // client threads never wait for the profiler; the buffers are queued and
+  // only picked up when the trace is processed.
   void transferCpuTrace(std::unique_ptr<libkineto::CpuTraceBuffer> cpuTrace);
 
   const Config& config() {
@@ -303,6 +321,9 @@ class GenericActivityProfiler {
   virtual void popCorrelationIdImpl([[maybe_unused]] CorrelationFlowType type) {
   }
   virtual void onResetTraceData() {}
+  // Called when the state built up while processing a trace is reset,
+  // including on rotateTrace(), with the GPU tracers still enabled.
+  virtual void onResetProcessingState() {}
   virtual void onFinalizeTrace(
       [[maybe_unused]] const Config& config,
       [[maybe_unused]] ActivityLogger& logger) {}
@@ -346,15 +367,20 @@ class GenericActivityProfiler {
   };
 
   GpuUserEventMap gpuUserEventMap_;
+  // The correlation state below is looked up or updated once per record, so
+  // it uses flat maps; see reserveCorrelationState().
+  using CorrelationMap = FlatHashMap<int64_t, int64_t>;
   // id -> activity*
-  std::unordered_map<int64_t, const ITraceActivity*> activityMap_;
+  FlatHashMap<int64_t, const ITraceActivity*> activityMap_;
   // cuda runtime id -> pytorch op id
   // CUPTI provides a mechanism for correlating Cuda events to arbitrary
   // external events, e.g.operator activities from PyTorch.
-  std::unordered_map<int64_t, int64_t> cpuCorrelationMap_;
+  CorrelationMap cpuCorrelationMap_;
   // CUDA runtime <-> GPU Activity
-  std::unordered_map<int64_t, const ITraceActivity*> correlatedCudaActivities_;
-  std::unordered_map<int64_t, int64_t> userCorrelationMap_;
+  FlatHashMap<int64_t, const ITraceActivity*> correlatedCudaActivities_;
+  CorrelationMap userCorrelationMap_;
+  // Size of the correlation state in the last trace that had any.
+  size_t lastCorrelationCount_{0};
 
   // data structure to collect cuptiActivityFlushAll() latency overhead
   struct profilerOverhead {
@@ -381,6 +407,9 @@ class GenericActivityProfiler {
       libkineto::CpuTraceBuffer& cpuTrace,
       ActivityLogger& logger);
 
+  // Reports the demangle cache lookups made since start.
+  void reportDemangleCacheStats(const DemangleCacheStats& start);
+
   inline bool hasDeviceResource(int64_t device, int64_t id) {
     return resourceInfo_.contains({device, id});
   }
@@ -425,14 +454,39 @@ class GenericActivityProfiler {
 
   const ITraceActivity* linkedActivity(
       int32_t correlationId,
-      const std::unordered_map<int64_t, int64_t>& correlationMap);
+      const CorrelationMap& correlationMap);
+
+  // Pre-sizes the GPU correlation state, so that it is rarely rehashed while
+  // processing the records of a trace. maxRecords bounds the number of
+  // correlated records, but mostly overestimates it; the reservation follows
+  // the number seen in the previous trace instead, and is capped.
+  void reserveCorrelationState(size_t maxRecords);
+
+  // The threads that process a trace, sized by
+  // activitiesSerializationThreads(). They are kept between traces, and are
+  // only replaced when a trace asks for a different number.
+  WorkerPool& processingPool();
 
   const ITraceActivity* cpuActivity(int32_t correlationId);
   void updateGpuNetSpan(const ITraceActivity& gpuOp);
   bool outOfRange(const ITraceActivity& act);
+
+  // Whether act passes the activity filter of the trace. Derived classes
+  // check a wrapper of a raw record on the stack, so that dropped records
+  // are not copied into the trace buffers.
+  bool keepActivity(const ITraceActivity& act) {
+    return !activityFilter_.enabled() || activityFilter_.keep(act);
+  }
+
   void handleGpuActivity(const ITraceActivity& act, ActivityLogger* logger);
+  // handleGpuActivity() for an activity that already passed keepActivity()
+  // and outOfRange().
+  void handleKeptGpuActivity(
+      const ITraceActivity& act,
+      ActivityLogger* logger);
 
   void resetTraceData();
+  void resetProcessingState();
 
   void addOverheadSample(profilerOverhead& counter, int64_t overhead) {
     counter.overhead += overhead;
@@ -455,6 +509,9 @@ class GenericActivityProfiler {
   // Resolved details about the config and states are stored here.
   std::unique_ptr<ConfigDerivedState> derivedConfig_;
 
+  // Compiled from config_ by configure().
+  ActivityFilter activityFilter_;
+
   // Logger used during trace processing
   ActivityLogger* logger_;
 
@@ -466,7 +523,7 @@ class GenericActivityProfiler {
 
   // Maintain a map of client trace activity to trace span.
   // Maps correlation id -> TraceSpan* held by traceSpans_.
-  using ActivityTraceMap = std::unordered_map<int64_t, CpuGpuSpanPair*>;
+  using ActivityTraceMap = FlatHashMap<int64_t, CpuGpuSpanPair*>;
   ActivityTraceMap clientActivityTraceMap_;
 
   // Cache thread names and system thread ids for pthread ids,
@@ -487,7 +544,21 @@ class GenericActivityProfiler {
 
   // Gate for CPU trace ingestion. True only between startTraceInternal()
   // and resetInternal() — spans arriving outside this window are discarded.
-  bool acceptCpuTraces_{false};
+  std::atomic<bool> acceptCpuTraces_{false};
+
+  // CPU traces handed over by transferCpuTrace(), tagged with the
+  // cpuTraceEpoch_ they were sent in. The epoch advances on every reset, so
+  // a span that raced with a reset is dropped rather than leaking into the
+  // next trace.
+  struct PendingCpuTrace {
+    uint64_t epoch;
+    std::unique_ptr<libkineto::CpuTraceBuffer> buffer;
+  };
+  MpscQueue<PendingCpuTrace> cpuTraceQueue_;
+  std::atomic<uint64_t> cpuTraceEpoch_{0};
+
+  // Moves the queued CPU traces of the current trace to traceBuffers_.
+  void drainCpuTraces();
   std::atomic<bool> toggleState_{true};
 
   // ***************************************************************************
@@ -543,6 +614,8 @@ class GenericActivityProfiler {
   // Buffers where trace data is stored
   std::unique_ptr<ActivityBuffers> traceBuffers_;
 
+  std::unique_ptr<WorkerPool> processingPool_;
+
   // Trace metadata
   std::unordered_map<std::string, std::string> metadata_;
 
@@ -53,8 +53,9 @@ void GenericTraceActivity::log(ActivityLogger& logger) const {
 
 const std::string GenericTraceActivity::getMetadataValue(
     const std::string& key) const {
-  const auto it = metadataMap_.find(key);
-  return it == metadataMap_.end() ? "" : metadataValueToString(it->second);
+  const auto id = MetadataKeys::find(key);
+  const TypedValue* value = id ? metadata_.find(*id) : nullptr;
+  return value == nullptr ? "" : metadataValueToString(*value);
 }
 
 const std::string GenericTraceActivity::metadataJson() const {
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#ifdef HAS_ZLIB
+
+#include "GzipTraceFileWriter.h"
+
+#include <memory>
+#include <utility>
+
+// TODO(T90238193)
+// @lint-ignore-every CLANGTIDY facebook-hte-RelativeInclude
+#include "Logger.h"
+
+namespace KINETO_NAMESPACE {
+
+namespace {
+
+// Size of the buffer compressed output is collected in before it is written.
+constexpr size_t kOutputChunkBytes = 256 * 1024;
+
+// windowBits for deflateInit2: the default window size plus 16 to write a
+// gzip header and trailer instead of a raw zlib stream.
+constexpr int kGzipWindowBits = 15 + 16;
+constexpr int kMemLevel = 8;
+
+} // namespace
+
+GzipTraceFileWriter::GzipTraceFileWriter(int level) : level_(level) {}
+
+GzipTraceFileWriter::~GzipTraceFileWriter() {
+  if (thread_.joinable()) {
+    close();
+  }
+}
+
+void GzipTraceFileWriter::open(std::FILE* file) {
+  file_ = file;
+  if (deflateInit2(
+          &stream_,
+          level_,
+          Z_DEFLATED,
+          kGzipWindowBits,
+          kMemLevel,
+          Z_DEFAULT_STRATEGY) != Z_OK) {
+    LOG(ERROR) << "Failed to initialize gzip compression: "
+               << (stream_.msg ? stream_.msg : "unknown error");
+    failed_ = true;
+    return;
+  }
+  out_.resize(kOutputChunkBytes);
+  thread_ = std::thread([this] { compressLoop(); });
+}
+
+bool GzipTraceFileWriter::write(std::string_view block) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this] {
+    return pending_.size() < kMaxPendingBlocks || failed_;
+  });
+  if (failed_ || !thread_.joinable()) {
+    return false;
+  }
+  std::string copy;
+  if (!free_.empty()) {
+    copy = std::move(free_.back());
+    free_.pop_back();
+  }
+  copy.assign(block);
+  pending_.push_back(std::move(copy));
+  lock.unlock();
+  cv_.notify_all();
+  return true;
+}
+
+bool GzipTraceFileWriter::close() {
+  if (!thread_.joinable()) {
+    return !failed_;
+  }
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    done_ = true;
+  }
+  cv_.notify_all();
+  thread_.join();
+  deflateEnd(&stream_);
+  return !failed_;
+}
+
+void GzipTraceFileWriter::compressLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [this] { return !pending_.empty() || done_; });
+    if (pending_.empty()) {
+      break;
+    }
+    std::string block = std::move(pending_.front());
+    pending_.pop_front();
+    lock.unlock();
+    // A failed write leaves the stream unusable; keep draining the queue so
+    // the producer does not block, but stop compressing.
+    if (!failed_ && !deflateBlock(block, Z_NO_FLUSH)) {
+      failed_ = true;
+    }
+    lock.lock();
+    free_.push_back(std::move(block));
+    cv_.notify_all();
+  }
+  lock.unlock();
+  if (!failed_ && !deflateBlock({}, Z_FINISH)) {
+    failed_ = true;
+  }
+}
+
+bool GzipTraceFileWriter::deflateBlock(std::string_view block, int flush) {
+  // zlib's API is not const-correct; deflate() does not modify its input.
+  stream_.next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(block.data()));
+  stream_.avail_in = static_cast<uInt>(block.size());
+  do {
+    stream_.next_out = out_.data();
+    stream_.avail_out = static_cast<uInt>(out_.size());
+    int rc = deflate(&stream_, flush);
+    if (rc == Z_STREAM_ERROR) {
+      LOG(ERROR) << "gzip compression failed";
+      return false;
+    }
+    size_t produced = out_.size() - stream_.avail_out;
+    if (produced > 0 &&
+        std::fwrite(out_.data(), 1, produced, file_) != produced) {
+      PLOG(ERROR) << "Failed to write compressed trace";
+      return false;
+    }
+  } while (stream_.avail_out == 0);
+  return true;
+}
+
+std::unique_ptr<ActivityLogger> makeGzipChromeTraceLogger(
+    const std::string& path) {
+  std::string fileName = path;
+  if (!fileName.empty() && !fileName.ends_with(".gz")) {
+    fileName += ".gz";
+  }
+  return std::make_unique<ChromeTraceLogger>(
+      fileName, std::make_unique<GzipTraceFileWriter>());
+}
+
+} // namespace KINETO_NAMESPACE
+
+#endif // HAS_ZLIB
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#ifdef HAS_ZLIB
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <zlib.h>
+
+// TODO(T90238193)
+// @lint-ignore-every CLANGTIDY facebook-hte-RelativeInclude
+#include "output_json.h"
+
+namespace KINETO_NAMESPACE {
+
+// Protocol prefix for gzip-compressed Chrome traces, e.g.
+// file+gz:///tmp/trace.json.gz
+constexpr char kGzipFileProtocol[] = "file+gz";
+
+// Compresses the trace into a gzip stream on a background thread, so the
+// trace is never written to disk uncompressed. write() only copies the block
+// into a queue; it blocks when kMaxPendingBlocks are still waiting to be
+// compressed, which bounds memory use when the compressor falls behind.
+class GzipTraceFileWriter : public TraceFileWriter {
+ public:
+  static constexpr size_t kMaxPendingBlocks = 4;
+
+  explicit GzipTraceFileWriter(int level = Z_BEST_SPEED);
+  ~GzipTraceFileWriter() override;
+
+  GzipTraceFileWriter(const GzipTraceFileWriter&) = delete;
+  GzipTraceFileWriter& operator=(const GzipTraceFileWriter&) = delete;
+
+  void open(std::FILE* file) override;
+  bool write(std::string_view block) override;
+  bool close() override;
+
+ private:
+  void compressLoop();
+  bool deflateBlock(std::string_view block, int flush);
+
+  const int level_;
+  std::FILE* file_{nullptr};
+  z_stream stream_{};
+  std::vector<unsigned char> out_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::string> pending_;
+  // Blocks that were compressed already, kept to reuse their capacity.
+  std::vector<std::string> free_;
+  bool done_{false};
+  std::atomic<bool> failed_{false};
+  std::thread thread_;
+};
+
+// Creates a Chrome trace logger writing a gzip-compressed trace to path.
+// ".gz" is appended to path unless it already ends with it.
+std::unique_ptr<ActivityLogger> makeGzipChromeTraceLogger(
+    const std::string& path);
+
+} // namespace KINETO_NAMESPACE
+
+#endif // HAS_ZLIB
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "JsonEscape.h"
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define KINETO_JSON_ESCAPE_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define KINETO_JSON_ESCAPE_NEON
+#endif
+
+#include "Logger.h"
+
+namespace KINETO_NAMESPACE {
+
+namespace {
+
+std::string string2hex(const std::string& str) {
+  std::string out;
+  out.reserve(str.size() * 2);
+  for (uint8_t c : str) {
+    // “:02x” -> two‐digit, zero‐padded, lowercase hex
+    fmt::format_to(std::back_inserter(out), "{:02x}", c);
+  }
+  return out;
+}
+
+// Whether c is copied to the output unchanged.
+inline bool isOrdinary(unsigned char c) {
+  return c >= 0x20 && c < 0x7f && c != '"' && c != '\\';
+}
+
+// Writes the replacement for a character that is not ordinary. Returns false
+// if the name is not readable.
+inline bool escapeSpecial(char c, char*& out) {
+  switch (c) {
+    case '\\':
+      *out++ = '/';
+      return true;
+    case '\n':
+      return true;
+    case '"':
+      *out++ = '\\';
+      *out++ = '"';
+      return true;
+    default:
+      return false;
+  }
+}
+
+#if defined(__AVX2__)
+// Bit i is set if byte i of chunk is not ordinary.
+inline uint32_t specialMask(__m256i chunk) {
+  // Signed compare: bytes 0x80 and up are negative, so this also catches
+  // non-ASCII bytes.
+  __m256i special = _mm256_cmpgt_epi8(_mm256_set1_epi8(0x20), chunk);
+  special = _mm256_or_si256(
+      special, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(0x7f)));
+  special =
+      _mm256_or_si256(special, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('"')));
+  special = _mm256_or_si256(
+      special, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\\')));
+  return static_cast<uint32_t>(_mm256_movemask_epi8(special));
+}
+#endif
+
+#ifdef KINETO_JSON_ESCAPE_SSE2
+inline uint32_t specialMask(__m128i chunk) {
+  __m128i special = _mm_cmplt_epi8(chunk, _mm_set1_epi8(0x20));
+  special = _mm_or_si128(special, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(0x7f)));
+  special = _mm_or_si128(special, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('"')));
+  special = _mm_or_si128(special, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\')));
+  return static_cast<uint32_t>(_mm_movemask_epi8(special));
+}
+#endif
+
+#ifdef KINETO_JSON_ESCAPE_NEON
+// Nibble i is set if byte i of chunk is not ordinary.
+inline uint64_t specialMask(uint8x16_t chunk) {
+  uint8x16_t special = vorrq_u8(
+      vcltq_u8(chunk, vdupq_n_u8(0x20)), vcgeq_u8(chunk, vdupq_n_u8(0x7f)));
+  special = vorrq_u8(special, vceqq_u8(chunk, vdupq_n_u8('"')));
+  special = vorrq_u8(special, vceqq_u8(chunk, vdupq_n_u8('\\')));
+  const uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(special), 4);
+  return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+}
+#endif
+
+} // namespace
+
+void sanitizeStrForJSON(std::string& value) {
+  // Replace all backslashes with forward slash because Windows paths causing
+  // JSONDecodeError.
+  std::ranges::replace(value, '\\', '/');
+  // Remove all new line characters
+  std::erase(value, '\n');
+}
+
+void sanitizeForNonReadableChars(std::string& value) {
+  for (auto& c : value) {
+    if (!std::isprint(c)) {
+      LOG(WARNING) << "Non JSON compliant character found in string: 0x"
+                   << string2hex(value) << " Replacing with 'unknown'";
+      value = "unknown";
+      break;
+    }
+  }
+}
+
+void escapeQuotesForJSON(std::string& value) {
+  for (size_t pos = value.find('"'); pos != std::string::npos;
+       pos = value.find('"', pos + 2)) {
+    value.insert(pos, 1, '\\');
+  }
+}
+
+size_t escapeJsonName(std::string_view name, char* out) {
+  const char* in = name.data();
+  const char* const end = in + name.size();
+  char* const begin = out;
+  // Whole chunks are stored before they are scanned; only the ordinary
+  // prefix is kept. This stays within the output while at least 16 bytes of
+  // input remain, since every input byte has two bytes of room.
+#if defined(__AVX2__)
+  while (end - in >= 32) {
+    const __m256i chunk =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), chunk);
+    const uint32_t mask = specialMask(chunk);
+    if (mask == 0) {
+      in += 32;
+      out += 32;
+      continue;
+    }
+    const int ordinary = std::countr_zero(mask);
+    in += ordinary;
+    out += ordinary;
+    if (!escapeSpecial(*in++, out)) {
+      return kUnreadableJsonName;
+    }
+  }
+#endif
+#ifdef KINETO_JSON_ESCAPE_SSE2
+  while (end - in >= 16) {
+    const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), chunk);
+    const uint32_t mask = specialMask(chunk);
+    if (mask == 0) {
+      in += 16;
+      out += 16;
+      continue;
+    }
+    const int ordinary = std::countr_zero(mask);
+    in += ordinary;
+    out += ordinary;
+    if (!escapeSpecial(*in++, out)) {
+      return kUnreadableJsonName;
+    }
+  }
+#endif
+#ifdef KINETO_JSON_ESCAPE_NEON
+  while (end - in >= 16) {
+    const uint8x16_t chunk = vld1q_u8(reinterpret_cast<const uint8_t*>(in));
+    vst1q_u8(reinterpret_cast<uint8_t*>(out), chunk);
+    const uint64_t mask = specialMask(chunk);
+    if (mask == 0) {
+      in += 16;
+      out += 16;
+      continue;
+    }
+    const int ordinary = std::countr_zero(mask) / 4;
+    in += ordinary;
+    out += ordinary;
+    if (!escapeSpecial(*in++, out)) {
+      return kUnreadableJsonName;
+    }
+  }
+#endif
+  while (in < end) {
+    const char* run = in;
+    while (run < end && isOrdinary(static_cast<unsigned char>(*run))) {
+      run++;
+    }
+    std::memcpy(out, in, run - in);
+    out += run - in;
+    in = run;
+    if (in < end && !escapeSpecial(*in++, out)) {
+      return kUnreadableJsonName;
+    }
+  }
+  return out - begin;
+}
+
+void appendEscapedJsonName(fmt::memory_buffer& out, std::string_view name) {
+  const size_t size = out.size();
+  out.resize(size + maxEscapedJsonNameSize(name.size()));
+  const size_t escaped = escapeJsonName(name, out.data() + size);
+  if (escaped != kUnreadableJsonName) {
+    out.resize(size + escaped);
+    return;
+  }
+  // Rare; let the multi-pass functions log the warning.
+  out.resize(size);
+  std::string value{name};
+  sanitizeStrForJSON(value);
+  sanitizeForNonReadableChars(value);
+  out.append(value);
+}
+
+} // namespace KINETO_NAMESPACE
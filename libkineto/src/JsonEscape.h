@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include <fmt/format.h>
+
+namespace KINETO_NAMESPACE {
+
+// Replaces backslashes with forward slashes, since Windows paths cause
+// JSONDecodeErrors, and removes newlines.
+void sanitizeStrForJSON(std::string& value);
+
+// Replaces value with "unknown" if it contains a character that is not
+// printable, logging a warning.
+void sanitizeForNonReadableChars(std::string& value);
+
+// Escapes bare double quotes so an event name can be safely embedded in a
+// JSON string value ("name": "<value>"). Names can contain `"` (e.g.
+// dynamo-generated co_filenames like {"device": "cpu"} surfaced with
+// with_stack=True); an unescaped `"` corrupts the whole trace. Run after
+// sanitizeStrForJSON() so the inserted backslashes aren't rewritten. See
+// pytorch/pytorch#146900.
+void escapeQuotesForJSON(std::string& value);
+
+// Upper bound of the output of escapeJsonName() for a name of size bytes.
+constexpr size_t maxEscapedJsonNameSize(size_t size) {
+  return 2 * size;
+}
+
+// Returned by escapeJsonName() for names that are not readable.
+inline constexpr size_t kUnreadableJsonName = static_cast<size_t>(-1);
+
+// Single-pass equivalent of sanitizeStrForJSON(), sanitizeForNonReadableChars()
+// and escapeQuotesForJSON() applied in that order, without the warning.
+// Writes the escaped name to out, which must hold
+// maxEscapedJsonNameSize(name.size()) bytes, and returns its size. Returns
+// kUnreadableJsonName, leaving out unspecified, if the name has a character
+// that is neither a newline nor printable ASCII (std::isprint() in the "C"
+// locale).
+//
+// Runs of ordinary characters are found 16 or 32 bytes at a time with
+// SSE2, AVX2 or NEON, whichever the build targets, and copied in bulk.
+size_t escapeJsonName(std::string_view name, char* out);
+
+// Appends the escaped name to out, or "unknown" with a warning like
+// sanitizeForNonReadableChars() if it is not readable.
+void appendEscapedJsonName(fmt::memory_buffer& out, std::string_view name);
+
+} // namespace KINETO_NAMESPACE
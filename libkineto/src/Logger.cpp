@@ -14,15 +14,18 @@
 #ifndef USE_GOOGLE_LOG
 
 #include <chrono>
+#include <cstdlib>
 #include <cstring>
 #include <ctime>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
 
 #include <fmt/chrono.h>
 #include <fmt/format.h>
 #include <fmt/ostream.h>
 
+#include "AsyncLogWriter.h"
 #include "ThreadUtil.h"
 
 namespace KINETO_NAMESPACE {
@@ -30,6 +33,42 @@ namespace KINETO_NAMESPACE {
 std::atomic_int Logger::severityLevel_{VERBOSE};
 std::atomic_int Logger::verboseLogLevel_{-1};
 std::atomic<uint64_t> Logger::verboseLogModules_{~0ull};
+std::atomic_bool Logger::asyncLogging_{false};
+
+namespace {
+
+// Set once asynchronous logging is first enabled.
+std::atomic<AsyncLogWriter*> asyncWriter{nullptr};
+
+// Appends "<SEVERITY>:<local time> <pid>:<tid> <file>:<line>] ".
+void appendPrefix(
+    std::string& out,
+    int severity,
+    const std::tm& localTime,
+    int32_t pid,
+    int32_t tid,
+    const char* filePath,
+    int line) {
+  const char* file = std::strrchr(filePath, '/');
+  fmt::format_to(
+      std::back_inserter(out),
+      "{}:{:%Y-%m-%d %H:%M:%S} {}:{} {}:{}] ",
+      toString((LoggerOutputType)severity),
+      localTime,
+      pid,
+      tid,
+      (file ? file + 1 : filePath),
+      line);
+}
+
+std::tm toLocalTime(std::chrono::system_clock::time_point time) {
+  const auto tt = std::chrono::system_clock::to_time_t(time);
+  std::tm tm_result;
+  get_local_time(&tt, &tm_result);
+  return tm_result;
+}
+
+} // namespace
 
 void get_local_time(const time_t* time, struct tm* tm_result) {
 #ifdef _WIN32
@@ -42,22 +81,26 @@ void get_local_time(const time_t* time, struct tm* tm_result) {
 }
 
 Logger::Logger(int severity, int line, const char* filePath, int errnum)
-    : out_(LIBKINETO_DBG_STREAM), errnum_(errnum), messageSeverity_(severity) {
-  buf_ << toString((LoggerOutputType)severity) << ":";
-
-  const auto tt =
-      std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-  std::tm tm_result;
-  get_local_time(&tt, &tm_result);
-  const char* file = std::strrchr(filePath, '/');
-  fmt::print(
-      buf_,
-      "{:%Y-%m-%d %H:%M:%S} {}:{} {}:{}] ",
-      tm_result,
+    : out_(LIBKINETO_DBG_STREAM),
+      errnum_(errnum),
+      messageSeverity_(severity),
+      async_(asyncLogging()),
+      time_(std::chrono::system_clock::now()),
+      filePath_(filePath),
+      line_(line) {
+  if (async_) {
+    return;
+  }
+  std::string prefix;
+  appendPrefix(
+      prefix,
+      severity,
+      toLocalTime(time_),
       processId(false),
       systemThreadId(false),
-      (file ? file + 1 : filePath),
+      filePath,
       line);
+  buf_ << prefix;
 }
 
 Logger::~Logger() {
@@ -68,6 +111,18 @@ Logger::~Logger() {
   }
 #endif
 
+  if (async_) {
+    asyncLogWriter().push(
+        {time_,
+         processId(false),
+         systemThreadId(false),
+         filePath_,
+         line_,
+         messageSeverity_,
+         buf_.str()});
+    return;
+  }
+
   {
     std::lock_guard<std::mutex> guard(loggerObserversMutex());
     for (auto* observer : loggerObservers()) {
@@ -83,6 +138,76 @@ Logger::~Logger() {
   out_ << buf_.str() << std::endl;
 }
 
+AsyncLogWriter& Logger::asyncLogWriter() {
+  // Leaked, like the observers, so that messages can be logged during static
+  // destruction.
+  static AsyncLogWriter* writer = [] {
+    auto* writer = new AsyncLogWriter(&Logger::writeAsync);
+    asyncWriter.store(writer);
+    std::atexit([] { Logger::flush(); });
+    return writer;
+  }();
+  return *writer;
+}
+
+void Logger::writeAsync(std::vector<LogRecord>& records) {
+  std::string out;
+  std::string message;
+  // Records come in bursts, so convert the time once per second.
+  auto second = std::chrono::system_clock::time_point::min();
+  std::tm localTime{};
+  {
+    std::lock_guard<std::mutex> guard(loggerObserversMutex());
+    for (const LogRecord& record : records) {
+      const auto recordSecond =
+          std::chrono::floor<std::chrono::seconds>(record.time);
+      if (recordSecond != second) {
+        second = recordSecond;
+        localTime = toLocalTime(second);
+      }
+      message.clear();
+      appendPrefix(
+          message,
+          record.severity,
+          localTime,
+          record.pid,
+          record.tid,
+          record.file,
+          record.line);
+      message += record.message;
+      for (auto* observer : loggerObservers()) {
+        if (observer) {
+          observer->write(message, (LoggerOutputType)record.severity);
+        }
+      }
+      out += message;
+      out += '\n';
+    }
+  }
+  LIBKINETO_DBG_STREAM << out << std::flush;
+}
+
+void Logger::setAsyncLogging(bool enabled) {
+  if (enabled) {
+    // Start the writer before messages are queued for it.
+    asyncLogWriter();
+  }
+  if (asyncLogging_.exchange(enabled) && !enabled) {
+    flush();
+  }
+}
+
+void Logger::flush() {
+  if (auto* writer = asyncWriter.load()) {
+    writer->flush();
+  }
+}
+
+uint64_t Logger::droppedMessages() {
+  auto* writer = asyncWriter.load();
+  return writer ? writer->dropped() : 0;
+}
+
 void Logger::setVerboseLogModules(const std::vector<std::string>& modules) {
   uint64_t mask = 0;
   if (modules.empty()) {
@@ -104,6 +229,8 @@ void Logger::addLoggerObserver(ILoggerObserver* observer) {
 }
 
 void Logger::removeLoggerObserver(ILoggerObserver* observer) {
+  // Deliver the messages queued for it first.
+  flush();
   std::lock_guard<std::mutex> guard(loggerObserversMutex());
   loggerObservers().erase(observer);
 }
@@ -158,6 +285,8 @@ void Logger::setLoggerObserverOnDemand() {
 }
 
 void Logger::resetLoggerObservers() {
+  // Messages queued before the reset belong to the previous trace.
+  flush();
   std::lock_guard<std::mutex> guard(loggerObserversMutex());
   for (auto observer : loggerObservers()) {
     observer->reset();
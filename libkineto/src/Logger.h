@@ -18,6 +18,7 @@
 
 #define SET_LOG_SEVERITY_LEVEL(level)
 #define SET_LOG_VERBOSITY_LEVEL(level, modules)
+#define SET_LOG_ASYNC(enabled)
 #define LOGGER_OBSERVER_ADD_DEVICE(device)
 #define LOGGER_OBSERVER_ADD_EVENT_COUNT(count)
 #define LOGGER_OBSERVER_SET_TRACE_DURATION_MS(duration)
@@ -39,6 +40,7 @@
 #else // !USE_GOOGLE_LOG
 #include <stdio.h>
 #include <atomic>
+#include <chrono>
 #include <map>
 #include <mutex>
 #include <ostream>
@@ -59,6 +61,9 @@
 namespace KINETO_NAMESPACE {
 void get_local_time(const time_t* time, struct tm* tm_result);
 
+class AsyncLogWriter;
+struct LogRecord;
+
 class Logger {
  public:
   Logger(int severity, int line, const char* filePath, int errnum = 0);
@@ -109,6 +114,22 @@ class Logger {
 
   static void setVerboseLogModules(const std::vector<std::string>& modules);
 
+  // In asynchronous mode, messages are queued on the logging thread and
+  // written to the terminal and the observers by a background thread, which
+  // also formats the prefix with the time and location. Messages logged
+  // faster than they can be written are dropped and counted.
+  static void setAsyncLogging(bool enabled);
+
+  static inline bool asyncLogging() {
+    return asyncLogging_.load(std::memory_order_relaxed);
+  }
+
+  // Writes out the messages queued so far in asynchronous mode.
+  static void flush();
+
+  // Messages dropped in asynchronous mode.
+  static uint64_t droppedMessages();
+
   static inline uint64_t verboseLogModules() {
     return verboseLogModules_;
   }
@@ -152,13 +173,22 @@ class Logger {
       const std::string& reason);
 
  private:
+  static AsyncLogWriter& asyncLogWriter();
+  static void writeAsync(std::vector<LogRecord>& records);
+
   std::stringstream buf_;
   std::ostream& out_;
   int errnum_;
   int messageSeverity_;
+  // Set in asynchronous mode, where the prefix is formatted later.
+  bool async_;
+  std::chrono::system_clock::time_point time_;
+  const char* filePath_;
+  int line_;
   static std::atomic_int severityLevel_;
   static std::atomic_int verboseLogLevel_;
   static std::atomic<uint64_t> verboseLogModules_;
+  static std::atomic_bool asyncLogging_;
   static std::set<ILoggerObserver*>& loggerObservers() {
     static auto* inst = new std::set<ILoggerObserver*>();
     return *inst;
@@ -271,6 +301,8 @@ struct __to_constant__ {
   libkineto::Logger::setVerboseLogLevel(level); \
   libkineto::Logger::setVerboseLogModules(modules)
 
+#define SET_LOG_ASYNC(enabled) libkineto::Logger::setAsyncLogging(enabled)
+
 // Logging the set of devices the trace is collect on.
 #define LOGGER_OBSERVER_ADD_DEVICE(device_count) \
   libkineto::Logger::addLoggerObserverDevice(device_count)
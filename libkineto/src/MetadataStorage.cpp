@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "MetadataStorage.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace libkineto {
+
+namespace {
+
+// Names are stored in fixed-size chunks that never move, so that name() can
+// read them without taking the lock: a chunk is published before any id in
+// it is handed out.
+constexpr uint32_t kChunkBits = 10;
+constexpr uint32_t kChunkSize = 1u << kChunkBits;
+constexpr uint32_t kMaxChunks = 4096;
+
+class KeyTable {
+ public:
+  KeyTable() = default;
+  KeyTable(const KeyTable&) = delete;
+  KeyTable& operator=(const KeyTable&) = delete;
+
+  ~KeyTable() {
+    for (auto& chunk : chunks_) {
+      delete[] chunk.load(std::memory_order_relaxed);
+    }
+  }
+
+  std::optional<uint32_t> find(std::string_view key) const {
+    // Most lookups are for a key this thread has seen recently; those are
+    // answered without the lock.
+    const size_t hash = std::hash<std::string_view>()(key);
+    RecentKey& recent = recentKeys()[hash % kRecentKeys];
+    if (recent.hash == hash && recent.id != kNoId && name(recent.id) == key) {
+      return recent.id;
+    }
+    std::shared_lock<std::shared_mutex> guard(mutex_);
+    if (auto it = ids_.find(key); it != ids_.end()) {
+      recent = {hash, it->second};
+      return it->second;
+    }
+    return std::nullopt;
+  }
+
+  uint32_t intern(std::string_view key) {
+    if (auto id = find(key)) {
+      return *id;
+    }
+    std::unique_lock<std::shared_mutex> guard(mutex_);
+    if (auto it = ids_.find(key); it != ids_.end()) {
+      return it->second;
+    }
+    const uint32_t id = size_;
+    const uint32_t chunkIndex = id >> kChunkBits;
+    if (chunkIndex >= kMaxChunks) {
+      throw std::length_error("Too many distinct metadata keys");
+    }
+    std::string* chunk = chunks_[chunkIndex].load(std::memory_order_relaxed);
+    if (chunk == nullptr) {
+      chunk = new std::string[kChunkSize];
+      chunks_[chunkIndex].store(chunk, std::memory_order_release);
+    }
+    std::string& name = chunk[id & (kChunkSize - 1)];
+    name = key;
+    ids_.emplace(name, id);
+    size_++;
+    return id;
+  }
+
+  std::string_view name(uint32_t id) const {
+    return chunks_[id >> kChunkBits].load(
+        std::memory_order_acquire)[id & (kChunkSize - 1)];
+  }
+
+ private:
+  static constexpr uint32_t kNoId = UINT32_MAX;
+  static constexpr size_t kRecentKeys = 64;
+
+  struct RecentKey {
+    size_t hash{0};
+    uint32_t id{kNoId};
+  };
+
+  // Per-thread cache of recently looked up keys. Ids are never reassigned,
+  // so a cached entry stays correct.
+  static std::array<RecentKey, kRecentKeys>& recentKeys() {
+    thread_local std::array<RecentKey, kRecentKeys> recent;
+    return recent;
+  }
+
+  mutable std::shared_mutex mutex_;
+  // Views into the names in chunks_.
+  std::unordered_map<std::string_view, uint32_t> ids_;
+  std::array<std::atomic<std::string*>, kMaxChunks> chunks_{};
+  uint32_t size_{0};
+};
+
+KeyTable& keyTable() {
+  static KeyTable table;
+  return table;
+}
+
+} // namespace
+
+uint32_t MetadataKeys::intern(std::string_view key) {
+  return keyTable().intern(key);
+}
+
+std::optional<uint32_t> MetadataKeys::find(std::string_view key) {
+  return keyTable().find(key);
+}
+
+std::string_view MetadataKeys::name(uint32_t id) {
+  return keyTable().name(id);
+}
+
+} // namespace libkineto
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace KINETO_NAMESPACE {
+
+// Unbounded multi-producer, single-consumer handoff queue.
+//
+// push() is lock-free: it allocates a node and links it in with a single
+// compare-and-swap, so producers never wait for each other or for the
+// consumer. The consumer takes everything queued so far with drain(), which
+// is one atomic exchange followed by a walk of the detached list. Items are
+// handed to the consumer in the order in which their pushes took effect.
+//
+// Only one thread may call drain() at a time; any thread may push().
+template <class T>
+class MpscQueue {
+ public:
+  MpscQueue() = default;
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+
+  ~MpscQueue() {
+    deleteList(head_.load(std::memory_order_acquire));
+  }
+
+  void push(T value) {
+    Node* node =
+        new Node{std::move(value), head_.load(std::memory_order_relaxed)};
+    while (!head_.compare_exchange_weak(
+        node->next,
+        node,
+        std::memory_order_release,
+        std::memory_order_relaxed)) {
+    }
+  }
+
+  // Calls fn(T&&) for every item pushed before the call, oldest first, and
+  // returns the number of items. Items pushed concurrently with drain() are
+  // left for the next call.
+  template <class Fn>
+  size_t drain(Fn&& fn) {
+    // Pushes link new nodes in front of head_, so the detached list is
+    // newest first; reverse it to hand items out in push order.
+    Node* list = reverse(head_.exchange(nullptr, std::memory_order_acquire));
+    size_t count = 0;
+    while (list != nullptr) {
+      Node* next = list->next;
+      fn(std::move(list->value));
+      delete list;
+      list = next;
+      count++;
+    }
+    return count;
+  }
+
+  // Drops everything queued so far.
+  void clear() {
+    deleteList(head_.exchange(nullptr, std::memory_order_acquire));
+  }
+
+  // Whether the queue was empty at some point during the call.
+  [[nodiscard]] bool empty() const {
+    return head_.load(std::memory_order_relaxed) == nullptr;
+  }
+
+ private:
+  struct Node {
+    T value;
+    Node* next;
+  };
+
+  static Node* reverse(Node* list) {
+    Node* reversed = nullptr;
+    while (list != nullptr) {
+      Node* next = list->next;
+      list->next = reversed;
+      reversed = list;
+      list = next;
+    }
+    return reversed;
+  }
+
+  static void deleteList(Node* list) {
+    while (list != nullptr) {
+      Node* next = list->next;
+      delete list;
+      list = next;
+    }
+  }
+
+  // Most recently pushed node.
+  std::atomic<Node*> head_{nullptr};
+};
+
+} // namespace KINETO_NAMESPACE
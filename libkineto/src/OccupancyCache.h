@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace KINETO_NAMESPACE {
+
+// The parts of a kernel launch that decide how many of its blocks fit on an
+// SM. The grid size does not, so launches of one kernel over differently
+// sized inputs share an entry.
+struct KernelLaunchShape {
+  uint32_t registersPerThread{0};
+  uint32_t staticSharedMemory{0};
+  uint32_t dynamicSharedMemory{0};
+  uint32_t blockSize{0};
+
+  bool operator==(const KernelLaunchShape& other) const = default;
+};
+
+// Per-device cache of occupancy results keyed by launch shape, consulted by
+// computeOccupancyMetrics() in DeviceProperties.cpp.
+//
+// Kernel metadata is rendered at least once per kernel record, and a
+// training loop launches the same few shapes over and over, so the occupancy
+// calculation is almost always a repeat. Each device has its own table and
+// lock; metadata may be rendered from several serialization threads.
+// Entries are never evicted: the number of distinct shapes is bounded by the
+// kernels in the program.
+template <class Result>
+class OccupancyCache {
+ public:
+  explicit OccupancyCache(size_t deviceCount) {
+    devices_.reserve(deviceCount);
+    for (size_t i = 0; i < deviceCount; i++) {
+      devices_.push_back(std::make_unique<Device>());
+    }
+  }
+
+  // Returns the cached result for shape on deviceId, or compute() if there
+  // is none yet. Results for unknown devices are not cached.
+  template <class Compute>
+  Result get(
+      uint32_t deviceId,
+      const KernelLaunchShape& shape,
+      Compute&& compute) {
+    if (deviceId >= devices_.size()) {
+      return compute();
+    }
+    Device& device = *devices_[deviceId];
+    {
+      std::lock_guard<std::mutex> guard(device.mutex);
+      if (auto it = device.results.find(shape); it != device.results.end()) {
+        device.hits++;
+        return it->second;
+      }
+    }
+    Result result = compute();
+    std::lock_guard<std::mutex> guard(device.mutex);
+    device.misses++;
+    device.results.try_emplace(shape, result);
+    return result;
+  }
+
+  [[nodiscard]] int64_t hits() const {
+    return sum(&Device::hits);
+  }
+
+  [[nodiscard]] int64_t misses() const {
+    return sum(&Device::misses);
+  }
+
+  [[nodiscard]] size_t size() const {
+    size_t size = 0;
+    for (const auto& device : devices_) {
+      std::lock_guard<std::mutex> guard(device->mutex);
+      size += device->results.size();
+    }
+    return size;
+  }
+
+ private:
+  struct ShapeHash {
+    size_t operator()(const KernelLaunchShape& shape) const {
+      uint64_t h = shape.registersPerThread;
+      h = h * 0x9e3779b97f4a7c15ULL + shape.staticSharedMemory;
+      h = h * 0x9e3779b97f4a7c15ULL + shape.dynamicSharedMemory;
+      h = h * 0x9e3779b97f4a7c15ULL + shape.blockSize;
+      return static_cast<size_t>(h ^ (h >> 32));
+    }
+  };
+
+  struct Device {
+    mutable std::mutex mutex;
+    std::unordered_map<KernelLaunchShape, Result, ShapeHash> results;
+    int64_t hits{0};
+    int64_t misses{0};
+  };
+
+  int64_t sum(int64_t Device::* counter) const {
+    int64_t total = 0;
+    for (const auto& device : devices_) {
+      std::lock_guard<std::mutex> guard(device->mutex);
+      total += (*device).*counter;
+    }
+    return total;
+  }
+
+  std::vector<std::unique_ptr<Device>> devices_;
+};
+
+} // namespace KINETO_NAMESPACE
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ParallelActivityLogger.h"
+
+#include <algorithm>
+#include <utility>
+
+// TODO(T90238193)
+// @lint-ignore-every CLANGTIDY facebook-hte-RelativeInclude
+#include "ActivityBuffers.h"
+#include "Logger.h"
+
+namespace KINETO_NAMESPACE {
+
+ParallelActivityLogger::ParallelActivityLogger(
+    ActivityLogger& target,
+    WorkerPool& pool)
+    : target_(target), pool_(pool) {}
+
+ParallelActivityLogger::~ParallelActivityLogger() {
+  if (!pending_.empty()) {
+    LOG(WARNING) << "Dropping " << pending_.size()
+                 << " activities that were never flushed";
+  }
+}
+
+void ParallelActivityLogger::render(
+    const PendingActivity* begin,
+    const PendingActivity* end,
+    ActivityLogger& logger) {
+  for (const auto* it = begin; it != end; ++it) {
+    if (it->generic) {
+      logger.handleGenericActivity(
+          static_cast<const GenericTraceActivity&>(*it->activity));
+    } else {
+      logger.handleActivity(*it->activity);
+    }
+  }
+}
+
+void ParallelActivityLogger::flush() {
+  const PendingActivity* data = pending_.data();
+  const size_t count = pending_.size();
+  const int numThreads = pool_.numThreads();
+  size_t pos = 0;
+
+  std::vector<std::unique_ptr<ActivityLogger>> shards;
+  std::vector<ShardTask> tasks;
+  // Each round renders up to one shard per thread and merges them into the
+  // target in order before the next round starts, so at most numThreads
+  // shards are held in memory at a time. Whatever is left over once less
+  // than a full shard remains is rendered on the calling thread.
+  while (numThreads > 1 && count - pos > kActivitiesPerShard) {
+    for (int i = 0; i < numThreads && pos < count; i++) {
+      auto shard = target_.createShard();
+      if (!shard) {
+        break;
+      }
+      const size_t end = std::min(pos + kActivitiesPerShard, count);
+      tasks.push_back({data + pos, data + end, shard.get()});
+      shards.push_back(std::move(shard));
+      pos = end;
+    }
+    if (shards.empty()) {
+      // The target does not support shards.
+      break;
+    }
+    pool_.run(tasks.size(), [&tasks](size_t i) {
+      render(tasks[i].begin, tasks[i].end, *tasks[i].shard);
+    });
+    for (auto& shard : shards) {
+      target_.mergeShard(*shard);
+    }
+    tasks.clear();
+    shards.clear();
+  }
+  render(data + pos, data + count, target_);
+  pending_.clear();
+}
+
+void ParallelActivityLogger::handleDeviceInfo(
+    const DeviceInfo& info,
+    int64_t time) {
+  flush();
+  target_.handleDeviceInfo(info, time);
+}
+
+void ParallelActivityLogger::handleResourceInfo(
+    const ResourceInfo& info,
+    int64_t time) {
+  flush();
+  target_.handleResourceInfo(info, time);
+}
+
+void ParallelActivityLogger::handleOverheadInfo(
+    const OverheadInfo& info,
+    int64_t time) {
+  flush();
+  target_.handleOverheadInfo(info, time);
+}
+
+void ParallelActivityLogger::handleTraceSpan(const TraceSpan& span) {
+  flush();
+  target_.handleTraceSpan(span);
+}
+
+void ParallelActivityLogger::handleTraceStart(
+    const std::unordered_map<std::string, std::string>& metadata,
+    const std::string& device_properties) {
+  flush();
+  target_.handleTraceStart(metadata, device_properties);
+}
+
+void ParallelActivityLogger::handleTraceMetadata(
+    const std::string& key,
+    const std::string& value) {
+  flush();
+  target_.handleTraceMetadata(key, value);
+}
+
+void ParallelActivityLogger::finalizeMemoryTrace(
+    const std::string& url,
+    const Config& config) {
+  flush();
+  target_.finalizeMemoryTrace(url, config);
+}
+
+void ParallelActivityLogger::finalizeTrace(
+    const Config& config,
+    std::unique_ptr<ActivityBuffers> buffers,
+    int64_t endTime) {
+  flush();
+  target_.finalizeTrace(config, std::move(buffers), endTime);
+}
+
+} // namespace KINETO_NAMESPACE
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// TODO(T90238193)
+// @lint-ignore-every CLANGTIDY facebook-hte-RelativeInclude
+#include "WorkerPool.h"
+#include "output_base.h"
+
+namespace KINETO_NAMESPACE {
+
+// Forwards everything to a target logger, except that activities are queued
+// and rendered concurrently into shards of the target (see
+// ActivityLogger::createShard()). Every other call is an ordering barrier:
+// the queued activities are rendered and merged into the target, in the order
+// they were received, before the call is forwarded. The resulting output is
+// the same as if every activity had been sent to the target directly.
+//
+// Queued activities are held by pointer, so they must stay alive and must not
+// be modified until the next barrier or flush().
+//
+// Shards are rendered on the threads of pool, which must outlive the logger
+// and must not run anything else during flush().
+class ParallelActivityLogger : public ActivityLogger {
+ public:
+  // Activities are split into shards of this many activities, and at most
+  // one shard per pool thread is held in memory at a time.
+  static constexpr size_t kActivitiesPerShard = 16 * 1024;
+
+  ParallelActivityLogger(ActivityLogger& target, WorkerPool& pool);
+  ~ParallelActivityLogger() override;
+
+  ParallelActivityLogger(const ParallelActivityLogger&) = delete;
+  ParallelActivityLogger& operator=(const ParallelActivityLogger&) = delete;
+
+  void handleActivity(const ITraceActivity& activity) override {
+    pending_.push_back({&activity, false});
+  }
+
+  void handleGenericActivity(const GenericTraceActivity& activity) override {
+    pending_.push_back({&activity, true});
+  }
+
+  void handleDeviceInfo(const DeviceInfo& info, int64_t time) override;
+  void handleResourceInfo(const ResourceInfo& info, int64_t time) override;
+  void handleOverheadInfo(const OverheadInfo& info, int64_t time) override;
+  void handleTraceSpan(const TraceSpan& span) override;
+
+  void handleTraceStart(
+      const std::unordered_map<std::string, std::string>& metadata,
+      const std::string& device_properties) override;
+
+  void handleTraceMetadata(const std::string& key, const std::string& value)
+      override;
+
+  void finalizeMemoryTrace(const std::string& url, const Config& config)
+      override;
+
+  void finalizeTrace(
+      const Config& config,
+      std::unique_ptr<ActivityBuffers> buffers,
+      int64_t endTime) override;
+
+  // Render all queued activities into the target.
+  void flush();
+
+ private:
+  struct PendingActivity {
+    const ITraceActivity* activity;
+    // Whether it arrived through handleGenericActivity().
+    bool generic;
+  };
+
+  // A range of pending activities to be rendered into a shard.
+  struct ShardTask {
+    const PendingActivity* begin;
+    const PendingActivity* end;
+    ActivityLogger* shard;
+  };
+
+  static void render(
+      const PendingActivity* begin,
+      const PendingActivity* end,
+      ActivityLogger& logger);
+
+  ActivityLogger& target_;
+  WorkerPool& pool_;
+  std::vector<PendingActivity> pending_;
+};
+
+} // namespace KINETO_NAMESPACE
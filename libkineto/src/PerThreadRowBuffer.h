@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ActivityArena.h"
+
+namespace KINETO_NAMESPACE {
+
+// Rows recorded by tracing callbacks on many threads and collected by one
+// consumer thread, such as the records of the ROCm runtime callbacks.
+//
+// Each producer thread appends to its own segment: the row is constructed in
+// the segment's ActivityArena and its pointer appended to a list of
+// fixed-size blocks, then published with a release store of the segment's
+// row count. Appending takes no lock and allocates only when a slab or block
+// fills up. The consumer collects the rows published so far with drain().
+//
+// Rows are owned by the buffer and stay valid, at the same address, until
+// the buffer is destroyed; clear() only forgets them. The number of rows
+// since the last clear() is capped by maxRows(). Threads take their share of
+// it kQuotaRows at a time, so that they do not all update one counter per
+// row; rows may thus be refused when up to kQuotaRows per thread short of
+// the cap, but the cap is never exceeded.
+//
+// Only one thread may call drain() or clear() at a time; any thread may call
+// emplace(). A thread caches the segment of the buffer it last appended to,
+// so appending to several buffers alternately from one thread is slower.
+template <class Base>
+class PerThreadRowBuffer {
+ public:
+  static constexpr size_t kBlockRows = 1024;
+  static constexpr size_t kQuotaRows = 64;
+
+  explicit PerThreadRowBuffer(size_t maxRows) : maxRows_(maxRows) {}
+  PerThreadRowBuffer(const PerThreadRowBuffer&) = delete;
+  PerThreadRowBuffer& operator=(const PerThreadRowBuffer&) = delete;
+
+  void setMaxRows(size_t maxRows) {
+    maxRows_.store(maxRows, std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] size_t maxRows() const {
+    return maxRows_.load(std::memory_order_relaxed);
+  }
+
+  // Rows added since the last clear(), counting quota not used up yet.
+  [[nodiscard]] size_t size() const {
+    return std::min(count_.load(std::memory_order_relaxed), maxRows());
+  }
+
+  // Constructs a T, which derives from Base, in the calling thread's segment.
+  // Returns nullptr without constructing it once the cap is reached.
+  template <class T, class... Args>
+  T* emplace(Args&&... args) {
+    Segment& segment = localSegment();
+    if (!takeQuota(segment)) {
+      return nullptr;
+    }
+    T& row = segment.arena.template emplace<T>(std::forward<Args>(args)...);
+    segment.append(&row);
+    return &row;
+  }
+
+  // Appends the rows published since the last drain() or clear() to rows,
+  // in order for each thread, and returns their number.
+  size_t drain(std::vector<Base*>& rows) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    size_t total = 0;
+    for (const auto& segment : segments_) {
+      total += segment->published.load(std::memory_order_acquire) -
+          segment->consumed;
+    }
+    rows.reserve(rows.size() + total);
+    size_t count = 0;
+    for (const auto& segment : segments_) {
+      count += segment->consume([&rows](Base* row) { rows.push_back(row); });
+    }
+    return count;
+  }
+
+  // Forgets the rows not drained yet and restarts the count for maxRows().
+  void clear() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    for (const auto& segment : segments_) {
+      segment->consume([](Base*) {});
+    }
+    // Quota taken before this is void.
+    generation_.fetch_add(1, std::memory_order_relaxed);
+    count_.store(0, std::memory_order_relaxed);
+  }
+
+ private:
+  struct Block {
+    Base* rows[kBlockRows];
+    // Written before the first row in the next block is published.
+    Block* next{nullptr};
+  };
+
+  struct Segment {
+    Segment() : head(new Block), tail(head), readBlock(head) {}
+    Segment(const Segment&) = delete;
+    Segment& operator=(const Segment&) = delete;
+
+    ~Segment() {
+      while (head != nullptr) {
+        delete std::exchange(head, head->next);
+      }
+    }
+
+    // Producer only.
+    void append(Base* row) {
+      if (tailUsed == kBlockRows) {
+        tail->next = new Block;
+        tail = tail->next;
+        tailUsed = 0;
+      }
+      tail->rows[tailUsed++] = row;
+      published.store(
+          published.load(std::memory_order_relaxed) + 1,
+          std::memory_order_release);
+    }
+
+    // Consumer only. Calls fn for each row published since the last call.
+    template <class Fn>
+    size_t consume(Fn&& fn) {
+      const size_t end = published.load(std::memory_order_acquire);
+      const size_t count = end - consumed;
+      for (; consumed < end; consumed++) {
+        if (readIndex == kBlockRows) {
+          readBlock = readBlock->next;
+          readIndex = 0;
+        }
+        fn(readBlock->rows[readIndex++]);
+      }
+      return count;
+    }
+
+    // Owned by the producer thread.
+    ActivityArena arena;
+    Block* head;
+    Block* tail;
+    size_t tailUsed{0};
+    // Rows the thread may still add in generation quotaGeneration.
+    size_t quota{0};
+    uint64_t quotaGeneration{0};
+    std::atomic<size_t> published{0};
+    // Owned by the consumer.
+    Block* readBlock;
+    size_t readIndex{0};
+    size_t consumed{0};
+  };
+
+  Segment& localSegment() {
+    struct Cache {
+      uint64_t owner{0};
+      Segment* segment{nullptr};
+    };
+    thread_local Cache cache;
+    if (cache.owner != id_) {
+      std::lock_guard<std::mutex> guard(mutex_);
+      auto& segment = segmentByThread_[std::this_thread::get_id()];
+      if (!segment) {
+        segment = segments_.emplace_back(std::make_unique<Segment>()).get();
+      }
+      cache = {id_, segment};
+    }
+    return *cache.segment;
+  }
+
+  bool takeQuota(Segment& segment) {
+    const uint64_t generation = generation_.load(std::memory_order_relaxed);
+    if (segment.quotaGeneration != generation) {
+      segment.quota = 0;
+      segment.quotaGeneration = generation;
+    }
+    if (segment.quota == 0) {
+      const size_t max = maxRows();
+      if (count_.load(std::memory_order_relaxed) >= max) {
+        return false;
+      }
+      const size_t taken =
+          count_.fetch_add(kQuotaRows, std::memory_order_relaxed);
+      if (taken >= max) {
+        return false;
+      }
+      segment.quota = std::min(kQuotaRows, max - taken);
+    }
+    segment.quota--;
+    return true;
+  }
+
+  static uint64_t nextId() {
+    static std::atomic<uint64_t> next{1};
+    return next++;
+  }
+
+  // Identifies this buffer in the per-thread caches.
+  const uint64_t id_{nextId()};
+  std::atomic<size_t> maxRows_;
+  // Rows handed out as quota since the last clear().
+  std::atomic<size_t> count_{0};
+  std::atomic<uint64_t> generation_{0};
+  // Guards segment registration, drain() and clear().
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<Segment>> segments_;
+  std::unordered_map<std::thread::id, Segment*> segmentByThread_;
+};
+
+} // namespace KINETO_NAMESPACE
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace KINETO_NAMESPACE {
+
+// A mergeable streaming quantile sketch, after KLL (Karnin, Lang and
+// Liberty, "Optimal Quantile Approximation in Streams", 2016).
+//
+// Values are kept in levels, where a value at level h stands for 2^h of the
+// values added. When the sketch is full, the lowest full level is sorted and
+// every other value, starting from the first or second at random, moves up a
+// level; the rest are dropped. Level capacities shrink by 2/3 from the top
+// level down, so the sketch holds fewer than 3k values however many were
+// added, and at the default k the rank of a percentile is typically off by
+// less than 1% of the count. Until k values have been added nothing is
+// dropped and the percentiles are exact.
+//
+// T needs operator< and to be copy constructible and move assignable.
+template <class T>
+class QuantileSketch {
+ public:
+  static constexpr size_t kDefaultK = 256;
+
+  explicit QuantileSketch(size_t k = kDefaultK)
+      : k_(std::max<size_t>(k, kMinK)),
+        levels_(1),
+        capacities_{k_},
+        maxRetained_(k_) {}
+
+  void add(T value) {
+    levels_[0].push_back(std::move(value));
+    count_++;
+    if (++retained_ >= maxRetained_) {
+      compress();
+    }
+  }
+
+  // Adds the values of another sketch, as if they had been added here.
+  void merge(const QuantileSketch& other) {
+    while (levels_.size() < other.levels_.size()) {
+      addLevel();
+    }
+    for (size_t h = 0; h < other.levels_.size(); h++) {
+      const auto& from = other.levels_[h];
+      levels_[h].insert(levels_[h].end(), from.begin(), from.end());
+    }
+    count_ += other.count_;
+    retained_ += other.retained_;
+    if (retained_ >= maxRetained_) {
+      compress();
+    }
+  }
+
+  // Number of values added.
+  [[nodiscard]] uint64_t count() const {
+    return count_;
+  }
+
+  // Number of values held.
+  [[nodiscard]] size_t retained() const {
+    return retained_;
+  }
+
+  // True until values have been dropped.
+  [[nodiscard]] bool exact() const {
+    return levels_.size() == 1;
+  }
+
+  // Nearest-rank percentiles: for each p in percents, the value at index
+  // min(n - 1, p * n / 100) of the n values added in sorted order, or the
+  // value held closest after that rank. Empty if nothing was added.
+  [[nodiscard]] std::vector<T> percentiles(
+      const std::vector<int>& percents) const {
+    std::vector<T> result;
+    if (count_ == 0) {
+      return result;
+    }
+    // Values held, sorted, with the number of values added up to each.
+    std::vector<std::pair<const T*, uint64_t>> ranked;
+    ranked.reserve(retained_);
+    for (size_t h = 0; h < levels_.size(); h++) {
+      for (const T& value : levels_[h]) {
+        ranked.emplace_back(&value, uint64_t{1} << h);
+      }
+    }
+    std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) {
+      return *a.first < *b.first;
+    });
+    uint64_t cumulative = 0;
+    for (auto& item : ranked) {
+      cumulative += item.second;
+      item.second = cumulative;
+    }
+    result.reserve(percents.size());
+    for (int p : percents) {
+      const uint64_t rank =
+          std::min(count_ - 1, static_cast<uint64_t>(p) * count_ / 100);
+      auto it = std::upper_bound(
+          ranked.begin(),
+          ranked.end(),
+          rank,
+          [](uint64_t r, const auto& item) { return r < item.second; });
+      result.push_back(*it->first);
+    }
+    return result;
+  }
+
+ private:
+  static constexpr size_t kMinK = 8;
+
+  void addLevel() {
+    levels_.emplace_back();
+    capacities_.resize(levels_.size());
+    maxRetained_ = 0;
+    for (size_t h = 0; h < levels_.size(); h++) {
+      const size_t depth = levels_.size() - h - 1;
+      const double c = std::ceil(k_ * std::pow(2.0 / 3.0, depth));
+      capacities_[h] = std::max<size_t>(2, static_cast<size_t>(c));
+      maxRetained_ += capacities_[h];
+    }
+  }
+
+  // Compacts the lowest full level until the sketch is below capacity.
+  void compress() {
+    while (retained_ >= maxRetained_) {
+      for (size_t h = 0; h < levels_.size(); h++) {
+        if (levels_[h].size() >= capacities_[h]) {
+          if (h + 1 == levels_.size()) {
+            addLevel();
+          }
+          compact(h);
+          break;
+        }
+      }
+    }
+  }
+
+  void compact(size_t h) {
+    auto& level = levels_[h];
+    auto& next = levels_[h + 1];
+    std::sort(level.begin(), level.end());
+    const size_t pairs = level.size() / 2;
+    const size_t offset = rng_() & 1;
+    for (size_t i = 0; i < pairs; i++) {
+      next.push_back(std::move(level[2 * i + offset]));
+    }
+    // An odd value out stays, so the weights add up to the count.
+    if (level.size() % 2 == 1) {
+      level[0] = std::move(level.back());
+      level.erase(level.begin() + 1, level.end());
+    } else {
+      level.clear();
+    }
+    retained_ -= pairs;
+  }
+
+  size_t k_;
+  std::vector<std::vector<T>> levels_;
+  std::vector<size_t> capacities_;
+  size_t maxRetained_;
+  size_t retained_{0};
+  uint64_t count_{0};
+  // Seeded, so that the same values give the same percentiles.
+  std::minstd_rand rng_{1};
+};
+
+} // namespace KINETO_NAMESPACE
@@ -158,8 +158,12 @@ void RocmActivityProfiler::handleRuntimeActivity(
   }
   const ITraceActivity* linked =
       linkedActivity(activity->id, cpuCorrelationMap_);
+  if (!keepActivity(RuntimeActivity<T>(activity, linked))) {
+    return;
+  }
   const auto& runtime_activity =
-      traceBuffers_->addActivityWrapper(RuntimeActivity<T>(activity, linked));
+      traceBuffers_->emplaceActivityWrapper<RuntimeActivity<T>>(
+          activity, linked);
   checkTimestampOrder(&runtime_activity);
   if (outOfRange(runtime_activity)) {
     return;
@@ -172,9 +176,14 @@ inline void RocmActivityProfiler::handleGpuActivity(
     const rocprofAsyncRow* act,
     ActivityLogger* logger) {
   const ITraceActivity* linked = linkedActivity(act->id, cpuCorrelationMap_);
+  // Only records that are kept and in range are copied into the trace buffers.
+  const GpuActivity candidate(act, linked);
+  if (!keepActivity(candidate) || outOfRange(candidate)) {
+    return;
+  }
   const auto& gpu_activity =
-      traceBuffers_->addActivityWrapper(GpuActivity(act, linked));
-  GenericActivityProfiler::handleGpuActivity(gpu_activity, logger);
+      traceBuffers_->emplaceActivityWrapper<GpuActivity>(act, linked);
+  handleKeptGpuActivity(gpu_activity, logger);
 }
 
 void RocmActivityProfiler::handleRocprofActivity(
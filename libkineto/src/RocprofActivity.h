@@ -15,6 +15,7 @@
 #include "MetadataFieldCatalog.h"
 #include "RocprofLogger.h"
 #include "ThreadUtil.h"
+#include "TypedMetadataJson.h"
 
 #include <rocprofiler-sdk/cxx/name_info.hpp>
 #include <rocprofiler-sdk/fwd.h>
@@ -32,9 +33,12 @@ struct TraceSpan;
 // into subclasses of ITraceActivity so that they can all be accessed
 // using the ITraceActivity interface and logged via ActivityLogger.
 
-// Abstract base class, templated on Rocprof activity type
+// Abstract base class, templated on Rocprof activity type.
+// Subclasses render metadataJson() with JsonTypedMetadataVisitor.
 template <class T>
-struct RocprofActivity : public ITraceActivity {
+struct RocprofActivity
+    : public ITraceActivity,
+      public libkineto::internal::TypedMetadataJsonActivity {
   explicit RocprofActivity(const T* activity, const ITraceActivity* linked)
       : activity_(*activity), linked_(linked) {}
   // Our stored timestamps (from rocprof and generated) are in CLOCK_MONOTONIC
@@ -109,6 +109,8 @@ int RocprofActivityApi::processActivities(
 
   int count = 0;
 
+  d->collectRows();
+
   // Process all external correlations pairs
   for (int it = RocLogger::CorrelationDomain::begin;
        it < RocLogger::CorrelationDomain::end;
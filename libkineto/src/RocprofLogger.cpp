@@ -505,25 +505,26 @@ void RocprofLogger::popCorrelationID(CorrelationDomain type) {
 }
 
 void RocprofLogger::clearLogs() {
-  // CuptiActivityProfiler clears this before the output Loggers use the data
-  // for (auto &row : rows_)
-  //  delete row;
+  // Rows are not freed: the activities of the last trace still refer to them.
   rows_.clear();
+  rowBuffer_.clear();
   for (int i = 0; i < CorrelationDomain::size; ++i) {
     externalCorrelations_[i].clear();
   }
 }
 
-void RocprofLogger::insert_row_to_buffer(rocprofBase* row) {
+void RocprofLogger::collectRows() {
+  rowBuffer_.drain(rows_);
+}
+
+template <class T, class... Args>
+void RocprofLogger::insert_row_to_buffer(Args&&... args) {
   RocprofLogger* dis = &singleton();
-  std::lock_guard<std::mutex> lock(dis->rowsMutex_);
-  if (dis->rows_.size() >= dis->maxBufferSize_) {
+  if (!dis->rowBuffer_.template emplace<T>(std::forward<Args>(args)...)) {
     LOG_FIRST_N(WARNING, 10)
-        << "Exceeded max GPU buffer count (" << dis->rows_.size() << " > "
-        << dis->maxBufferSize_ << ") - terminating tracing";
-    return;
+        << "Exceeded max GPU buffer count (" << dis->rowBuffer_.size()
+        << " >= " << dis->rowBuffer_.maxRows() << ") - terminating tracing";
   }
-  dis->rows_.push_back(row);
 }
 
 void RocprofLogger::code_object_callback(
@@ -581,7 +582,7 @@ void RocprofLogger::api_callback(
             ,
             &args);
 
-        rocprofKernelRow* row = new rocprofKernelRow(
+        insert_row_to_buffer<rocprofKernelRow>(
             record.correlation_id.internal,
             record.kind,
             record.operation,
@@ -599,7 +600,6 @@ void RocprofLogger::api_callback(
             args.gridSize.z,
             args.groupSize,
             args.stream);
-        insert_row_to_buffer(row);
 
       }
       // Copy Records
@@ -612,7 +612,7 @@ void RocprofLogger::api_callback(
             ,
             &args);
 
-        rocprofCopyRow* row = new rocprofCopyRow(
+        insert_row_to_buffer<rocprofCopyRow>(
             record.correlation_id.internal,
             record.kind,
             record.operation,
@@ -625,7 +625,6 @@ void RocprofLogger::api_callback(
             args.size,
             args.copyKind,
             args.stream);
-        insert_row_to_buffer(row);
       }
       // Malloc Records
       else if (isMallocApi(record.operation)) {
@@ -637,7 +636,7 @@ void RocprofLogger::api_callback(
             1 /*max_deref*/
             ,
             &args);
-        rocprofMallocRow* row = new rocprofMallocRow(
+        insert_row_to_buffer<rocprofMallocRow>(
             record.correlation_id.internal,
             record.kind,
             record.operation,
@@ -647,11 +646,10 @@ void RocprofLogger::api_callback(
             endTime,
             args.ptr,
             args.size);
-        insert_row_to_buffer(row);
       }
       // Default Records
       else {
-        rocprofRow* row = new rocprofRow(
+        insert_row_to_buffer<rocprofRow>(
             record.correlation_id.internal,
             record.kind,
             record.operation,
@@ -659,7 +657,6 @@ void RocprofLogger::api_callback(
             systemThreadId(),
             startTime,
             endTime);
-        insert_row_to_buffer(row);
       }
       // External correlation
       static RocprofLogger* dis = &singleton();
@@ -707,7 +704,7 @@ void RocprofLogger::buffer_callback(
             ? kernel_it->second
             : "<unknown kernel>";
 
-        rocprofAsyncRow* row = new rocprofAsyncRow(
+        insert_row_to_buffer<rocprofAsyncRow>(
             record.correlation_id.internal,
             record.kind,
             record.operation,
@@ -717,7 +714,6 @@ void RocprofLogger::buffer_callback(
             record.start_timestamp,
             record.end_timestamp,
             kernel_name);
-        insert_row_to_buffer(row);
       } else if (header->kind == ROCPROFILER_BUFFER_TRACING_MEMORY_COPY) {
         auto& record =
             *(static_cast<rocprofiler_buffer_tracing_memory_copy_record_t*>(
@@ -730,7 +726,7 @@ void RocprofLogger::buffer_callback(
             ? agent_it->second.logical_node_type_id
             : -1;
 
-        rocprofAsyncRow* row = new rocprofAsyncRow(
+        insert_row_to_buffer<rocprofAsyncRow>(
             record.correlation_id.internal,
             record.kind,
             record.operation,
@@ -740,7 +736,6 @@ void RocprofLogger::buffer_callback(
             record.start_timestamp,
             record.end_timestamp,
             "");
-        insert_row_to_buffer(row);
       }
     }
   }
@@ -769,9 +764,7 @@ std::string RocprofLogger::opString(
 }
 
 void RocprofLogger::setMaxEvents(uint32_t maxBufferSize) {
-  RocprofLogger* dis = &singleton();
-  std::lock_guard<std::mutex> lock(dis->rowsMutex_);
-  maxBufferSize_ = maxBufferSize;
+  rowBuffer_.setMaxRows(maxBufferSize);
 }
 
 void RocprofLogger::ensureRegistered() {
@@ -22,6 +22,7 @@
 
 #include <rocprofiler-sdk/registration.h>
 
+#include "PerThreadRowBuffer.h"
 #include "RocLogger.h"
 
 class RocprofLogger {
@@ -60,7 +61,10 @@ class RocprofLogger {
   bool registered_{false};
   void endTracing();
 
-  static void insert_row_to_buffer(rocprofBase* row);
+  template <class T, class... Args>
+  static void insert_row_to_buffer(Args&&... args);
+  // Moves the rows recorded so far into rows_.
+  void collectRows();
 
   //
   static void api_callback(
@@ -79,10 +83,11 @@ class RocprofLogger {
       rocprofiler_user_data_t* user_data,
       void* callback_data);
 
-  // Api callback data
-  uint32_t maxBufferSize_{5000000}; // 5M GPU runtime/kernel events.
+  // Api callback data. Each callback thread appends to its own segment;
+  // rows are collected into rows_ when the activities are processed.
+  KINETO_NAMESPACE::PerThreadRowBuffer<rocprofBase> rowBuffer_{
+      5000000}; // 5M GPU runtime/kernel events.
   std::vector<rocprofBase*> rows_;
-  std::mutex rowsMutex_;
 
   // This vector collects pairs of correlationId and their respective
   // externalCorrelationId for each CorrelationDomain. This will be used
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+
+namespace KINETO_NAMESPACE {
+
+// The time seen by the profiler run loop, and how it waits for a deadline.
+// Tests substitute a fake clock to drive the loop through a trace without
+// waiting in real time.
+class RunLoopClock {
+ public:
+  using time_point = std::chrono::time_point<std::chrono::system_clock>;
+
+  virtual ~RunLoopClock() = default;
+
+  static RunLoopClock& system() {
+    static RunLoopClock clock;
+    return clock;
+  }
+
+  [[nodiscard]] virtual time_point now() const {
+    return std::chrono::system_clock::now();
+  }
+
+  // Blocks until cv is notified or the clock reaches deadline. May return
+  // early; callers check their condition again.
+  virtual void waitUntil(
+      std::condition_variable& cv,
+      std::unique_lock<std::mutex>& lock,
+      time_point deadline) {
+    if (deadline == time_point::max()) {
+      cv.wait(lock);
+    } else {
+      cv.wait_until(lock, deadline);
+    }
+  }
+};
+
+// Puts a run loop to sleep until there is something to do: until another
+// thread calls wake(), or until the next deadline of the loop, whichever
+// comes first. A loop with nothing to do waits for kNever and does not wake
+// up at all. A wake() while the loop is busy is not lost, but makes its next
+// wait return at once.
+class RunLoopWaker {
+ public:
+  using time_point = RunLoopClock::time_point;
+
+  static constexpr time_point kNever = time_point::max();
+
+  explicit RunLoopWaker(RunLoopClock& clock = RunLoopClock::system())
+      : clock_(clock) {}
+
+  void wake() {
+    {
+      std::scoped_lock lock(mutex_);
+      woken_ = true;
+    }
+    cv_.notify_all();
+  }
+
+  // Returns true if woken by wake(), false at the deadline.
+  bool waitUntil(time_point deadline) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!woken_ && clock_.now() < deadline) {
+      clock_.waitUntil(cv_, lock, deadline);
+    }
+    wakeups_++;
+    return std::exchange(woken_, false);
+  }
+
+  // Number of times waitUntil() has returned.
+  [[nodiscard]] uint64_t wakeups() const {
+    std::scoped_lock lock(mutex_);
+    return wakeups_;
+  }
+
+ private:
+  RunLoopClock& clock_;
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  bool woken_{false};
+  uint64_t wakeups_{0};
+};
+
+} // namespace KINETO_NAMESPACE
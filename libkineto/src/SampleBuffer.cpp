@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SampleBuffer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+#include <utility>
+
+namespace KINETO_NAMESPACE {
+
+namespace {
+
+constexpr size_t kMinCapacity = 16;
+
+} // namespace
+
+void SampleBuffer::push(
+    Timestamp timestamp,
+    const std::vector<int64_t>& values) {
+  const int instances = static_cast<int>(values.size());
+  if (empty() && instances != instances_) {
+    reallocate(std::max(capacity_, kMinCapacity), instances);
+  }
+  assert(instances == instances_);
+  if (size_ == capacity_) {
+    reallocate(std::max(capacity_ * 2, kMinCapacity), instances_);
+  }
+  const size_t s = slot(size_);
+  timestamps_[s] = timestamp;
+  for (int i = 0; i < instances_; i++) {
+    values_[i * capacity_ + s] = values[i];
+  }
+  size_++;
+}
+
+void SampleBuffer::popFront(size_t count) {
+  count = std::min(count, size_);
+  head_ = slot(count);
+  size_ -= count;
+}
+
+int64_t SampleBuffer::sum(int instance, size_t begin, size_t count) const {
+  if (count == 0) {
+    return 0;
+  }
+  const int64_t* column = values_.data() + instance * capacity_;
+  const size_t first = slot(begin);
+  // The range wraps around at most once.
+  const size_t head = std::min(count, capacity_ - first);
+  const int64_t total =
+      std::accumulate(column + first, column + first + head, int64_t{0});
+  return std::accumulate(column, column + (count - head), total);
+}
+
+// Moves the samples to the start of new columns.
+void SampleBuffer::reallocate(size_t capacity, int instances) {
+  std::vector<Timestamp> timestamps(capacity);
+  std::vector<int64_t> values(capacity * instances);
+  if (instances == instances_) {
+    for (size_t j = 0; j < size_; j++) {
+      timestamps[j] = timestamp(j);
+    }
+    for (int i = 0; i < instances; i++) {
+      for (size_t j = 0; j < size_; j++) {
+        values[i * capacity + j] = value(j, i);
+      }
+    }
+  } else {
+    size_ = 0;
+  }
+  timestamps_ = std::move(timestamps);
+  values_ = std::move(values);
+  capacity_ = capacity;
+  instances_ = instances;
+  head_ = 0;
+}
+
+} // namespace KINETO_NAMESPACE
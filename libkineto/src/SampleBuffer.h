@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace KINETO_NAMESPACE {
+
+// Samples of a counter with a value per domain instance, e.g. per SM, in a
+// ring buffer of columns. The values of each instance are contiguous, so a
+// sum over a range of samples for one instance reads sequential memory, and
+// erasing the oldest samples only moves the head. The buffer grows to the
+// most samples held at once and keeps its capacity when samples are erased,
+// so steady collection does not allocate.
+class SampleBuffer {
+ public:
+  using Timestamp = std::chrono::time_point<std::chrono::system_clock>;
+
+  // Appends a sample. All samples in the buffer have the same number of
+  // values, set by the first sample added to an empty buffer.
+  void push(Timestamp timestamp, const std::vector<int64_t>& values);
+
+  // Erases the oldest count samples, or all of them if there are fewer.
+  void popFront(size_t count);
+
+  void clear() {
+    head_ = 0;
+    size_ = 0;
+  }
+
+  [[nodiscard]] size_t size() const {
+    return size_;
+  }
+
+  [[nodiscard]] bool empty() const {
+    return size_ == 0;
+  }
+
+  [[nodiscard]] size_t capacity() const {
+    return capacity_;
+  }
+
+  [[nodiscard]] int instanceCount() const {
+    return instances_;
+  }
+
+  // Sample index 0 is the oldest.
+  [[nodiscard]] Timestamp timestamp(size_t index) const {
+    return timestamps_[slot(index)];
+  }
+
+  [[nodiscard]] int64_t value(size_t index, int instance) const {
+    return values_[instance * capacity_ + slot(index)];
+  }
+
+  // Sum of the values of an instance in count samples from index begin.
+  [[nodiscard]] int64_t sum(int instance, size_t begin, size_t count) const;
+
+ private:
+  // Capacity is a power of two.
+  [[nodiscard]] size_t slot(size_t index) const {
+    return (head_ + index) & (capacity_ - 1);
+  }
+
+  void reallocate(size_t capacity, int instances);
+
+  int instances_{0};
+  size_t capacity_{0};
+  size_t head_{0};
+  size_t size_{0};
+  std::vector<Timestamp> timestamps_;
+  // capacity_ slots per instance, one instance after the other.
+  std::vector<int64_t> values_;
+};
+
+} // namespace KINETO_NAMESPACE
@@ -9,12 +9,15 @@
 #include "SyncActivityProfilerHandler.h"
 
 #include <chrono>
+#include <exception>
+#include <utility>
 
 #include "ActivityProfilerController.h"
 #include "ActivityTrace.h"
 #include "Config.h"
 #include "GenericActivityProfiler.h"
 #include "Logger.h"
+#include "ThreadUtil.h"
 #include "libkineto.h"
 #include "output_membuf.h"
 
@@ -26,7 +29,12 @@ SyncActivityProfilerHandler::SyncActivityProfilerHandler(
     GenericActivityProfiler& profiler)
     : profiler_(profiler) {}
 
+SyncActivityProfilerHandler::~SyncActivityProfilerHandler() {
+  ensureProcessTraceDone();
+}
+
 void SyncActivityProfilerHandler::prepareTrace(const Config& config) {
+  ensureProcessTraceDone();
   auto now = std::chrono::system_clock::now();
   active_ = true;
 
@@ -42,9 +50,44 @@ void SyncActivityProfilerHandler::startTrace() {
 
 std::unique_ptr<ActivityTraceInterface> SyncActivityProfilerHandler::
     stopTrace() {
+  ensureProcessTraceDone();
+  stopCollection();
+  return processTrace();
+}
+
+std::future<std::unique_ptr<ActivityTraceInterface>>
+SyncActivityProfilerHandler::stopTraceAsync() {
+  ensureProcessTraceDone();
+  stopCollection();
+  std::promise<std::unique_ptr<ActivityTraceInterface>> trace;
+  auto future = trace.get_future();
+  processTraceThread_ = std::make_unique<std::thread>(
+      [this, trace = std::move(trace)]() mutable {
+        setThreadName("Kineto Trace Processing");
+        try {
+          trace.set_value(processTrace());
+        } catch (...) {
+          trace.set_exception(std::current_exception());
+        }
+      });
+  return future;
+}
+
+void SyncActivityProfilerHandler::ensureProcessTraceDone() {
+  if (processTraceThread_ && processTraceThread_->joinable()) {
+    processTraceThread_->join();
+    processTraceThread_.reset(nullptr);
+  }
+}
+
+void SyncActivityProfilerHandler::stopCollection() {
   profiler_.stopTrace(std::chrono::system_clock::now());
   USDT_EMIT_STOP_TRACE();
   UST_LOGGER_MARK_COMPLETED(kCollectionStage);
+}
+
+std::unique_ptr<ActivityTraceInterface> SyncActivityProfilerHandler::
+    processTrace() {
   auto logger = std::make_unique<MemoryTraceLogger>(profiler_.config());
   profiler_.processTrace(*logger);
   // Will follow up with another patch for logging URLs when ActivityTrace
@@ -57,6 +100,8 @@ std::unique_ptr<ActivityTraceInterface> SyncActivityProfilerHandler::
 }
 
 void SyncActivityProfilerHandler::cancel() {
+  // A trace being processed is already complete, and is not cancelled.
+  ensureProcessTraceDone();
   if (!active_) {
     return;
   }
@@ -9,7 +9,9 @@
 #pragma once
 
 #include <atomic>
+#include <future>
 #include <memory>
+#include <thread>
 
 #include "ActivityTraceInterface.h"
 #include "GenericActivityProfiler.h"
@@ -27,20 +29,32 @@ class SyncActivityProfilerHandler {
   SyncActivityProfilerHandler(SyncActivityProfilerHandler&&) = delete;
   SyncActivityProfilerHandler& operator=(SyncActivityProfilerHandler&&) =
       delete;
-  ~SyncActivityProfilerHandler() = default;
+  ~SyncActivityProfilerHandler();
 
   void prepareTrace(const Config& config);
   void toggleCollectionDynamic(const bool enable);
   void startTrace();
   std::unique_ptr<ActivityTraceInterface> stopTrace();
+  // Stops collection and returns at once, processing the trace on a
+  // background thread. The trace is processed in the profiler, so the
+  // handler stays active until the future is ready, and the next
+  // prepareTrace() or cancel() waits for it.
+  std::future<std::unique_ptr<ActivityTraceInterface>> stopTraceAsync();
   void cancel();
 
+  // Waits for the trace being processed after stopTraceAsync(), if any.
+  void ensureProcessTraceDone();
+
   [[nodiscard]] bool isSyncActive() const {
     return active_;
   }
 
  private:
+  void stopCollection();
+  std::unique_ptr<ActivityTraceInterface> processTrace();
+
   GenericActivityProfiler& profiler_;
   std::atomic<bool> active_{false};
+  std::unique_ptr<std::thread> processTraceThread_{nullptr};
 };
 } // namespace KINETO_NAMESPACE
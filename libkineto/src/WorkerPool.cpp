@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+namespace KINETO_NAMESPACE {
+
+WorkerPool::WorkerPool(int numThreads)
+    : numThreads_(std::max(numThreads, 1)) {}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    stop_ = true;
+  }
+  workReady_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void WorkerPool::workerLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    workReady_.wait(lock, [this] { return stop_ || next_ < count_; });
+    if (stop_) {
+      return;
+    }
+    const size_t index = next_++;
+    const auto& task = *task_;
+    lock.unlock();
+    task(index);
+    lock.lock();
+    if (--unfinished_ == 0) {
+      workDone_.notify_one();
+    }
+  }
+}
+
+void WorkerPool::run(size_t count, const std::function<void(size_t)>& task) {
+  if (numThreads_ == 1 || count <= 1) {
+    for (size_t i = 0; i < count; i++) {
+      task(i);
+    }
+    return;
+  }
+  if (workers_.empty()) {
+    workers_.reserve(numThreads_);
+    for (int i = 0; i < numThreads_; i++) {
+      workers_.emplace_back(&WorkerPool::workerLoop, this);
+    }
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  task_ = &task;
+  count_ = count;
+  next_ = 0;
+  unfinished_ = count;
+  workReady_.notify_all();
+  workDone_.wait(lock, [this] { return unfinished_ == 0; });
+  task_ = nullptr;
+  count_ = 0;
+  next_ = 0;
+}
+
+} // namespace KINETO_NAMESPACE
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace KINETO_NAMESPACE {
+
+// A fixed set of threads for the data-parallel passes of trace processing.
+// The threads are started by the first run() that needs them, and are kept
+// until the pool is destroyed, so that each pass does not pay for starting
+// and joining threads.
+class WorkerPool {
+ public:
+  explicit WorkerPool(int numThreads);
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  [[nodiscard]] int numThreads() const {
+    return numThreads_;
+  }
+
+  // Calls task(i) for each i in [0, count), and returns once all the calls
+  // are done. Tasks are handed out one at a time, in order, so uneven tasks
+  // are balanced across the threads. With a single thread or a single task,
+  // everything runs on the calling thread. Only one run() at a time.
+  void run(size_t count, const std::function<void(size_t)>& task);
+
+ private:
+  void workerLoop();
+
+  const int numThreads_;
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable workReady_;
+  std::condition_variable workDone_;
+  // Guarded by mutex_.
+  const std::function<void(size_t)>* task_{nullptr};
+  size_t count_{0};
+  size_t next_{0};
+  size_t unfinished_{0};
+  bool stop_{false};
+};
+
+} // namespace KINETO_NAMESPACE
@@ -139,6 +139,11 @@ void libkineto_init(bool cpuOnly, [[maybe_unused]] bool logOnError) {
     static_assert(static_cast<int>(VERBOSE) == 0);
     SET_LOG_SEVERITY_LEVEL(atoi(logLevelEnv));
   }
+  // Write log messages from a background thread.
+  const char* asyncLogEnv = getenv("KINETO_ASYNC_LOG");
+  if (asyncLogEnv && atoi(asyncLogEnv) != 0) {
+    SET_LOG_ASYNC(true);
+  }
 
   // Factory to connect to open source daemon if present
 #if __linux__
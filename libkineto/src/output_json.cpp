@@ -8,16 +8,21 @@
 
 #include "output_json.h"
 
+#include <fmt/compile.h>
 #include <fmt/format.h>
-#include <fmt/ostream.h>
 #include <algorithm>
+#include <cstdio>
 #include <ctime>
-#include <fstream>
 #include <iterator>
 #include <string_view>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
 #include "Config.h"
 #include "EnvMetadata.h"
+#include "JsonEscape.h"
 #include "TraceSpan.h"
+#include "TypedMetadataJson.h"
 
 #include "Logger.h"
 
@@ -28,6 +33,10 @@ constexpr int kSchemaVersion = 1;
 constexpr char kFlowStart = 's';
 constexpr char kFlowEnd = 'f';
 
+// Formatted events accumulate in memory until at least this many bytes are
+// pending, then go to the trace file in a single write.
+constexpr size_t kFlushThresholdBytes = 4 * 1024 * 1024;
+
 // CPU op name that is used to store collectives metadata
 // TODO: share the same string across c10d, profiler and libkineto
 constexpr std::string_view kParamCommsCallName = "record_param_comms";
@@ -68,48 +77,6 @@ constexpr std::string_view kDefaultLogFileFmt =
 constexpr std::string_view kDefaultLogFileFmt = "libkineto_activities_{}.json";
 #endif
 
-void sanitizeStrForJSON(std::string& value) {
-  // Replace all backslashes with forward slash because Windows paths causing
-  // JSONDecodeError.
-  std::ranges::replace(value, '\\', '/');
-  // Remove all new line characters
-  std::erase(value, '\n');
-}
-
-// Escape bare double quotes so an event name can be safely embedded in a JSON
-// string value ("name": "<value>"). Names can contain `"` (e.g.
-// dynamo-generated co_filenames like {"device": "cpu"} surfaced with
-// with_stack=True); an unescaped `"` corrupts the whole trace. Run after
-// sanitizeStrForJSON() so the inserted backslashes aren't rewritten. See
-// pytorch/pytorch#146900.
-void escapeQuotesForJSON(std::string& value) {
-  for (size_t pos = value.find('"'); pos != std::string::npos;
-       pos = value.find('"', pos + 2)) {
-    value.insert(pos, 1, '\\');
-  }
-}
-
-std::string string2hex(const std::string& str) {
-  std::string out;
-  out.reserve(str.size() * 2);
-  for (uint8_t c : str) {
-    // “:02x” -> two‐digit, zero‐padded, lowercase hex
-    fmt::format_to(std::back_inserter(out), "{:02x}", c);
-  }
-  return out;
-}
-
-void sanitizeForNonReadableChars(std::string& value) {
-  for (auto& c : value) {
-    if (!std::isprint(c)) {
-      LOG(WARNING) << "Non JSON compliant character found in string: 0x"
-                   << string2hex(value) << " Replacing with 'unknown'";
-      value = "unknown";
-      break;
-    }
-  }
-}
-
 inline int64_t sanitizeTid(int64_t tid) {
   // Convert all negative tids to its positive value. Create a specific case
   // for INT64_MIN so it is obvious how it is being handled.
@@ -119,16 +86,38 @@ inline int64_t sanitizeTid(int64_t tid) {
   return std::abs(tid);
 }
 
-// Format nanosecond timestamp as "us.fractional" for Chrome Trace JSON.
-std::string fmtTs(int64_t time_ns) {
-  return fmt::format("{}.{:03}", time_ns / 1000, time_ns % 1000);
-}
-
 bool isWhitespace(std::string_view s) {
   return std::ranges::all_of(
       s, [](unsigned char c) { return std::isspace(c); });
 }
 
+// Writes blocks to the trace file unchanged.
+class PlainTraceFileWriter : public TraceFileWriter {
+ public:
+  void open(std::FILE* file) override {
+    file_ = file;
+  }
+
+  bool write(std::string_view block) override {
+    return std::fwrite(block.data(), 1, block.size(), file_) == block.size();
+  }
+
+  bool close() override {
+    return true;
+  }
+
+ private:
+  std::FILE* file_{nullptr};
+};
+
+// Whether op's metadataJson() is exactly the JSON rendering of the fields it
+// visits. Subclasses of GenericTraceActivity may override metadataJson(), so
+// only the exact type qualifies.
+bool metadataJsonIsTyped(const ITraceActivity& op) {
+  return typeid(op) == typeid(GenericTraceActivity) ||
+      dynamic_cast<const internal::TypedMetadataJsonActivity*>(&op) != nullptr;
+}
+
 } // namespace
 
 ChromeTraceBaseTime& ChromeTraceBaseTime::singleton() {
@@ -152,20 +141,34 @@ int64_t transToRelativeTime(int64_t time) {
 }
 
 // Internal helper for building the "args" JSON object content.
-// Handles comma separation automatically.
+// Handles comma separation automatically. The builder renders into a
+// caller-owned scratch buffer so that consecutive events reuse its capacity.
 class ArgsBuilder {
  public:
+  explicit ArgsBuilder(fmt::memory_buffer& buf) : buf_(buf) {
+    buf_.clear();
+  }
+
   // Add a key with a pre-formatted value (number, boolean, already-quoted
   // string, JSON array/object).
   void addRaw(std::string_view key, std::string_view value) {
     appendComma();
-    fmt::format_to(std::back_inserter(buf_), R"("{}": {})", key, value);
+    fmt::format_to(fmt::appender(buf_), FMT_COMPILE(R"("{}": {})"), key, value);
+  }
+
+  // Add a key with a numeric value, formatted in place.
+  template <typename T>
+    requires std::is_arithmetic_v<T>
+  void addNumber(std::string_view key, T value) {
+    appendComma();
+    fmt::format_to(fmt::appender(buf_), FMT_COMPILE(R"("{}": {})"), key, value);
   }
 
   // Add a key with a string value (will be JSON-quoted).
   void addQuoted(std::string_view key, std::string_view value) {
     appendComma();
-    fmt::format_to(std::back_inserter(buf_), R"("{}": "{}")", key, value);
+    fmt::format_to(
+        fmt::appender(buf_), FMT_COMPILE(R"("{}": "{}")"), key, value);
   }
 
   // Append a pre-formatted JSON fragment (e.g., from metadataJson()).
@@ -179,171 +182,230 @@ class ArgsBuilder {
     buf_.append(json_fragment);
   }
 
+  // Append op's metadata, as appendFragment(op.metadataJson()) would, after
+  // sanitizeStrForJSON() if sanitize is set. Typed metadata is written
+  // straight into the buffer.
+  void appendMetadata(const ITraceActivity& op, bool sanitize) {
+    if (metadataJsonIsTyped(op)) {
+      if (sanitize) {
+        internal::JsonTypedMetadataWriter<fmt::memory_buffer, true> writer(
+            buf_, /*leadingComma=*/!empty());
+        op.visitTypedMetadata(writer);
+      } else {
+        internal::JsonTypedMetadataWriter<fmt::memory_buffer> writer(
+            buf_, /*leadingComma=*/!empty());
+        op.visitTypedMetadata(writer);
+      }
+      return;
+    }
+    std::string json = op.metadataJson();
+    if (sanitize) {
+      sanitizeStrForJSON(json);
+    }
+    appendFragment(json);
+  }
+
   [[nodiscard]] std::string_view str() const {
-    return buf_;
+    return {buf_.data(), buf_.size()};
   }
 
   [[nodiscard]] bool empty() const {
-    return buf_.empty();
+    return buf_.size() == 0;
   }
 
-  // Return the full "args" JSON field (e.g., ', "args": { ... }'), or an
-  // empty string if no args were added.
-  [[nodiscard]] std::string renderField() const {
-    if (buf_.empty()) {
-      return {};
+  // Append the full "args" JSON field (e.g., ', "args": { ... }') to out, or
+  // nothing if no args were added.
+  void appendField(fmt::memory_buffer& out) const {
+    if (empty()) {
+      return;
     }
-    return fmt::format(
-        R"JSON(,
+    fmt::format_to(
+        fmt::appender(out),
+        FMT_COMPILE(R"JSON(,
     "args": {{
       {}
-    }})JSON",
-        buf_);
+    }})JSON"),
+        str());
   }
 
  private:
   void appendComma() {
-    if (!buf_.empty()) {
-      buf_.append(",");
+    if (!empty()) {
+      buf_.push_back(',');
     }
   }
-  std::string buf_;
+  fmt::memory_buffer& buf_;
 };
 
-void ChromeTraceLogger::writeMetadataEvent(
+namespace {
+
+// Per-kind event formatters. Id is either std::string_view (pre-formatted,
+// possibly quoted, pid/tid) or int64_t. Timestamps are nanoseconds rendered
+// as "us.fractional".
+
+template <typename Id>
+void formatMetadataEvent(
+    fmt::memory_buffer& out,
     std::string_view name,
     int64_t ts,
-    std::string_view pid,
-    std::string_view tid,
+    Id pid,
+    Id tid,
     std::string_view arg_key,
     std::string_view arg_value) {
   // clang-format off
-  fmt::print(traceOf_, R"JSON(
+  fmt::format_to(fmt::appender(out), FMT_COMPILE(R"JSON(
   {{
     "ph": "M",
     "name": "{}",
-    "ts": {},
+    "ts": {}.{:03},
     "pid": {},
     "tid": {},
     "args": {{
       "{}": {}
     }}
-  }},)JSON",
-      name, fmtTs(ts), pid, tid, arg_key, arg_value);
+  }},)JSON"),
+      name, ts / 1000, ts % 1000, pid, tid, arg_key, arg_value);
   // clang-format on
 }
 
-void ChromeTraceLogger::writeCompleteEvent(
+template <typename Id>
+void formatCompleteEvent(
+    fmt::memory_buffer& out,
     std::string_view cat,
     std::string_view name,
-    std::string_view pid,
-    std::string_view tid,
+    Id pid,
+    Id tid,
     int64_t ts,
     int64_t dur,
     const ArgsBuilder& args) {
   // clang-format off
-  fmt::print(traceOf_, R"JSON(
+  fmt::format_to(fmt::appender(out), FMT_COMPILE(R"JSON(
   {{
     "ph": "X",
     "cat": "{}",
     "name": "{}",
     "pid": {},
     "tid": {},
-    "ts": {},
-    "dur": {}
-    {}
-  }},)JSON",
-      cat, name, pid, tid, fmtTs(ts), fmtTs(dur), args.renderField());
+    "ts": {}.{:03},
+    "dur": {}.{:03}
+    )JSON"),
+      cat, name, pid, tid, ts / 1000, ts % 1000, dur / 1000, dur % 1000);
   // clang-format on
+  args.appendField(out);
+  fmt::format_to(fmt::appender(out), FMT_COMPILE("\n  }},"));
 }
 
-void ChromeTraceLogger::writeInstantEvent(
+template <typename Id>
+void formatInstantEvent(
+    fmt::memory_buffer& out,
     std::string_view cat,
     std::string_view name,
     std::string_view scope,
-    std::string_view pid,
-    std::string_view tid,
+    Id pid,
+    Id tid,
     int64_t ts,
     const ArgsBuilder& args,
     bool finalEvent) {
-  std::string cat_str;
+  fmt::format_to(fmt::appender(out), FMT_COMPILE(R"JSON(
+  {{
+    "ph": "i",
+    )JSON"));
   if (!cat.empty()) {
-    cat_str = fmt::format(
-        R"JSON(
-    "cat": "{}",)JSON",
+    fmt::format_to(
+        fmt::appender(out),
+        FMT_COMPILE(R"JSON(
+    "cat": "{}",)JSON"),
         cat);
   }
-  const char* trailing = finalEvent ? "" : ",";
   // clang-format off
-  fmt::print(traceOf_, R"JSON(
-  {{
-    "ph": "i",
-    {}
+  fmt::format_to(fmt::appender(out), FMT_COMPILE(R"JSON(
     "s": "{}",
     "name": "{}",
     "pid": {},
     "tid": {},
-    "ts": {}
-    {}
-  }}{})JSON",
-      cat_str, scope, name, pid, tid, fmtTs(ts), args.renderField(), trailing);
+    "ts": {}.{:03}
+    )JSON"),
+      scope, name, pid, tid, ts / 1000, ts % 1000);
   // clang-format on
+  args.appendField(out);
+  if (finalEvent) {
+    fmt::format_to(fmt::appender(out), FMT_COMPILE("\n  }}"));
+  } else {
+    fmt::format_to(fmt::appender(out), FMT_COMPILE("\n  }},"));
+  }
 }
 
-void ChromeTraceLogger::writeCounterEvent(
+template <typename Id>
+void formatCounterEvent(
+    fmt::memory_buffer& out,
     std::string_view cat,
     std::string_view name,
-    std::string_view pid,
-    std::string_view tid,
+    Id pid,
+    Id tid,
     int64_t ts,
     const ArgsBuilder& args) {
   // clang-format off
-  fmt::print(traceOf_, R"JSON(
+  fmt::format_to(fmt::appender(out), FMT_COMPILE(R"JSON(
   {{
     "ph": "C",
     "cat": "{}",
     "name": "{}",
     "pid": {},
     "tid": {},
-    "ts": {},
+    "ts": {}.{:03},
     "args": {{
       {}
     }}
-  }},)JSON",
-      cat, name, pid, tid, fmtTs(ts), args.str());
+  }},)JSON"),
+      cat, name, pid, tid, ts / 1000, ts % 1000, args.str());
   // clang-format on
 }
 
-void ChromeTraceLogger::writeFlowEvent(
+template <typename Id>
+void formatFlowEvent(
+    fmt::memory_buffer& out,
     char type,
     int64_t id,
-    std::string_view pid,
-    std::string_view tid,
+    Id pid,
+    Id tid,
     int64_t ts,
     std::string_view cat,
     std::string_view name) {
   // Flow events must bind to specific slices in order to exist.
   // Only Flow end needs to specify a binding point to enclosing slice.
   // Flow start automatically sets binding point to enclosing slice.
-  const auto* const binding = (type == kFlowEnd) ? R"(, "bp": "e")" : "";
+  const std::string_view binding =
+      (type == kFlowEnd) ? R"(, "bp": "e")" : "";
 
   // clang-format off
-  fmt::print(traceOf_, R"JSON(
+  fmt::format_to(fmt::appender(out), FMT_COMPILE(R"JSON(
   {{
     "ph": "{}",
     "id": {},
     "pid": {},
     "tid": {},
-    "ts": {},
+    "ts": {}.{:03},
     "cat": "{}",
     "name": "{}"
     {}
-  }},)JSON",
-      type, id, pid, tid, fmtTs(ts), cat, name, binding);
+  }},)JSON"),
+      type, id, pid, tid, ts / 1000, ts % 1000, cat, name, binding);
   // clang-format on
 }
 
-// Integer overloads — delegate to the string_view versions.
+} // namespace
+
+void ChromeTraceLogger::writeMetadataEvent(
+    std::string_view name,
+    int64_t ts,
+    std::string_view pid,
+    std::string_view tid,
+    std::string_view arg_key,
+    std::string_view arg_value) {
+  formatMetadataEvent(buf_, name, ts, pid, tid, arg_key, arg_value);
+  flushIfFull();
+}
+
 void ChromeTraceLogger::writeMetadataEvent(
     std::string_view name,
     int64_t ts,
@@ -351,8 +413,20 @@ void ChromeTraceLogger::writeMetadataEvent(
     int64_t tid,
     std::string_view arg_key,
     std::string_view arg_value) {
-  writeMetadataEvent(
-      name, ts, std::to_string(pid), std::to_string(tid), arg_key, arg_value);
+  formatMetadataEvent(buf_, name, ts, pid, tid, arg_key, arg_value);
+  flushIfFull();
+}
+
+void ChromeTraceLogger::writeCompleteEvent(
+    std::string_view cat,
+    std::string_view name,
+    std::string_view pid,
+    std::string_view tid,
+    int64_t ts,
+    int64_t dur,
+    const ArgsBuilder& args) {
+  formatCompleteEvent(buf_, cat, name, pid, tid, ts, dur, args);
+  flushIfFull();
 }
 
 void ChromeTraceLogger::writeCompleteEvent(
@@ -363,8 +437,21 @@ void ChromeTraceLogger::writeCompleteEvent(
     int64_t ts,
     int64_t dur,
     const ArgsBuilder& args) {
-  writeCompleteEvent(
-      cat, name, std::to_string(pid), std::to_string(tid), ts, dur, args);
+  formatCompleteEvent(buf_, cat, name, pid, tid, ts, dur, args);
+  flushIfFull();
+}
+
+void ChromeTraceLogger::writeInstantEvent(
+    std::string_view cat,
+    std::string_view name,
+    std::string_view scope,
+    std::string_view pid,
+    std::string_view tid,
+    int64_t ts,
+    const ArgsBuilder& args,
+    bool finalEvent) {
+  formatInstantEvent(buf_, cat, name, scope, pid, tid, ts, args, finalEvent);
+  flushIfFull();
 }
 
 void ChromeTraceLogger::writeInstantEvent(
@@ -376,15 +463,19 @@ void ChromeTraceLogger::writeInstantEvent(
     int64_t ts,
     const ArgsBuilder& args,
     bool finalEvent) {
-  writeInstantEvent(
-      cat,
-      name,
-      scope,
-      std::to_string(pid),
-      std::to_string(tid),
-      ts,
-      args,
-      finalEvent);
+  formatInstantEvent(buf_, cat, name, scope, pid, tid, ts, args, finalEvent);
+  flushIfFull();
+}
+
+void ChromeTraceLogger::writeCounterEvent(
+    std::string_view cat,
+    std::string_view name,
+    std::string_view pid,
+    std::string_view tid,
+    int64_t ts,
+    const ArgsBuilder& args) {
+  formatCounterEvent(buf_, cat, name, pid, tid, ts, args);
+  flushIfFull();
 }
 
 void ChromeTraceLogger::writeCounterEvent(
@@ -394,8 +485,20 @@ void ChromeTraceLogger::writeCounterEvent(
     int64_t tid,
     int64_t ts,
     const ArgsBuilder& args) {
-  writeCounterEvent(
-      cat, name, std::to_string(pid), std::to_string(tid), ts, args);
+  formatCounterEvent(buf_, cat, name, pid, tid, ts, args);
+  flushIfFull();
+}
+
+void ChromeTraceLogger::writeFlowEvent(
+    char type,
+    int64_t id,
+    std::string_view pid,
+    std::string_view tid,
+    int64_t ts,
+    std::string_view cat,
+    std::string_view name) {
+  formatFlowEvent(buf_, type, id, pid, tid, ts, cat, name);
+  flushIfFull();
 }
 
 void ChromeTraceLogger::writeFlowEvent(
@@ -406,8 +509,29 @@ void ChromeTraceLogger::writeFlowEvent(
     int64_t ts,
     std::string_view cat,
     std::string_view name) {
-  writeFlowEvent(
-      type, id, std::to_string(pid), std::to_string(tid), ts, cat, name);
+  formatFlowEvent(buf_, type, id, pid, tid, ts, cat, name);
+  flushIfFull();
+}
+
+void ChromeTraceLogger::flushIfFull() {
+  if (!shard_ && buf_.size() >= kFlushThresholdBytes) {
+    flushBuffer();
+  }
+}
+
+void ChromeTraceLogger::flushBuffer() {
+  if (traceFile_ != nullptr && buf_.size() > 0 &&
+      !writer_->write({buf_.data(), buf_.size()})) {
+    PLOG(ERROR) << "Failed to write to '" << tempFileName_ << "'";
+    abandonTraceFile();
+  }
+  buf_.clear();
+}
+
+void ChromeTraceLogger::abandonTraceFile() {
+  writer_->close();
+  std::fclose(traceFile_);
+  traceFile_ = nullptr;
 }
 
 void ChromeTraceLogger::metadataToJSON(
@@ -420,8 +544,8 @@ void ChromeTraceLogger::metadataToJSON(
       distInfo_.distInfo_present_ = true;
     }
     sanitizeStrForJSON(sanitizedValue);
-    fmt::print(
-        traceOf_,
+    fmt::format_to(
+        fmt::appender(buf_),
         R"JSON(
       "{}": {},)JSON",
         k,
@@ -444,7 +568,7 @@ std::unordered_map<std::string, std::string> ChromeTraceLogger::
 void ChromeTraceLogger::handleTraceStart(
     const std::unordered_map<std::string, std::string>& metadata,
     const std::string& device_properties) {
-  if (!traceOf_) {
+  if (!writable()) {
     return;
   }
   std::string display_unit = "ms";
@@ -452,7 +576,7 @@ void ChromeTraceLogger::handleTraceStart(
   display_unit = "ns";
 #endif
   // clang-format off
-  fmt::print(traceOf_, R"JSON( {{
+  fmt::format_to(fmt::appender(buf_), R"JSON( {{
     "schemaVersion": {},
     "deviceProperties": [{}],
     )JSON",
@@ -467,7 +591,7 @@ void ChromeTraceLogger::handleTraceStart(
   // of the rest of the writing are writing new trace events to the array. We
   // close the array in `finalizeTrace`.
   // clang-format off
-  fmt::print(traceOf_, R"JSON(
+  fmt::format_to(fmt::appender(buf_), R"JSON(
     "displayTimeUnit": "{}",
     "baseTimeNanoseconds": {},
     "traceEvents": [
@@ -477,16 +601,24 @@ void ChromeTraceLogger::handleTraceStart(
   // clang-format on
 }
 
+void ChromeTraceLogger::handleTraceMetadata(
+    const std::string& key,
+    const std::string& value) {
+  traceMetadata_[key] = value;
+}
+
 static std::string defaultFileName() {
   return fmt::format(kDefaultLogFileFmt, processId());
 }
 
 void ChromeTraceLogger::openTraceFile() {
   tempFileName_ = fileName_ + ".tmp";
-  traceOf_.open(tempFileName_, std::ofstream::out | std::ofstream::trunc);
-  if (!traceOf_) {
+  traceFile_ = std::fopen(tempFileName_.c_str(), "w");
+  if (traceFile_ == nullptr) {
     PLOG(ERROR) << "Failed to open '" << fileName_ << "'";
   } else {
+    std::setvbuf(traceFile_, nullptr, _IONBF, 0);
+    writer_->open(traceFile_);
     LOG(INFO) << "Tracing to temporary file " << fileName_;
   }
 }
@@ -497,14 +629,72 @@ void ChromeTraceLogger::finalizeMemoryTrace(
   LOG(INFO) << "finalizeMemoryTrace not implemented for ChromeTraceLogger";
 }
 
-ChromeTraceLogger::ChromeTraceLogger(const std::string& traceFileName) {
+ChromeTraceLogger::ChromeTraceLogger(const std::string& traceFileName)
+    : ChromeTraceLogger(traceFileName, std::make_unique<PlainTraceFileWriter>()) {
+}
+
+ChromeTraceLogger::ChromeTraceLogger(
+    const std::string& traceFileName,
+    std::unique_ptr<TraceFileWriter> writer)
+    : writer_(std::move(writer)) {
   fileName_ = traceFileName.empty() ? defaultFileName() : traceFileName;
-  traceOf_.clear(std::ios_base::badbit);
   openTraceFile();
 }
 
+ChromeTraceLogger::~ChromeTraceLogger() {
+  // Only reached with an open file if the trace was never finalized; keep
+  // whatever was formatted so far in the temporary file.
+  if (traceFile_ != nullptr) {
+    flushBuffer();
+    if (traceFile_ != nullptr) {
+      abandonTraceFile();
+    }
+  }
+}
+
+std::unique_ptr<ActivityLogger> ChromeTraceLogger::createShard() {
+  if (traceFile_ == nullptr) {
+    return nullptr;
+  }
+  std::unique_ptr<ChromeTraceLogger> shard(new ChromeTraceLogger());
+  shard->shard_ = true;
+  return shard;
+}
+
+void ChromeTraceLogger::mergeShard(ActivityLogger& shard) {
+  auto* other = dynamic_cast<ChromeTraceLogger*>(&shard);
+  if (other == nullptr || !other->shard_) {
+    LOG(ERROR) << "Not a ChromeTraceLogger shard - skipping merge";
+    return;
+  }
+
+  std::string_view out(other->buf_.data(), other->buf_.size());
+  size_t pos = 0;
+  for (const auto& meta : other->pendingSyncStreamMetadata_) {
+    buf_.append(out.substr(pos, meta.offset - pos));
+    pos = meta.offset;
+    if (syncStreamMetadataEmitted_.insert(meta.key).second) {
+      writeSyncStreamMetadata(meta.ts, meta.device, meta.tid, meta.resource);
+    }
+  }
+  buf_.append(out.substr(pos));
+  flushIfFull();
+
+  // Both only ever keep the first value seen, and shards are merged in trace
+  // order.
+  if (distInfo_.backend.empty() && !other->distInfo_.backend.empty()) {
+    distInfo_.backend = other->distInfo_.backend;
+    distInfo_.rank = other->distInfo_.rank;
+    distInfo_.world_size = other->distInfo_.world_size;
+    distInfo_.nccl_version = other->distInfo_.nccl_version;
+  }
+  for (const auto& [name, config] : other->pgMap_) {
+    pgMap_.insert({name, config});
+  }
+}
+
 void ChromeTraceLogger::handleDeviceInfo(const DeviceInfo& info, int64_t time) {
-  if (!traceOf_) {
+  if (!writable()) {
     return;
   }
 
@@ -535,7 +725,7 @@ void ChromeTraceLogger::handleDeviceInfo(const DeviceInfo& info, int64_t time) {
 void ChromeTraceLogger::handleResourceInfo(
     const ResourceInfo& info,
     int64_t time) {
-  if (!traceOf_) {
+  if (!writable()) {
     return;
   }
 
@@ -560,7 +750,7 @@ void ChromeTraceLogger::handleResourceInfo(
 void ChromeTraceLogger::handleOverheadInfo(
     const OverheadInfo& info,
     int64_t time) {
-  if (!traceOf_) {
+  if (!writable()) {
     return;
   }
 
@@ -584,7 +774,7 @@ void ChromeTraceLogger::handleOverheadInfo(
 }
 
 void ChromeTraceLogger::handleTraceSpan(const TraceSpan& span) {
-  if (!traceOf_) {
+  if (!writable()) {
     return;
   }
 
@@ -594,8 +784,8 @@ void ChromeTraceLogger::handleTraceSpan(const TraceSpan& span) {
   // a guard to prevent this.
   int64_t dur = (span.endTime == 0) ? 0 : span.endTime - span.startTime;
 
-  ArgsBuilder args;
-  args.addRaw("Op count", fmt::format("{}", span.opCount));
+  ArgsBuilder args(argsBuf_);
+  args.addNumber("Op count", span.opCount);
   writeCompleteEvent(
       /*cat=*/"Trace",
       /*name=*/fmt::format("{}{} ({})", span.prefix, span.name, span.iteration),
@@ -617,13 +807,13 @@ void ChromeTraceLogger::handleTraceSpan(const TraceSpan& span) {
 }
 
 void ChromeTraceLogger::addIterationMarker(const TraceSpan& span) {
-  if (!traceOf_) {
+  if (!writable()) {
     return;
   }
 
   int64_t start = transToRelativeTime(span.startTime);
 
-  ArgsBuilder args;
+  ArgsBuilder args(argsBuf_);
   writeInstantEvent(
       /*cat=*/"",
       /*name=*/fmt::format("Iteration Start: {}", span.name),
@@ -636,13 +826,13 @@ void ChromeTraceLogger::addIterationMarker(const TraceSpan& span) {
 
 void ChromeTraceLogger::handleGenericInstantEvent(
     const libkineto::ITraceActivity& op) {
-  if (!traceOf_) {
+  if (!writable()) {
     return;
   }
 
   int64_t ts = transToRelativeTime(op.timestamp());
-  ArgsBuilder args;
-  args.appendFragment(op.metadataJson());
+  ArgsBuilder args(argsBuf_);
+  args.appendMetadata(op, /*sanitize=*/false);
   writeInstantEvent(
       /*cat=*/toString(op.type()),
       /*name=*/op.name(),
@@ -655,13 +845,13 @@ void ChromeTraceLogger::handleGenericInstantEvent(
 
 void ChromeTraceLogger::handleCounterEvent(
     const libkineto::ITraceActivity& op) {
-  if (!traceOf_) {
+  if (!writable()) {
     return;
   }
 
-  ArgsBuilder args;
+  ArgsBuilder args(argsBuf_);
   for (const auto& [name, value] : op.counterValues()) {
-    args.addRaw(name, fmt::format("{}", value));
+    args.addNumber(name, value);
   }
 
   int64_t ts = transToRelativeTime(op.timestamp());
@@ -674,6 +864,32 @@ void ChromeTraceLogger::handleCounterEvent(
       /*args=*/args);
 }
 
+void ChromeTraceLogger::writeSyncStreamMetadata(
+    int64_t ts,
+    int64_t device,
+    int64_t tid,
+    int64_t resource) {
+  // clang-format off
+  fmt::format_to(fmt::appender(buf_), FMT_COMPILE(R"JSON(
+  {{
+    "name": "thread_name", "ph": "M", "ts": {}.{:03}, "pid": {}, "tid": {},
+    "args": {{
+      "name": "stream {} (sync)"
+    }}
+  }},
+  {{
+    "name": "thread_sort_index", "ph": "M", "ts": {}.{:03}, "pid": {}, "tid": {},
+    "args": {{
+      "sort_index": {}
+    }}
+  }},)JSON"),
+      ts/1000, ts%1000, device, tid,
+      resource,
+      ts/1000, ts%1000, device, tid,
+      resource);
+  // clang-format on
+}
+
 void ChromeTraceLogger::appendCollectiveArgs(
     ArgsBuilder& args,
     const ITraceActivity& collectiveRecord) {
@@ -794,7 +1010,7 @@ void ChromeTraceLogger::appendCollectiveMetadata(
 }
 
 void ChromeTraceLogger::handleActivity(const libkineto::ITraceActivity& op) {
-  if (!traceOf_) {
+  if (!writable()) {
     return;
   }
 
@@ -847,13 +1063,11 @@ void ChromeTraceLogger::handleActivity(const libkineto::ITraceActivity& op) {
       external_id = op.correlationId();
     }
   }
-  ArgsBuilder args;
+  ArgsBuilder args(argsBuf_);
   if (external_id != 0) {
-    args.addRaw("External id", fmt::format("{}", external_id));
+    args.addNumber("External id", external_id);
   }
-  std::string op_metadata = op.metadataJson();
-  sanitizeStrForJSON(op_metadata);
-  args.appendFragment(op_metadata);
+  args.appendMetadata(op, /*sanitize=*/true);
 
   // Populate collective metadata from the linked record_param_comms CPU op.
   const auto* linkedOp = op.linkedActivity();
@@ -877,39 +1091,25 @@ void ChromeTraceLogger::handleActivity(const libkineto::ITraceActivity& op) {
     int64_t key = (device << 32) | syncTid;
     if (syncStreamMetadataEmitted_.insert(key).second) {
       int64_t metaTime = transToRelativeTime(ts);
-      // clang-format off
-      fmt::print(traceOf_, R"JSON(
-  {{
-    "name": "thread_name", "ph": "M", "ts": {}.{:03}, "pid": {}, "tid": {},
-    "args": {{
-      "name": "stream {} (sync)"
-    }}
-  }},
-  {{
-    "name": "thread_sort_index", "ph": "M", "ts": {}.{:03}, "pid": {}, "tid": {},
-    "args": {{
-      "sort_index": {}
-    }}
-  }},)JSON",
-          metaTime/1000, metaTime%1000, device, syncTid,
-          resource,
-          metaTime/1000, metaTime%1000, device, syncTid,
-          resource);
-      // clang-format on
+      if (shard_) {
+        pendingSyncStreamMetadata_.push_back(
+            {buf_.size(), key, metaTime, device, syncTid, resource});
+      } else {
+        writeSyncStreamMetadata(metaTime, device, syncTid, resource);
+      }
     }
     resource = syncTid;
   }
 
   // TODO: Remove this once legacy tools are updated.
-  std::string op_name = op.name() == "kernel" ? "Kernel" : op.name();
-  sanitizeStrForJSON(op_name);
-  sanitizeForNonReadableChars(op_name);
-  escapeQuotesForJSON(op_name);
+  nameBuf_.clear();
+  appendEscapedJsonName(
+      nameBuf_, op.name() == "kernel" ? "Kernel" : op.name());
 
   ts = transToRelativeTime(ts);
   writeCompleteEvent(
       /*cat=*/toString(op.type()),
-      /*name=*/op_name,
+      /*name=*/std::string_view(nameBuf_.data(), nameBuf_.size()),
       /*pid=*/device,
       /*tid=*/sanitizeTid(resource),
       /*ts=*/ts,
@@ -922,14 +1122,14 @@ void ChromeTraceLogger::handleActivity(const libkineto::ITraceActivity& op) {
 
 void ChromeTraceLogger::handleGenericActivity(
     const libkineto::GenericTraceActivity& op) {
-  if (!traceOf_) {
+  if (!writable()) {
     return;
   }
   handleActivity(op);
 }
 
 void ChromeTraceLogger::handleGenericLink(const ITraceActivity& act) {
-  if (!traceOf_) {
+  if (!writable()) {
     return;
   }
   static struct {
@@ -956,8 +1156,8 @@ void ChromeTraceLogger::handleLink(
     char type,
     const ITraceActivity& e,
     int64_t id,
-    const std::string& name) {
-  if (!traceOf_) {
+    std::string_view name) {
+  if (!writable()) {
     return;
   }
 
@@ -989,22 +1189,22 @@ void ChromeTraceLogger::addOnDemandDistMetadata() {
   if (distInfo_.backend.empty()) {
     return;
   }
-  fmt::print(
-      traceOf_,
+  fmt::format_to(
+      fmt::appender(buf_),
       R"JSON(
   "distributedInfo": {{"backend": "{}", "rank": {}, "world_size": {}, "pg_count": {}, "pg_config": [)JSON",
       distInfo_.backend,
       distInfo_.rank,
       distInfo_.world_size,
-      std::to_string(pgMap_.size()));
+      pgMap_.size());
 
   bool first = true;
   for (const auto& element : pgMap_) {
     if (!first) {
-      fmt::print(traceOf_, ",");
+      buf_.push_back(',');
     }
-    fmt::print(
-        traceOf_,
+    fmt::format_to(
+        fmt::appender(buf_),
         R"JSON({{"pg_name": "{}", "pg_desc": "{}", "backend_config": "{}", "pg_size": {}, "ranks": "{}"}})JSON",
         element.second.pg_name,
         element.second.pg_desc,
@@ -1014,15 +1214,15 @@ void ChromeTraceLogger::addOnDemandDistMetadata() {
     first = false;
   }
 
-  fmt::print(
-      traceOf_,
+  fmt::format_to(
+      fmt::appender(buf_),
       R"JSON(], "nccl_version": "{}"}},)JSON",
       distInfo_.nccl_version);
   distInfo_.distInfo_present_ = true;
 }
 
 void ChromeTraceLogger::finalizeTrace(int64_t endTime) {
-  if (!traceOf_) {
+  if (traceFile_ == nullptr) {
     LOG(ERROR) << "Failed to write to log file!";
     return;
   }
@@ -1032,7 +1232,7 @@ void ChromeTraceLogger::finalizeTrace(int64_t endTime) {
   // Note that this call ends the `traceEvents` array opened up in
   // `handleTraceStart.`
   endTime = transToRelativeTime(endTime);
-  ArgsBuilder emptyArgs;
+  ArgsBuilder emptyArgs(argsBuf_);
   writeInstantEvent(
       /*cat=*/"",
       /*name=*/"Record Window End",
@@ -1044,16 +1244,33 @@ void ChromeTraceLogger::finalizeTrace(int64_t endTime) {
       /*finalEvent=*/true);
 
   // Close the `traceEvents` array.
-  fmt::print(traceOf_, "\n  ],");
+  buf_.append(std::string_view("\n  ],"));
+
+  metadataToJSON(traceMetadata_);
+  traceMetadata_.clear();
 
   if (!distInfo_.distInfo_present_) {
     addOnDemandDistMetadata();
   }
 
   // The last entry MUST NOT end with a comma.
-  fmt::print(traceOf_, R"JSON("traceName": "{}" }})JSON", fileName_);
-
-  traceOf_.close();
+  fmt::format_to(
+      fmt::appender(buf_), R"JSON("traceName": "{}" }})JSON", fileName_);
+
+  flushBuffer();
+  if (traceFile_ != nullptr && !writer_->close()) {
+    PLOG(ERROR) << "Failed to write to '" << tempFileName_ << "'";
+    std::fclose(traceFile_);
+    traceFile_ = nullptr;
+  }
+  if (traceFile_ == nullptr) {
+    LOG(ERROR) << "Failed to write to log file!";
+    return;
+  }
+  if (std::fclose(traceFile_) != 0) {
+    PLOG(ERROR) << "Failed to close '" << tempFileName_ << "'";
+  }
+  traceFile_ = nullptr;
 
   // On some systems, rename() fails if the destination file exists.
   // So, remove the destination file first.
@@ -9,14 +9,19 @@
 #pragma once
 
 #include <chrono>
-#include <fstream>
+#include <cstdio>
 #include <map>
+#include <memory>
 #include <ostream>
 #include <ratio>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
+
+#include <fmt/format.h>
 
 // TODO(T90238193)
 // @lint-ignore-every CLANGTIDY facebook-hte-RelativeInclude
@@ -55,9 +60,34 @@ struct DistributedInfo {
   bool distInfo_present_{false};
 };
 
+// Writes the serialized trace to the temporary trace file. ChromeTraceLogger
+// hands over its output in large blocks, in order; a writer may transform them
+// on the way, e.g. to compress the trace.
+class TraceFileWriter {
+ public:
+  virtual ~TraceFileWriter() = default;
+
+  // Called once, right after the trace file was opened. The file remains
+  // owned by the logger and is closed only after close() returns.
+  virtual void open(std::FILE* file) = 0;
+
+  // Returns false if the block could not be written.
+  virtual bool write(std::string_view block) = 0;
+
+  // Writes out anything still pending. Called once after the last block, or
+  // when giving up on the file after a failed write.
+  virtual bool close() = 0;
+};
+
 class ChromeTraceLogger : public libkineto::ActivityLogger {
  public:
   explicit ChromeTraceLogger(const std::string& traceFileName);
+  ChromeTraceLogger(
+      const std::string& traceFileName,
+      std::unique_ptr<TraceFileWriter> writer);
+  ChromeTraceLogger(const ChromeTraceLogger&) = delete;
+  ChromeTraceLogger& operator=(const ChromeTraceLogger&) = delete;
+  ~ChromeTraceLogger() override;
 
   // Note: the caller of these functions should handle concurrency
   // i.e., we these functions are not thread-safe
@@ -76,6 +106,9 @@ class ChromeTraceLogger : public libkineto::ActivityLogger {
       const std::unordered_map<std::string, std::string>& metadata,
       const std::string& device_properties) override;
 
+  void handleTraceMetadata(const std::string& key, const std::string& value)
+      override;
+
   void finalizeTrace(
       const Config& config,
       std::unique_ptr<ActivityBuffers> buffers,
@@ -83,6 +116,12 @@ class ChromeTraceLogger : public libkineto::ActivityLogger {
 
   void finalizeMemoryTrace(const std::string&, const Config&) override;
 
+  // Shards render activities into memory only. Classes deriving from
+  // ChromeTraceLogger that change how activities are rendered must override
+  // createShard() as well.
+  std::unique_ptr<ActivityLogger> createShard() override;
+  void mergeShard(ActivityLogger& shard) override;
+
   std::string traceFileName() const {
     return fileName_;
   }
@@ -91,21 +130,44 @@ class ChromeTraceLogger : public libkineto::ActivityLogger {
   void finalizeTrace(int64_t endTime);
 
  private:
+  // Constructs a shard; see createShard().
+  ChromeTraceLogger() = default;
+
+  // False when the trace file could not be opened or written.
+  [[nodiscard]] bool writable() const {
+    return traceFile_ != nullptr || shard_;
+  }
+
   // Create a flow event (arrow)
   void handleLink(
       char type,
       const ITraceActivity& e,
       int64_t id,
-      const std::string& name);
+      std::string_view name);
 
   void addIterationMarker(const TraceSpan& span);
 
   void openTraceFile();
 
+  // Events are formatted straight into buf_, which is handed to the trace
+  // file in large blocks. flushIfFull() is called after every event and only
+  // writes once kFlushThresholdBytes have accumulated.
+  void flushIfFull();
+  void flushBuffer();
+  // Closes the trace file after a failed write, leaving it unfinished.
+  void abandonTraceFile();
+
   void handleGenericInstantEvent(const ITraceActivity& op);
 
   void handleCounterEvent(const ITraceActivity& op);
 
+  // Name and sort the dedicated row that Stream Sync events are moved to.
+  void writeSyncStreamMetadata(
+      int64_t ts,
+      int64_t device,
+      int64_t tid,
+      int64_t resource);
+
   void handleGenericLink(const ITraceActivity& activity);
 
   void metadataToJSON(
@@ -117,9 +179,9 @@ class ChromeTraceLogger : public libkineto::ActivityLogger {
   void addOnDemandDistMetadata();
 
   // Chrome Trace event writer helpers.
-  // The string_view pid/tid variants are the canonical implementations.
-  // Integer overloads are provided for convenience at call sites with
-  // numeric process/thread IDs.
+  // Each event kind has a single compile-time format shared by the
+  // string_view and integer pid/tid overloads, so numeric IDs are formatted
+  // in place rather than converted to temporary strings first.
   void writeMetadataEvent(
       std::string_view name,
       int64_t ts,
@@ -225,8 +287,21 @@ class ChromeTraceLogger : public libkineto::ActivityLogger {
 
   std::string fileName_;
   std::string tempFileName_;
-  std::ofstream traceOf_;
+  // Unbuffered: buf_ already batches writes, so stdio buffering would only
+  // add a copy. Null when the file could not be opened or a write failed.
+  std::FILE* traceFile_{nullptr};
+  std::unique_ptr<TraceFileWriter> writer_;
+  // Reusable output buffer. Its capacity is retained across flushes so the
+  // steady state formats events without heap allocations.
+  fmt::memory_buffer buf_;
+  // Reusable scratch buffer for the "args" object of the event being written.
+  fmt::memory_buffer argsBuf_;
+  // Reusable scratch buffer for the escaped name of the event being written.
+  fmt::memory_buffer nameBuf_;
   DistributedInfo distInfo_ = DistributedInfo();
+
+  // From handleTraceMetadata(), written after the trace events.
+  std::unordered_map<std::string, std::string> traceMetadata_;
   // Map of all observed process groups to their configs in trace. Key is
   // pg_name, value is pgConfig that will be used to populate pg_config in
   // distributedInfo of trace
@@ -239,6 +314,22 @@ class ChromeTraceLogger : public libkineto::ActivityLogger {
   // Tracks which (device, virtualTid) pairs have had thread_name metadata
   // emitted, to avoid duplicates.
   std::unordered_set<int64_t> syncStreamMetadataEmitted_;
+
+  // A shard cannot tell whether an earlier shard already named a Stream Sync
+  // row, so it records the metadata at its position in buf_ instead and
+  // mergeShard() writes it only if the merged trace has not seen the row yet.
+  struct PendingSyncStreamMetadata {
+    size_t offset;
+    int64_t key;
+    int64_t ts;
+    int64_t device;
+    int64_t tid;
+    int64_t resource;
+  };
+  std::vector<PendingSyncStreamMetadata> pendingSyncStreamMetadata_;
+
+  // True for in-memory shards created by createShard().
+  bool shard_{false};
 };
 
 // std::chrono header start
@@ -16,6 +16,7 @@
 
 // TODO(T90238193)
 // @lint-ignore-every CLANGTIDY facebook-hte-RelativeInclude
+#include "ActivityArena.h"
 #include "ActivityBuffers.h"
 #include "Config.h"
 #include "GenericTraceActivity.h"
@@ -52,8 +53,7 @@ class MemoryTraceLogger : public ActivityLogger {
 
   template <class T>
   void addActivityWrapper(const T& act) {
-    wrappers_.push_back(std::make_unique<T>(act));
-    activities_.push_back(wrappers_.back().get());
+    activities_.push_back(&wrappers_.emplace<T>(act));
   }
 
   // Just add the pointer to the list - ownership of the underlying
@@ -72,6 +72,12 @@ class MemoryTraceLogger : public ActivityLogger {
     device_properties_ = device_properties;
   }
 
+  // Kept with the metadata from handleTraceStart().
+  void handleTraceMetadata(const std::string& key, const std::string& value)
+      override {
+    metadata_[key] = value;
+  }
+
   void finalizeTrace(
       [[maybe_unused]] const Config& config,
       std::unique_ptr<ActivityBuffers> buffers,
@@ -96,14 +102,46 @@ class MemoryTraceLogger : public ActivityLogger {
     for (auto& p : resourceInfoList_) {
       logger.handleResourceInfo(p.first, p.second);
     }
-    for (auto& activity : activities_) {
+    logActivities(logger);
+    // Hold on to the buffers
+    logger.finalizeTrace(*config_, nullptr, endTime_);
+  }
+
+  // Logs the activities and CPU spans only, so that several traces can be
+  // combined into one (see FlightRecorder).
+  void logActivities(ActivityLogger& logger) const {
+    for (const auto& activity : activities_) {
       activity->log(logger);
     }
-    for (auto& cpu_trace_buffer : buffers_->cpu) {
-      logger.handleTraceSpan(cpu_trace_buffer->span);
+    if (buffers_) {
+      for (const auto& cpu_trace_buffer : buffers_->cpu) {
+        logger.handleTraceSpan(cpu_trace_buffer->span);
+      }
     }
-    // Hold on to the buffers
-    logger.finalizeTrace(*config_, nullptr, endTime_);
+  }
+
+  // Activities and CPU spans held by this trace.
+  [[nodiscard]] size_t eventCount() const {
+    return activities_.size() + (buffers_ ? buffers_->cpu.size() : 0);
+  }
+
+  [[nodiscard]] const std::unordered_map<std::string, std::string>& metadata()
+      const {
+    return metadata_;
+  }
+
+  [[nodiscard]] const std::string& deviceProperties() const {
+    return device_properties_;
+  }
+
+  [[nodiscard]] const std::vector<std::pair<DeviceInfo, int64_t>>&
+  deviceInfos() const {
+    return deviceInfoList_;
+  }
+
+  [[nodiscard]] const std::vector<std::pair<ResourceInfo, int64_t>>&
+  resourceInfos() const {
+    return resourceInfoList_;
   }
 
   void setChromeLogger(std::shared_ptr<ActivityLogger> logger) {
@@ -116,9 +154,8 @@ class MemoryTraceLogger : public ActivityLogger {
 
  private:
   std::unique_ptr<Config> config_;
-  // Optimization: Remove unique_ptr by keeping separate vector per type
   std::vector<const ITraceActivity*> activities_;
-  std::vector<std::unique_ptr<const ITraceActivity>> wrappers_;
+  ActivityArena wrappers_;
   std::vector<std::pair<DeviceInfo, int64_t>> deviceInfoList_;
   std::vector<std::pair<ResourceInfo, int64_t>> resourceInfoList_;
   std::unique_ptr<ActivityBuffers> buffers_;
@@ -0,0 +1,926 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "output_perfetto.h"
+
+#include <fmt/format.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <string_view>
+#include <tuple>
+
+// TODO(T90238193)
+// @lint-ignore-every CLANGTIDY facebook-hte-RelativeInclude
+#include "EnvMetadata.h"
+#include "Logger.h"
+#include "ThreadUtil.h"
+#include "TraceSpan.h"
+#include "TypedMetadataJson.h"
+
+namespace KINETO_NAMESPACE {
+namespace {
+
+// Field numbers from the Perfetto trace protos (protos/perfetto/trace/).
+namespace proto {
+// Trace
+constexpr uint32_t kTracePacket = 1;
+// TracePacket
+constexpr uint32_t kClockSnapshot = 6;
+constexpr uint32_t kTimestamp = 8;
+constexpr uint32_t kTrustedPacketSequenceId = 10;
+constexpr uint32_t kTrackEvent = 11;
+constexpr uint32_t kInternedData = 12;
+constexpr uint32_t kSequenceFlags = 13;
+constexpr uint32_t kTracePacketDefaults = 59;
+constexpr uint32_t kTrackDescriptor = 60;
+// TracePacket.SequenceFlags
+constexpr uint64_t kSeqIncrementalStateCleared = 1;
+constexpr uint64_t kSeqNeedsIncrementalState = 2;
+// TracePacketDefaults
+constexpr uint32_t kDefaultsTimestampClockId = 58;
+// ClockSnapshot
+constexpr uint32_t kSnapshotClocks = 1;
+constexpr uint32_t kSnapshotPrimaryTraceClock = 2;
+// ClockSnapshot.Clock
+constexpr uint32_t kClockId = 1;
+constexpr uint32_t kClockTimestamp = 2;
+constexpr uint32_t kClockIsIncremental = 3;
+// BuiltinClock
+constexpr uint64_t kBuiltinClockRealtime = 1;
+// InternedData
+constexpr uint32_t kInternedEventCategories = 1;
+constexpr uint32_t kInternedEventNames = 2;
+constexpr uint32_t kInternedDebugAnnotationNames = 3;
+// EventCategory, EventName, DebugAnnotationName
+constexpr uint32_t kInternedIid = 1;
+constexpr uint32_t kInternedName = 2;
+// TrackDescriptor
+constexpr uint32_t kTrackUuid = 1;
+constexpr uint32_t kTrackName = 2;
+constexpr uint32_t kTrackProcess = 3;
+constexpr uint32_t kTrackThread = 4;
+constexpr uint32_t kTrackParentUuid = 5;
+constexpr uint32_t kTrackCounter = 8;
+// ProcessDescriptor
+constexpr uint32_t kProcessPid = 1;
+constexpr uint32_t kProcessName = 6;
+constexpr uint32_t kProcessLabels = 8;
+// ThreadDescriptor
+constexpr uint32_t kThreadPid = 1;
+constexpr uint32_t kThreadTid = 2;
+constexpr uint32_t kThreadName = 5;
+// TrackEvent
+constexpr uint32_t kEventCategoryIids = 3;
+constexpr uint32_t kEventDebugAnnotations = 4;
+constexpr uint32_t kEventType = 9;
+constexpr uint32_t kEventNameIid = 10;
+constexpr uint32_t kEventTrackUuid = 11;
+constexpr uint32_t kEventDoubleCounterValue = 44;
+constexpr uint32_t kEventFlowIds = 47;
+constexpr uint32_t kEventTerminatingFlowIds = 48;
+// TrackEvent.Type
+constexpr uint64_t kTypeSliceBegin = 1;
+constexpr uint64_t kTypeSliceEnd = 2;
+constexpr uint64_t kTypeInstant = 3;
+constexpr uint64_t kTypeCounter = 4;
+// DebugAnnotation
+constexpr uint32_t kAnnotationNameIid = 1;
+constexpr uint32_t kAnnotationBoolValue = 2;
+constexpr uint32_t kAnnotationUintValue = 3;
+constexpr uint32_t kAnnotationIntValue = 4;
+constexpr uint32_t kAnnotationDoubleValue = 5;
+constexpr uint32_t kAnnotationStringValue = 6;
+constexpr uint32_t kAnnotationLegacyJsonValue = 9;
+constexpr uint32_t kAnnotationName = 10;
+constexpr uint32_t kAnnotationDictEntries = 11;
+} // namespace proto
+
+constexpr uint32_t kWireVarint = 0;
+constexpr uint32_t kWireFixed64 = 1;
+constexpr uint32_t kWireLengthDelimited = 2;
+
+// All packets are written on this one sequence.
+constexpr uint64_t kSequenceId = 1;
+// Sequence-scoped clock that packet timestamps are deltas on.
+constexpr uint64_t kIncrementalClockId = 64;
+
+// Nested messages whose size is not known up front get their length
+// backfilled as a varint padded to this many bytes, like protozero does.
+constexpr size_t kNestedLengthBytes = 4;
+constexpr size_t kMaxNestedLength = (1u << (7 * kNestedLengthBytes)) - 1;
+
+// Packets accumulate in memory until at least this many bytes are pending,
+// then go to the trace file in a single write.
+constexpr size_t kFlushThresholdBytes = 4 * 1024 * 1024;
+
+// Keep in sync with ChromeTraceLogger::kSyncStreamTidOffset.
+constexpr int64_t kSyncStreamTidOffset = 1000000;
+
+#ifdef __linux__
+constexpr std::string_view kDefaultLogFileFmt =
+    "/tmp/libkineto_activities_{}.pftrace";
+#else
+constexpr std::string_view kDefaultLogFileFmt =
+    "libkineto_activities_{}.pftrace";
+#endif
+
+void appendVarint(std::string& out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+void appendTag(std::string& out, uint32_t field, uint32_t wireType) {
+  appendVarint(out, (static_cast<uint64_t>(field) << 3) | wireType);
+}
+
+void appendVarintField(std::string& out, uint32_t field, uint64_t value) {
+  appendTag(out, field, kWireVarint);
+  appendVarint(out, value);
+}
+
+// int32 and int64 fields: negative values are sign-extended to 64 bits.
+void appendIntField(std::string& out, uint32_t field, int64_t value) {
+  appendVarintField(out, field, static_cast<uint64_t>(value));
+}
+
+void appendFixed64Field(std::string& out, uint32_t field, uint64_t value) {
+  appendTag(out, field, kWireFixed64);
+  for (int i = 0; i < 8; i++) {
+    out.push_back(static_cast<char>(value >> (8 * i)));
+  }
+}
+
+void appendDoubleField(std::string& out, uint32_t field, double value) {
+  uint64_t bits = 0;
+  static_assert(sizeof(bits) == sizeof(value));
+  std::memcpy(&bits, &value, sizeof(bits));
+  appendFixed64Field(out, field, bits);
+}
+
+void appendBytesField(
+    std::string& out,
+    uint32_t field,
+    std::string_view value) {
+  appendTag(out, field, kWireLengthDelimited);
+  appendVarint(out, value.size());
+  out.append(value);
+}
+
+// Starts a nested message of unknown length; returns the position to pass
+// to endNested().
+size_t beginNested(std::string& out, uint32_t field) {
+  appendTag(out, field, kWireLengthDelimited);
+  size_t pos = out.size();
+  out.append(kNestedLengthBytes, '\0');
+  return pos;
+}
+
+void endNested(std::string& out, size_t pos) {
+  size_t size = out.size() - pos - kNestedLengthBytes;
+  if (size > kMaxNestedLength) {
+    LOG(ERROR) << "Perfetto trace message too large: " << size << " bytes";
+    size = 0;
+    out.resize(pos + kNestedLengthBytes);
+  }
+  for (size_t i = 0; i < kNestedLengthBytes; i++) {
+    uint8_t byte = (size >> (7 * i)) & 0x7f;
+    if (i + 1 < kNestedLengthBytes) {
+      byte |= 0x80;
+    }
+    out[pos + i] = static_cast<char>(byte);
+  }
+}
+
+// Starts a TracePacket on the trace sequence.
+size_t beginPacket(std::string& out, uint64_t sequenceFlags) {
+  size_t packet = beginNested(out, proto::kTracePacket);
+  appendVarintField(out, proto::kTrustedPacketSequenceId, kSequenceId);
+  appendVarintField(out, proto::kSequenceFlags, sequenceFlags);
+  return packet;
+}
+
+// Flow ids are only unique within a flow type; Perfetto needs them unique
+// across the trace.
+uint64_t flowId(const ITraceActivity& activity) {
+  return (static_cast<uint64_t>(activity.flowType()) << 32) |
+      static_cast<uint32_t>(activity.flowId());
+}
+
+// Mirrors the "External id" that ChromeTraceLogger attaches to events.
+int64_t externalId(const ITraceActivity& op) {
+  if (op.linkedActivity()) {
+    return op.linkedActivity()->correlationId();
+  }
+  // Some runtime events and kernels may not have a linked activity,
+  // should not set an "External id" for them. Otherwise, these events
+  // may be incorrectly linked to the other external events.
+  static const std::set<libkineto::ActivityType> excludedTypes = {
+      libkineto::ActivityType::GPU_MEMCPY,
+      libkineto::ActivityType::GPU_MEMSET,
+      libkineto::ActivityType::CONCURRENT_KERNEL,
+      libkineto::ActivityType::CUDA_RUNTIME,
+      libkineto::ActivityType::CUDA_DRIVER,
+      libkineto::ActivityType::XPU_RUNTIME,
+      libkineto::ActivityType::XPU_DRIVER,
+      libkineto::ActivityType::PRIVATEUSE1_RUNTIME,
+      libkineto::ActivityType::PRIVATEUSE1_DRIVER};
+  return excludedTypes.contains(op.type()) ? 0 : op.correlationId();
+}
+
+bool isStreamSync(const ITraceActivity& op) {
+  return op.type() == ActivityType::CUDA_SYNC && op.name() == "Stream Sync";
+}
+
+} // namespace
+
+uint64_t PerfettoTraceLogger::InternTable::intern(std::string_view str) {
+  auto [it, inserted] = ids.try_emplace(std::string(str), strings.size() + 1);
+  if (inserted) {
+    strings.push_back(&it->first);
+  }
+  return it->second;
+}
+
+// Encodes typed metadata as TrackEvent debug annotations. Top-level names are
+// interned; entries of nested dicts carry their name inline.
+class PerfettoTraceLogger::DebugAnnotationWriter final
+    : public ITypedMetadataVisitor {
+ public:
+  DebugAnnotationWriter(std::string& out, InternTable& names)
+      : out_(out), names_(names) {}
+
+  void addInt(std::string_view name, int64_t value) {
+    appendAnnotation(name, [&](std::string& a) {
+      appendIntField(a, proto::kAnnotationIntValue, value);
+    });
+  }
+
+  void addJson(std::string_view name, std::string_view value) {
+    appendAnnotation(name, [&](std::string& a) {
+      appendBytesField(a, proto::kAnnotationLegacyJsonValue, value);
+    });
+  }
+
+ private:
+  void visitValue(const MetadataField<int64_t>& field, int64_t value)
+      override {
+    addInt(field.name, value);
+  }
+
+  void visitValue(const MetadataField<double>& field, double value) override {
+    appendAnnotation(field.name, [&](std::string& a) {
+      appendDoubleField(a, proto::kAnnotationDoubleValue, value);
+    });
+  }
+
+  void visitValue(const MetadataField<bool>& field, bool value) override {
+    appendAnnotation(field.name, [&](std::string& a) {
+      appendVarintField(a, proto::kAnnotationBoolValue, value ? 1 : 0);
+    });
+  }
+
+  void visitValue(
+      const MetadataField<std::string>& field,
+      std::string_view value) override {
+    appendAnnotation(field.name, [&](std::string& a) {
+      appendBytesField(a, proto::kAnnotationStringValue, value);
+    });
+  }
+
+  void visitValue(
+      const MetadataField<std::vector<int64_t>>& field,
+      const std::vector<int64_t>& value) override {
+    appendArray(field.name, value);
+  }
+
+  void visitValue(
+      const MetadataField<std::vector<std::string>>& field,
+      const std::vector<std::string>& value) override {
+    appendArray(field.name, value);
+  }
+
+  void visitValue(const MetadataField<RawJson>& field, const RawJson& value)
+      override {
+    addJson(field.name, value.value);
+  }
+
+  void visitValue(const MetadataField<uint64_t>& field, uint64_t value)
+      override {
+    appendAnnotation(field.name, [&](std::string& a) {
+      appendVarintField(a, proto::kAnnotationUintValue, value);
+    });
+  }
+
+  void visitValue(
+      const MetadataField<InputShapes>& field,
+      const InputShapes& value) override {
+    appendArray(field.name, value);
+  }
+
+  void visitUnsupported(std::string_view name) override {
+    appendAnnotation(name, [&](std::string& a) {
+      appendBytesField(
+          a, proto::kAnnotationStringValue, "<unsupported metadata type>");
+    });
+  }
+
+  void beginDict(std::string_view name) override {
+    bool topLevel = dicts_.empty();
+    appendName(dicts_.emplace_back(), name, topLevel);
+  }
+
+  void endDict() override {
+    std::string dict = std::move(dicts_.back());
+    dicts_.pop_back();
+    appendBytesField(target(), targetField(), dict);
+  }
+
+  // Arrays are rendered as JSON, like ChromeTraceLogger does.
+  template <typename T>
+  void appendArray(std::string_view name, const std::vector<T>& value) {
+    json_.clear();
+    internal::JsonTypedMetadataVisitor::appendArray(json_, value);
+    addJson(name, json_);
+  }
+
+  template <typename WriteValue>
+  void appendAnnotation(std::string_view name, WriteValue writeValue) {
+    annotation_.clear();
+    appendName(annotation_, name, dicts_.empty());
+    writeValue(annotation_);
+    appendBytesField(target(), targetField(), annotation_);
+  }
+
+  void appendName(
+      std::string& annotation,
+      std::string_view name,
+      bool topLevel) {
+    if (topLevel) {
+      appendVarintField(
+          annotation, proto::kAnnotationNameIid, names_.intern(name));
+    } else {
+      appendBytesField(annotation, proto::kAnnotationName, name);
+    }
+  }
+
+  std::string& target() {
+    return dicts_.empty() ? out_ : dicts_.back();
+  }
+
+  uint32_t targetField() const {
+    return dicts_.empty() ? proto::kEventDebugAnnotations
+                          : proto::kAnnotationDictEntries;
+  }
+
+  std::string& out_;
+  InternTable& names_;
+  std::vector<std::string> dicts_;
+  std::string annotation_;
+  std::string json_;
+};
+
+static std::string defaultFileName() {
+  return fmt::format(kDefaultLogFileFmt, processId());
+}
+
+PerfettoTraceLogger::PerfettoTraceLogger(const std::string& traceFileName)
+    // Track uuids are global in Perfetto; derive them from the pid so that
+    // traces of different ranks can be merged.
+    : nextTrackUuid_((static_cast<uint64_t>(processId()) << 32) + 1) {
+  fileName_ = traceFileName.empty() ? defaultFileName() : traceFileName;
+  openTraceFile();
+}
+
+PerfettoTraceLogger::~PerfettoTraceLogger() {
+  // Only reached with an open file if the trace was never finalized; keep
+  // whatever was encoded so far in the temporary file.
+  if (traceFile_ != nullptr) {
+    flushOutput();
+    if (traceFile_ != nullptr) {
+      std::fclose(traceFile_);
+    }
+  }
+}
+
+void PerfettoTraceLogger::openTraceFile() {
+  tempFileName_ = fileName_ + ".tmp";
+  traceFile_ = std::fopen(tempFileName_.c_str(), "wb");
+  if (traceFile_ == nullptr) {
+    PLOG(ERROR) << "Failed to open '" << fileName_ << "'";
+    return;
+  }
+  std::setvbuf(traceFile_, nullptr, _IONBF, 0);
+  LOG(INFO) << "Tracing to temporary file " << fileName_;
+
+  // Start the sequence: packets without an explicit clock use the
+  // incremental clock, which each batch of events anchors (see flushEvents).
+  size_t packet = beginPacket(out_, proto::kSeqIncrementalStateCleared);
+  size_t defaults = beginNested(out_, proto::kTracePacketDefaults);
+  appendVarintField(
+      out_, proto::kDefaultsTimestampClockId, kIncrementalClockId);
+  endNested(out_, defaults);
+  endNested(out_, packet);
+}
+
+void PerfettoTraceLogger::flushIfFull() {
+  if (out_.size() >= kFlushThresholdBytes) {
+    flushOutput();
+  }
+}
+
+void PerfettoTraceLogger::flushOutput() {
+  if (traceFile_ == nullptr || out_.empty()) {
+    out_.clear();
+    return;
+  }
+  if (std::fwrite(out_.data(), 1, out_.size(), traceFile_) != out_.size()) {
+    PLOG(ERROR) << "Failed to write to '" << tempFileName_ << "'";
+    std::fclose(traceFile_);
+    traceFile_ = nullptr;
+  }
+  out_.clear();
+}
+
+void PerfettoTraceLogger::writeProcessDescriptor(
+    uint64_t uuid,
+    int64_t pid,
+    std::string_view name,
+    std::string_view label) {
+  size_t packet = beginPacket(out_, proto::kSeqNeedsIncrementalState);
+  size_t track = beginNested(out_, proto::kTrackDescriptor);
+  appendVarintField(out_, proto::kTrackUuid, uuid);
+  size_t process = beginNested(out_, proto::kTrackProcess);
+  appendIntField(out_, proto::kProcessPid, static_cast<int32_t>(pid));
+  if (!name.empty()) {
+    appendBytesField(out_, proto::kProcessName, name);
+  }
+  if (!label.empty()) {
+    appendBytesField(out_, proto::kProcessLabels, label);
+  }
+  endNested(out_, process);
+  endNested(out_, track);
+  endNested(out_, packet);
+  flushIfFull();
+}
+
+void PerfettoTraceLogger::writeThreadDescriptor(
+    uint64_t uuid,
+    int64_t pid,
+    int64_t tid,
+    std::string_view name) {
+  size_t packet = beginPacket(out_, proto::kSeqNeedsIncrementalState);
+  size_t track = beginNested(out_, proto::kTrackDescriptor);
+  appendVarintField(out_, proto::kTrackUuid, uuid);
+  size_t thread = beginNested(out_, proto::kTrackThread);
+  appendIntField(out_, proto::kThreadPid, static_cast<int32_t>(pid));
+  appendIntField(out_, proto::kThreadTid, static_cast<int32_t>(tid));
+  if (!name.empty()) {
+    appendBytesField(out_, proto::kThreadName, name);
+  }
+  endNested(out_, thread);
+  endNested(out_, track);
+  endNested(out_, packet);
+  flushIfFull();
+}
+
+// Tracks are described as soon as an event needs them, so that descriptors
+// always precede their events. handleDeviceInfo and handleResourceInfo, which
+// usually come last, describe them again with their names.
+uint64_t PerfettoTraceLogger::processTrack(int64_t pid) {
+  auto [it, inserted] = processTracks_.try_emplace(pid, 0);
+  if (inserted) {
+    it->second = nextTrackUuid_++;
+    writeProcessDescriptor(it->second, pid, "", "");
+  }
+  return it->second;
+}
+
+uint64_t PerfettoTraceLogger::threadTrack(int64_t pid, int64_t tid) {
+  auto [it, inserted] = threadTracks_.try_emplace({pid, tid}, 0);
+  if (inserted) {
+    it->second = nextTrackUuid_++;
+    writeThreadDescriptor(it->second, pid, tid, "");
+  }
+  return it->second;
+}
+
+uint64_t PerfettoTraceLogger::childTrack(
+    uint64_t parent,
+    const std::string& name,
+    bool counter) {
+  auto [it, inserted] = childTracks_.try_emplace({parent, name}, 0);
+  if (inserted) {
+    it->second = nextTrackUuid_++;
+    size_t packet = beginPacket(out_, proto::kSeqNeedsIncrementalState);
+    size_t track = beginNested(out_, proto::kTrackDescriptor);
+    appendVarintField(out_, proto::kTrackUuid, it->second);
+    appendVarintField(out_, proto::kTrackParentUuid, parent);
+    appendBytesField(out_, proto::kTrackName, name);
+    if (counter) {
+      endNested(out_, beginNested(out_, proto::kTrackCounter));
+    }
+    endNested(out_, track);
+    endNested(out_, packet);
+    flushIfFull();
+  }
+  return it->second;
+}
+
+uint64_t PerfettoTraceLogger::rootTrack(const std::string& name) {
+  auto [it, inserted] = rootTracks_.try_emplace(name, 0);
+  if (inserted) {
+    it->second = nextTrackUuid_++;
+    size_t packet = beginPacket(out_, proto::kSeqNeedsIncrementalState);
+    size_t track = beginNested(out_, proto::kTrackDescriptor);
+    appendVarintField(out_, proto::kTrackUuid, it->second);
+    appendBytesField(out_, proto::kTrackName, name);
+    endNested(out_, track);
+    endNested(out_, packet);
+    flushIfFull();
+  }
+  return it->second;
+}
+
+void PerfettoTraceLogger::handleDeviceInfo(
+    const DeviceInfo& info,
+    [[maybe_unused]] int64_t time) {
+  if (traceFile_ == nullptr) {
+    return;
+  }
+  writeProcessDescriptor(processTrack(info.id), info.id, info.name, info.label);
+}
+
+void PerfettoTraceLogger::handleResourceInfo(
+    const ResourceInfo& info,
+    [[maybe_unused]] int64_t time) {
+  if (traceFile_ == nullptr) {
+    return;
+  }
+  writeThreadDescriptor(
+      threadTrack(info.deviceId, info.id), info.deviceId, info.id, info.name);
+}
+
+void PerfettoTraceLogger::handleOverheadInfo(
+    const OverheadInfo& info,
+    [[maybe_unused]] int64_t time) {
+  if (traceFile_ == nullptr) {
+    return;
+  }
+  // Same reserved pid as in ChromeTraceLogger.
+  writeProcessDescriptor(processTrack(-1), -1, info.name, "");
+}
+
+void PerfettoTraceLogger::handleTraceStart(
+    const std::unordered_map<std::string, std::string>& metadata,
+    const std::string& device_properties) {
+  if (traceFile_ == nullptr) {
+    return;
+  }
+  // Written as annotations of an instant event in finalizeTrace(), once the
+  // time range of the trace is known.
+  metadata_ = libkineto::getEnvMetadata();
+  for (const auto& [k, v] : metadata) {
+    metadata_[k] = v;
+  }
+  deviceProperties_ = device_properties;
+}
+
+void PerfettoTraceLogger::encodeEventFields(
+    uint64_t track,
+    std::string_view category,
+    std::string_view name,
+    uint64_t type) {
+  appendVarintField(events_, proto::kEventType, type);
+  appendVarintField(events_, proto::kEventTrackUuid, track);
+  appendVarintField(events_, proto::kEventNameIid, eventNames_.intern(name));
+  if (!category.empty()) {
+    appendVarintField(
+        events_, proto::kEventCategoryIids, categories_.intern(category));
+  }
+}
+
+void PerfettoTraceLogger::encodeActivityArgs(
+    const ITraceActivity& activity,
+    DebugAnnotationWriter& args) {
+  int64_t id = externalId(activity);
+  if (id != 0) {
+    args.addInt("External id", id);
+  }
+  activity.visitTypedMetadata(args);
+  if (activity.flowId() > 0) {
+    uint64_t flow = flowId(activity);
+    // The source of a flow starts it; the destination terminates it.
+    appendFixed64Field(
+        events_,
+        activity.flowStart() ? proto::kEventFlowIds
+                             : proto::kEventTerminatingFlowIds,
+        flow);
+  }
+}
+
+void PerfettoTraceLogger::pushEvent(
+    int64_t ts,
+    int64_t rank,
+    int64_t tieBreak,
+    int64_t seq,
+    size_t offset) {
+  pending_.push_back(
+      {std::max<int64_t>(ts, 0),
+       rank,
+       tieBreak,
+       seq,
+       static_cast<uint32_t>(events_.size() - offset),
+       offset});
+}
+
+void PerfettoTraceLogger::endSlice(
+    uint64_t track,
+    int64_t ts,
+    int64_t duration,
+    int64_t seq) {
+  size_t offset = events_.size();
+  appendVarintField(events_, proto::kEventType, proto::kTypeSliceEnd);
+  appendVarintField(events_, proto::kEventTrackUuid, track);
+  if (duration > 0) {
+    pushEvent(ts + duration, kRankEnd, -ts, -seq, offset);
+  } else {
+    pushEvent(ts, kRankZeroLengthEnd, 0, -seq, offset);
+  }
+  if (pending_.size() >= kMaxPendingEvents) {
+    flushEvents();
+  }
+}
+
+void PerfettoTraceLogger::handleActivity(const libkineto::ITraceActivity& op) {
+  if (traceFile_ == nullptr) {
+    return;
+  }
+
+  switch (op.type()) {
+    case ActivityType::MTIA_COUNTERS:
+    case ActivityType::XPU_SCOPE_PROFILER:
+      handleCounterEvent(op);
+      return;
+    default:
+      break;
+  }
+
+  int64_t ts = op.timestamp();
+  int64_t duration = std::max<int64_t>(op.duration(), 0);
+  int64_t device = op.deviceId();
+  int64_t resource = op.resourceId();
+
+  if (op.type() == ActivityType::GPU_USER_ANNOTATION) {
+    // Enclose the GPU ops of the annotation, which start and end at the same
+    // time, rather than nest in the first of them.
+    ts -= 1;
+    duration += 2;
+  }
+
+  uint64_t track = 0;
+  if (isStreamSync(op)) {
+    // Move Stream Sync events to a dedicated row so they don't overlap with
+    // kernel events on the same stream.
+    int64_t syncTid = resource + kSyncStreamTidOffset;
+    bool known = threadTracks_.contains({device, syncTid});
+    track = threadTrack(device, syncTid);
+    if (!known) {
+      writeThreadDescriptor(
+          track, device, syncTid, fmt::format("stream {} (sync)", resource));
+    }
+  } else {
+    track = threadTrack(device, resource);
+  }
+
+  int64_t seq = eventCount_++;
+  size_t offset = events_.size();
+  bool instant = op.type() == ActivityType::CPU_INSTANT_EVENT;
+  encodeEventFields(
+      track,
+      toString(op.type()),
+      op.name(),
+      instant ? proto::kTypeInstant : proto::kTypeSliceBegin);
+  DebugAnnotationWriter args(events_, annotationNames_);
+  encodeActivityArgs(op, args);
+  pushEvent(ts, kRankBegin, -(ts + (instant ? 0 : duration)), seq, offset);
+  if (!instant) {
+    endSlice(track, ts, duration, seq);
+  } else if (pending_.size() >= kMaxPendingEvents) {
+    flushEvents();
+  }
+}
+
+void PerfettoTraceLogger::handleGenericActivity(
+    const libkineto::GenericTraceActivity& op) {
+  handleActivity(op);
+}
+
+void PerfettoTraceLogger::handleCounterEvent(const ITraceActivity& op) {
+  uint64_t process = processTrack(op.deviceId());
+  for (const auto& [name, value] : op.counterValues()) {
+    uint64_t track =
+        childTrack(process, fmt::format("{} {}", op.name(), name), true);
+    size_t offset = events_.size();
+    appendVarintField(events_, proto::kEventType, proto::kTypeCounter);
+    appendVarintField(events_, proto::kEventTrackUuid, track);
+    appendDoubleField(events_, proto::kEventDoubleCounterValue, value);
+    pushEvent(
+        op.timestamp(), kRankBegin, -op.timestamp(), eventCount_++, offset);
+  }
+  if (pending_.size() >= kMaxPendingEvents) {
+    flushEvents();
+  }
+}
+
+void PerfettoTraceLogger::handleTraceSpan(const TraceSpan& span) {
+  if (traceFile_ == nullptr) {
+    return;
+  }
+
+  // If endTime is 0 and start time is non-zero, dur can overflow. Add
+  // a guard to prevent this.
+  int64_t duration = (span.endTime == 0)
+      ? 0
+      : std::max<int64_t>(span.endTime - span.startTime, 0);
+  uint64_t track = childTrack(rootTrack("Spans"), span.name, false);
+  int64_t seq = eventCount_++;
+  size_t offset = events_.size();
+  encodeEventFields(
+      track,
+      "Trace",
+      fmt::format("{}{} ({})", span.prefix, span.name, span.iteration),
+      proto::kTypeSliceBegin);
+  DebugAnnotationWriter args(events_, annotationNames_);
+  args.addInt("Op count", span.opCount);
+  pushEvent(
+      span.startTime, kRankBegin, -(span.startTime + duration), seq, offset);
+  endSlice(track, span.startTime, duration, seq);
+
+  uint64_t markers = childTrack(
+      rootTrack("Traces"), fmt::format("Trace {}", span.name), false);
+  offset = events_.size();
+  encodeEventFields(
+      markers,
+      "",
+      fmt::format("Iteration Start: {}", span.name),
+      proto::kTypeInstant);
+  pushEvent(span.startTime, kRankBegin, -span.startTime, eventCount_++, offset);
+  if (pending_.size() >= kMaxPendingEvents) {
+    flushEvents();
+  }
+}
+
+void PerfettoTraceLogger::flushEvents() {
+  if (traceFile_ == nullptr) {
+    pending_.clear();
+    events_.clear();
+    return;
+  }
+
+  // Interned strings first used by this batch of events.
+  if (eventNames_.emitted < eventNames_.strings.size() ||
+      categories_.emitted < categories_.strings.size() ||
+      annotationNames_.emitted < annotationNames_.strings.size()) {
+    size_t packet = beginPacket(out_, proto::kSeqNeedsIncrementalState);
+    size_t interned = beginNested(out_, proto::kInternedData);
+    auto writeEntries = [this](InternTable& table, uint32_t field) {
+      for (size_t i = table.emitted; i < table.strings.size(); i++) {
+        size_t entry = beginNested(out_, field);
+        appendVarintField(out_, proto::kInternedIid, i + 1);
+        appendBytesField(out_, proto::kInternedName, *table.strings[i]);
+        endNested(out_, entry);
+      }
+      table.emitted = table.strings.size();
+    };
+    writeEntries(categories_, proto::kInternedEventCategories);
+    writeEntries(eventNames_, proto::kInternedEventNames);
+    writeEntries(annotationNames_, proto::kInternedDebugAnnotationNames);
+    endNested(out_, interned);
+    endNested(out_, packet);
+  }
+
+  if (pending_.empty()) {
+    flushIfFull();
+    return;
+  }
+
+  std::sort(
+      pending_.begin(),
+      pending_.end(),
+      [](const PendingEvent& a, const PendingEvent& b) {
+        return std::tie(a.ts, a.rank, a.tieBreak, a.seq) <
+            std::tie(b.ts, b.rank, b.tieBreak, b.seq);
+      });
+
+  // Batches are not ordered relative to each other, so every batch resets
+  // the incremental clock to zero: the first delta of a batch is its
+  // absolute start time, the rest are small.
+  size_t packet = beginPacket(out_, proto::kSeqNeedsIncrementalState);
+  size_t snapshot = beginNested(out_, proto::kClockSnapshot);
+  for (auto [clockId, incremental] :
+       {std::pair{proto::kBuiltinClockRealtime, false},
+        std::pair{kIncrementalClockId, true}}) {
+    size_t clock = beginNested(out_, proto::kSnapshotClocks);
+    appendVarintField(out_, proto::kClockId, clockId);
+    appendVarintField(out_, proto::kClockTimestamp, 0);
+    if (incremental) {
+      appendVarintField(out_, proto::kClockIsIncremental, 1);
+    }
+    endNested(out_, clock);
+  }
+  appendVarintField(
+      out_, proto::kSnapshotPrimaryTraceClock, proto::kBuiltinClockRealtime);
+  endNested(out_, snapshot);
+  endNested(out_, packet);
+
+  // Event packets are small and their size is known, so their lengths are
+  // written exactly rather than padded.
+  int64_t last = 0;
+  std::string header;
+  for (const auto& event : pending_) {
+    header.clear();
+    appendVarintField(
+        header, proto::kTimestamp, static_cast<uint64_t>(event.ts - last));
+    appendVarintField(header, proto::kTrustedPacketSequenceId, kSequenceId);
+    appendVarintField(
+        header, proto::kSequenceFlags, proto::kSeqNeedsIncrementalState);
+    appendTag(header, proto::kTrackEvent, kWireLengthDelimited);
+    appendVarint(header, event.size);
+    appendTag(out_, proto::kTracePacket, kWireLengthDelimited);
+    appendVarint(out_, header.size() + event.size);
+    out_.append(header);
+    out_.append(events_, event.offset, event.size);
+    last = event.ts;
+    flushIfFull();
+  }
+  pending_.clear();
+  events_.clear();
+}
+
+void PerfettoTraceLogger::finalizeTrace(
+    [[maybe_unused]] const Config& config,
+    [[maybe_unused]] std::unique_ptr<ActivityBuffers> buffers,
+    int64_t endTime) {
+  finalizeTrace(endTime);
+}
+
+void PerfettoTraceLogger::finalizeMemoryTrace(
+    [[maybe_unused]] const std::string& url,
+    [[maybe_unused]] const Config& config) {
+  LOG(INFO) << "finalizeMemoryTrace not implemented for PerfettoTraceLogger";
+}
+
+void PerfettoTraceLogger::finalizeTrace(int64_t endTime) {
+  if (traceFile_ == nullptr) {
+    LOG(ERROR) << "Failed to write to log file!";
+    return;
+  }
+
+  uint64_t track = rootTrack("Traces");
+  size_t offset = events_.size();
+  encodeEventFields(track, "", "Record Window End", proto::kTypeInstant);
+  pushEvent(endTime, kRankBegin, -endTime, eventCount_++, offset);
+
+  // Trace metadata has no dedicated place in a Perfetto trace; keep it as
+  // the annotations of an instant event at the end of the trace.
+  offset = events_.size();
+  encodeEventFields(track, "", "Trace Metadata", proto::kTypeInstant);
+  DebugAnnotationWriter args(events_, annotationNames_);
+  for (const auto& [k, v] : metadata_) {
+    args.addJson(k, v);
+  }
+  args.addJson("deviceProperties", fmt::format("[{}]", deviceProperties_));
+  pushEvent(endTime, kRankBegin, -endTime, eventCount_++, offset);
+
+  flushEvents();
+  flushOutput();
+  if (traceFile_ == nullptr) {
+    return;
+  }
+  if (std::fclose(traceFile_) != 0) {
+    PLOG(ERROR) << "Failed to close '" << tempFileName_ << "'";
+  }
+  traceFile_ = nullptr;
+
+  // On some systems, rename() fails if the destination file exists.
+  // So, remove the destination file first.
+  std::remove(fileName_.c_str());
+  if (std::rename(tempFileName_.c_str(), fileName_.c_str()) != 0) {
+    PLOG(ERROR) << "Failed to rename " << tempFileName_ << " to " << fileName_;
+  } else {
+    LOG(INFO) << "Renamed the trace file to " << fileName_;
+  }
+  LOG(INFO) << "Perfetto Trace written to " << fileName_;
+}
+
+} // namespace KINETO_NAMESPACE
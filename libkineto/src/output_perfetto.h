@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// TODO(T90238193)
+// @lint-ignore-every CLANGTIDY facebook-hte-RelativeInclude
+#include "ActivityBuffers.h"
+#include "GenericTraceActivity.h"
+#include "output_base.h"
+
+namespace KINETO_NAMESPACE {
+
+struct TraceSpan;
+
+// Protocol prefix for binary Perfetto traces, e.g.
+// perfetto:///tmp/trace.pftrace
+constexpr char kPerfettoFileProtocol[] = "perfetto";
+
+// Writes the trace as a stream of Perfetto TracePacket protos, encoded by hand
+// so that no dependency on the Perfetto SDK is needed. The output loads in
+// ui.perfetto.dev and trace_processor like any other Perfetto trace.
+//
+// All packets share one packet sequence:
+//  * Devices and resources map to process and thread track descriptors.
+//  * Event names, categories and annotation names are interned.
+//  * Timestamps are deltas on an incremental clock. Events are buffered and
+//    sorted in batches of up to kMaxPendingEvents, and a clock snapshot
+//    resets the clock before each batch, so deltas never go negative.
+//  * Flows between activities use TrackEvent flow ids.
+class PerfettoTraceLogger : public libkineto::ActivityLogger {
+ public:
+  static constexpr size_t kMaxPendingEvents = 64 * 1024;
+
+  explicit PerfettoTraceLogger(const std::string& traceFileName);
+  PerfettoTraceLogger(const PerfettoTraceLogger&) = delete;
+  PerfettoTraceLogger& operator=(const PerfettoTraceLogger&) = delete;
+  ~PerfettoTraceLogger() override;
+
+  // Note: the caller of these functions should handle concurrency
+  // i.e., we these functions are not thread-safe
+  void handleDeviceInfo(const DeviceInfo& info, int64_t time) override;
+
+  void handleOverheadInfo(const OverheadInfo& info, int64_t time) override;
+
+  void handleResourceInfo(const ResourceInfo& info, int64_t time) override;
+
+  void handleTraceSpan(const TraceSpan& span) override;
+
+  void handleActivity(const ITraceActivity& activity) override;
+  void handleGenericActivity(const GenericTraceActivity& activity) override;
+
+  void handleTraceStart(
+      const std::unordered_map<std::string, std::string>& metadata,
+      const std::string& device_properties) override;
+
+  void handleTraceMetadata(const std::string& key, const std::string& value)
+      override {
+    metadata_[key] = value;
+  }
+
+  void finalizeTrace(
+      const Config& config,
+      std::unique_ptr<ActivityBuffers> buffers,
+      int64_t endTime) override;
+
+  void finalizeMemoryTrace(const std::string&, const Config&) override;
+
+  std::string traceFileName() const {
+    return fileName_;
+  }
+
+ protected:
+  void finalizeTrace(int64_t endTime);
+
+ private:
+  class DebugAnnotationWriter;
+
+  // Interned strings of one kind. Ids are 1-based, in order of first use;
+  // the strings from emitted onwards have not been written out yet.
+  struct InternTable {
+    std::unordered_map<std::string, uint64_t> ids;
+    std::vector<const std::string*> strings;
+    size_t emitted{0};
+
+    uint64_t intern(std::string_view str);
+  };
+
+  // Orders events with equal timestamps so that slices nest on each track:
+  // ends of slices that started earlier, then begins and instants, then ends
+  // of zero-length slices.
+  static constexpr int64_t kRankEnd = 0;
+  static constexpr int64_t kRankBegin = 1;
+  static constexpr int64_t kRankZeroLengthEnd = 2;
+
+  // A TrackEvent waiting to be sorted into the output. Its encoded body is
+  // events_[offset, offset + size). Events sort by (ts, rank, tieBreak, seq):
+  // within a rank, outer slices begin first and inner slices end first.
+  struct PendingEvent {
+    int64_t ts;
+    int64_t rank;
+    int64_t tieBreak;
+    int64_t seq;
+    uint32_t size;
+    size_t offset;
+  };
+
+  void openTraceFile();
+
+  // Output packets are collected in out_ and written in large blocks.
+  void flushIfFull();
+  void flushOutput();
+
+  // Sorts the pending events and writes them out, preceded by the interned
+  // strings they refer to and a clock snapshot anchoring their deltas.
+  void flushEvents();
+
+  uint64_t processTrack(int64_t pid);
+  uint64_t threadTrack(int64_t pid, int64_t tid);
+  uint64_t childTrack(uint64_t parent, const std::string& name, bool counter);
+  // Trace-level tracks for spans and markers.
+  uint64_t rootTrack(const std::string& name);
+  void writeProcessDescriptor(
+      uint64_t uuid,
+      int64_t pid,
+      std::string_view name,
+      std::string_view label);
+  void writeThreadDescriptor(
+      uint64_t uuid,
+      int64_t pid,
+      int64_t tid,
+      std::string_view name);
+
+  void handleCounterEvent(const ITraceActivity& op);
+
+  // Appends the fields shared by all named events to events_.
+  void encodeEventFields(
+      uint64_t track,
+      std::string_view category,
+      std::string_view name,
+      uint64_t type);
+  void encodeActivityArgs(
+      const ITraceActivity& activity,
+      DebugAnnotationWriter& args);
+  // Queues the end of the slice started by event seq.
+  void endSlice(uint64_t track, int64_t ts, int64_t duration, int64_t seq);
+  // Queues the event encoded at events_[offset, end).
+  void pushEvent(
+      int64_t ts,
+      int64_t rank,
+      int64_t tieBreak,
+      int64_t seq,
+      size_t offset);
+
+  std::string fileName_;
+  std::string tempFileName_;
+  std::FILE* traceFile_{nullptr};
+
+  std::string out_;
+  std::string events_;
+  std::vector<PendingEvent> pending_;
+  int64_t eventCount_{0};
+
+  InternTable eventNames_;
+  InternTable categories_;
+  InternTable annotationNames_;
+
+  uint64_t nextTrackUuid_;
+  std::unordered_map<int64_t, uint64_t> processTracks_;
+  std::map<std::pair<int64_t, int64_t>, uint64_t> threadTracks_;
+  std::map<std::pair<uint64_t, std::string>, uint64_t> childTracks_;
+  std::unordered_map<std::string, uint64_t> rootTracks_;
+
+  std::unordered_map<std::string, std::string> metadata_;
+  std::string deviceProperties_;
+};
+
+} // namespace KINETO_NAMESPACE
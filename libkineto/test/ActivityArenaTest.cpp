@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "include/GenericTraceActivity.h"
+#include "include/TraceSpan.h"
+#include "src/ActivityArena.h"
+#include "src/ActivityBuffers.h"
+
+using namespace KINETO_NAMESPACE;
+using namespace libkineto;
+
+namespace {
+
+int liveObjects = 0;
+
+struct Tracked {
+  explicit Tracked(int64_t v) : value(v) {
+    liveObjects++;
+  }
+  Tracked(const Tracked& other) : value(other.value) {
+    liveObjects++;
+  }
+  ~Tracked() {
+    liveObjects--;
+  }
+  int64_t value;
+};
+
+struct alignas(64) OverAligned {
+  explicit OverAligned(int v) : value(v) {}
+  int value;
+};
+
+struct Throwing {
+  explicit Throwing(bool shouldThrow) {
+    if (shouldThrow) {
+      throw std::runtime_error("constructor failed");
+    }
+    liveObjects++;
+  }
+  ~Throwing() {
+    liveObjects--;
+  }
+};
+
+// Minimal wrapper shaped like the CUPTI / roctracer activity wrappers: a
+// reference to a raw record plus an optional linked activity.
+struct RawRecord {
+  int64_t start;
+  int64_t end;
+  int32_t correlationId;
+};
+
+struct MockActivity : public ITraceActivity {
+  MockActivity(const RawRecord& raw, const ITraceActivity* linked)
+      : raw_(raw), linked_(linked) {
+    liveObjects++;
+  }
+  MockActivity(const MockActivity& other)
+      : ITraceActivity(other), raw_(other.raw_), linked_(other.linked_) {
+    liveObjects++;
+  }
+  ~MockActivity() override {
+    liveObjects--;
+  }
+
+  int64_t deviceId() const override {
+    return 0;
+  }
+  int64_t resourceId() const override {
+    return 0;
+  }
+  int32_t getThreadId() const override {
+    return 0;
+  }
+  int64_t timestamp() const override {
+    return raw_.start;
+  }
+  int64_t duration() const override {
+    return raw_.end - raw_.start;
+  }
+  int64_t correlationId() const override {
+    return raw_.correlationId;
+  }
+  int flowType() const override {
+    return 0;
+  }
+  int64_t flowId() const override {
+    return 0;
+  }
+  bool flowStart() const override {
+    return false;
+  }
+  ActivityType type() const override {
+    return ActivityType::CONCURRENT_KERNEL;
+  }
+  const std::string name() const override {
+    return "mock";
+  }
+  const ITraceActivity* linkedActivity() const override {
+    return linked_;
+  }
+  const TraceSpan* traceSpan() const override {
+    return nullptr;
+  }
+  void log(ActivityLogger& /*logger*/) const override {}
+  const std::string metadataJson() const override {
+    return "";
+  }
+
+  const RawRecord& raw_;
+  const ITraceActivity* linked_;
+};
+
+} // namespace
+
+TEST(ActivityArenaTest, AddressesStayStableAcrossSlabs) {
+  constexpr int kCount = 100000;
+  liveObjects = 0;
+  {
+    ActivityArena arena;
+    std::vector<Tracked*> objects;
+    for (int i = 0; i < kCount; i++) {
+      objects.push_back(&arena.emplace<Tracked>(i));
+    }
+    EXPECT_EQ(arena.size(), kCount);
+    EXPECT_EQ(liveObjects, kCount);
+    // One allocation per slab, not per object.
+    const size_t perSlab = ActivityArena::kSlabBytes / sizeof(Tracked);
+    EXPECT_EQ(arena.slabCount(), (kCount + perSlab - 1) / perSlab);
+
+    std::set<Tracked*> unique(objects.begin(), objects.end());
+    EXPECT_EQ(unique.size(), kCount);
+    for (int i = 0; i < kCount; i++) {
+      EXPECT_EQ(objects[i]->value, i);
+    }
+  }
+  EXPECT_EQ(liveObjects, 0);
+}
+
+TEST(ActivityArenaTest, KeepsTypesInSeparateSlabs) {
+  ActivityArena arena;
+  auto& a = arena.emplace<Tracked>(1);
+  auto& b = arena.emplace<OverAligned>(2);
+  auto& c = arena.emplace<Tracked>(3);
+  auto& d = arena.emplace<OverAligned>(4);
+
+  EXPECT_EQ(arena.size(), 4);
+  EXPECT_EQ(arena.slabCount(), 2);
+  EXPECT_EQ(&c, &a + 1);
+  EXPECT_EQ(&d, &b + 1);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(&b) % alignof(OverAligned), 0);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(&d) % alignof(OverAligned), 0);
+  EXPECT_EQ(a.value + b.value + c.value + d.value, 10);
+}
+
+TEST(ActivityArenaTest, ThrowingConstructorLeavesArenaConsistent) {
+  liveObjects = 0;
+  {
+    ActivityArena arena;
+    arena.emplace<Throwing>(false);
+    EXPECT_THROW(arena.emplace<Throwing>(true), std::runtime_error);
+    arena.emplace<Throwing>(false);
+    EXPECT_EQ(arena.size(), 2);
+    EXPECT_EQ(liveObjects, 2);
+  }
+  EXPECT_EQ(liveObjects, 0);
+}
+
+TEST(ActivityArenaTest, MovedArenaOwnsObjects) {
+  liveObjects = 0;
+  {
+    ActivityArena arena;
+    Tracked* obj = &arena.emplace<Tracked>(42);
+    ActivityArena moved(std::move(arena));
+    EXPECT_EQ(moved.size(), 1);
+    EXPECT_EQ(obj->value, 42);
+    EXPECT_EQ(liveObjects, 1);
+  }
+  EXPECT_EQ(liveObjects, 0);
+}
+
+TEST(ActivityArenaTest, ActivityBuffersOwnWrappers) {
+  constexpr int kCount = 10000;
+  liveObjects = 0;
+  std::vector<RawRecord> records;
+  for (int i = 0; i < kCount; i++) {
+    records.push_back({100 * i, 100 * i + 50, i});
+  }
+
+  auto buffers = std::make_unique<ActivityBuffers>();
+  std::vector<const ITraceActivity*> wrappers;
+  const ITraceActivity* linked = nullptr;
+  for (int i = 0; i < kCount; i++) {
+    // Alternate between copying and constructing in place.
+    const ITraceActivity& act = i % 2
+        ? buffers->addActivityWrapper(MockActivity(records[i], linked))
+        : buffers->emplaceActivityWrapper<MockActivity>(records[i], linked);
+    wrappers.push_back(&act);
+    linked = &act;
+  }
+  EXPECT_EQ(buffers->activityWrapperCount(), kCount);
+  EXPECT_EQ(liveObjects, kCount);
+
+  for (int i = 0; i < kCount; i++) {
+    EXPECT_EQ(wrappers[i]->correlationId(), i);
+    EXPECT_EQ(wrappers[i]->duration(), 50);
+    EXPECT_EQ(wrappers[i]->linkedActivity(), i ? wrappers[i - 1] : nullptr);
+  }
+
+  buffers.reset();
+  EXPECT_EQ(liveObjects, 0);
+}
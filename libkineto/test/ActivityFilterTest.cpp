@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include "include/Config.h"
+#include "include/GenericTraceActivity.h"
+#include "include/time_since_epoch.h"
+#include "src/ActivityFilter.h"
+#include "src/GenericActivityProfiler.h"
+#include "src/output_membuf.h"
+
+using namespace KINETO_NAMESPACE;
+using namespace std::chrono;
+
+namespace {
+
+const TraceSpan& testSpan() {
+  static const TraceSpan span(0, 1000000, "test");
+  return span;
+}
+
+GenericTraceActivity makeActivity(
+    ActivityType type,
+    const std::string& name,
+    int64_t durationNs,
+    int64_t device = 0,
+    int64_t stream = 0) {
+  GenericTraceActivity act(testSpan(), type, name);
+  act.startTime = 1000;
+  act.endTime = 1000 + durationNs;
+  act.device = device;
+  act.resource = stream;
+  return act;
+}
+
+std::unique_ptr<Config> makeConfig(const std::string& options) {
+  auto cfg = std::make_unique<Config>();
+  EXPECT_TRUE(cfg->parse(options));
+  cfg->validate(system_clock::now());
+  return cfg;
+}
+
+std::vector<std::string> names(MemoryTraceLogger& logger) {
+  std::vector<std::string> res;
+  for (const auto* act : *logger.traceActivities()) {
+    res.push_back(act->name());
+  }
+  return res;
+}
+
+// Hands the activities added to it to the profiler as GPU activities, as the
+// CUPTI and ROCm profilers do with the records in their buffers.
+class MockGpuActivityProfiler : public GenericActivityProfiler {
+ public:
+  MockGpuActivityProfiler() : GenericActivityProfiler(/*cpuOnly=*/false) {}
+
+  void addGpuActivity(GenericTraceActivity act) {
+    gpuActivities_.push_back(std::move(act));
+  }
+
+ protected:
+  void processGpuActivities(ActivityLogger& logger) override {
+    for (const auto& act : gpuActivities_) {
+      handleGpuActivity(act, &logger);
+    }
+  }
+
+ private:
+  std::deque<GenericTraceActivity> gpuActivities_;
+};
+
+} // namespace
+
+TEST(ActivityFilterTest, DisabledKeepsEverything) {
+  ActivityFilter filter;
+  filter.configure(*makeConfig(""));
+  EXPECT_FALSE(filter.enabled());
+  EXPECT_TRUE(filter.keep(makeActivity(ActivityType::CPU_OP, "op", 0)));
+  EXPECT_EQ(filter.dropCounts().total(), 0);
+}
+
+TEST(ActivityFilterTest, TypeAndDuration) {
+  ActivityFilter filter;
+  filter.configure(*makeConfig(R"(
+    ACTIVITIES_FILTER_TYPES=cpu_op,kernel
+    ACTIVITIES_FILTER_MIN_DURATION_US=2)"));
+  EXPECT_TRUE(filter.enabled());
+  EXPECT_TRUE(filter.keep(makeActivity(ActivityType::CPU_OP, "op", 2000)));
+  EXPECT_TRUE(
+      filter.keep(makeActivity(ActivityType::CONCURRENT_KERNEL, "k", 5000)));
+  EXPECT_FALSE(
+      filter.keep(makeActivity(ActivityType::CONCURRENT_KERNEL, "k", 1999)));
+  EXPECT_FALSE(
+      filter.keep(makeActivity(ActivityType::USER_ANNOTATION, "a", 5000)));
+  EXPECT_FALSE(filter.keep(makeActivity(ActivityType::GPU_MEMCPY, "m", 0)));
+
+  const auto counts = filter.dropCounts();
+  EXPECT_EQ(counts.type, 2);
+  EXPECT_EQ(counts.duration, 1);
+  EXPECT_EQ(counts.total(), 3);
+}
+
+// A name has to match both the prefixes and the regex when both are set.
+TEST(ActivityFilterTest, Name) {
+  ActivityFilter filter;
+  filter.configure(*makeConfig(R"(
+    ACTIVITIES_FILTER_NAME_PREFIXES=aten::,nccl
+    ACTIVITIES_FILTER_NAME_REGEX=mm|conv)"));
+  EXPECT_TRUE(filter.keep(makeActivity(ActivityType::CPU_OP, "aten::mm", 0)));
+  EXPECT_TRUE(filter.keep(
+      makeActivity(ActivityType::CPU_OP, "aten::convolution", 0)));
+  EXPECT_FALSE(filter.keep(makeActivity(ActivityType::CPU_OP, "aten::add", 0)));
+  EXPECT_FALSE(filter.keep(makeActivity(ActivityType::CPU_OP, "mm", 0)));
+  EXPECT_FALSE(filter.keep(makeActivity(ActivityType::CPU_OP, "ncc", 0)));
+  EXPECT_EQ(filter.dropCounts().name, 3);
+}
+
+// Host side activities have a pid and tid where GPU activities have a device
+// and stream, and are not dropped by device or stream.
+TEST(ActivityFilterTest, DeviceAndStream) {
+  ActivityFilter filter;
+  filter.configure(*makeConfig(R"(
+    ACTIVITIES_FILTER_DEVICES=1
+    ACTIVITIES_FILTER_STREAMS=7,8)"));
+  const auto kernel = ActivityType::CONCURRENT_KERNEL;
+  EXPECT_TRUE(filter.keep(makeActivity(kernel, "k", 0, 1, 7)));
+  EXPECT_TRUE(
+      filter.keep(makeActivity(ActivityType::GPU_MEMSET, "s", 0, 1, 8)));
+  EXPECT_FALSE(filter.keep(makeActivity(kernel, "k", 0, 0, 7)));
+  EXPECT_FALSE(filter.keep(makeActivity(kernel, "k", 0, 1, 9)));
+  EXPECT_TRUE(
+      filter.keep(makeActivity(ActivityType::CUDA_RUNTIME, "r", 0, 1234, 1)));
+  EXPECT_TRUE(filter.keep(makeActivity(ActivityType::CPU_OP, "op", 0, 0, 3)));
+
+  const auto counts = filter.dropCounts();
+  EXPECT_EQ(counts.device, 1);
+  EXPECT_EQ(counts.stream, 1);
+  EXPECT_EQ(
+      filter.dropCountsJson(),
+      R"({"total": 2, "type": 0, "duration": 0, "name": 0, "device": 1, "stream": 1})");
+
+  // Configuring again starts over.
+  filter.configure(*makeConfig(""));
+  EXPECT_EQ(filter.dropCounts().total(), 0);
+}
+
+TEST(ActivityFilterTest, CpuTrace) {
+  auto cfg = makeConfig(R"(
+    ACTIVITIES_FILTER_NAME_PREFIXES=aten::
+    ACTIVITIES_FILTER_MIN_DURATION_US=1)");
+  GenericActivityProfiler profiler(/*cpuOnly=*/true);
+  const auto now = system_clock::now();
+  profiler.configure(*cfg, now);
+  profiler.startTrace(now);
+
+  auto trace = std::make_unique<CpuTraceBuffer>();
+  trace->span = TraceSpan(0, 1000000, "step");
+  trace->gpuOpCount = 0;
+  trace->emplace_activity(makeActivity(ActivityType::CPU_OP, "aten::mm", 5000));
+  trace->emplace_activity(makeActivity(ActivityType::CPU_OP, "aten::view", 10));
+  trace->emplace_activity(
+      makeActivity(ActivityType::CPU_OP, "optimizer", 5000));
+  trace->emplace_activity(
+      makeActivity(ActivityType::USER_ANNOTATION, "aten::step", 8000));
+  profiler.transferCpuTrace(std::move(trace));
+  profiler.stopTrace(system_clock::now());
+
+  MemoryTraceLogger logger(*cfg);
+  profiler.processTrace(logger);
+
+  EXPECT_EQ(
+      names(logger), std::vector<std::string>({"aten::mm", "aten::step"}));
+  ASSERT_TRUE(logger.metadata().contains("filteredActivities"));
+  EXPECT_EQ(
+      logger.metadata().at("filteredActivities"),
+      R"({"total": 2, "type": 0, "duration": 1, "name": 1, "device": 0, "stream": 0})");
+}
+
+TEST(ActivityFilterTest, GpuActivities) {
+  auto cfg = makeConfig(R"(
+    ACTIVITIES_FILTER_TYPES=kernel,cuda_runtime
+    ACTIVITIES_FILTER_STREAMS=7)");
+  MockGpuActivityProfiler profiler;
+  const auto start = system_clock::now();
+  profiler.configure(*cfg, start);
+  profiler.startTrace(start);
+  const auto end = start + milliseconds(10);
+  profiler.stopTrace(end);
+
+  // Activities have to be in the capture window.
+  const int64_t ts = timeSinceEpoch(start + milliseconds(1));
+  auto gpuActivity =
+      [ts](ActivityType type, const std::string& name, int64_t stream) {
+        auto act = makeActivity(type, name, 1000, 0, stream);
+        act.startTime = ts;
+        act.endTime = ts + 1000;
+        return act;
+      };
+  profiler.addGpuActivity(
+      gpuActivity(ActivityType::CONCURRENT_KERNEL, "kept", 7));
+  profiler.addGpuActivity(
+      gpuActivity(ActivityType::CONCURRENT_KERNEL, "other stream", 8));
+  profiler.addGpuActivity(gpuActivity(ActivityType::GPU_MEMCPY, "memcpy", 7));
+  profiler.addGpuActivity(
+      gpuActivity(ActivityType::CUDA_RUNTIME, "cudaLaunchKernel", 1));
+
+  MemoryTraceLogger logger(*cfg);
+  profiler.processTrace(logger);
+
+  EXPECT_EQ(
+      names(logger), std::vector<std::string>({"kept", "cudaLaunchKernel"}));
+  ASSERT_TRUE(logger.metadata().contains("filteredActivities"));
+  EXPECT_EQ(
+      logger.metadata().at("filteredActivities"),
+      R"({"total": 2, "type": 1, "duration": 0, "name": 0, "device": 0, "stream": 1})");
+}
+
+// Without a filter, the trace metadata is as before.
+TEST(ActivityFilterTest, NoMetadataWithoutFilter) {
+  auto cfg = makeConfig("");
+  GenericActivityProfiler profiler(/*cpuOnly=*/true);
+  const auto now = system_clock::now();
+  profiler.configure(*cfg, now);
+  profiler.startTrace(now);
+  profiler.stopTrace(now);
+
+  MemoryTraceLogger logger(*cfg);
+  profiler.processTrace(logger);
+  EXPECT_FALSE(logger.metadata().contains("filteredActivities"));
+}
@@ -13,6 +13,7 @@
 #include <chrono>
 #include <fstream>
 #include <string>
+#include <thread>
 
 #include "include/Config.h"
 #include "src/ActivityProfilerController.h"
@@ -247,3 +248,67 @@ TEST(ActivityProfilerController, CanAcceptConfigReflectsActiveState) {
   EXPECT_TRUE(controller.isActive());
   EXPECT_FALSE(controller.canAcceptConfig());
 }
+
+// A running flight recorder keeps the profiler active, but dump and stop
+// requests still reach it through the controller; other requests do not.
+TEST(ActivityProfilerController, FlightRecorderDumpAndStop) {
+  auto traceFile = createTempTraceFile("libkineto_test", ".json");
+  auto dumpFile = createTempTraceFile("libkineto_test_dump", ".json");
+
+  Config cfg;
+  ASSERT_TRUE(cfg.parse(fmt::format(
+      R"CFG(
+    PROFILE_START_ITERATION = 2
+    ACTIVITIES_WARMUP_ITERATIONS = 1
+    ACTIVITIES_ITERATIONS = 1
+    ACTIVITIES_FLIGHT_RECORDER = true
+    ACTIVITIES_FLIGHT_RECORDER_WINDOW_ITERATIONS = 4
+    ACTIVITIES_LOG_FILE = {}
+  )CFG",
+      traceFile.path())));
+  Config dumpCfg;
+  ASSERT_TRUE(dumpCfg.parse(fmt::format(
+      R"CFG(
+    ACTIVITIES_FLIGHT_RECORDER_DUMP = true
+    ACTIVITIES_LOG_FILE = {}
+  )CFG",
+      dumpFile.path())));
+  Config stopCfg;
+  ASSERT_TRUE(stopCfg.parse("ACTIVITIES_FLIGHT_RECORDER_STOP = true"));
+
+  ActivityProfilerController controller(ConfigLoader::instance(), true);
+  // Nothing to dump or stop yet.
+  EXPECT_FALSE(controller.acceptConfig(dumpCfg));
+  EXPECT_FALSE(controller.stopFlightRecorder());
+
+  controller.asyncStep();
+  EXPECT_TRUE(controller.acceptConfig(cfg));
+  for (int i = 0; i < 4; ++i) {
+    controller.asyncStep();
+  }
+  EXPECT_TRUE(controller.isActive());
+  EXPECT_TRUE(controller.canAcceptConfig());
+
+  // A regular request is turned away.
+  Config traceCfg;
+  ASSERT_TRUE(traceCfg.parse(fmt::format(
+      "ACTIVITIES_LOG_FILE = {}", traceFile.path())));
+  EXPECT_FALSE(controller.acceptConfig(traceCfg));
+
+  // The dump is written by the profiler loop, while recording carries on.
+  EXPECT_TRUE(controller.acceptConfig(dumpCfg));
+  const std::string dumpLog = logUrlToPath(dumpCfg.activitiesLogUrl());
+  const auto deadline = steady_clock::now() + seconds(10);
+  while (!traceFileHasContent(dumpLog) && steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(milliseconds(10));
+  }
+  EXPECT_TRUE(traceFileHasContent(dumpLog)) << dumpLog;
+  EXPECT_TRUE(controller.isActive());
+
+  EXPECT_TRUE(controller.acceptConfig(stopCfg));
+  while (controller.isActive() && steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(milliseconds(10));
+  }
+  EXPECT_FALSE(controller.isActive());
+  EXPECT_TRUE(controller.canAcceptConfig());
+}
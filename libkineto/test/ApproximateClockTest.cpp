@@ -9,6 +9,8 @@
 #include "src/ApproximateClock.h"
 
 #include <chrono>
+#include <functional>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -98,3 +100,66 @@ TEST(ApproximateClockTest, GetTimeIsPositiveAndAdvances) {
   } while (t1 == t0 && std::chrono::steady_clock::now() < deadline);
   EXPECT_GT(t1, t0);
 }
+
+TEST(ApproximateClockTest, ConversionMatchesConverterFunction) {
+  ApproximateClockToUnixTimeConverter converter;
+  auto conversion = converter.makeConversion();
+  std::function<libkineto::time_t(approx_time_t)> convert =
+      [conversion](approx_time_t t) { return conversion.convert(t); };
+  EXPECT_FALSE(conversion.identity);
+  EXPECT_GT(conversion.scale_factor, 0.0);
+
+  approx_time_t now = getApproximateTime();
+  EXPECT_EQ(convert(now), conversion.convert(now));
+  // Times before the reference point are clamped to 0.
+  EXPECT_EQ(conversion.convert(conversion.t0_approx), 0);
+  EXPECT_EQ(conversion.convert(0), 0);
+}
+
+TEST(ApproximateClockTest, BatchConversionMatchesScalar) {
+  ApproximateClockConversion conversion{
+      .t0_approx = 1000,
+      .t0 = 1'700'000'000'000'000'000,
+      .scale_factor = 0.37,
+      .identity = false};
+  std::vector<approx_time_t> in;
+  for (approx_time_t t = 0; t < 100000; t += 7) {
+    in.push_back(t * 1013);
+  }
+  std::vector<libkineto::time_t> out(in.size());
+  conversion.convert(in, out);
+  for (size_t i = 0; i < in.size(); i++) {
+    ASSERT_EQ(out[i], conversion.convert(in[i])) << "at " << in[i];
+  }
+
+  // Identity, through the converter.
+  ApproximateTimeConverter converter;
+  EXPECT_TRUE(converter.isIdentity());
+  converter.convert(in, out);
+  for (size_t i = 0; i < in.size(); i++) {
+    ASSERT_EQ(out[i], static_cast<libkineto::time_t>(in[i]));
+  }
+}
+
+TEST(ApproximateClockTest, ConverterHoldsConversionOrFunction) {
+  ApproximateTimeConverter converter;
+  EXPECT_EQ(converter(12345), 12345);
+
+  converter = [](approx_time_t t) {
+    return static_cast<libkineto::time_t>(2 * t);
+  };
+  EXPECT_FALSE(converter.isIdentity());
+  EXPECT_EQ(converter(21), 42);
+  std::vector<approx_time_t> in = {1, 2, 3};
+  std::vector<libkineto::time_t> out(in.size());
+  converter.convert(in, out);
+  EXPECT_EQ(out, (std::vector<libkineto::time_t>{2, 4, 6}));
+
+  converter = ApproximateClockConversion{
+      .t0_approx = 100, .t0 = 5000, .scale_factor = 2.0, .identity = false};
+  EXPECT_EQ(converter(150), 5100);
+  EXPECT_EQ(converter(50), 0);
+
+  converter = ApproximateClockConversion();
+  EXPECT_TRUE(converter.isIdentity());
+}
@@ -13,12 +13,17 @@
 
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <fstream>
 #include <future>
 #include <mutex>
+#include <set>
+#include <thread>
 
 #include "include/Config.h"
+#include "include/GenericTraceActivity.h"
 #include "include/libkineto.h"
+#include "include/time_since_epoch.h"
 #include "src/AsyncActivityProfilerHandler.h"
 #include "src/GenericActivityProfiler.h"
 
@@ -48,10 +53,23 @@ class MockGpuProfiler : public GenericActivityProfiler {
     gpuStopped_ = stopped;
   }
 
+  int enableCount{0};
+  int disableCount{0};
+  int clearCount{0};
+
  protected:
   bool isGpuCollectionStopped() const override {
     return gpuStopped_;
   }
+  void enableGpuTracing() override {
+    ++enableCount;
+  }
+  void disableGpuTracing() override {
+    ++disableCount;
+  }
+  void clearGpuActivities() override {
+    ++clearCount;
+  }
 
  private:
   bool gpuStopped_{false};
@@ -68,7 +86,9 @@ class MockClientInterface : public libkineto::ClientInterface {
       bool /*unused*/,
       bool /*unused*/,
       bool /*unused*/,
-      bool /*unused*/) override {}
+      bool /*unused*/) override {
+    ++prepareCount;
+  }
   void start() override {
     ++startCount;
   }
@@ -104,6 +124,7 @@ class MockClientInterface : public libkineto::ClientInterface {
     return memoryStopPromise_.get_future();
   }
 
+  std::atomic<int> prepareCount{0};
   std::atomic<int> startCount{0};
   std::atomic<int> stopCount{0};
   std::atomic<int> memoryStartCount{0};
@@ -449,13 +470,12 @@ TEST(AsyncActivityProfilerHandler, FinalizesPendingTraceOnTeardown) {
     EXPECT_TRUE(handler.isAsyncActive());
 
     // CollectTrace -> ProcessTrace asynchronously. Application step()
-    // deliberately does not finalize ProcessTrace; the loop thread should do
-    // that while exiting.
+    // deliberately does not finalize ProcessTrace; the loop thread does,
+    // either once woken up or while exiting.
     handler.step();
     handler.ensureCollectTraceDone();
-    EXPECT_TRUE(handler.isAsyncActive());
 
-    // handler goes out of scope here with a collected trace still pending.
+    // handler may go out of scope here with a collected trace still pending.
   }
 
   // The pending trace must have been finalized during teardown.
@@ -848,3 +868,469 @@ TEST_F(AsyncClientTest, MemoryProfileRequestDrivesClientHooks) {
   EXPECT_EQ(client_.memoryExportCount.load(), 1);
   EXPECT_EQ(client_.exportedPath(), traceFile.path());
 }
+
+namespace {
+
+// A CPU span with a single op of the same name, as the client would send.
+std::unique_ptr<CpuTraceBuffer> makeCpuSpan(
+    const std::string& name,
+    time_point<system_clock> time) {
+  const int64_t start = libkineto::timeSinceEpoch(time);
+  auto trace = std::make_unique<CpuTraceBuffer>();
+  trace->span = TraceSpan(start, start + 1000, name);
+  trace->gpuOpCount = 0;
+  GenericTraceActivity op(trace->span, ActivityType::CPU_OP, name);
+  op.startTime = start;
+  op.endTime = start + 1000;
+  trace->emplace_activity(std::move(op));
+  return trace;
+}
+
+// Names of the CPU ops in a JSON trace.
+std::set<std::string> cpuOpNames(const Config& cfg) {
+  std::ifstream file(logUrlToPath(cfg.activitiesLogUrl()));
+  EXPECT_TRUE(file.is_open());
+  const auto trace = nlohmann::json::parse(file);
+  std::set<std::string> names;
+  for (const auto& event : trace["traceEvents"]) {
+    if (event.value("cat", "") == "cpu_op") {
+      names.insert(event["name"].get<std::string>());
+    }
+  }
+  return names;
+}
+
+std::unique_ptr<Config> makeFlightRecorderConfig(
+    time_point<system_clock> startTime,
+    const std::string& options) {
+  auto cfg = std::make_unique<Config>();
+  EXPECT_TRUE(cfg->parse(fmt::format(
+      R"CFG(
+    ACTIVITIES_FLIGHT_RECORDER = true
+    ACTIVITIES_WARMUP_PERIOD_SECS = 1
+    PROFILE_START_TIME = {}
+    {}
+  )CFG",
+      duration_cast<milliseconds>(startTime.time_since_epoch()).count(),
+      options)));
+  return cfg;
+}
+
+std::unique_ptr<Config> makeDumpConfig(const TempTraceFile& traceFile) {
+  auto cfg = std::make_unique<Config>();
+  EXPECT_TRUE(cfg->parse(fmt::format(
+      R"CFG(
+    ACTIVITIES_FLIGHT_RECORDER_DUMP = true
+    ACTIVITIES_LOG_FILE = {}
+  )CFG",
+      traceFile.path())));
+  return cfg;
+}
+
+} // namespace
+
+// The flight recorder keeps tracing in segments and retains the ones that
+// overlap the window. A dump writes only the retained window, and recording
+// carries on afterwards.
+TEST(AsyncActivityProfilerHandler, FlightRecorderRetainsLatestWindow) {
+  GenericActivityProfiler profiler(/*cpu only*/ true);
+  AsyncActivityProfilerHandler handler(profiler);
+  auto traceFile = createTempTraceFile("libkineto_test_flight", ".json");
+
+  auto now = system_clock::now();
+  auto startTime = now + seconds(2);
+  // A 4s window recorded in 2s segments.
+  auto cfg = makeFlightRecorderConfig(
+      startTime,
+      R"CFG(
+    ACTIVITIES_FLIGHT_RECORDER_WINDOW_SECS = 4
+    ACTIVITIES_FLIGHT_RECORDER_SEGMENTS = 2
+  )CFG");
+  auto dumpCfg = makeDumpConfig(traceFile);
+
+  // Nothing to dump before the flight recorder runs.
+  EXPECT_FALSE(handler.requestFlightRecorderDump(*dumpCfg));
+
+  handler.configure(*cfg, now);
+  EXPECT_TRUE(handler.isFlightRecording());
+  handler.performRunLoopStep(startTime, startTime);
+  EXPECT_TRUE(handler.isAsyncActive());
+
+  // One span per second, for 10 seconds.
+  auto t = startTime;
+  for (int i = 0; i < 10; i++) {
+    profiler.transferCpuTrace(makeCpuSpan(fmt::format("op{}", i), t));
+    t += seconds(1);
+    handler.performRunLoopStep(t, t + seconds(1));
+  }
+  // Segments ending at 8s and 10s are retained; the one ending at 6s lies
+  // entirely outside the window.
+  ASSERT_NE(handler.flightRecorder(), nullptr);
+  EXPECT_EQ(handler.flightRecorder()->segmentCount(), 2);
+  EXPECT_EQ(handler.flightRecorder()->eventCount(), 8);
+
+  // Regular trace requests are turned away while recording.
+  Config traceCfg;
+  EXPECT_FALSE(handler.scheduleTrace(traceCfg));
+
+  // The dump ends the current segment, so it includes the latest span.
+  profiler.transferCpuTrace(makeCpuSpan("op10", t));
+  EXPECT_TRUE(handler.scheduleTrace(*dumpCfg));
+  EXPECT_FALSE(handler.requestFlightRecorderDump(*dumpCfg));
+  t += milliseconds(500);
+  handler.performRunLoopStep(t, t + seconds(1));
+  EXPECT_EQ(handler.flightRecorder()->segmentCount(), 3);
+  EXPECT_TRUE(handler.isFlightRecording());
+
+#ifdef __linux__
+  EXPECT_EQ(
+      cpuOpNames(*dumpCfg),
+      std::set<std::string>({"op6", "op7", "op8", "op9", "op10"}));
+#endif
+
+  EXPECT_TRUE(handler.stopFlightRecorder());
+  handler.performRunLoopStep(t, t + seconds(1));
+  EXPECT_FALSE(handler.isFlightRecording());
+  EXPECT_FALSE(handler.isAsyncActive());
+  EXPECT_EQ(handler.flightRecorder(), nullptr);
+}
+
+// With a window counted in iterations, segments end on step() boundaries.
+TEST(AsyncActivityProfilerHandler, FlightRecorderIterationWindow) {
+  GenericActivityProfiler profiler(/*cpu only*/ true);
+  AsyncActivityProfilerHandler handler(profiler);
+  auto traceFile = createTempTraceFile("libkineto_test_flight", ".json");
+
+  auto now = system_clock::now();
+  auto startTime = now + seconds(2);
+  auto cfg = makeFlightRecorderConfig(
+      startTime,
+      R"CFG(
+    ACTIVITIES_FLIGHT_RECORDER_WINDOW_ITERATIONS = 4
+    ACTIVITIES_FLIGHT_RECORDER_SEGMENTS = 2
+  )CFG");
+
+  handler.configure(*cfg, now);
+  handler.performRunLoopStep(startTime, startTime);
+
+  for (int i = 0; i < 10; i++) {
+    profiler.transferCpuTrace(makeCpuSpan(fmt::format("step{}", i), now));
+    handler.step();
+    handler.performRunLoopStep(startTime, startTime);
+  }
+  // Two segments of two iterations each.
+  EXPECT_EQ(handler.flightRecorder()->segmentCount(), 2);
+
+  auto dumpCfg = makeDumpConfig(traceFile);
+  EXPECT_TRUE(handler.requestFlightRecorderDump(*dumpCfg));
+  handler.performRunLoopStep(startTime, startTime);
+#ifdef __linux__
+  EXPECT_EQ(
+      cpuOpNames(*dumpCfg),
+      std::set<std::string>({"step6", "step7", "step8", "step9"}));
+#endif
+}
+
+// The number of retained events stays within
+// ACTIVITIES_FLIGHT_RECORDER_MAX_EVENTS by evicting whole segments.
+TEST(AsyncActivityProfilerHandler, FlightRecorderEventLimit) {
+  GenericActivityProfiler profiler(/*cpu only*/ true);
+  AsyncActivityProfilerHandler handler(profiler);
+
+  auto now = system_clock::now();
+  auto startTime = now + seconds(2);
+  auto cfg = makeFlightRecorderConfig(
+      startTime,
+      R"CFG(
+    ACTIVITIES_FLIGHT_RECORDER_WINDOW_SECS = 60
+    ACTIVITIES_FLIGHT_RECORDER_SEGMENTS = 60
+    ACTIVITIES_FLIGHT_RECORDER_MAX_EVENTS = 10
+  )CFG");
+  handler.configure(*cfg, now);
+  handler.performRunLoopStep(startTime, startTime);
+
+  auto t = startTime;
+  for (int i = 0; i < 20; i++) {
+    // Three spans, i.e. six events, per segment.
+    for (int j = 0; j < 3; j++) {
+      profiler.transferCpuTrace(makeCpuSpan(fmt::format("op{}", i), t));
+    }
+    t += seconds(1);
+    handler.performRunLoopStep(t, t + seconds(1));
+    EXPECT_LE(handler.flightRecorder()->eventCount(), 10);
+  }
+  EXPECT_EQ(handler.flightRecorder()->segmentCount(), 1);
+  EXPECT_EQ(handler.flightRecorder()->eventCount(), 6);
+}
+
+// Every segment is a separate collection for the client, which is prepared
+// only once.
+TEST_F(AsyncClientTest, FlightRecorderRestartsClientPerSegment) {
+  GenericActivityProfiler profiler(/*cpu only*/ true);
+  AsyncActivityProfilerHandler handler(profiler);
+
+  auto now = system_clock::now();
+  auto startTime = now + seconds(2);
+  auto cfg = makeFlightRecorderConfig(
+      startTime,
+      R"CFG(
+    ACTIVITIES_FLIGHT_RECORDER_WINDOW_SECS = 2
+    ACTIVITIES_FLIGHT_RECORDER_SEGMENTS = 2
+  )CFG");
+  handler.configure(*cfg, now);
+  handler.performRunLoopStep(startTime, startTime);
+  EXPECT_EQ(client_.startCount.load(), 1);
+
+  auto t = startTime;
+  for (int i = 0; i < 3; i++) {
+    t += seconds(1);
+    handler.performRunLoopStep(t, t + seconds(1));
+  }
+  EXPECT_EQ(client_.startCount.load(), 4);
+  EXPECT_EQ(client_.stopCount.load(), 3);
+  EXPECT_EQ(client_.prepareCount.load(), 1);
+
+  handler.cancel();
+  EXPECT_FALSE(handler.isFlightRecording());
+  EXPECT_FALSE(handler.isAsyncActive());
+  EXPECT_EQ(client_.stopCount.load(), 4);
+}
+
+// GPU tracing stays enabled from one segment to the next, and is only set up
+// again once it has stopped at its buffer limit.
+TEST(AsyncActivityProfilerHandler, FlightRecorderKeepsGpuTracingEnabled) {
+  MockGpuProfiler profiler;
+  AsyncActivityProfilerHandler handler(profiler);
+
+  auto now = system_clock::now();
+  auto startTime = now + seconds(2);
+  auto cfg = makeFlightRecorderConfig(
+      startTime,
+      R"CFG(
+    ACTIVITIES_FLIGHT_RECORDER_WINDOW_SECS = 2
+    ACTIVITIES_FLIGHT_RECORDER_SEGMENTS = 2
+  )CFG");
+  handler.configure(*cfg, now);
+  handler.performRunLoopStep(startTime, startTime);
+  ASSERT_TRUE(handler.isFlightRecording());
+  const int enabled = profiler.enableCount;
+  const int cleared = profiler.clearCount;
+  EXPECT_EQ(profiler.disableCount, 0);
+
+  auto t = startTime;
+  for (int i = 0; i < 3; i++) {
+    profiler.transferCpuTrace(makeCpuSpan(fmt::format("op{}", i), t));
+    t += seconds(1);
+    handler.performRunLoopStep(t, t + seconds(1));
+  }
+  EXPECT_EQ(handler.flightRecorder()->segmentCount(), 2);
+  EXPECT_EQ(profiler.enableCount, enabled);
+  EXPECT_EQ(profiler.disableCount, 0);
+  EXPECT_EQ(profiler.clearCount, cleared);
+
+  profiler.setGpuCollectionStopped(true);
+  t += milliseconds(500);
+  handler.performRunLoopStep(t, t + seconds(1));
+  EXPECT_TRUE(handler.isFlightRecording());
+  EXPECT_EQ(profiler.disableCount, 1);
+  EXPECT_EQ(profiler.enableCount, enabled + 1);
+
+  profiler.setGpuCollectionStopped(false);
+  EXPECT_TRUE(handler.stopFlightRecorder());
+  handler.performRunLoopStep(t, t + seconds(1));
+  EXPECT_FALSE(handler.isAsyncActive());
+}
+
+// Drives the profiler loop through time. The loop sees the time set by
+// advanceTo(), and waits until the test advances the clock past its deadline
+// or the loop is woken up.
+class FakeRunLoopClock : public RunLoopClock {
+ public:
+  explicit FakeRunLoopClock(time_point now) : now_(now) {}
+
+  time_point now() const override {
+    std::scoped_lock lock(mutex_);
+    return now_;
+  }
+
+  void waitUntil(
+      std::condition_variable& cv,
+      std::unique_lock<std::mutex>& lock,
+      time_point deadline) override {
+    {
+      std::scoped_lock guard(mutex_);
+      deadline_ = deadline;
+      waiting_ = true;
+      loopCv_ = &cv;
+      loopMutex_ = lock.mutex();
+      waitingCv_.notify_all();
+    }
+    cv.wait(lock);
+  }
+
+  // Blocks until the loop waits, and returns its deadline.
+  time_point nextDeadline() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    EXPECT_TRUE(
+        waitingCv_.wait_for(lock, seconds(10), [this]() { return waiting_; }));
+    return deadline_;
+  }
+
+  void advanceTo(time_point t) {
+    std::condition_variable* cv = nullptr;
+    std::mutex* loopMutex = nullptr;
+    {
+      std::scoped_lock lock(mutex_);
+      now_ = t;
+      waiting_ = false;
+      cv = loopCv_;
+      loopMutex = loopMutex_;
+    }
+    if (cv != nullptr) {
+      // Taken once the loop is in cv.wait(), so the notification is not lost.
+      std::scoped_lock lock(*loopMutex);
+      cv->notify_all();
+    }
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  std::condition_variable waitingCv_;
+  time_point now_;
+  time_point deadline_;
+  bool waiting_{false};
+  std::condition_variable* loopCv_{nullptr};
+  std::mutex* loopMutex_{nullptr};
+};
+
+// The loop wakes up exactly at the deadlines of a trace: to activate the
+// request, to start tracing and to stop it. Once the trace is written it does
+// not wake up again, however much time passes.
+TEST(AsyncActivityProfilerHandler, RunLoopWakesAtTraceDeadlines) {
+  constexpr int kWarmupSecs = 2;
+  constexpr int kDurationSecs = 1;
+  // Whole milliseconds, as PROFILE_START_TIME is.
+  const auto now = time_point_cast<milliseconds>(system_clock::now());
+  const auto startTime = now + seconds(kWarmupSecs + 2);
+  const auto endTime = startTime + seconds(kDurationSecs);
+
+  FakeRunLoopClock clock(now);
+  GenericActivityProfiler profiler(/*cpu only*/ true);
+  AsyncActivityProfilerHandler handler(profiler, clock);
+
+  auto traceFile = createTempTraceFile("libkineto_test", ".json");
+  Config cfg;
+  ASSERT_TRUE(cfg.parse(fmt::format(
+      R"CFG(
+    ACTIVITIES_WARMUP_PERIOD_SECS = {}
+    ACTIVITIES_DURATION_SECS = {}
+    ACTIVITIES_LOG_FILE = {}
+    PROFILE_START_TIME = {}
+  )CFG",
+      kWarmupSecs,
+      kDurationSecs,
+      traceFile.path(),
+      duration_cast<milliseconds>(startTime.time_since_epoch()).count())));
+  ASSERT_TRUE(handler.scheduleTrace(cfg));
+
+  // Activated one controller interval ahead of the warmup.
+  const auto activationTime =
+      startTime - seconds(kWarmupSecs) - Config::kControllerIntervalMsecs;
+  auto deadline = clock.nextDeadline();
+  EXPECT_EQ(deadline, activationTime);
+
+  // Warmup flushes buffers every controller interval, up to the start time.
+  while (deadline < startTime) {
+    clock.advanceTo(deadline);
+    const auto next = clock.nextDeadline();
+    EXPECT_GT(next, deadline);
+    EXPECT_LE(next - deadline, Config::kControllerIntervalMsecs);
+    deadline = next;
+  }
+  EXPECT_TRUE(handler.isAsyncActive());
+  EXPECT_EQ(deadline, startTime);
+
+  clock.advanceTo(startTime);
+  EXPECT_EQ(clock.nextDeadline(), endTime);
+
+  clock.advanceTo(endTime);
+  EXPECT_EQ(clock.nextDeadline(), RunLoopWaker::kNever);
+  EXPECT_FALSE(handler.isAsyncActive());
+  checkTracefile(logUrlToPath(cfg.activitiesLogUrl()).c_str());
+
+  const auto wakeups = handler.runLoopWakeups();
+  clock.advanceTo(endTime + hours(24));
+  EXPECT_EQ(clock.nextDeadline(), RunLoopWaker::kNever);
+  EXPECT_EQ(handler.runLoopWakeups(), wakeups);
+}
+
+// A request in the future does not wake the loop before it is due.
+TEST(AsyncActivityProfilerHandler, RunLoopSleepsUntilRequestIsDue) {
+  const auto now = time_point_cast<milliseconds>(system_clock::now());
+  const auto startTime = now + hours(1);
+
+  FakeRunLoopClock clock(now);
+  GenericActivityProfiler profiler(/*cpu only*/ true);
+  AsyncActivityProfilerHandler handler(profiler, clock);
+
+  auto traceFile = createTempTraceFile("libkineto_test", ".json");
+  Config cfg;
+  ASSERT_TRUE(cfg.parse(fmt::format(
+      R"CFG(
+    ACTIVITIES_WARMUP_PERIOD_SECS = 0
+    ACTIVITIES_DURATION_SECS = 1
+    ACTIVITIES_LOG_FILE = {}
+    PROFILE_START_TIME = {}
+  )CFG",
+      traceFile.path(),
+      duration_cast<milliseconds>(startTime.time_since_epoch()).count())));
+  ASSERT_TRUE(handler.scheduleTrace(cfg));
+
+  const auto activationTime = startTime - Config::kControllerIntervalMsecs;
+  EXPECT_EQ(clock.nextDeadline(), activationTime);
+  // Lets the loop take the wake up from scheduleTrace() before counting.
+  clock.advanceTo(now);
+  EXPECT_EQ(clock.nextDeadline(), activationTime);
+  const auto wakeups = handler.runLoopWakeups();
+  for (auto t = now + minutes(10); t < activationTime; t += minutes(10)) {
+    clock.advanceTo(t);
+    EXPECT_EQ(clock.nextDeadline(), activationTime);
+  }
+  EXPECT_EQ(handler.runLoopWakeups(), wakeups);
+  EXPECT_FALSE(handler.isAsyncActive());
+}
+
+// A trace collected by step() is processed as soon as it is collected, and not
+// at the next deadline of the loop: the clock never moves here.
+TEST(AsyncActivityProfilerHandler, RunLoopProcessesIterationTraceOnCollection) {
+  const auto now = time_point_cast<milliseconds>(system_clock::now());
+  FakeRunLoopClock clock(now);
+  GenericActivityProfiler profiler(/*cpu only*/ true);
+  AsyncActivityProfilerHandler handler(profiler, clock);
+  handler.step();
+
+  auto traceFile = createTempTraceFile("libkineto_test", ".json");
+  Config cfg;
+  ASSERT_TRUE(cfg.parse(fmt::format(
+      R"CFG(
+    PROFILE_START_ITERATION = 3
+    ACTIVITIES_WARMUP_ITERATIONS = 1
+    ACTIVITIES_ITERATIONS = 2
+    ACTIVITIES_LOG_FILE = {}
+  )CFG",
+      traceFile.path())));
+  ASSERT_TRUE(handler.scheduleTrace(cfg));
+  // Iteration requests are activated by step(), not by the loop.
+  EXPECT_EQ(clock.nextDeadline(), RunLoopWaker::kNever);
+
+  for (int i = 0; i < 5; i++) {
+    handler.step();
+  }
+  const auto deadline = steady_clock::now() + seconds(10);
+  while (handler.isAsyncActive() && steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(milliseconds(10));
+  }
+  EXPECT_FALSE(handler.isAsyncActive());
+  EXPECT_EQ(clock.now(), now);
+  checkTracefile(logUrlToPath(cfg.activitiesLogUrl()).c_str());
+}
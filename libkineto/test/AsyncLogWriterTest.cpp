@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "include/ILoggerObserver.h"
+#include "src/AsyncLogWriter.h"
+
+using namespace KINETO_NAMESPACE;
+
+namespace {
+
+// Never wakes up by itself, so records are only written on flush() or when
+// a ring fills up.
+constexpr std::chrono::milliseconds kNoFlush = std::chrono::hours(1);
+
+class CapturingOutput {
+ public:
+  AsyncLogWriter::Output output() {
+    return [this](std::vector<LogRecord>& records) {
+      std::lock_guard<std::mutex> guard(mutex_);
+      for (auto& record : records) {
+        records_.push_back(std::move(record));
+      }
+    };
+  }
+
+  std::vector<LogRecord> records() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return records_;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<LogRecord> records_;
+};
+
+LogRecord makeRecord(int severity, std::string message) {
+  return {
+      std::chrono::system_clock::now(),
+      1,
+      2,
+      __FILE__,
+      __LINE__,
+      severity,
+      std::move(message)};
+}
+
+} // namespace
+
+TEST(AsyncLogWriterTest, WritesRecordsOnFlush) {
+  CapturingOutput output;
+  AsyncLogWriter writer(output.output(), 64, kNoFlush);
+  EXPECT_TRUE(writer.push(makeRecord(INFO, "first")));
+  EXPECT_TRUE(writer.push(makeRecord(ERROR, "second")));
+  EXPECT_TRUE(output.records().empty());
+
+  writer.flush();
+  auto records = output.records();
+  ASSERT_EQ(records.size(), 2);
+  EXPECT_EQ(records[0].message, "first");
+  EXPECT_EQ(records[1].message, "second");
+  EXPECT_EQ(records[1].severity, ERROR);
+  EXPECT_EQ(writer.dropped(), 0);
+}
+
+TEST(AsyncLogWriterTest, FlushesPeriodicallyAndOnDestruction) {
+  CapturingOutput output;
+  {
+    AsyncLogWriter writer(
+        output.output(), 64, std::chrono::milliseconds(1));
+    writer.push(makeRecord(INFO, "periodic"));
+    for (int i = 0; i < 1000 && output.records().empty(); i++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(output.records().size(), 1);
+    writer.push(makeRecord(INFO, "last"));
+  }
+  auto records = output.records();
+  ASSERT_EQ(records.size(), 2);
+  EXPECT_EQ(records[1].message, "last");
+}
+
+// A full ring drops records, and the next batch reports how many. The ring
+// may be drained at any time once half full, so only totals are checked.
+TEST(AsyncLogWriterTest, CountsDroppedRecords) {
+  CapturingOutput output;
+  AsyncLogWriter writer(output.output(), 4, kNoFlush);
+  int accepted = 0;
+  for (int i = 0; i < 100; i++) {
+    accepted += writer.push(makeRecord(INFO, std::to_string(i))) ? 1 : 0;
+  }
+  EXPECT_GE(accepted, 4);
+  EXPECT_EQ(writer.dropped(), 100 - accepted);
+  writer.flush();
+
+  int written = 0;
+  int reportedDrops = 0;
+  for (const auto& record : output.records()) {
+    if (record.severity == WARNING) {
+      const auto start = record.message.find(' ') + 1;
+      reportedDrops += std::stoi(record.message.substr(start));
+    } else {
+      written++;
+    }
+  }
+  EXPECT_EQ(written, accepted);
+  EXPECT_EQ(reportedDrops, 100 - accepted);
+
+  // Drops are only reported once.
+  const size_t total = output.records().size();
+  writer.flush();
+  EXPECT_EQ(output.records().size(), total);
+}
+
+// Records from many threads, including threads that have exited, are all
+// written, and those of each thread in order.
+TEST(AsyncLogWriterTest, CollectsRecordsFromManyThreads) {
+  constexpr int kThreads = 8;
+  constexpr int kRecords = 200;
+  CapturingOutput output;
+  AsyncLogWriter writer(output.output(), 1024, std::chrono::milliseconds(1));
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&writer, t] {
+      for (int i = 0; i < kRecords; i++) {
+        ASSERT_TRUE(writer.push(makeRecord(
+            INFO, std::to_string(t) + " " + std::to_string(i))));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  writer.flush();
+
+  const auto records = output.records();
+  ASSERT_EQ(records.size(), kThreads * kRecords);
+  std::map<int, int> next;
+  for (const auto& record : records) {
+    const auto space = record.message.find(' ');
+    const int thread = std::stoi(record.message.substr(0, space));
+    EXPECT_EQ(std::stoi(record.message.substr(space + 1)), next[thread]++);
+  }
+  EXPECT_EQ(writer.dropped(), 0);
+}
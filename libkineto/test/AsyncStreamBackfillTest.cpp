@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "src/AsyncStreamBackfill.h"
+
+using namespace KINETO_NAMESPACE;
+
+namespace {
+
+enum class Kind { kOther, kLaunch, kAsync };
+
+// Stands in for the runtime and async rows of a ROCm trace.
+struct Row {
+  uint64_t id{0};
+  Kind kind{Kind::kOther};
+  // Stream of a launch.
+  uint64_t launchStream{0};
+  // Async ops only.
+  int device{0};
+  uint64_t queue{0};
+  uint64_t stream{0};
+  bool selected{true};
+};
+
+uint64_t launchStream(const Row* row) {
+  return row->kind == Kind::kLaunch ? row->launchStream : 0;
+}
+
+Row* asyncOp(Row* row) {
+  return row->kind == Kind::kAsync && row->selected ? row : nullptr;
+}
+
+// The previous implementation of detail::backfillAsyncStreams, with several
+// passes over the rows and maps keyed by correlation id and queue.
+void referenceBackfill(std::vector<Row*>& rows) {
+  std::unordered_map<uint64_t, uint64_t> streamByCorrelation;
+  for (const auto* item : rows) {
+    const uint64_t sid = launchStream(item);
+    if (sid != 0) {
+      streamByCorrelation[item->id] = sid;
+    }
+  }
+  if (streamByCorrelation.empty()) {
+    return;
+  }
+
+  for (auto* item : rows) {
+    auto* async = asyncOp(item);
+    if (async == nullptr || async->stream != 0) {
+      continue;
+    }
+    const auto it = streamByCorrelation.find(async->id);
+    if (it != streamByCorrelation.end()) {
+      async->stream = it->second;
+    }
+  }
+
+  std::unordered_map<uint64_t, uint64_t> streamByQueue;
+  std::unordered_set<uint64_t> ambiguousQueues;
+  for (auto* item : rows) {
+    const auto* async = asyncOp(item);
+    if (async == nullptr || async->stream == 0 || async->queue == 0) {
+      continue;
+    }
+    if (ambiguousQueues.count(async->queue) > 0) {
+      continue;
+    }
+    const auto [it, inserted] =
+        streamByQueue.emplace(async->queue, async->stream);
+    if (!inserted && it->second != async->stream) {
+      streamByQueue.erase(it);
+      ambiguousQueues.insert(async->queue);
+    }
+  }
+  for (auto* item : rows) {
+    auto* async = asyncOp(item);
+    if (async == nullptr || async->stream != 0) {
+      continue;
+    }
+    const auto it = streamByQueue.find(async->queue);
+    if (it != streamByQueue.end()) {
+      async->stream = it->second;
+    }
+  }
+
+  constexpr uint64_t kQueueKeyTag = uint64_t{1} << 63;
+  std::unordered_map<int, std::unordered_map<uint64_t, uint64_t>>
+      deviceStreamToIndex;
+  for (auto* item : rows) {
+    auto* async = asyncOp(item);
+    if (async == nullptr) {
+      continue;
+    }
+    uint64_t key;
+    if (async->stream != 0) {
+      key = async->stream;
+    } else if (async->queue != 0) {
+      key = async->queue | kQueueKeyTag;
+    } else {
+      continue;
+    }
+    auto& mapping = deviceStreamToIndex[async->device];
+    auto [it, inserted] = mapping.emplace(key, mapping.size() + 1);
+    async->stream = it->second;
+  }
+}
+
+void backfill(std::vector<Row*>& rows) {
+  detail::backfillStreams(rows, launchStream, asyncOp);
+}
+
+std::vector<Row*> pointers(std::vector<Row>& rows) {
+  std::vector<Row*> result;
+  for (Row& row : rows) {
+    result.push_back(&row);
+  }
+  return result;
+}
+
+struct TraceShape {
+  int ops;
+  // Correlation ids are this far apart.
+  uint64_t idStride;
+  int devices;
+  int streams;
+  int queues;
+  // Percent of async ops with no launch, already with a stream, not
+  // selected, and with no queue.
+  int unlaunched;
+  int preassigned;
+  int unselected;
+  int noQueue;
+  // Percent of ops launched on a stream other than their queue's.
+  int crossQueue;
+};
+
+// Launches and async ops for a synthetic trace. Launches and async ops are
+// recorded in different places, so their order in the rows is mixed up, and
+// some correlation ids are launched twice.
+std::vector<Row> makeTrace(const TraceShape& shape, uint32_t seed) {
+  std::mt19937 rng(seed);
+  auto percent = [&rng](int p) {
+    return static_cast<int>(rng() % 100) < p;
+  };
+  std::vector<Row> rows;
+  const uint64_t firstId = 1000 + rng() % 1000;
+  for (int i = 0; i < shape.ops; i++) {
+    const uint64_t id = firstId + i * shape.idStride;
+    const int device = static_cast<int>(rng() % shape.devices);
+    const uint64_t stream = 0x7f0000001000 + (rng() % shape.streams) * 0x40;
+    const uint64_t queue = percent(shape.crossQueue)
+        ? 0x10 + rng() % shape.queues
+        : 0x10 + (stream / 0x40) % shape.queues;
+    if (!percent(shape.unlaunched)) {
+      Row launch;
+      launch.id = id;
+      launch.kind = Kind::kLaunch;
+      launch.launchStream = stream;
+      rows.push_back(launch);
+      if (percent(2)) {
+        launch.launchStream += 0x40;
+        rows.push_back(launch);
+      }
+    }
+    Row async;
+    async.id = id;
+    async.kind = Kind::kAsync;
+    async.device = device;
+    async.queue = percent(shape.noQueue) ? 0 : queue;
+    async.stream = percent(shape.preassigned) ? 0x5000 + rng() % 4 : 0;
+    async.selected = !percent(shape.unselected);
+    rows.push_back(async);
+    if (percent(10)) {
+      Row other;
+      other.id = id;
+      rows.push_back(other);
+    }
+  }
+  // Mix up neighbouring rows, as rows recorded on different threads are.
+  for (size_t i = 0; i + 1 < rows.size(); i++) {
+    if (percent(30)) {
+      std::swap(rows[i], rows[i + 1 + rng() % std::min<size_t>(
+                                              64, rows.size() - i - 1)]);
+    }
+  }
+  return rows;
+}
+
+void expectMatchesReference(const TraceShape& shape, uint32_t seed) {
+  std::vector<Row> expected = makeTrace(shape, seed);
+  std::vector<Row> actual = expected;
+  auto expectedRows = pointers(expected);
+  auto actualRows = pointers(actual);
+  referenceBackfill(expectedRows);
+  backfill(actualRows);
+  for (size_t i = 0; i < expected.size(); i++) {
+    ASSERT_EQ(actual[i].stream, expected[i].stream)
+        << "row " << i << " seed " << seed;
+  }
+}
+
+} // namespace
+
+TEST(AsyncStreamBackfillTest, ResolvesStreams) {
+  std::vector<Row> rows(7);
+  // Kernel 1 completes before its launch is seen.
+  rows[0] = {.id = 1, .kind = Kind::kAsync, .device = 0, .queue = 5};
+  rows[1] = {.id = 1, .kind = Kind::kLaunch, .launchStream = 0x700};
+  // Internal copy without a launch, on the same queue.
+  rows[2] = {.id = 2, .kind = Kind::kAsync, .device = 0, .queue = 5};
+  // Launch on another stream, and an op on a queue used by two streams.
+  rows[3] = {.id = 3, .kind = Kind::kLaunch, .launchStream = 0x900};
+  rows[4] = {.id = 3, .kind = Kind::kAsync, .device = 0, .queue = 6};
+  rows[5] = {.id = 4, .kind = Kind::kAsync, .device = 0, .queue = 6};
+  // Same stream on another device.
+  rows[6] = {.id = 3, .kind = Kind::kAsync, .device = 1, .queue = 7};
+  rows.push_back({.id = 5, .kind = Kind::kLaunch, .launchStream = 0x700});
+  rows.push_back({.id = 5, .kind = Kind::kAsync, .device = 0, .queue = 6});
+
+  auto ptrs = pointers(rows);
+  backfill(ptrs);
+  EXPECT_EQ(rows[0].stream, 1);
+  EXPECT_EQ(rows[2].stream, 1);
+  EXPECT_EQ(rows[4].stream, 2);
+  // Queue 6 is ambiguous, so it becomes a stream of its own.
+  EXPECT_EQ(rows[5].stream, 3);
+  EXPECT_EQ(rows[6].stream, 1);
+  EXPECT_EQ(rows[8].stream, 1);
+}
+
+TEST(AsyncStreamBackfillTest, NothingAssignedWithoutLaunches) {
+  std::vector<Row> rows(2);
+  rows[0] = {.id = 1, .kind = Kind::kAsync, .queue = 5};
+  rows[1] = {.id = 2, .kind = Kind::kAsync, .queue = 5, .stream = 0x700};
+  auto ptrs = pointers(rows);
+  backfill(ptrs);
+  EXPECT_EQ(rows[0].stream, 0);
+  EXPECT_EQ(rows[1].stream, 0x700);
+}
+
+TEST(AsyncStreamBackfillTest, MatchesReferenceOnDenseIds) {
+  const TraceShape shape{
+      .ops = 20000,
+      .idStride = 1,
+      .devices = 4,
+      .streams = 16,
+      .queues = 8,
+      .unlaunched = 10,
+      .preassigned = 5,
+      .unselected = 10,
+      .noQueue = 5,
+      .crossQueue = 5};
+  for (uint32_t seed = 1; seed <= 10; seed++) {
+    expectMatchesReference(shape, seed);
+  }
+}
+
+// Sparse correlation ids are looked up in a hash map instead.
+TEST(AsyncStreamBackfillTest, MatchesReferenceOnSparseIds) {
+  const TraceShape shape{
+      .ops = 5000,
+      .idStride = 1000003,
+      .devices = 2,
+      .streams = 64,
+      .queues = 4,
+      .unlaunched = 20,
+      .preassigned = 0,
+      .unselected = 0,
+      .noQueue = 10,
+      .crossQueue = 20};
+  for (uint32_t seed = 1; seed <= 10; seed++) {
+    expectMatchesReference(shape, seed);
+  }
+}
+
+TEST(AsyncStreamBackfillTest, MatchesReferenceOnEdgeCases) {
+  // Only internal ops, few enough launches for the dense range slack to
+  // matter, and many streams and queues.
+  const std::vector<TraceShape> shapes{
+      {1, 1, 1, 1, 1, 0, 0, 0, 0, 0},
+      {50, 1, 1, 1, 1, 100, 0, 0, 0, 0},
+      {200, 37, 3, 5, 2, 90, 10, 10, 10, 50},
+      {3000, 2, 8, 1000, 500, 30, 0, 0, 0, 100},
+      {3000, 1, 1, 3, 1, 50, 50, 50, 50, 0},
+  };
+  for (const auto& shape : shapes) {
+    for (uint32_t seed = 1; seed <= 20; seed++) {
+      expectMatchesReference(shape, seed);
+    }
+  }
+}
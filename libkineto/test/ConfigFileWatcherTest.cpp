@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "src/ConfigFileWatcher.h"
+
+using namespace KINETO_NAMESPACE;
+using namespace std::chrono;
+
+namespace {
+
+// Counts the calls from a watcher on a file in a fresh temporary directory.
+class ConfigFileWatcherTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    std::string dir = "/tmp/kineto_config_watcher_XXXXXX";
+    ASSERT_NE(mkdtemp(dir.data()), nullptr);
+    dir_ = dir;
+    path_ = dir_ + "/libkineto.conf";
+  }
+
+  void TearDown() override {
+    std::filesystem::remove_all(dir_);
+  }
+
+  std::unique_ptr<ConfigFileWatcher> watch(const std::string& path) {
+    return std::make_unique<ConfigFileWatcher>(path, [this]() {
+      std::scoped_lock lock(mutex_);
+      calls_++;
+      changed_.notify_all();
+    });
+  }
+
+  // Waits for the number of calls to go past count.
+  bool waitForCallAfter(int count, milliseconds timeout = seconds(10)) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return changed_.wait_for(lock, timeout, [&]() { return calls_ > count; });
+  }
+
+  int calls() {
+    std::scoped_lock lock(mutex_);
+    return calls_;
+  }
+
+  static void write(const std::string& path, const std::string& text) {
+    std::ofstream(path) << text;
+  }
+
+  std::string dir_;
+  std::string path_;
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  int calls_{0};
+};
+
+TEST_F(ConfigFileWatcherTest, NotifiesOnWrite) {
+  auto watcher = watch(path_);
+  ASSERT_TRUE(watcher->active());
+
+  const auto start = steady_clock::now();
+  write(path_, "ACTIVITIES_ENABLED=true\n");
+  ASSERT_TRUE(waitForCallAfter(0));
+  EXPECT_LT(steady_clock::now() - start, seconds(1));
+
+  const int count = calls();
+  write(path_, "ACTIVITIES_ENABLED=false\n");
+  EXPECT_TRUE(waitForCallAfter(count));
+}
+
+// Editors and config management tools write a new file and rename it over
+// the old one.
+TEST_F(ConfigFileWatcherTest, NotifiesOnReplaceAndRemove) {
+  write(path_, "ACTIVITIES_ENABLED=true\n");
+  auto watcher = watch(path_);
+  ASSERT_TRUE(watcher->active());
+
+  const std::string tmp = dir_ + "/.libkineto.conf.swp";
+  write(tmp, "ACTIVITIES_ENABLED=false\n");
+  ASSERT_EQ(std::rename(tmp.c_str(), path_.c_str()), 0);
+  ASSERT_TRUE(waitForCallAfter(0));
+
+  const int count = calls();
+  std::filesystem::remove(path_);
+  EXPECT_TRUE(waitForCallAfter(count));
+}
+
+TEST_F(ConfigFileWatcherTest, IgnoresOtherFiles) {
+  auto watcher = watch(path_);
+  ASSERT_TRUE(watcher->active());
+  write(dir_ + "/other.conf", "ACTIVITIES_ENABLED=true\n");
+  write(dir_ + "/libkineto.conf.bak", "ACTIVITIES_ENABLED=true\n");
+  EXPECT_FALSE(waitForCallAfter(0, milliseconds(200)));
+}
+
+// The caller polls instead.
+TEST_F(ConfigFileWatcherTest, InactiveWithoutDirectory) {
+  auto watcher = watch(dir_ + "/missing/libkineto.conf");
+  EXPECT_FALSE(watcher->active());
+}
+
+TEST_F(ConfigFileWatcherTest, InactiveOnceDirectoryIsRemoved) {
+  auto watcher = watch(path_);
+  ASSERT_TRUE(watcher->active());
+  std::filesystem::remove_all(dir_);
+  ASSERT_TRUE(waitForCallAfter(0));
+  const auto deadline = steady_clock::now() + seconds(10);
+  while (watcher->active() && steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(milliseconds(1));
+  }
+  EXPECT_FALSE(watcher->active());
+}
+
+} // namespace
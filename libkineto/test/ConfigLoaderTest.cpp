@@ -8,6 +8,12 @@
 
 #include <gtest/gtest.h>
 
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -15,9 +21,33 @@
 #include "src/ConfigLoader.h"
 
 using namespace KINETO_NAMESPACE;
+using namespace std::chrono;
 
 namespace {
 
+// ConfigLoader reads KINETO_CONFIG once, so point it at a file of this
+// binary's own before any test runs. The file does not exist until a test
+// writes it, which the loader treats like an empty config.
+struct TempConfigFile {
+  TempConfigFile() {
+    std::string dir = "/tmp/kineto_config_loader_XXXXXX";
+    if (mkdtemp(dir.data()) != nullptr) {
+      path = dir + "/libkineto.conf";
+      setenv("KINETO_CONFIG", path.c_str(), 1);
+    }
+  }
+
+  ~TempConfigFile() {
+    if (!path.empty()) {
+      std::filesystem::remove_all(std::filesystem::path(path).parent_path());
+    }
+  }
+
+  std::string path;
+};
+
+const TempConfigFile kConfigFile;
+
 // Records how ConfigLoader dispatches to a handler and lets a test control
 // whether canAcceptConfig() accepts, so the fan-out logic can be asserted
 // without a real profiler or the daemon poll thread.
@@ -147,4 +177,38 @@ TEST_F(ConfigLoaderTest, CanHandlerAcceptConfigIsPerKind) {
           ConfigLoader::ConfigKind::ActivityProfiler));
 }
 
+// A change to the config file is applied as soon as it is written, rather
+// than on the next poll of the file minutes later, and rewriting the same
+// text does not parse it again.
+TEST_F(ConfigLoaderTest, ReloadsConfigFileOnChange) {
+  ASSERT_FALSE(kConfigFile.path.empty());
+  RecordingConfigHandler handler;
+  registerHandler(ConfigLoader::ConfigKind::ActivityProfiler, &handler);
+
+  auto writeAndWait = [](const std::string& text, milliseconds period) {
+    const auto start = steady_clock::now();
+    std::ofstream(kConfigFile.path) << text;
+    while (loader().getConfigCopy()->samplePeriod() != period &&
+           steady_clock::now() - start < seconds(30)) {
+      std::this_thread::sleep_for(milliseconds(1));
+    }
+    return steady_clock::now() - start;
+  };
+
+  EXPECT_LT(
+      writeAndWait("SAMPLE_PERIOD_MSECS=1234\n", milliseconds(1234)),
+      seconds(2));
+  EXPECT_EQ(loader().getConfigCopy()->samplePeriod(), milliseconds(1234));
+
+  auto config = loader().getConfigCopy();
+  std::ofstream(kConfigFile.path) << "SAMPLE_PERIOD_MSECS=1234\n";
+  std::this_thread::sleep_for(milliseconds(200));
+  EXPECT_FALSE(loader().hasNewConfig(*config));
+
+  EXPECT_LT(
+      writeAndWait("SAMPLE_PERIOD_MSECS=567\n", milliseconds(567)),
+      seconds(2));
+  EXPECT_TRUE(loader().hasNewConfig(*config));
+}
+
 } // namespace
@@ -325,6 +325,105 @@ TEST(ParseTest, RequestTraceIds) {
   EXPECT_EQ(cfg.requestGroupTraceID(), "ABC");
 }
 
+TEST(ParseTest, SerializationThreads) {
+  Config cfg;
+  EXPECT_EQ(cfg.activitiesSerializationThreads(), 1);
+  EXPECT_TRUE(cfg.parse("ACTIVITIES_SERIALIZATION_THREADS=8"));
+  EXPECT_EQ(cfg.activitiesSerializationThreads(), 8);
+  // Clamped to [1, 64]
+  EXPECT_TRUE(cfg.parse("ACTIVITIES_SERIALIZATION_THREADS=0"));
+  EXPECT_EQ(cfg.activitiesSerializationThreads(), 1);
+  EXPECT_TRUE(cfg.parse("ACTIVITIES_SERIALIZATION_THREADS=1000"));
+  EXPECT_EQ(cfg.activitiesSerializationThreads(), 64);
+}
+
+TEST(ParseTest, ActivityFilter) {
+  Config cfg;
+  EXPECT_TRUE(cfg.activitiesFilterTypes().empty());
+  EXPECT_EQ(cfg.activitiesFilterMinDuration(), nanoseconds(0));
+  EXPECT_TRUE(cfg.activitiesFilterNameRegex().empty());
+  EXPECT_TRUE(cfg.activitiesFilterNamePrefixes().empty());
+  EXPECT_TRUE(cfg.activitiesFilterDevices().empty());
+  EXPECT_TRUE(cfg.activitiesFilterStreams().empty());
+
+  EXPECT_TRUE(cfg.parse(R"(
+    ACTIVITIES_FILTER_TYPES=kernel, GPU_MEMCPY
+    ACTIVITIES_FILTER_MIN_DURATION_US=5
+    ACTIVITIES_FILTER_NAME_REGEX=^(gemm|conv)
+    ACTIVITIES_FILTER_NAME_PREFIXES=aten::, nccl
+    ACTIVITIES_FILTER_DEVICES=0,2
+    ACTIVITIES_FILTER_STREAMS=7)"));
+  EXPECT_EQ(
+      cfg.activitiesFilterTypes(),
+      std::set<ActivityType>(
+          {ActivityType::CONCURRENT_KERNEL, ActivityType::GPU_MEMCPY}));
+  EXPECT_EQ(cfg.activitiesFilterMinDuration(), microseconds(5));
+  EXPECT_EQ(cfg.activitiesFilterNameRegex(), "^(gemm|conv)");
+  EXPECT_EQ(
+      cfg.activitiesFilterNamePrefixes(),
+      std::vector<std::string>({"aten::", "nccl"}));
+  EXPECT_EQ(cfg.activitiesFilterDevices(), std::set<int64_t>({0, 2}));
+  EXPECT_EQ(cfg.activitiesFilterStreams(), std::set<int64_t>({7}));
+
+  // Invalid regexes and types are rejected.
+  EXPECT_FALSE(cfg.parse("ACTIVITIES_FILTER_NAME_REGEX=(gemm"));
+  EXPECT_EQ(cfg.activitiesFilterNameRegex(), "^(gemm|conv)");
+  EXPECT_FALSE(cfg.parse("ACTIVITIES_FILTER_TYPES=not_a_type"));
+}
+
+TEST(ParseTest, CuptiHostBufferPool) {
+  Config cfg;
+  EXPECT_EQ(cfg.cuptiHostBufferPoolSize(), 0);
+  EXPECT_FALSE(cfg.cuptiHostBufferHugePages());
+  EXPECT_TRUE(cfg.parse(R"(
+    CUPTI_HOST_BUFFER_POOL_SIZE=16
+    CUPTI_HOST_BUFFER_HUGE_PAGES=true)"));
+  EXPECT_EQ(cfg.cuptiHostBufferPoolSize(), 16);
+  EXPECT_TRUE(cfg.cuptiHostBufferHugePages());
+  EXPECT_TRUE(cfg.parse("CUPTI_HOST_BUFFER_POOL_SIZE=0"));
+  EXPECT_EQ(cfg.cuptiHostBufferPoolSize(), 0);
+  // Clamped to 1024
+  EXPECT_TRUE(cfg.parse("CUPTI_HOST_BUFFER_POOL_SIZE=100000"));
+  EXPECT_EQ(cfg.cuptiHostBufferPoolSize(), 1024);
+}
+
+TEST(ParseTest, FlightRecorder) {
+  Config cfg;
+  EXPECT_FALSE(cfg.flightRecorderEnabled());
+  EXPECT_FALSE(cfg.flightRecorderDump());
+  EXPECT_EQ(cfg.flightRecorderWindow(), seconds(30));
+  EXPECT_EQ(cfg.flightRecorderWindowIterations(), 0);
+  EXPECT_EQ(cfg.flightRecorderSegments(), 4);
+  EXPECT_EQ(cfg.flightRecorderMaxEvents(), 1000000);
+
+  EXPECT_TRUE(cfg.parse(R"(
+    ACTIVITIES_FLIGHT_RECORDER=true
+    ACTIVITIES_FLIGHT_RECORDER_WINDOW_SECS=10
+    ACTIVITIES_FLIGHT_RECORDER_WINDOW_ITERATIONS=20
+    ACTIVITIES_FLIGHT_RECORDER_SEGMENTS=5
+    ACTIVITIES_FLIGHT_RECORDER_MAX_EVENTS=5000000000)"));
+  EXPECT_TRUE(cfg.flightRecorderEnabled());
+  EXPECT_EQ(cfg.flightRecorderWindow(), seconds(10));
+  EXPECT_EQ(cfg.flightRecorderWindowIterations(), 20);
+  EXPECT_EQ(cfg.flightRecorderSegments(), 5);
+  EXPECT_EQ(cfg.flightRecorderMaxEvents(), 5000000000);
+
+  // Out of range values are clamped.
+  EXPECT_TRUE(cfg.parse(R"(
+    ACTIVITIES_FLIGHT_RECORDER_WINDOW_SECS=0
+    ACTIVITIES_FLIGHT_RECORDER_SEGMENTS=0
+    ACTIVITIES_FLIGHT_RECORDER_MAX_EVENTS=0)"));
+  EXPECT_EQ(cfg.flightRecorderWindow(), seconds(1));
+  EXPECT_EQ(cfg.flightRecorderSegments(), 1);
+  EXPECT_EQ(cfg.flightRecorderMaxEvents(), 1);
+
+  EXPECT_TRUE(cfg.parse("ACTIVITIES_FLIGHT_RECORDER_DUMP=true"));
+  EXPECT_TRUE(cfg.flightRecorderDump());
+  EXPECT_FALSE(cfg.flightRecorderStop());
+  EXPECT_TRUE(cfg.parse("ACTIVITIES_FLIGHT_RECORDER_STOP=true"));
+  EXPECT_TRUE(cfg.flightRecorderStop());
+}
+
 // Trusted base config may set any trace path.
 TEST(ParseTest, BaseConfigLogFileUnrestricted) {
   Config cfg;
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "src/CuptiActivityBufferPool.h"
+
+using namespace KINETO_NAMESPACE;
+
+namespace {
+
+constexpr size_t kBufferSize = 64 * 1024;
+
+std::shared_ptr<CuptiActivityBufferPool> makePool(
+    int64_t maxInFlight,
+    size_t highWaterMark) {
+  auto pool = CuptiActivityBufferPool::create(kBufferSize);
+  pool->setMaxInFlight(maxInFlight);
+  pool->setHighWaterMark(highWaterMark);
+  return pool;
+}
+
+} // namespace
+
+TEST(CuptiActivityBufferPoolTest, RecyclesCompletedBuffers) {
+  auto pool = makePool(4, 2);
+  size_t size = 0;
+  uint8_t* data = pool->request(&size);
+  ASSERT_NE(data, nullptr);
+  EXPECT_EQ(size, kBufferSize);
+  EXPECT_EQ(pool->inFlight(), 1);
+
+  auto buffer = pool->complete(data, 100);
+  ASSERT_NE(buffer, nullptr);
+  EXPECT_EQ(buffer->data(), data);
+  EXPECT_EQ(buffer->size(), 100);
+  EXPECT_EQ(pool->inFlight(), 0);
+  EXPECT_EQ(pool->stats().completed, 1);
+
+  // Destroying the buffer returns its memory to the pool.
+  buffer.reset();
+  EXPECT_EQ(pool->stats().completed, 0);
+  EXPECT_EQ(pool->stats().idle, 1);
+  EXPECT_EQ(pool->request(&size), data);
+
+  const auto stats = pool->stats();
+  EXPECT_EQ(stats.allocated, 1);
+  EXPECT_EQ(stats.recycled, 1);
+  EXPECT_EQ(stats.idle, 0);
+}
+
+// Only buffers in flight count against the limit, as before pooling.
+TEST(CuptiActivityBufferPoolTest, RefusesRequestsBeyondMaxInFlight) {
+  auto pool = makePool(2, 2);
+  size_t size = 0;
+  uint8_t* first = pool->request(&size);
+  uint8_t* second = pool->request(&size);
+  ASSERT_NE(first, nullptr);
+  ASSERT_NE(second, nullptr);
+  EXPECT_EQ(pool->request(&size), nullptr);
+  EXPECT_EQ(pool->stats().exhausted, 1);
+  EXPECT_EQ(pool->stats().peakInFlight, 2);
+
+  // A completed buffer frees up a slot even while the trace holds it.
+  auto buffer = pool->complete(first, 0);
+  EXPECT_NE(pool->request(&size), nullptr);
+  EXPECT_EQ(pool->request(&size), nullptr);
+  EXPECT_EQ(pool->stats().exhausted, 2);
+
+  // Nothing may be handed out until the profiler is configured.
+  auto unconfigured = CuptiActivityBufferPool::create(kBufferSize);
+  EXPECT_EQ(unconfigured->request(&size), nullptr);
+}
+
+TEST(CuptiActivityBufferPoolTest, PrefaultsUpToHighWaterMark) {
+  auto pool = makePool(8, 3);
+  pool->prefault();
+  EXPECT_EQ(pool->stats().idle, 3);
+  EXPECT_EQ(pool->stats().allocated, 3);
+  // Already full.
+  pool->prefault();
+  EXPECT_EQ(pool->stats().allocated, 3);
+
+  // Requests are served from the pool without allocating.
+  size_t size = 0;
+  std::vector<uint8_t*> buffers;
+  for (int i = 0; i < 3; i++) {
+    buffers.push_back(pool->request(&size));
+  }
+  auto stats = pool->stats();
+  EXPECT_EQ(stats.allocated, 3);
+  EXPECT_EQ(stats.recycled, 3);
+  EXPECT_EQ(stats.idle, 0);
+
+  // Capped by the in-flight limit, since no more can be used at once.
+  auto capped = makePool(2, 5);
+  capped->prefault();
+  EXPECT_EQ(capped->stats().idle, 2);
+}
+
+TEST(CuptiActivityBufferPoolTest, FreesBuffersBeyondHighWaterMark) {
+  auto pool = makePool(8, 1);
+  size_t size = 0;
+  std::vector<std::unique_ptr<CuptiActivityBuffer>> buffers;
+  for (int i = 0; i < 3; i++) {
+    buffers.push_back(pool->complete(pool->request(&size), 0));
+  }
+  buffers.clear();
+  EXPECT_EQ(pool->stats().idle, 1);
+
+  // Lowering the high-water mark trims the pool.
+  pool->setHighWaterMark(0);
+  EXPECT_EQ(pool->stats().idle, 0);
+}
+
+TEST(CuptiActivityBufferPoolTest, RejectsUnknownBuffers) {
+  auto pool = makePool(2, 2);
+  uint8_t other[16];
+  EXPECT_EQ(pool->complete(other, 0), nullptr);
+
+  size_t size = 0;
+  uint8_t* data = pool->request(&size);
+  auto buffer = pool->complete(data, 0);
+  ASSERT_NE(buffer, nullptr);
+  // Already completed.
+  EXPECT_EQ(pool->complete(data, 0), nullptr);
+}
+
+TEST(CuptiActivityBufferPoolTest, BuffersOutliveThePoolOwner) {
+  auto pool = makePool(2, 2);
+  size_t size = 0;
+  auto buffer = pool->complete(pool->request(&size), 8);
+  std::weak_ptr<CuptiActivityBufferPool> weak = pool;
+  pool.reset();
+  EXPECT_FALSE(weak.expired());
+  buffer->data()[0] = 1;
+  buffer.reset();
+  EXPECT_TRUE(weak.expired());
+}
+
+TEST(CuptiActivityBufferPoolTest, AlignsHugePageBuffers) {
+  auto pool = CuptiActivityBufferPool::create(4 * 1024 * 1024);
+  pool->setMaxInFlight(2);
+  pool->setHighWaterMark(1);
+  pool->setHugePages(true);
+  pool->prefault();
+  size_t size = 0;
+  uint8_t* data = pool->request(&size);
+  ASSERT_NE(data, nullptr);
+  EXPECT_EQ(size, 4 * 1024 * 1024);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(data) % (2 * 1024 * 1024), 0);
+}
@@ -285,20 +285,33 @@ struct MockCuptiActivityBuffer {
 // Mock parts of the CuptiActivityApi
 class MockCuptiActivities : public CuptiActivityApi {
  public:
-  const std::pair<int, size_t> processActivities(
-      [[maybe_unused]] CuptiActivityBufferMap& bufferMap,
+  // Hands out the activities of activityBuffer split over numBuffers
+  // buffers, in order.
+  int processBufferActivities(
+      CuptiActivityBuffer& buffer,
       const std::function<void(const CUpti_Activity*)>& handler) override {
-    for (CUpti_Activity* act : activityBuffer->activities) {
-      handler(act);
+    const auto& activities = activityBuffer->activities;
+    const size_t index = bufferIndex_.at(buffer.data());
+    const size_t begin = activities.size() * index / numBuffers;
+    const size_t end = activities.size() * (index + 1) / numBuffers;
+    for (size_t i = begin; i < end; i++) {
+      handler(activities[i]);
     }
-    return {activityBuffer->activities.size(), 100};
+    return static_cast<int>(end - begin);
   }
 
   std::unique_ptr<CuptiActivityBufferMap> activityBuffers() override {
     auto map = std::make_unique<CuptiActivityBufferMap>();
-    auto buf = std::make_unique<CuptiActivityBuffer>(100);
-    uint8_t* addr = buf->data();
-    (*map)[addr] = std::move(buf);
+    for (int i = 0; i < numBuffers; i++) {
+      auto buf = std::make_unique<CuptiActivityBuffer>(100);
+      uint8_t* addr = buf->data();
+      (*map)[addr] = std::move(buf);
+    }
+    // Buffers are processed in address order.
+    bufferIndex_.clear();
+    for (const auto& [addr, buf] : *map) {
+      bufferIndex_.emplace(addr, bufferIndex_.size());
+    }
     return map;
   }
 
@@ -310,6 +323,10 @@ class MockCuptiActivities : public CuptiActivityApi {
   }
 
   std::unique_ptr<MockCuptiActivityBuffer> activityBuffer;
+  int numBuffers{1};
+
+ private:
+  std::map<const uint8_t*, size_t> bufferIndex_;
 };
 
 // Common setup / teardown and helper functions
@@ -1176,3 +1193,80 @@ TEST_F(CuptiActivityProfilerTest, WaitEventMapClearedOnReset) {
     }
   }
 }
+
+// Decoding the GPU buffers on several threads must not change the trace:
+// correlation and CUDA event state recorded in one buffer has to reach the
+// records of later buffers, and activities must come out in buffer order.
+TEST_F(CuptiActivityProfilerTest, ParallelBufferDecodeMatchesSerial) {
+  int64_t start_time_ns =
+      libkineto::timeSinceEpoch(std::chrono::system_clock::now());
+  int64_t duration_ns = 1000;
+  auto start_time = time_point<system_clock>(nanoseconds(start_time_ns));
+
+  auto runTrace = [&](int threads, int buffers) {
+    Config cfg;
+    cfg.parse(fmt::format("ACTIVITIES_SERIALIZATION_THREADS={}", threads));
+    cfg.validate(std::chrono::system_clock::now());
+    CuptiActivityProfiler profiler(cuptiActivities_, /*cpu only*/ false);
+    profiler.configure(cfg, start_time);
+    profiler.startTrace(start_time);
+    profiler.stopTrace(start_time + nanoseconds(duration_ns));
+    libkineto::get_time_converter() = [](approx_time_t t) { return t; };
+    profiler.recordThreadInfo();
+
+    auto cpuOps = std::make_unique<MockCpuActivityBuffer>(
+        start_time_ns, start_time_ns + duration_ns);
+    auto gpuOps = std::make_unique<MockCuptiActivityBuffer>();
+    for (int i = 0; i < 8; i++) {
+      const int64_t t = start_time_ns + 100 * i;
+      cpuOps->addOp(fmt::format("op{}", i), t + 10, t + 30, i + 1);
+      gpuOps->addCorrelationActivity(
+          10 + i, CUPTI_EXTERNAL_CORRELATION_KIND_CUSTOM0, i + 1);
+      gpuOps->addCudaEventActivity(100 + i, 42, 1, 0);
+    }
+    for (int i = 0; i < 8; i++) {
+      const int64_t t = start_time_ns + 100 * i;
+      gpuOps->addRuntimeActivity(CUDA_LAUNCH_KERNEL, t + 13, t + 18, 10 + i);
+      gpuOps->addKernelActivity(t + 50, t + 70, 10 + i, 0, 0, 1 + i % 2);
+      gpuOps->addMemcpyActivity(t + 72, t + 80, 10 + i);
+      gpuOps->addSyncActivity(
+          t + 82,
+          t + 84,
+          101 + i,
+          CUPTI_ACTIVITY_SYNCHRONIZATION_TYPE_STREAM_WAIT_EVENT,
+          2,
+          42);
+    }
+    profiler.transferCpuTrace(std::move(cpuOps));
+    cuptiActivities_.activityBuffer = std::move(gpuOps);
+    cuptiActivities_.numBuffers = buffers;
+
+    auto logger = std::make_unique<MemoryTraceLogger>(cfg);
+    profiler.processTrace(*logger);
+    profiler.reset();
+    cuptiActivities_.numBuffers = 1;
+
+    ActivityTrace trace(std::move(logger), loggerFactory);
+    std::vector<std::string> events;
+    for (const auto& activity : *trace.activities()) {
+      const auto* linked = activity->linkedActivity();
+      events.push_back(fmt::format(
+          "{} {} {} {} {} {} [{}]",
+          activity->name(),
+          activity->timestamp(),
+          activity->duration(),
+          activity->deviceId(),
+          activity->resourceId(),
+          linked ? linked->correlationId() : -1,
+          activity->metadataJson()));
+    }
+    return events;
+  };
+
+  const auto serial = runTrace(/*threads=*/1, /*buffers=*/1);
+  // CPU ops, runtime calls, kernels and memcpys, at least.
+  EXPECT_GE(serial.size(), 8 * 4);
+  EXPECT_EQ(runTrace(/*threads=*/1, /*buffers=*/5), serial);
+  EXPECT_EQ(runTrace(/*threads=*/4, /*buffers=*/5), serial);
+  EXPECT_EQ(runTrace(/*threads=*/8, /*buffers=*/3), serial);
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/Demangle.h"
+
+using namespace KINETO_NAMESPACE;
+
+namespace {
+
+constexpr const char* kMangled = "_ZN2at6native13reduce_kernelILi512ELi1EEEvv";
+constexpr const char* kDemangled = "void at::native::reduce_kernel<512, 1>()";
+
+} // namespace
+
+TEST(DemangleTest, Demangle) {
+  EXPECT_EQ(demangle(kMangled), kDemangled);
+  EXPECT_EQ(demangleUncached(kMangled), kDemangled);
+  EXPECT_EQ(demangle("not_mangled"), "not_mangled");
+  EXPECT_EQ(demangle(nullptr), "");
+  EXPECT_EQ(demangle(std::string(kMangled)), kDemangled);
+}
+
+TEST(DemangleTest, CountsHitsAndMisses) {
+  DemangleCache cache;
+  EXPECT_EQ(cache.demangle(kMangled), kDemangled);
+  EXPECT_EQ(cache.demangle(kMangled), kDemangled);
+  EXPECT_EQ(cache.demangle("not_mangled"), "not_mangled");
+  // Keyed by content, not by pointer.
+  const std::string copy(kMangled);
+  EXPECT_EQ(cache.demangle(copy.c_str()), kDemangled);
+
+  DemangleCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.hits, 2);
+  EXPECT_EQ(stats.misses, 2);
+  EXPECT_EQ(stats.uncached, 0);
+  EXPECT_EQ(stats.size, 2);
+
+  cache.clear();
+  stats = cache.stats();
+  EXPECT_EQ(stats.hits, 0);
+  EXPECT_EQ(stats.misses, 0);
+  EXPECT_EQ(stats.size, 0);
+}
+
+TEST(DemangleTest, StaysWithinCapacity) {
+  constexpr size_t kCapacity = 64;
+  DemangleCache cache(kCapacity);
+  for (int i = 0; i < 1000; i++) {
+    const std::string name = "_Z6kernelILi" + std::to_string(i) + "EEvv";
+    EXPECT_EQ(
+        cache.demangle(name.c_str()),
+        "void kernel<" + std::to_string(i) + ">()");
+    EXPECT_LE(cache.stats().size, kCapacity);
+  }
+  const DemangleCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.misses, 1000);
+  EXPECT_GT(stats.uncached, 0);
+  EXPECT_EQ(stats.misses - stats.uncached, static_cast<int64_t>(stats.size));
+}
+
+// Cached names are not evicted by later ones, so references to them stay
+// valid; names that do not fit are still demangled.
+TEST(DemangleTest, InternsNames) {
+  constexpr size_t kCapacity = 16;
+  DemangleCache cache(kCapacity);
+  const std::string& interned = cache.demangle(kMangled);
+  for (int i = 0; i < 100; i++) {
+    const std::string name = "_Z6kernelILi" + std::to_string(i) + "EEvv";
+    EXPECT_EQ(
+        cache.demangle(name.c_str()),
+        "void kernel<" + std::to_string(i) + ">()");
+  }
+  EXPECT_EQ(interned, kDemangled);
+  EXPECT_EQ(&cache.demangle(kMangled), &interned);
+  EXPECT_GT(cache.stats().uncached, 0);
+}
+
+TEST(DemangleTest, ConcurrentLookups) {
+  constexpr int kThreads = 8;
+  constexpr int kNames = 100;
+  constexpr int kRounds = 50;
+  DemangleCache cache;
+  std::vector<std::thread> threads;
+  std::vector<int> mismatches(kThreads, 0);
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&, t] {
+      for (int r = 0; r < kRounds; r++) {
+        for (int i = 0; i < kNames; i++) {
+          const std::string name = "_Z6kernelILi" + std::to_string(i) + "EEvv";
+          if (cache.demangle(name.c_str()) !=
+              "void kernel<" + std::to_string(i) + ">()") {
+            mismatches[t]++;
+          }
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  for (int t = 0; t < kThreads; t++) {
+    EXPECT_EQ(mismatches[t], 0);
+  }
+  const DemangleCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.size, kNames);
+  EXPECT_EQ(stats.hits + stats.misses, int64_t{kThreads} * kRounds * kNames);
+  // Threads racing on the first lookup of a name may all miss.
+  EXPECT_GE(stats.misses, kNames);
+  EXPECT_LE(stats.misses, kThreads * kNames);
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <random>
+#include <set>
+#include <unordered_map>
+
+#include "src/FlatHashMap.h"
+
+using namespace KINETO_NAMESPACE;
+
+TEST(FlatHashMapTest, InsertFindAndOverwrite) {
+  FlatHashMap<int64_t, int64_t> map;
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(map.find(1), map.end());
+
+  map[1] = 10;
+  EXPECT_TRUE(map.insert({2, 20}).second);
+  // insert() keeps the existing value, operator[] overwrites it.
+  auto [it, inserted] = map.insert({1, 11});
+  EXPECT_FALSE(inserted);
+  EXPECT_EQ(it->second, 10);
+  map[2] = 21;
+
+  EXPECT_EQ(map.size(), 2);
+  EXPECT_EQ(map.find(1)->second, 10);
+  EXPECT_EQ(map.find(2)->second, 21);
+  EXPECT_TRUE(map.contains(2));
+  EXPECT_EQ(map.count(3), 0);
+  EXPECT_EQ(map.find(3), map.end());
+
+  const auto& constMap = map;
+  EXPECT_EQ(constMap.find(1)->second, 10);
+  EXPECT_EQ(constMap.find(3), constMap.end());
+}
+
+TEST(FlatHashMapTest, HandlesReservedKey) {
+  constexpr int64_t kMin = std::numeric_limits<int64_t>::min();
+  FlatHashMap<int64_t, int> map;
+  EXPECT_FALSE(map.contains(kMin));
+  map[kMin] = 1;
+  map[0] = 2;
+  EXPECT_EQ(map.size(), 2);
+  EXPECT_EQ(map.find(kMin)->second, 1);
+
+  // Survives rehashing and shows up when iterating.
+  for (int i = 1; i < 1000; i++) {
+    map[i] = i;
+  }
+  EXPECT_EQ(map.find(kMin)->second, 1);
+  int64_t keySum = 0;
+  size_t entries = 0;
+  for (const auto& [key, value] : map) {
+    if (key != kMin) {
+      keySum += key;
+    }
+    entries++;
+  }
+  EXPECT_EQ(entries, 1001);
+  EXPECT_EQ(keySum, 999 * 1000 / 2);
+}
+
+TEST(FlatHashMapTest, ReserveAvoidsRehash) {
+  FlatHashMap<int64_t, int64_t> map;
+  map.reserve(100000);
+  const size_t capacity = map.capacity();
+  EXPECT_GE(capacity * 3, 100000u * 4);
+  for (int64_t i = 0; i < 100000; i++) {
+    map[i * 7] = i;
+  }
+  EXPECT_EQ(map.capacity(), capacity);
+
+  map.clear();
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(map.capacity(), 0);
+  EXPECT_EQ(map.begin(), map.end());
+  EXPECT_EQ(map.find(7), map.end());
+}
+
+// Randomized comparison against std::unordered_map, with keys drawn from a
+// small range so that most operations hit existing entries.
+TEST(FlatHashMapTest, MatchesUnorderedMap) {
+  std::mt19937_64 rng(1234);
+  FlatHashMap<int32_t, uint64_t> map;
+  std::unordered_map<int32_t, uint64_t> expected;
+  std::uniform_int_distribution<int32_t> keys(-50000, 50000);
+  for (int i = 0; i < 200000; i++) {
+    const int32_t key = keys(rng);
+    switch (rng() % 3) {
+      case 0:
+        map[key] = i;
+        expected[key] = i;
+        break;
+      case 1:
+        EXPECT_EQ(
+            map.insert({key, i}).second, expected.insert({key, i}).second);
+        break;
+      default: {
+        auto it = map.find(key);
+        auto expectedIt = expected.find(key);
+        ASSERT_EQ(it == map.end(), expectedIt == expected.end());
+        if (expectedIt != expected.end()) {
+          EXPECT_EQ(it->second, expectedIt->second);
+        }
+      }
+    }
+  }
+  EXPECT_EQ(map.size(), expected.size());
+  const std::map<int32_t, uint64_t> iterated(map.begin(), map.end());
+  const std::map<int32_t, uint64_t> sorted(expected.begin(), expected.end());
+  EXPECT_EQ(iterated, sorted);
+}
+
+// Pointers, e.g. to HIP streams, have all their low bits zero. The default
+// hash puts all of those below in one slot of a small table; MixedKeyHash
+// spreads them.
+TEST(FlatHashMapTest, MixedKeyHashSpreadsPointers) {
+  constexpr int kLog2Capacity = 4;
+  constexpr size_t kMask = (size_t{1} << kLog2Capacity) - 1;
+  std::set<size_t> sequentialSlots;
+  std::set<size_t> mixedSlots;
+  for (uint64_t i = 0; i < 8; i++) {
+    const uint64_t pointer = 0x7f0000000000 + (i << 20);
+    sequentialSlots.insert(
+        SequentialKeyHash::hash(pointer, kLog2Capacity) & kMask);
+    mixedSlots.insert(MixedKeyHash::hash(pointer, kLog2Capacity) & kMask);
+  }
+  EXPECT_EQ(sequentialSlots.size(), 1u);
+  EXPECT_GE(mixedSlots.size(), 5u);
+
+  FlatHashMap<uint64_t, int, MixedKeyHash> map;
+  std::unordered_map<uint64_t, int> expected;
+  for (int i = 0; i < 10000; i++) {
+    const uint64_t pointer = 0x7f0000000000 + (uint64_t(i) << 12);
+    map[pointer] = i;
+    expected[pointer] = i;
+  }
+  EXPECT_EQ(map.size(), expected.size());
+  for (const auto& [key, value] : expected) {
+    const auto it = map.find(key);
+    ASSERT_NE(it, map.end());
+    EXPECT_EQ(it->second, value);
+  }
+}
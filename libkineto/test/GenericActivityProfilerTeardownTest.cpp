@@ -50,8 +50,9 @@ class GenericActivityProfilerTeardownTest : public ::testing::Test {
 
 // A span arriving after teardown must be discarded, not dereferenced.
 // acceptCpuTraces_ is still true here, so the acceptCpuTraces_ gate alone is
-// not enough -- transferCpuTrace() must also null-check traceBuffers_. Before
-// the fix it ran cpu.push_back() on the null traceBuffers_ and crashed.
+// not enough. transferCpuTrace() used to run cpu.push_back() on the null
+// traceBuffers_ and crash; it now only queues the span, which is dropped at
+// the next reset.
 TEST_F(GenericActivityProfilerTeardownTest, LateTransferCpuTraceIsDiscarded) {
   GenericActivityProfiler profiler(/*cpuOnly=*/true);
   runSyncTraceLeavingStaleState(profiler, *cfg_);
@@ -10,6 +10,7 @@
 #include "include/TypedMetadata.h"
 
 #include <fmt/format.h>
+#include <fmt/ranges.h>
 #include <gtest/gtest.h>
 #include <cstdint>
 #include <map>
@@ -232,3 +233,54 @@ TEST(
   EXPECT_EQ(
       activity.getMetadataValue("input_dims"), "[[2, 2], [[4, 1], [4, 1]]]");
 }
+
+TEST(GenericTraceActivityMetadataTest, MetadataKeysAreInterned) {
+  const uint32_t id = MetadataKeys::intern("interned key");
+  EXPECT_EQ(MetadataKeys::intern(std::string("interned key")), id);
+  EXPECT_EQ(MetadataKeys::find("interned key"), std::optional<uint32_t>{id});
+  EXPECT_EQ(MetadataKeys::name(id), "interned key");
+  EXPECT_NE(MetadataKeys::intern("other interned key"), id);
+  EXPECT_EQ(MetadataKeys::find("never interned key"), std::nullopt);
+}
+
+TEST(GenericTraceActivityMetadataTest, MetadataKeepsInsertionOrder) {
+  GenericTraceActivity activity;
+  std::vector<std::string> expected;
+  for (int i = 0; i < 12; i++) {
+    activity.addMetadata(fmt::format("key{}", i), i);
+    expected.push_back(fmt::format("\"key{}\": {}", i, i));
+  }
+  // Like std::unordered_map::emplace, a repeated key keeps the first value.
+  activity.addMetadata("key3", 42);
+  activity.addMetadataQuoted("key3", "ignored");
+
+  EXPECT_EQ(
+      activity.metadataJson(), fmt::format("{}", fmt::join(expected, ", ")));
+  EXPECT_EQ(activity.getMetadataValue("key3"), "3");
+}
+
+TEST(GenericTraceActivityMetadataTest, CopyAndMovePreserveMetadata) {
+  // One entry fits inline, ten spill to the heap.
+  for (int count : {1, 10}) {
+    GenericTraceActivity activity;
+    for (int i = 0; i < count; i++) {
+      activity.addMetadataQuoted(
+          fmt::format("key{}", i), fmt::format("a long value {}", i));
+    }
+    const std::string json = activity.metadataJson();
+
+    GenericTraceActivity copy(activity);
+    EXPECT_EQ(copy.metadataJson(), json);
+    GenericTraceActivity moved(std::move(copy));
+    EXPECT_EQ(moved.metadataJson(), json);
+
+    GenericTraceActivity assigned;
+    assigned.addMetadata("stale", 1);
+    assigned = moved;
+    EXPECT_EQ(assigned.metadataJson(), json);
+    assigned = std::move(moved);
+    EXPECT_EQ(assigned.metadataJson(), json);
+    EXPECT_EQ(assigned.getMetadataValue("stale"), "");
+    EXPECT_EQ(activity.metadataJson(), json);
+  }
+}
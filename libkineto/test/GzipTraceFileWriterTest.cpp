@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+
+#include "include/GenericTraceActivity.h"
+#include "include/TraceSpan.h"
+#include "src/GzipTraceFileWriter.h"
+#include "src/output_json.h"
+#include "test/TestUtils.h"
+
+using namespace KINETO_NAMESPACE;
+using namespace libkineto;
+
+namespace {
+
+class TestableChromeTraceLogger : public ChromeTraceLogger {
+ public:
+  using ChromeTraceLogger::ChromeTraceLogger;
+  using ChromeTraceLogger::finalizeTrace;
+};
+
+std::string readFile(const std::string& path) {
+  std::ifstream f(path);
+  return std::string(
+      (std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+}
+
+std::string readGzipFile(const std::string& path) {
+  std::string result;
+  gzFile file = gzopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return result;
+  }
+  char buf[64 * 1024];
+  int n = 0;
+  while ((n = gzread(file, buf, sizeof(buf))) > 0) {
+    result.append(buf, n);
+  }
+  gzclose(file);
+  return result;
+}
+
+// Writes numOps CPU ops to logger and finalizes the trace.
+void writeTrace(TestableChromeTraceLogger& logger, int numOps) {
+  TraceSpan span(0, 0, "test_span");
+  GenericTraceActivity act(span, ActivityType::CPU_OP, "");
+  act.device = 0;
+  act.resource = 0;
+  act.addMetadata("padding", "\"" + std::string(128, 'x') + "\"");
+
+  logger.handleTraceStart({}, "");
+  for (int i = 0; i < numOps; i++) {
+    act.activityName = "op_" + std::to_string(i);
+    act.startTime = 1000 * i;
+    act.endTime = 1000 * i + 500;
+    logger.handleGenericActivity(act);
+  }
+  logger.handleTraceSpan(span);
+  logger.finalizeTrace(/*endTime=*/1000 * numOps);
+}
+
+// traceName is the only field that depends on the output path.
+std::string stripTraceName(const std::string& trace) {
+  return trace.substr(0, trace.rfind("\"traceName\""));
+}
+
+} // namespace
+
+// Enough events for many flush blocks, so the producer has to wait for the
+// compressor thread.
+TEST(GzipTraceFileWriterTest, RoundTripMatchesPlainTrace) {
+  constexpr int kNumOps = 100000;
+  const auto plainFile =
+      libkineto::test::createTempTraceFile("GzipTraceTest.", ".json");
+  {
+    TestableChromeTraceLogger logger(plainFile.path());
+    writeTrace(logger, kNumOps);
+  }
+
+  const auto gzipFile =
+      libkineto::test::createTempTraceFile("GzipTraceTest.", ".json.gz");
+  {
+    TestableChromeTraceLogger logger(
+        gzipFile.path(), std::make_unique<GzipTraceFileWriter>());
+    writeTrace(logger, kNumOps);
+  }
+
+  const std::string plain = readFile(plainFile.path());
+  const std::string compressed = readFile(gzipFile.path());
+  ASSERT_FALSE(plain.empty());
+  // gzip magic bytes
+  ASSERT_GE(compressed.size(), 2u);
+  EXPECT_EQ(static_cast<unsigned char>(compressed[0]), 0x1f);
+  EXPECT_EQ(static_cast<unsigned char>(compressed[1]), 0x8b);
+  EXPECT_LT(compressed.size(), plain.size() / 4);
+
+  EXPECT_EQ(stripTraceName(readGzipFile(gzipFile.path())), stripTraceName(plain));
+}
+
+TEST(GzipTraceFileWriterTest, FactoryAppendsGzSuffix) {
+  const auto traceFile =
+      libkineto::test::createTempTraceFile("GzipTraceTest.", ".json");
+  auto logger = makeGzipChromeTraceLogger(traceFile.path());
+  auto* chromeLogger = dynamic_cast<ChromeTraceLogger*>(logger.get());
+  ASSERT_NE(chromeLogger, nullptr);
+  EXPECT_EQ(chromeLogger->traceFileName(), traceFile.path() + ".gz");
+
+  // The trace only appears under its final name once finalized.
+  logger.reset();
+  std::remove((traceFile.path() + ".gz.tmp").c_str());
+}
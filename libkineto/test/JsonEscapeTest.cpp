@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "src/JsonEscape.h"
+
+using namespace KINETO_NAMESPACE;
+
+namespace {
+
+// What the logger did with event names before escapeJsonName().
+std::string escapeMultiPass(std::string_view name) {
+  std::string value{name};
+  sanitizeStrForJSON(value);
+  sanitizeForNonReadableChars(value);
+  escapeQuotesForJSON(value);
+  return value;
+}
+
+std::string escapeSinglePass(std::string_view name) {
+  fmt::memory_buffer out;
+  appendEscapedJsonName(out, name);
+  return fmt::to_string(out);
+}
+
+} // namespace
+
+TEST(JsonEscapeTest, EscapesEachSpecialCharacter) {
+  EXPECT_EQ(escapeSinglePass(""), "");
+  EXPECT_EQ(escapeSinglePass("aten::addmm"), "aten::addmm");
+  EXPECT_EQ(escapeSinglePass(R"(C:\a\b)"), "C:/a/b");
+  EXPECT_EQ(escapeSinglePass("a\nb\n"), "ab");
+  EXPECT_EQ(
+      escapeSinglePass(R"({"device": "cpu"})"), R"({\"device\": \"cpu\"})");
+  EXPECT_EQ(escapeSinglePass("tab\there"), "unknown");
+  EXPECT_EQ(escapeSinglePass("caf\xc3\xa9"), "unknown");
+  EXPECT_EQ(escapeSinglePass("del\x7f"), "unknown");
+}
+
+TEST(JsonEscapeTest, AppendsToExistingContent) {
+  fmt::memory_buffer out;
+  out.append(std::string_view{"name: "});
+  appendEscapedJsonName(out, std::string(40, '"'));
+  appendEscapedJsonName(out, "\t");
+  std::string expected = "name: ";
+  for (int i = 0; i < 40; i++) {
+    expected += "\\\"";
+  }
+  EXPECT_EQ(fmt::to_string(out), expected + "unknown");
+}
+
+// Random names over an alphabet weighted towards the characters that need
+// handling, at lengths that straddle the vector widths, must come out exactly
+// as the multi-pass functions produce them.
+TEST(JsonEscapeTest, MatchesMultiPassFunctions) {
+  const std::vector<char> alphabet = {
+      'a', 'Z', '0', ' ', ':', '/', '{', '}', '(', ')', '"', '"', '"',
+      '\\', '\\', '\n', '\n', '\t', '\x7f', '\x80', '\xff', '\x1f', '~'};
+  std::mt19937 rng(1234);
+  std::uniform_int_distribution<size_t> pick(0, alphabet.size() - 1);
+  std::uniform_int_distribution<int> length(0, 200);
+  // Most names are kept readable; otherwise nearly all would come out as
+  // "unknown".
+  std::uniform_int_distribution<int> percent(0, 99);
+  for (int i = 0; i < 20000; i++) {
+    std::string name;
+    const int size = length(rng);
+    const bool readableOnly = percent(rng) < 70;
+    for (int j = 0; j < size; j++) {
+      char c = alphabet[pick(rng)];
+      const auto byte = static_cast<unsigned char>(c);
+      if (readableOnly && (byte < 0x20 || byte >= 0x7f) && c != '\n') {
+        c = 'x';
+      }
+      name += c;
+    }
+    ASSERT_EQ(escapeSinglePass(name), escapeMultiPass(name))
+        << "name of size " << name.size() << " at iteration " << i;
+  }
+}
+
+// Every offset of a special character relative to the vector chunks.
+TEST(JsonEscapeTest, MatchesMultiPassFunctionsAtEveryOffset) {
+  for (char special : {'"', '\\', '\n', '\t'}) {
+    for (size_t size = 1; size <= 80; size++) {
+      for (size_t pos = 0; pos < size; pos++) {
+        std::string name(size, 'x');
+        name[pos] = special;
+        ASSERT_EQ(escapeSinglePass(name), escapeMultiPass(name))
+            << "special " << static_cast<int>(special) << " at " << pos
+            << " of " << size;
+      }
+    }
+  }
+}
+
+TEST(JsonEscapeTest, OutputFitsMaxSize) {
+  const std::string quotes(1000, '"');
+  std::vector<char> out(maxEscapedJsonNameSize(quotes.size()));
+  EXPECT_EQ(escapeJsonName(quotes, out.data()), out.size());
+  EXPECT_EQ(escapeJsonName("\x01", out.data()), kUnreadableJsonName);
+}
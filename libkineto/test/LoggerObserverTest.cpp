@@ -289,6 +289,56 @@ TEST(LoggerObserverTest, UstMacrosRespectSeverityThreshold) {
   Logger::removeLoggerObserver(observer.get());
 }
 
+TEST(LoggerObserverTest, AsyncLoggingDeliversOnFlush) {
+  auto observer = std::make_unique<CapturingObserver>();
+  Logger::addLoggerObserver(observer.get());
+  Logger::setAsyncLogging(true);
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; i++) {
+    threads.emplace_back(writeSeveralMessages);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  LOG(INFO) << InfoTestStr;
+  Logger::flush();
+
+  auto md = observer->extractCollectorMetadata();
+  EXPECT_EQ(md[LoggerOutputType::INFO].size(), 8 * 10 + 1);
+  EXPECT_EQ(md[LoggerOutputType::WARNING].size(), 8 * 10);
+  EXPECT_EQ(md[LoggerOutputType::ERROR].size(), 8 * 10);
+  EXPECT_EQ(Logger::droppedMessages(), 0);
+  // Formatted as in synchronous mode.
+  const std::string& message = md[LoggerOutputType::INFO].back();
+  EXPECT_EQ(message.rfind("INFO:", 0), 0) << message;
+  EXPECT_NE(message.find(" LoggerObserverTest.cpp:"), std::string::npos);
+  EXPECT_NE(message.find(std::string("] ") + InfoTestStr), std::string::npos);
+
+  Logger::setAsyncLogging(false);
+  Logger::removeLoggerObserver(observer.get());
+}
+
+// Queued messages are delivered before an observer is reset or removed.
+TEST(LoggerObserverTest, AsyncLoggingFlushesBeforeObserverChanges) {
+  auto observer = std::make_unique<CapturingObserver>();
+  Logger::addLoggerObserver(observer.get());
+  Logger::setAsyncLogging(true);
+
+  // Cleared by the reset.
+  LOG(WARNING) << WarningTestStr;
+  Logger::resetLoggerObservers();
+  LOG(ERROR) << ErrorTestStr;
+  Logger::removeLoggerObserver(observer.get());
+  Logger::setAsyncLogging(false);
+
+  EXPECT_EQ(observer->messages[LoggerOutputType::WARNING].size(), 0);
+  ASSERT_EQ(observer->messages[LoggerOutputType::ERROR].size(), 1);
+  EXPECT_NE(
+      observer->messages[LoggerOutputType::ERROR][0].find(ErrorTestStr),
+      std::string::npos);
+}
+
 #endif // !USE_GOOGLE_LOG
 
 int main(int argc, char** argv) {
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "include/Config.h"
+#include "include/GenericTraceActivity.h"
+#include "src/GenericActivityProfiler.h"
+#include "src/MpscQueue.h"
+#include "src/output_membuf.h"
+
+using namespace KINETO_NAMESPACE;
+using namespace std::chrono;
+
+TEST(MpscQueueTest, DrainsInPushOrder) {
+  MpscQueue<std::unique_ptr<int>> queue;
+  EXPECT_TRUE(queue.empty());
+  for (int i = 0; i < 5; i++) {
+    queue.push(std::make_unique<int>(i));
+  }
+  EXPECT_FALSE(queue.empty());
+
+  std::vector<int> drained;
+  const size_t count =
+      queue.drain([&](std::unique_ptr<int>&& v) { drained.push_back(*v); });
+  EXPECT_EQ(count, 5);
+  EXPECT_EQ(drained, std::vector<int>({0, 1, 2, 3, 4}));
+  EXPECT_TRUE(queue.empty());
+  EXPECT_EQ(queue.drain([](std::unique_ptr<int>&&) {}), 0);
+
+  queue.push(std::make_unique<int>(5));
+  queue.clear();
+  EXPECT_TRUE(queue.empty());
+  // Anything still queued is freed with the queue.
+  queue.push(std::make_unique<int>(6));
+}
+
+// Many producers push while the consumer keeps draining. Every item must come
+// out exactly once, and items from one producer must stay in order.
+TEST(MpscQueueTest, ConcurrentProducers) {
+  constexpr int kProducers = 16;
+  constexpr int kItemsPerProducer = 20000;
+  struct Item {
+    int producer;
+    int seq;
+  };
+  MpscQueue<Item> queue;
+  std::atomic<int> running{kProducers};
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; p++) {
+    producers.emplace_back([&, p] {
+      for (int i = 0; i < kItemsPerProducer; i++) {
+        queue.push({p, i});
+      }
+      running--;
+    });
+  }
+
+  std::vector<int> next(kProducers, 0);
+  int64_t total = 0;
+  bool ordered = true;
+  auto consume = [&](Item&& item) {
+    ordered = ordered && item.seq == next[item.producer];
+    next[item.producer] = item.seq + 1;
+    total++;
+  };
+  while (running > 0) {
+    queue.drain(consume);
+  }
+  for (auto& t : producers) {
+    t.join();
+  }
+  queue.drain(consume);
+
+  EXPECT_TRUE(ordered);
+  EXPECT_EQ(total, int64_t{kProducers} * kItemsPerProducer);
+  for (int p = 0; p < kProducers; p++) {
+    EXPECT_EQ(next[p], kItemsPerProducer);
+  }
+}
+
+namespace {
+
+// Records the spans handed to the logger.
+class SpanRecordingLogger : public MemoryTraceLogger {
+ public:
+  using MemoryTraceLogger::MemoryTraceLogger;
+
+  void handleTraceSpan(const TraceSpan& span) override {
+    spans.emplace_back(span.name, span.iteration);
+  }
+
+  std::vector<std::pair<std::string, int>> spans;
+};
+
+std::unique_ptr<CpuTraceBuffer> makeCpuTrace(const std::string& name) {
+  auto trace = std::make_unique<CpuTraceBuffer>();
+  trace->span = TraceSpan(100, 200, name);
+  trace->gpuOpCount = 0;
+  GenericTraceActivity op(trace->span, ActivityType::CPU_OP, name + " op");
+  op.startTime = 110;
+  op.endTime = 120;
+  trace->emplace_activity(std::move(op));
+  return trace;
+}
+
+} // namespace
+
+class CpuTraceIngestionTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    cfg_ = std::make_unique<Config>();
+    cfg_->validate(system_clock::now());
+  }
+
+  void startTrace(GenericActivityProfiler& profiler) {
+    const auto now = system_clock::now();
+    profiler.configure(*cfg_, now);
+    profiler.startTrace(now);
+  }
+
+  std::unique_ptr<Config> cfg_;
+};
+
+// Spans transferred from many threads during a trace all reach the logger,
+// and iterations of a span are numbered without gaps.
+TEST_F(CpuTraceIngestionTest, ConcurrentTransfers) {
+  constexpr int kThreads = 16;
+  constexpr int kSpansPerThread = 50;
+  GenericActivityProfiler profiler(/*cpuOnly=*/true);
+  startTrace(profiler);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&profiler, t] {
+      for (int i = 0; i < kSpansPerThread; i++) {
+        profiler.transferCpuTrace(makeCpuTrace("span" + std::to_string(t)));
+        profiler.transferCpuTrace(makeCpuTrace("shared"));
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  profiler.stopTrace(system_clock::now());
+
+  SpanRecordingLogger logger(*cfg_);
+  profiler.processTrace(logger);
+
+  EXPECT_EQ(
+      logger.traceActivities()->size(), 2u * kThreads * kSpansPerThread);
+  std::map<std::string, std::vector<int>> iterations;
+  for (const auto& [name, iteration] : logger.spans) {
+    iterations[name].push_back(iteration);
+  }
+  ASSERT_EQ(iterations.size(), kThreads + 1u);
+  for (const auto& [name, seen] : iterations) {
+    // Per-thread spans arrive in the order they were sent.
+    std::vector<int> expected(seen.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+      expected[i] = static_cast<int>(i);
+    }
+    if (name == "shared") {
+      EXPECT_EQ(seen.size(), size_t{kThreads} * kSpansPerThread);
+      std::vector<int> sorted = seen;
+      std::sort(sorted.begin(), sorted.end());
+      EXPECT_EQ(sorted, expected);
+    } else {
+      EXPECT_EQ(seen, expected) << name;
+    }
+  }
+}
+
+// A span transferred after the trace was processed must not show up in the
+// next trace.
+TEST_F(CpuTraceIngestionTest, LateSpanDroppedOnReset) {
+  GenericActivityProfiler profiler(/*cpuOnly=*/true);
+  startTrace(profiler);
+  profiler.transferCpuTrace(makeCpuTrace("first"));
+  profiler.stopTrace(system_clock::now());
+  SpanRecordingLogger firstLogger(*cfg_);
+  profiler.processTrace(firstLogger);
+  profiler.transferCpuTrace(makeCpuTrace("late"));
+
+  startTrace(profiler);
+  profiler.transferCpuTrace(makeCpuTrace("second"));
+  profiler.stopTrace(system_clock::now());
+  SpanRecordingLogger secondLogger(*cfg_);
+  profiler.processTrace(secondLogger);
+
+  using Spans = std::vector<std::pair<std::string, int>>;
+  EXPECT_EQ(firstLogger.spans, Spans({{"first", 0}}));
+  EXPECT_EQ(secondLogger.spans, Spans({{"second", 0}}));
+}
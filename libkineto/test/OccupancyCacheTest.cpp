@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <random>
+#include <set>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "src/OccupancyCache.h"
+
+using namespace KINETO_NAMESPACE;
+
+namespace {
+
+// Stand-ins for the CUDA device properties and the occupancy calculator, so
+// that the cache can be exercised without a GPU.
+struct SyntheticDevice {
+  int regsPerSm;
+  int sharedMemPerSm;
+  int maxThreadsPerSm;
+  int maxBlocksPerSm;
+};
+
+const SyntheticDevice kDevices[] = {
+    {65536, 167936, 2048, 32},
+    {65536, 233472, 2048, 32},
+};
+
+struct SyntheticKernel {
+  uint32_t deviceId;
+  uint32_t registersPerThread;
+  uint32_t staticSharedMemory;
+  uint32_t dynamicSharedMemory;
+  uint32_t blockX;
+  uint32_t blockY;
+  uint32_t gridX;
+};
+
+struct SyntheticOccupancy {
+  int activeBlocks;
+  int limitRegs;
+  int limitSharedMem;
+  int limitWarps;
+
+  bool operator==(const SyntheticOccupancy& other) const = default;
+};
+
+KernelLaunchShape launchShape(const SyntheticKernel& kernel) {
+  return KernelLaunchShape{
+      .registersPerThread = kernel.registersPerThread,
+      .staticSharedMemory = kernel.staticSharedMemory,
+      .dynamicSharedMemory = kernel.dynamicSharedMemory,
+      .blockSize = kernel.blockX * kernel.blockY};
+}
+
+SyntheticOccupancy computeOccupancy(
+    const SyntheticDevice& device,
+    const KernelLaunchShape& shape) {
+  SyntheticOccupancy occupancy{};
+  const int regsPerBlock =
+      static_cast<int>(shape.registersPerThread * shape.blockSize);
+  const int sharedPerBlock =
+      static_cast<int>(shape.staticSharedMemory + shape.dynamicSharedMemory);
+  occupancy.limitRegs =
+      regsPerBlock ? device.regsPerSm / regsPerBlock : device.maxBlocksPerSm;
+  occupancy.limitSharedMem = sharedPerBlock
+      ? device.sharedMemPerSm / sharedPerBlock
+      : device.maxBlocksPerSm;
+  occupancy.limitWarps =
+      device.maxThreadsPerSm / static_cast<int>(shape.blockSize);
+  occupancy.activeBlocks = std::min(
+      {occupancy.limitRegs,
+       occupancy.limitSharedMem,
+       occupancy.limitWarps,
+       device.maxBlocksPerSm});
+  return occupancy;
+}
+
+// A training-loop-like stream of kernel records: a few dozen launch shapes
+// repeated many times, with grid sizes that vary between launches.
+std::vector<SyntheticKernel> makeKernels(int count) {
+  std::vector<SyntheticKernel> shapes;
+  for (uint32_t regs : {32u, 64u, 128u}) {
+    for (uint32_t smem : {0u, 4096u, 49152u}) {
+      for (uint32_t blockX : {128u, 256u, 512u}) {
+        shapes.push_back({0, regs, smem, smem / 2, blockX, 1, 0});
+      }
+    }
+  }
+  std::mt19937 rng(42);
+  std::vector<SyntheticKernel> kernels;
+  for (int i = 0; i < count; i++) {
+    SyntheticKernel kernel = shapes[rng() % shapes.size()];
+    kernel.deviceId = rng() % 2;
+    kernel.gridX = 1 + rng() % 4096;
+    kernels.push_back(kernel);
+  }
+  return kernels;
+}
+
+using ShapeId = std::tuple<uint32_t, uint32_t, uint32_t, uint32_t, uint32_t>;
+
+ShapeId shapeId(const SyntheticKernel& kernel) {
+  return {
+      kernel.deviceId,
+      kernel.registersPerThread,
+      kernel.staticSharedMemory,
+      kernel.dynamicSharedMemory,
+      kernel.blockX * kernel.blockY};
+}
+
+} // namespace
+
+// Cached results are identical to computing every record, and each launch
+// shape is computed once per device.
+TEST(OccupancyCacheTest, MatchesUncachedResults) {
+  const auto kernels = makeKernels(20000);
+  OccupancyCache<SyntheticOccupancy> cache(std::size(kDevices));
+  int computed = 0;
+  for (const auto& kernel : kernels) {
+    const KernelLaunchShape shape = launchShape(kernel);
+    const SyntheticOccupancy cached = cache.get(kernel.deviceId, shape, [&] {
+      computed++;
+      return computeOccupancy(kDevices[kernel.deviceId], shape);
+    });
+    ASSERT_EQ(cached, computeOccupancy(kDevices[kernel.deviceId], shape));
+  }
+
+  std::set<ShapeId> distinct;
+  for (const auto& kernel : kernels) {
+    distinct.insert(shapeId(kernel));
+  }
+  EXPECT_EQ(computed, distinct.size());
+  EXPECT_EQ(cache.size(), distinct.size());
+  EXPECT_EQ(cache.misses(), distinct.size());
+  EXPECT_EQ(cache.hits() + cache.misses(), kernels.size());
+}
+
+// The same shape can have different results on different devices.
+TEST(OccupancyCacheTest, PerDevice) {
+  OccupancyCache<SyntheticOccupancy> cache(std::size(kDevices));
+  const KernelLaunchShape shape{
+      .registersPerThread = 32,
+      .staticSharedMemory = 49152,
+      .dynamicSharedMemory = 0,
+      .blockSize = 128};
+  for (uint32_t device = 0; device < std::size(kDevices); device++) {
+    const SyntheticOccupancy expected =
+        computeOccupancy(kDevices[device], shape);
+    for (int i = 0; i < 3; i++) {
+      EXPECT_EQ(
+          cache.get(device, shape, [&] { return expected; }), expected);
+    }
+  }
+  EXPECT_NE(
+      computeOccupancy(kDevices[0], shape),
+      computeOccupancy(kDevices[1], shape));
+  EXPECT_EQ(cache.misses(), 2);
+  EXPECT_EQ(cache.hits(), 4);
+}
+
+TEST(OccupancyCacheTest, UnknownDeviceNotCached) {
+  OccupancyCache<int> cache(1);
+  int computed = 0;
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(
+        cache.get(5, KernelLaunchShape{}, [&] { return ++computed; }), i + 1);
+  }
+  EXPECT_EQ(cache.size(), 0);
+  EXPECT_EQ(cache.hits() + cache.misses(), 0);
+}
+
+// Records may be rendered from several serialization threads.
+TEST(OccupancyCacheTest, ConcurrentLookups) {
+  constexpr int kThreads = 8;
+  const auto kernels = makeKernels(5000);
+  OccupancyCache<SyntheticOccupancy> cache(std::size(kDevices));
+  std::atomic<int> mismatches{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&] {
+      for (const auto& kernel : kernels) {
+        const KernelLaunchShape shape = launchShape(kernel);
+        const auto compute = [&] {
+          return computeOccupancy(kDevices[kernel.deviceId], shape);
+        };
+        if (cache.get(kernel.deviceId, shape, compute) != compute()) {
+          mismatches++;
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(mismatches, 0);
+  EXPECT_EQ(cache.hits() + cache.misses(), int64_t{kThreads} * 5000);
+}
@@ -9,6 +9,7 @@
 #include <gtest/gtest.h>
 #include <nlohmann/json.hpp>
 
+#include <algorithm>
 #include <cstdint>
 #include <fstream>
 #include <iterator>
@@ -195,3 +196,110 @@ TEST(OutputJsonTest, CollectiveMetadataToleratesQuotedAndUnquotedForms) {
   EXPECT_EQ(quoted["distributedInfo"], expectedDistInfo);
   EXPECT_EQ(unquoted["distributedInfo"], expectedDistInfo);
 }
+
+// Enough events to push the trace past several output flush blocks. Every
+// event must land in the file exactly once, in order, and the result must
+// still parse.
+TEST(OutputJsonTest, LargeTraceSpanningFlushBlocksIsValidJson) {
+  const auto traceFile =
+      libkineto::test::createTempTraceFile("OutputJsonTest.", ".json");
+
+  constexpr int kNumEvents = 50000;
+  TraceSpan span(0, 0, "test_span");
+  GenericTraceActivity act(span, ActivityType::CPU_OP, "");
+  act.device = 0;
+  act.resource = 0;
+  act.addMetadata("padding", "\"" + std::string(128, 'x') + "\"");
+
+  TestableChromeTraceLogger logger(traceFile.path());
+  logger.handleTraceStart({}, "");
+  for (int i = 0; i < kNumEvents; i++) {
+    act.activityName = "op_" + std::to_string(i);
+    act.startTime = 1000 * i;
+    act.endTime = 1000 * i + 500;
+    logger.handleGenericActivity(act);
+  }
+  logger.finalizeTrace(/*endTime=*/1000 * kNumEvents);
+
+  nlohmann::json data;
+  ASSERT_NO_THROW(data = nlohmann::json::parse(readFile(traceFile.path())));
+
+  int next = 0;
+  for (const auto& event : data["traceEvents"]) {
+    if (event["ph"] == "X") {
+      ASSERT_EQ(event["name"].get<std::string>(), "op_" + std::to_string(next));
+      next++;
+    }
+  }
+  EXPECT_EQ(next, kNumEvents);
+}
+
+// Metadata from handleTraceMetadata() is written after the trace events, as
+// a top-level field next to the metadata from handleTraceStart().
+TEST(OutputJsonTest, TraceMetadataAfterEvents) {
+  const auto traceFile =
+      libkineto::test::createTempTraceFile("OutputJsonTest.", ".json");
+
+  TestableChromeTraceLogger logger(traceFile.path());
+  logger.handleTraceStart({{"trace_id", "\"abc\""}}, "");
+  logger.handleTraceMetadata("filteredActivities", R"({"total": 3})");
+  logger.finalizeTrace(/*endTime=*/300);
+
+  nlohmann::json data;
+  ASSERT_NO_THROW(data = nlohmann::json::parse(readFile(traceFile.path())));
+  EXPECT_EQ(data["trace_id"], "abc");
+  EXPECT_EQ(data["filteredActivities"], nlohmann::json({{"total", 3}}));
+}
+
+// Typed metadata is streamed into the event args rather than rendered with
+// metadataJson() first. The args must be the same as those of the legacy
+// rendering, including the backslash and newline sanitization.
+TEST(OutputJsonTest, StreamedMetadataMatchesMetadataJson) {
+  const auto traceFile =
+      libkineto::test::createTempTraceFile("OutputJsonTest.", ".json");
+
+  TraceSpan span(0, 0, "test_span");
+  GenericTraceActivity act(span, ActivityType::CPU_OP, "aten::addmm");
+  act.startTime = 100;
+  act.endTime = 200;
+  act.device = 0;
+  act.resource = 0;
+  act.addMetadata(MetadataField<int64_t>{"Sequence number"}, int64_t{-7});
+  act.addMetadata(MetadataField<uint64_t>{"Record function id"}, uint64_t{9});
+  act.addMetadata(MetadataField<double>{"Ratio"}, 0.25);
+  act.addMetadata(MetadataField<bool>{"Flag"}, true);
+  act.addMetadata(
+      MetadataField<std::string>{"Path"}, std::string{"C:\\tmp\\a\nb"});
+  act.addMetadata(
+      MetadataField<std::vector<int64_t>>{"Dims"},
+      std::vector<int64_t>{1, 2, 3});
+  act.addMetadata(
+      MetadataField<std::vector<std::string>>{"Input type"},
+      std::vector<std::string>{"float", "dir\\file"});
+  act.addMetadata(
+      MetadataField<InputShapes>{"Input Dims"},
+      InputShapes{
+          std::vector<int64_t>{4, 5}, TensorListShapes{{1}, {2, 3}}});
+  act.addMetadata("Call stack", "\"a.py(1)\\nb.py(2)\"");
+
+  TestableChromeTraceLogger logger(traceFile.path());
+  logger.handleTraceStart({}, "");
+  logger.handleGenericActivity(act);
+  logger.finalizeTrace(/*endTime=*/300);
+
+  std::string legacy = act.metadataJson();
+  std::ranges::replace(legacy, '\\', '/');
+  std::erase(legacy, '\n');
+  const nlohmann::json expected = nlohmann::json::parse("{" + legacy + "}");
+  EXPECT_EQ(expected["Path"], "C:/tmp/ab");
+
+  const nlohmann::json data = nlohmann::json::parse(readFile(traceFile.path()));
+  nlohmann::json args;
+  for (const auto& event : data["traceEvents"]) {
+    if (event.contains("name") && event["name"] == "aten::addmm") {
+      args = event["args"];
+    }
+  }
+  args.erase("External id");
+  EXPECT_EQ(args, expected);
+}
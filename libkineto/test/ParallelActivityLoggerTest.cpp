@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "include/GenericTraceActivity.h"
+#include "include/TraceSpan.h"
+#include "src/ParallelActivityLogger.h"
+#include "src/output_json.h"
+#include "test/TestUtils.h"
+
+using namespace KINETO_NAMESPACE;
+using namespace libkineto;
+
+namespace {
+
+class TestableChromeTraceLogger : public ChromeTraceLogger {
+ public:
+  explicit TestableChromeTraceLogger(const std::string& file)
+      : ChromeTraceLogger(file) {}
+  using ChromeTraceLogger::finalizeTrace;
+};
+
+// Records the order of the calls it receives and does not support shards.
+class RecordingLogger : public ActivityLogger {
+ public:
+  void handleDeviceInfo(const DeviceInfo& info, int64_t /*time*/) override {
+    calls.push_back("device:" + info.name);
+  }
+  void handleResourceInfo(const ResourceInfo& info, int64_t /*time*/)
+      override {
+    calls.push_back("resource:" + info.name);
+  }
+  void handleOverheadInfo(const OverheadInfo& info, int64_t /*time*/)
+      override {
+    calls.push_back("overhead:" + info.name);
+  }
+  void handleTraceSpan(const TraceSpan& span) override {
+    calls.push_back("span:" + span.name);
+  }
+  void handleActivity(const ITraceActivity& activity) override {
+    calls.push_back("activity:" + activity.name());
+  }
+  void handleGenericActivity(const GenericTraceActivity& activity) override {
+    calls.push_back("generic:" + activity.name());
+  }
+  void handleTraceStart(
+      const std::unordered_map<std::string, std::string>& /*metadata*/,
+      const std::string& /*device_properties*/) override {
+    calls.push_back("start");
+  }
+  void finalizeMemoryTrace(const std::string& /*url*/, const Config& /*config*/)
+      override {}
+  void finalizeTrace(
+      const Config& /*config*/,
+      std::unique_ptr<ActivityBuffers> /*buffers*/,
+      int64_t /*endTime*/) override {}
+
+  std::vector<std::string> calls;
+};
+
+std::string readFile(const std::string& path) {
+  std::ifstream f(path);
+  return std::string(
+      (std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+}
+
+// A mix of activities that exercises the stateful parts of the Chrome
+// writer: Stream Sync rows are named once per stream, collectives populate
+// distributedInfo, and flows link CPU ops to kernels. Enough of them to span
+// several shards.
+class TraceFixture {
+ public:
+  static constexpr int kNumOps = 3 * ParallelActivityLogger::kActivitiesPerShard;
+
+  TraceFixture() : span_(0, 0, "test_span") {
+    commsOp_ = &add(ActivityType::CPU_OP, "record_param_comms", 0, 1);
+    commsOp_->addMetadata("Collective name", "\"allreduce\"");
+    commsOp_->addMetadata("Process Group Name", "\"0\"");
+    commsOp_->addMetadata("Process Group Description", "\"default_pg\"");
+    commsOp_->addMetadata("Group size", "8");
+    commsOp_->addMetadata("Rank", "0");
+
+    for (int i = 0; i < kNumOps; i++) {
+      auto& op = add(ActivityType::CPU_OP, "op_" + std::to_string(i), i, 1);
+      op.addMetadata("index", std::to_string(i));
+      if (i % 1000 == 0) {
+        op.flow.id = i + 1;
+        op.flow.type = kLinkAsyncCpuGpu;
+        op.flow.start = true;
+      }
+      if (i % 7000 == 0) {
+        // Each stream shows up in several shards but must only be named once.
+        add(ActivityType::CUDA_SYNC, "Stream Sync", i, (i / 7000) % 3);
+      }
+      if (i % 5000 == 0) {
+        auto& kernel =
+            add(ActivityType::CONCURRENT_KERNEL, "nccl:all_reduce", i, 7);
+        kernel.device = 1;
+        kernel.linked = commsOp_;
+      }
+    }
+  }
+
+  // Sends every activity to logger, with a span boundary in the middle.
+  void log(ActivityLogger& logger) const {
+    logger.handleTraceStart({}, "");
+    size_t i = 0;
+    for (const auto& act : activities_) {
+      if (i++ == activities_.size() / 2) {
+        logger.handleTraceSpan(span_);
+      }
+      logger.handleGenericActivity(act);
+    }
+    logger.handleTraceSpan(span_);
+  }
+
+ private:
+  GenericTraceActivity& add(
+      ActivityType type,
+      const std::string& name,
+      int64_t start,
+      int64_t resource) {
+    auto& act = activities_.emplace_back(span_, type, name);
+    act.startTime = 1000 + start * 10;
+    act.endTime = act.startTime + 5;
+    act.device = 0;
+    act.resource = resource;
+    act.id = static_cast<int32_t>(activities_.size());
+    return act;
+  }
+
+  TraceSpan span_;
+  // deque for address stability; the activities link to each other.
+  std::deque<GenericTraceActivity> activities_;
+  GenericTraceActivity* commsOp_;
+};
+
+} // namespace
+
+TEST(ParallelActivityLoggerTest, OutputMatchesSequentialLogger) {
+  TraceFixture fixture;
+
+  const auto sequentialFile =
+      libkineto::test::createTempTraceFile("ParallelLoggerTest.", ".json");
+  {
+    TestableChromeTraceLogger logger(sequentialFile.path());
+    fixture.log(logger);
+    logger.finalizeTrace(/*endTime=*/10000000);
+  }
+
+  const auto parallelFile =
+      libkineto::test::createTempTraceFile("ParallelLoggerTest.", ".json");
+  {
+    TestableChromeTraceLogger logger(parallelFile.path());
+    WorkerPool pool(/*numThreads=*/4);
+    ParallelActivityLogger parallelLogger(logger, pool);
+    fixture.log(parallelLogger);
+    parallelLogger.flush();
+    logger.finalizeTrace(/*endTime=*/10000000);
+  }
+
+  // traceName is the only field that depends on the output path.
+  auto stripTraceName = [](std::string trace) {
+    return trace.substr(0, trace.rfind("\"traceName\""));
+  };
+  const std::string sequential = readFile(sequentialFile.path());
+  const std::string parallel = readFile(parallelFile.path());
+  ASSERT_FALSE(sequential.empty());
+  EXPECT_EQ(stripTraceName(sequential), stripTraceName(parallel));
+
+  nlohmann::json data;
+  ASSERT_NO_THROW(data = nlohmann::json::parse(parallel));
+  EXPECT_EQ(data["distributedInfo"]["backend"], "nccl");
+  int streamNames = 0;
+  for (const auto& event : data["traceEvents"]) {
+    if (event["name"] == "thread_name" && event["tid"] >= 1000000) {
+      streamNames++;
+    }
+  }
+  EXPECT_EQ(streamNames, 3);
+}
+
+TEST(ParallelActivityLoggerTest, BarriersPreserveCallOrder) {
+  TraceSpan span(0, 0, "span");
+  const size_t numActivities = 3 * ParallelActivityLogger::kActivitiesPerShard;
+  std::vector<GenericTraceActivity> activities;
+  activities.reserve(numActivities);
+  for (size_t i = 0; i < numActivities; i++) {
+    activities.emplace_back(
+        span, ActivityType::CPU_OP, "op_" + std::to_string(i));
+  }
+
+  RecordingLogger expected;
+  RecordingLogger target;
+  WorkerPool pool(/*numThreads=*/4);
+  ParallelActivityLogger parallelLogger(target, pool);
+  for (ActivityLogger* logger :
+       {static_cast<ActivityLogger*>(&expected),
+        static_cast<ActivityLogger*>(&parallelLogger)}) {
+    logger->handleTraceStart({}, "");
+    logger->handleActivity(activities[0]);
+    logger->handleOverheadInfo(ActivityLogger::OverheadInfo("overhead"), 0);
+    for (const auto& act : activities) {
+      logger->handleGenericActivity(act);
+    }
+    logger->handleTraceSpan(span);
+    logger->handleActivity(activities[1]);
+  }
+
+  // The trailing activity is held until the next barrier or flush().
+  EXPECT_EQ(target.calls.size(), expected.calls.size() - 1);
+  parallelLogger.flush();
+  EXPECT_EQ(target.calls, expected.calls);
+}
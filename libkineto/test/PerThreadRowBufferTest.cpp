@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/PerThreadRowBuffer.h"
+
+using namespace KINETO_NAMESPACE;
+
+namespace {
+
+struct Row {
+  Row(int producer, int seq) : producer(producer), seq(seq) {}
+  int producer;
+  int seq;
+};
+
+struct NamedRow : Row {
+  NamedRow(int producer, int seq, std::string name)
+      : Row(producer, seq), name(std::move(name)) {}
+  std::string name;
+};
+
+} // namespace
+
+TEST(PerThreadRowBufferTest, DrainsRowsInOrder) {
+  PerThreadRowBuffer<Row> buffer(100000);
+  // Spans several blocks.
+  constexpr int kRows = 3 * PerThreadRowBuffer<Row>::kBlockRows + 5;
+  for (int i = 0; i < kRows; i++) {
+    if (i % 2 == 0) {
+      ASSERT_NE(buffer.emplace<Row>(0, i), nullptr);
+    } else {
+      ASSERT_NE(buffer.emplace<NamedRow>(0, i, std::to_string(i)), nullptr);
+    }
+  }
+  // Counts the quota taken, too.
+  EXPECT_GE(buffer.size(), kRows);
+
+  std::vector<Row*> rows;
+  EXPECT_EQ(buffer.drain(rows), kRows);
+  ASSERT_EQ(rows.size(), kRows);
+  for (int i = 0; i < kRows; i++) {
+    EXPECT_EQ(rows[i]->seq, i);
+  }
+  EXPECT_EQ(static_cast<NamedRow*>(rows[1])->name, "1");
+
+  // Only rows added since are drained next.
+  EXPECT_EQ(buffer.drain(rows), 0);
+  buffer.emplace<Row>(0, kRows);
+  EXPECT_EQ(buffer.drain(rows), 1);
+  EXPECT_EQ(rows.back()->seq, kRows);
+}
+
+TEST(PerThreadRowBufferTest, CapsRowsUntilCleared) {
+  PerThreadRowBuffer<Row> buffer(10);
+  std::vector<Row*> rows;
+  for (int i = 0; i < 4; i++) {
+    buffer.emplace<Row>(0, i);
+  }
+  buffer.drain(rows);
+  // Drained rows still count against the cap.
+  for (int i = 4; i < 15; i++) {
+    EXPECT_EQ(buffer.emplace<Row>(0, i) != nullptr, i < 10) << i;
+  }
+  EXPECT_EQ(buffer.size(), 10);
+
+  // clear() forgets undrained rows and restarts the count, but rows that
+  // were drained stay valid.
+  buffer.clear();
+  EXPECT_EQ(buffer.size(), 0);
+  buffer.setMaxRows(2);
+  EXPECT_NE(buffer.emplace<Row>(0, 100), nullptr);
+  EXPECT_NE(buffer.emplace<Row>(0, 101), nullptr);
+  EXPECT_EQ(buffer.emplace<Row>(0, 102), nullptr);
+  EXPECT_EQ(buffer.drain(rows), 2);
+  ASSERT_EQ(rows.size(), 6);
+  EXPECT_EQ(rows[3]->seq, 3);
+  EXPECT_EQ(rows[4]->seq, 100);
+  EXPECT_EQ(rows[5]->seq, 101);
+}
+
+// Many producers append while the consumer keeps draining. Every row must
+// come out exactly once, and rows from one producer must stay in order.
+TEST(PerThreadRowBufferTest, ConcurrentProducers) {
+  constexpr int kProducers = 16;
+  constexpr int kRowsPerProducer = 20000;
+  PerThreadRowBuffer<Row> buffer(
+      kProducers * (kRowsPerProducer + PerThreadRowBuffer<Row>::kQuotaRows));
+
+  std::atomic<int> running{kProducers};
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; p++) {
+    producers.emplace_back([&, p] {
+      for (int i = 0; i < kRowsPerProducer; i++) {
+        if (i % 3 == 0) {
+          buffer.emplace<NamedRow>(p, i, "kernel");
+        } else {
+          buffer.emplace<Row>(p, i);
+        }
+      }
+      running--;
+    });
+  }
+
+  std::vector<Row*> rows;
+  while (running > 0) {
+    buffer.drain(rows);
+  }
+  for (auto& p : producers) {
+    p.join();
+  }
+  buffer.drain(rows);
+  ASSERT_EQ(rows.size(), kProducers * kRowsPerProducer);
+
+  std::map<int, int> next;
+  for (const Row* row : rows) {
+    ASSERT_EQ(row->seq, next[row->producer]++) << "producer " << row->producer;
+  }
+}
+
+// Producers racing for the last rows under the cap never exceed it, and
+// stop at most a quota per thread short of it.
+TEST(PerThreadRowBufferTest, ConcurrentProducersRespectCap) {
+  constexpr int kProducers = 8;
+  constexpr size_t kMaxRows = 10007;
+  PerThreadRowBuffer<Row> buffer(kMaxRows);
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; p++) {
+    producers.emplace_back([&, p] {
+      for (int i = 0; buffer.emplace<Row>(p, i) != nullptr; i++) {
+      }
+    });
+  }
+  for (auto& p : producers) {
+    p.join();
+  }
+  std::vector<Row*> rows;
+  buffer.drain(rows);
+  EXPECT_LE(rows.size(), kMaxRows);
+  EXPECT_GE(
+      rows.size(), kMaxRows - kProducers * PerThreadRowBuffer<Row>::kQuotaRows);
+  EXPECT_EQ(buffer.size(), kMaxRows);
+}
+
+TEST(PerThreadRowBufferTest, SeparateBuffersOnOneThread) {
+  PerThreadRowBuffer<Row> first(100);
+  PerThreadRowBuffer<Row> second(100);
+  for (int i = 0; i < 10; i++) {
+    first.emplace<Row>(1, i);
+    second.emplace<Row>(2, i);
+  }
+  std::vector<Row*> rows;
+  EXPECT_EQ(first.drain(rows), 10);
+  for (const Row* row : rows) {
+    EXPECT_EQ(row->producer, 1);
+  }
+  rows.clear();
+  EXPECT_EQ(second.drain(rows), 10);
+  for (const Row* row : rows) {
+    EXPECT_EQ(row->producer, 2);
+  }
+}
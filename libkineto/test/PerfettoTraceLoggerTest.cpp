@@ -0,0 +1,457 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "include/GenericTraceActivity.h"
+#include "include/TraceSpan.h"
+#include "src/output_perfetto.h"
+#include "test/TestUtils.h"
+
+using namespace KINETO_NAMESPACE;
+using namespace libkineto;
+
+namespace {
+
+class TestablePerfettoTraceLogger : public PerfettoTraceLogger {
+ public:
+  using PerfettoTraceLogger::finalizeTrace;
+  using PerfettoTraceLogger::PerfettoTraceLogger;
+};
+
+// Just enough of a protobuf decoder to check the trace.
+struct Field {
+  uint32_t number{0};
+  uint64_t value{0};
+  std::string_view bytes;
+};
+
+uint64_t readVarint(std::string_view data, size_t& pos) {
+  uint64_t value = 0;
+  for (int shift = 0; pos < data.size(); shift += 7) {
+    auto byte = static_cast<uint8_t>(data[pos++]);
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      break;
+    }
+  }
+  return value;
+}
+
+std::vector<Field> decode(std::string_view data) {
+  std::vector<Field> fields;
+  size_t pos = 0;
+  while (pos < data.size()) {
+    uint64_t tag = readVarint(data, pos);
+    Field field;
+    field.number = static_cast<uint32_t>(tag >> 3);
+    switch (tag & 7) {
+      case 0:
+        field.value = readVarint(data, pos);
+        break;
+      case 1:
+        for (int i = 0; i < 8; i++) {
+          auto byte = static_cast<uint8_t>(data[pos + i]);
+          field.value |= static_cast<uint64_t>(byte) << (8 * i);
+        }
+        pos += 8;
+        break;
+      case 2: {
+        uint64_t size = readVarint(data, pos);
+        field.bytes = data.substr(pos, size);
+        pos += size;
+        break;
+      }
+      default:
+        ADD_FAILURE() << "Unexpected wire type " << (tag & 7);
+        return fields;
+    }
+    fields.push_back(field);
+  }
+  EXPECT_EQ(pos, data.size());
+  return fields;
+}
+
+const Field* find(const std::vector<Field>& fields, uint32_t number) {
+  for (const auto& field : fields) {
+    if (field.number == number) {
+      return &field;
+    }
+  }
+  return nullptr;
+}
+
+struct Event {
+  // Events are sorted within each batch, which starts with a clock snapshot.
+  int batch;
+  int64_t ts;
+  uint64_t type;
+  uint64_t track;
+  std::string name;
+  std::string category;
+  // Integer and JSON annotations, as strings.
+  std::map<std::string, std::string> args;
+  std::vector<uint64_t> flowIds;
+  std::vector<uint64_t> terminatingFlowIds;
+};
+
+struct Track {
+  std::string name;
+  int64_t pid{0};
+  int64_t tid{0};
+  uint64_t parent{0};
+};
+
+// The decoded trace, with interned strings and timestamps resolved.
+struct Trace {
+  std::vector<Event> events;
+  std::map<uint64_t, Track> tracks;
+  int clockSnapshots{0};
+  int internedNameCount{0};
+
+  const Event* findEvent(std::string_view name, uint64_t type) const {
+    for (const auto& event : events) {
+      if (event.name == name && event.type == type) {
+        return &event;
+      }
+    }
+    return nullptr;
+  }
+};
+
+Trace readTrace(const std::string& path) {
+  std::ifstream f(path, std::ios::binary);
+  const std::string data(
+      (std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+
+  Trace trace;
+  std::map<uint64_t, std::string> names;
+  std::map<uint64_t, std::string> categories;
+  std::map<uint64_t, std::string> annotationNames;
+  int64_t clock = 0;
+  for (const auto& packetField : decode(data)) {
+    EXPECT_EQ(packetField.number, 1u);
+    auto packet = decode(packetField.bytes);
+    EXPECT_NE(find(packet, 10), nullptr) << "missing sequence id";
+
+    if (const auto* interned = find(packet, 12)) {
+      for (const auto& entry : decode(interned->bytes)) {
+        auto fields = decode(entry.bytes);
+        uint64_t iid = find(fields, 1)->value;
+        std::string name(find(fields, 2)->bytes);
+        auto& table = entry.number == 1 ? categories
+            : entry.number == 2         ? names
+                                        : annotationNames;
+        EXPECT_TRUE(table.emplace(iid, name).second) << "iid reused: " << name;
+        trace.internedNameCount += entry.number == 2;
+      }
+    }
+    if (find(packet, 6) != nullptr) {
+      trace.clockSnapshots++;
+      clock = 0;
+    }
+    if (const auto* desc = find(packet, 60)) {
+      auto fields = decode(desc->bytes);
+      Track& track = trace.tracks[find(fields, 1)->value];
+      if (const auto* parent = find(fields, 5)) {
+        track.parent = parent->value;
+      }
+      if (const auto* name = find(fields, 2)) {
+        track.name = name->bytes;
+      }
+      if (const auto* process = find(fields, 3)) {
+        auto p = decode(process->bytes);
+        track.pid = static_cast<int32_t>(find(p, 1)->value);
+        if (const auto* name = find(p, 6)) {
+          track.name = name->bytes;
+        }
+      }
+      if (const auto* thread = find(fields, 4)) {
+        auto t = decode(thread->bytes);
+        track.pid = static_cast<int32_t>(find(t, 1)->value);
+        track.tid = static_cast<int32_t>(find(t, 2)->value);
+        if (const auto* name = find(t, 5)) {
+          track.name = name->bytes;
+        }
+      }
+    }
+    if (const auto* trackEvent = find(packet, 11)) {
+      clock += static_cast<int64_t>(find(packet, 8)->value);
+      Event event;
+      event.batch = trace.clockSnapshots;
+      event.ts = clock;
+      for (const auto& field : decode(trackEvent->bytes)) {
+        switch (field.number) {
+          case 3:
+            event.category = categories.at(field.value);
+            break;
+          case 4: {
+            auto annotation = decode(field.bytes);
+            auto& arg =
+                event.args[annotationNames.at(find(annotation, 1)->value)];
+            if (const auto* value = find(annotation, 4)) {
+              arg = std::to_string(static_cast<int64_t>(value->value));
+            } else if (const auto* json = find(annotation, 9)) {
+              arg = json->bytes;
+            }
+            break;
+          }
+          case 9:
+            event.type = field.value;
+            break;
+          case 10:
+            event.name = names.at(field.value);
+            break;
+          case 11:
+            event.track = field.value;
+            break;
+          case 47:
+            event.flowIds.push_back(field.value);
+            break;
+          case 48:
+            event.terminatingFlowIds.push_back(field.value);
+            break;
+          default:
+            break;
+        }
+      }
+      EXPECT_TRUE(trace.tracks.contains(event.track))
+          << "track described after its events";
+      trace.events.push_back(std::move(event));
+    }
+  }
+  return trace;
+}
+
+constexpr uint64_t kSliceBegin = 1;
+constexpr uint64_t kSliceEnd = 2;
+constexpr uint64_t kInstant = 3;
+
+} // namespace
+
+TEST(PerfettoTraceLoggerTest, EncodesTracksNamesFlowsAndTimestamps) {
+  const auto traceFile =
+      libkineto::test::createTempTraceFile("PerfettoTraceTest.", ".pftrace");
+  constexpr int64_t kBase = 1700000000000000000;
+  TraceSpan span(kBase, kBase + 100000, "test_span");
+
+  std::deque<GenericTraceActivity> activities;
+  auto add = [&](ActivityType type,
+                 const std::string& name,
+                 int64_t start,
+                 int64_t end,
+                 int32_t device,
+                 int64_t resource) -> GenericTraceActivity& {
+    auto& act = activities.emplace_back(span, type, name);
+    act.startTime = kBase + start;
+    act.endTime = kBase + end;
+    act.device = device;
+    act.resource = resource;
+    act.id = static_cast<int32_t>(activities.size());
+    return act;
+  };
+  auto& outer = add(ActivityType::CPU_OP, "aten::matmul", 100, 900, 42, 7);
+  outer.addMetadata("Sequence number", 12);
+  outer.flow.id = 5;
+  outer.flow.type = kLinkAsyncCpuGpu;
+  outer.flow.start = true;
+  add(ActivityType::CPU_OP, "aten::mm", 200, 900, 42, 7);
+  add(ActivityType::CPU_OP, "aten::mm", 950, 990, 42, 7);
+  auto& kernel =
+      add(ActivityType::CONCURRENT_KERNEL, "gemm_kernel", 1000, 3000, 0, 3);
+  kernel.flow.id = 5;
+  kernel.flow.type = kLinkAsyncCpuGpu;
+  kernel.flow.start = false;
+  kernel.linked = &outer;
+
+  {
+    TestablePerfettoTraceLogger logger(traceFile.path());
+    logger.handleTraceStart({{"rank", "3"}}, "");
+    for (const auto& act : activities) {
+      logger.handleGenericActivity(act);
+    }
+    logger.handleTraceSpan(span);
+    logger.handleResourceInfo({7, 7, 42, "python main"}, kBase);
+    logger.handleDeviceInfo({0, 0, "GPU 0", "cuda"}, kBase);
+    logger.finalizeTrace(/*endTime=*/kBase + 5000);
+  }
+
+  Trace trace = readTrace(traceFile.path());
+  // Each name is interned once, however often it is used.
+  // 3 op names, the span and its iteration marker, the end of the record
+  // window and the trace metadata.
+  EXPECT_EQ(trace.internedNameCount, 7);
+  EXPECT_EQ(trace.clockSnapshots, 1);
+
+  const Event* matmul = trace.findEvent("aten::matmul", kSliceBegin);
+  ASSERT_NE(matmul, nullptr);
+  EXPECT_EQ(matmul->ts, kBase + 100);
+  EXPECT_EQ(matmul->category, "cpu_op");
+  EXPECT_EQ(matmul->args.at("Sequence number"), "12");
+  EXPECT_EQ(matmul->args.at("External id"), std::to_string(outer.id));
+  const Track& thread = trace.tracks.at(matmul->track);
+  EXPECT_EQ(thread.pid, 42);
+  EXPECT_EQ(thread.tid, 7);
+  EXPECT_EQ(thread.name, "python main");
+
+  const Event* gemm = trace.findEvent("gemm_kernel", kSliceBegin);
+  ASSERT_NE(gemm, nullptr);
+  EXPECT_EQ(gemm->ts, kBase + 1000);
+  EXPECT_EQ(gemm->category, "kernel");
+  const Track& stream = trace.tracks.at(gemm->track);
+  EXPECT_EQ(stream.pid, 0);
+  EXPECT_EQ(stream.tid, 3);
+
+  // The flow starts at the CPU op and terminates at the kernel.
+  ASSERT_EQ(matmul->flowIds.size(), 1u);
+  ASSERT_EQ(gemm->terminatingFlowIds.size(), 1u);
+  EXPECT_EQ(matmul->flowIds[0], gemm->terminatingFlowIds[0]);
+
+  bool gpuProcessNamed = false;
+  for (const auto& [uuid, track] : trace.tracks) {
+    gpuProcessNamed |= track.name == "GPU 0" && track.pid == 0;
+  }
+  EXPECT_TRUE(gpuProcessNamed);
+
+  const Event* spanEvent = trace.findEvent("test_span (-1)", kSliceBegin);
+  ASSERT_NE(spanEvent, nullptr);
+  EXPECT_EQ(spanEvent->ts, kBase);
+  EXPECT_EQ(trace.tracks.at(spanEvent->track).name, "test_span");
+  const Event* windowEnd = trace.findEvent("Record Window End", kInstant);
+  ASSERT_NE(windowEnd, nullptr);
+  EXPECT_EQ(windowEnd->ts, kBase + 5000);
+
+  // Every slice ends where it should: matmul at 900, after the nested mm.
+  std::vector<int64_t> matmulTrackEnds;
+  for (const auto& event : trace.events) {
+    if (event.track == matmul->track && event.type == kSliceEnd) {
+      matmulTrackEnds.push_back(event.ts - kBase);
+    }
+  }
+  EXPECT_EQ(matmulTrackEnds, (std::vector<int64_t>{900, 900, 990}));
+}
+
+// Random nested, adjacent and zero-length slices on a few threads, enough
+// for several batches of events. Replaying the begin and end events of each
+// batch must close the slices in the order they nest.
+TEST(PerfettoTraceLoggerTest, SlicesNestAcrossBatches) {
+  const auto traceFile =
+      libkineto::test::createTempTraceFile("PerfettoTraceTest.", ".pftrace");
+  constexpr int64_t kBase = 1000000;
+  TraceSpan span(kBase, kBase, "span");
+
+  std::mt19937 rng(1234);
+  std::deque<GenericTraceActivity> activities;
+  // Each op is the root of a small tree of slices sharing bounds.
+  std::uniform_int_distribution<int> shape(0, 3);
+  for (int i = 0; i < 50000; i++) {
+    int64_t tid = i % 3;
+    int64_t start = kBase + (i / 3) * 10;
+    auto add = [&](int64_t s, int64_t e) {
+      auto& act = activities.emplace_back(
+          span,
+          ActivityType::CPU_OP,
+          "op_" + std::to_string(activities.size()));
+      act.startTime = s;
+      act.endTime = e;
+      act.device = 1;
+      act.resource = tid;
+    };
+    switch (shape(rng)) {
+      case 0: // parent and child with the same end
+        add(start, start + 10);
+        add(start + 5, start + 10);
+        break;
+      case 1: // identical bounds
+        add(start, start + 10);
+        add(start, start + 10);
+        break;
+      case 2: // zero-length slice at the start of another one
+        add(start, start + 10);
+        add(start, start);
+        break;
+      default: // adjacent slices
+        add(start, start + 5);
+        add(start + 5, start + 10);
+        break;
+    }
+  }
+
+  {
+    TestablePerfettoTraceLogger logger(traceFile.path());
+    logger.handleTraceStart({}, "");
+    // Log in reverse to make sure batches are sorted.
+    for (auto it = activities.rbegin(); it != activities.rend(); ++it) {
+      logger.handleGenericActivity(*it);
+    }
+    logger.finalizeTrace(/*endTime=*/kBase + 1000000);
+  }
+
+  Trace trace = readTrace(traceFile.path());
+  EXPECT_GT(trace.clockSnapshots, 1);
+
+  std::map<std::string, const GenericTraceActivity*> byName;
+  for (const auto& act : activities) {
+    byName[act.activityName] = &act;
+  }
+  std::map<uint64_t, std::vector<const GenericTraceActivity*>> stacks;
+  size_t slices = 0;
+  int batch = 0;
+  for (const auto& event : trace.events) {
+    if (event.batch != batch) {
+      for (const auto& [track, stack] : stacks) {
+        EXPECT_TRUE(stack.empty());
+      }
+      batch = event.batch;
+    }
+    if (event.type == kSliceBegin) {
+      const auto* act = byName.at(event.name);
+      EXPECT_EQ(event.ts, act->startTime);
+      auto& stack = stacks[event.track];
+      if (!stack.empty()) {
+        EXPECT_GE(act->startTime, stack.back()->startTime);
+        EXPECT_LE(act->endTime, stack.back()->endTime) << event.name;
+      }
+      stack.push_back(act);
+    } else if (event.type == kSliceEnd) {
+      auto& stack = stacks[event.track];
+      ASSERT_FALSE(stack.empty());
+      EXPECT_EQ(event.ts, stack.back()->endTime) << stack.back()->activityName;
+      stack.pop_back();
+      slices++;
+    }
+  }
+  EXPECT_EQ(slices, activities.size());
+  for (const auto& [track, stack] : stacks) {
+    EXPECT_TRUE(stack.empty());
+  }
+}
+
+TEST(PerfettoTraceLoggerTest, UnfinalizedTraceIsNotRenamed) {
+  const auto traceFile =
+      libkineto::test::createTempTraceFile("PerfettoTraceTest.", ".pftrace");
+  std::remove(traceFile.path().c_str());
+  {
+    PerfettoTraceLogger logger(traceFile.path());
+    EXPECT_EQ(logger.traceFileName(), traceFile.path());
+    logger.handleTraceStart({}, "");
+  }
+  std::ifstream f(traceFile.path());
+  EXPECT_FALSE(f.good());
+  std::remove((traceFile.path() + ".tmp").c_str());
+}
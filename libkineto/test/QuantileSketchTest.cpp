@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "src/QuantileSketch.h"
+#include "src/SampleListener.h"
+
+using namespace KINETO_NAMESPACE;
+
+namespace {
+
+const std::vector<int> kPercents = {0, 1, 5, 10, 25, 50, 75, 90, 95, 99, 100};
+
+// Nearest-rank percentiles of the values, with nth_element.
+std::vector<int64_t> exactPercentiles(std::vector<int64_t> values) {
+  std::vector<int64_t> result;
+  for (int p : kPercents) {
+    const size_t idx = std::min(values.size() - 1, p * values.size() / 100);
+    std::nth_element(values.begin(), values.begin() + idx, values.end());
+    result.push_back(values[idx]);
+  }
+  return result;
+}
+
+// How far the rank of each estimate is from the rank asked for, as a
+// fraction of the number of values. With duplicates, any rank of the
+// estimate counts.
+double maxRankError(
+    std::vector<int64_t> values,
+    const std::vector<int64_t>& estimates) {
+  std::sort(values.begin(), values.end());
+  const double n = static_cast<double>(values.size());
+  double worst = 0;
+  for (size_t i = 0; i < kPercents.size(); i++) {
+    const double rank = std::min(n - 1, std::floor(kPercents[i] * n / 100));
+    const auto range =
+        std::equal_range(values.begin(), values.end(), estimates[i]);
+    const double lo = static_cast<double>(range.first - values.begin());
+    const double hi = static_cast<double>(range.second - values.begin()) - 1;
+    const double error = rank < lo ? lo - rank : rank > hi ? rank - hi : 0;
+    worst = std::max(worst, error / n);
+  }
+  return worst;
+}
+
+std::vector<int64_t> sketchPercentiles(const std::vector<int64_t>& values) {
+  QuantileSketch<int64_t> sketch;
+  for (int64_t value : values) {
+    sketch.add(value);
+  }
+  return sketch.percentiles(kPercents);
+}
+
+std::vector<int64_t> makeValues(const std::string& shape, size_t n) {
+  std::mt19937_64 rng(n);
+  std::vector<int64_t> values;
+  values.reserve(n);
+  std::normal_distribution<double> normal(1e6, 1e5);
+  std::exponential_distribution<double> exponential(1e-4);
+  for (size_t i = 0; i < n; i++) {
+    if (shape == "uniform") {
+      values.push_back(static_cast<int64_t>(rng() % 1000000000));
+    } else if (shape == "normal") {
+      values.push_back(static_cast<int64_t>(normal(rng)));
+    } else if (shape == "exponential") {
+      values.push_back(static_cast<int64_t>(exponential(rng)));
+    } else if (shape == "ascending") {
+      values.push_back(static_cast<int64_t>(i));
+    } else if (shape == "descending") {
+      values.push_back(static_cast<int64_t>(n - i));
+    } else {
+      // Few distinct values.
+      values.push_back(static_cast<int64_t>(rng() % 7));
+    }
+  }
+  return values;
+}
+
+} // namespace
+
+// Below k values the sketch keeps them all.
+TEST(QuantileSketchTest, ExactForFewValues) {
+  for (size_t n : {1, 2, 3, 11, 80, 132, 255}) {
+    const auto values = makeValues("uniform", n);
+    QuantileSketch<int64_t> sketch;
+    for (int64_t value : values) {
+      sketch.add(value);
+    }
+    EXPECT_TRUE(sketch.exact());
+    EXPECT_EQ(sketch.percentiles(kPercents), exactPercentiles(values))
+        << n << " values";
+  }
+}
+
+TEST(QuantileSketchTest, NearestRank) {
+  QuantileSketch<int64_t> sketch;
+  for (int64_t value : {80, 10, 20, 70, 60, 40, 90, 30, 50, 0, 100}) {
+    sketch.add(value);
+  }
+  EXPECT_EQ(
+      sketch.percentiles({10, 49, 50, 90}),
+      std::vector<int64_t>({10, 50, 50, 90}));
+  EXPECT_TRUE(QuantileSketch<int64_t>().percentiles({50}).empty());
+}
+
+TEST(QuantileSketchTest, AccurateOnSyntheticData) {
+  for (const char* shape :
+       {"uniform",
+        "normal",
+        "exponential",
+        "ascending",
+        "descending",
+        "duplicates"}) {
+    for (size_t n : {1000, 100000, 1000000}) {
+      const auto values = makeValues(shape, n);
+      EXPECT_LT(maxRankError(values, sketchPercentiles(values)), 0.02)
+          << shape << ", " << n << " values";
+    }
+  }
+}
+
+TEST(QuantileSketchTest, MemoryIsBounded) {
+  QuantileSketch<int64_t> sketch;
+  size_t most = 0;
+  for (int64_t i = 0; i < 2000000; i++) {
+    sketch.add(i * 7919 % 1000003);
+    most = std::max(most, sketch.retained());
+  }
+  EXPECT_EQ(sketch.count(), 2000000);
+  EXPECT_FALSE(sketch.exact());
+  EXPECT_LT(most, 3 * QuantileSketch<int64_t>::kDefaultK);
+}
+
+TEST(QuantileSketchTest, MergesAccurately) {
+  for (const char* shape : {"uniform", "exponential", "ascending"}) {
+    const auto values = makeValues(shape, 500000);
+    // Uneven parts, as from devices or reports of different lengths.
+    std::vector<QuantileSketch<int64_t>> parts(8);
+    std::mt19937 rng(3);
+    for (int64_t value : values) {
+      parts[rng() % 8 < 5 ? 0 : rng() % 8].add(value);
+    }
+    QuantileSketch<int64_t> merged;
+    for (const auto& part : parts) {
+      merged.merge(part);
+    }
+    EXPECT_EQ(merged.count(), values.size());
+    EXPECT_LT(merged.retained(), 3 * QuantileSketch<int64_t>::kDefaultK);
+    EXPECT_LT(maxRankError(values, merged.percentiles(kPercents)), 0.02)
+        << shape;
+  }
+}
+
+TEST(QuantileSketchTest, MergeOfExactSketchesIsExact) {
+  const auto values = makeValues("normal", 200);
+  QuantileSketch<int64_t> a;
+  QuantileSketch<int64_t> b;
+  for (size_t i = 0; i < values.size(); i++) {
+    (i % 3 == 0 ? a : b).add(values[i]);
+  }
+  a.merge(b);
+  EXPECT_TRUE(a.exact());
+  EXPECT_EQ(a.percentiles(kPercents), exactPercentiles(values));
+}
+
+// Metric values are SampleValues, which can only be move assigned.
+TEST(QuantileSketchTest, SampleValues) {
+  QuantileSketch<SampleValue> sketch(16);
+  for (int i = 100; i > 0; i--) {
+    sketch.add(SampleValue(i * 0.5));
+  }
+  const auto pcs = sketch.percentiles({0, 50, 100});
+  ASSERT_EQ(pcs.size(), 3);
+  EXPECT_DOUBLE_EQ(pcs[0].getDouble(), 0.5);
+  EXPECT_NEAR(pcs[1].getDouble(), 25.5, 5);
+  EXPECT_DOUBLE_EQ(pcs[2].getDouble(), 50);
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+#include "src/RunLoopWaker.h"
+
+using namespace KINETO_NAMESPACE;
+using namespace std::chrono;
+
+namespace {
+
+TEST(RunLoopWaker, WakeBeforeWaitIsNotLost) {
+  RunLoopWaker waker;
+  waker.wake();
+  const auto start = steady_clock::now();
+  EXPECT_TRUE(waker.waitUntil(RunLoopWaker::kNever));
+  EXPECT_LT(steady_clock::now() - start, seconds(1));
+  EXPECT_EQ(waker.wakeups(), 1u);
+
+  // The wake is used up.
+  EXPECT_FALSE(waker.waitUntil(system_clock::now() + milliseconds(10)));
+  EXPECT_EQ(waker.wakeups(), 2u);
+}
+
+TEST(RunLoopWaker, ReturnsAtDeadline) {
+  RunLoopWaker waker;
+  const auto deadline = system_clock::now() + milliseconds(50);
+  EXPECT_FALSE(waker.waitUntil(deadline));
+  EXPECT_GE(system_clock::now(), deadline);
+}
+
+TEST(RunLoopWaker, WaitsForWakeWithoutDeadline) {
+  RunLoopWaker waker;
+  std::thread thread([&waker]() {
+    std::this_thread::sleep_for(milliseconds(50));
+    waker.wake();
+  });
+  const auto start = steady_clock::now();
+  EXPECT_TRUE(waker.waitUntil(RunLoopWaker::kNever));
+  EXPECT_GE(steady_clock::now() - start, milliseconds(50));
+  thread.join();
+}
+
+} // namespace
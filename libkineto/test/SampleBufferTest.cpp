@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <vector>
+
+#include "src/SampleBuffer.h"
+
+using namespace std::chrono;
+using namespace KINETO_NAMESPACE;
+
+TEST(SampleBufferTest, SumsRanges) {
+  SampleBuffer buffer;
+  auto t = system_clock::now();
+  buffer.push(t, {1, 2, 3, 4});
+  buffer.push(t + seconds(1), {10, 20, 30, 40});
+  buffer.push(t + seconds(2), {100, 200, 300, 400});
+
+  EXPECT_EQ(buffer.size(), 3);
+  EXPECT_EQ(buffer.instanceCount(), 4);
+  EXPECT_EQ(buffer.sum(0, 0, 3), 111);
+  EXPECT_EQ(buffer.sum(3, 1, 2), 440);
+  EXPECT_EQ(buffer.sum(2, 2, 1), 300);
+  EXPECT_EQ(buffer.sum(1, 1, 0), 0);
+  EXPECT_EQ(buffer.value(1, 2), 30);
+  EXPECT_EQ(buffer.timestamp(2), t + seconds(2));
+
+  buffer.popFront(1);
+  EXPECT_EQ(buffer.size(), 2);
+  EXPECT_EQ(buffer.sum(0, 0, 2), 110);
+  EXPECT_EQ(buffer.value(0, 3), 40);
+  EXPECT_EQ(buffer.timestamp(0), t + seconds(1));
+
+  buffer.popFront(5);
+  EXPECT_TRUE(buffer.empty());
+}
+
+// Erasing from the front and adding at the back wraps around the columns
+// without growing them.
+TEST(SampleBufferTest, MatchesDequeWhileWrapping) {
+  SampleBuffer buffer;
+  std::deque<std::vector<int64_t>> expected;
+  std::mt19937 rng(7);
+  auto t = system_clock::now();
+  size_t capacity = 0;
+  for (int round = 0; round < 200; round++) {
+    // Reports take about as many samples as they erase.
+    const int pushes = 20 + rng() % 8;
+    for (int i = 0; i < pushes; i++) {
+      std::vector<int64_t> values = {
+          static_cast<int64_t>(rng() % 1000),
+          static_cast<int64_t>(rng() % 1000),
+          static_cast<int64_t>(rng() % 1000)};
+      buffer.push(t, values);
+      expected.push_back(values);
+    }
+    ASSERT_EQ(buffer.size(), expected.size());
+    const size_t begin = rng() % expected.size();
+    const size_t count = rng() % (expected.size() - begin + 1);
+    for (int instance = 0; instance < 3; instance++) {
+      int64_t sum = 0;
+      for (size_t j = begin; j < begin + count; j++) {
+        sum += expected[j][instance];
+      }
+      ASSERT_EQ(buffer.sum(instance, begin, count), sum) << "round " << round;
+    }
+    for (size_t j = 0; j < expected.size(); j++) {
+      ASSERT_EQ(buffer.value(j, 1), expected[j][1]);
+    }
+    const size_t erase = std::min<size_t>(expected.size(), 20 + rng() % 8);
+    buffer.popFront(erase);
+    expected.erase(expected.begin(), expected.begin() + erase);
+    if (round == 100) {
+      capacity = buffer.capacity();
+    }
+  }
+  EXPECT_EQ(buffer.capacity(), capacity);
+  EXPECT_LE(buffer.capacity(), 64);
+}
+
+TEST(SampleBufferTest, GrowsInOrder) {
+  SampleBuffer buffer;
+  auto t = system_clock::now();
+  // Wrap around before growing.
+  for (int i = 0; i < 10; i++) {
+    buffer.push(t, {i, -i});
+  }
+  buffer.popFront(10);
+  for (int i = 0; i < 100; i++) {
+    buffer.push(t + seconds(i), {i, -i});
+  }
+  ASSERT_EQ(buffer.size(), 100);
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(buffer.value(i, 0), i);
+    EXPECT_EQ(buffer.value(i, 1), -i);
+    EXPECT_EQ(buffer.timestamp(i), t + seconds(i));
+  }
+  EXPECT_EQ(buffer.sum(0, 0, 100), 4950);
+  EXPECT_EQ(buffer.sum(1, 50, 50), -3725);
+}
+
+TEST(SampleBufferTest, InstanceCountSetWhenEmpty) {
+  SampleBuffer buffer;
+  auto t = system_clock::now();
+  buffer.push(t, {1, 2});
+  buffer.clear();
+  buffer.push(t, {1, 2, 3, 4, 5});
+  buffer.push(t, {1, 2, 3, 4, 5});
+  EXPECT_EQ(buffer.instanceCount(), 5);
+  EXPECT_EQ(buffer.size(), 2);
+  EXPECT_EQ(buffer.sum(4, 0, 2), 10);
+}
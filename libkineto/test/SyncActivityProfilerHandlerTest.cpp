@@ -9,14 +9,106 @@
 #include <gtest/gtest.h>
 
 #include <chrono>
+#include <future>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "include/Config.h"
+#include "include/IActivityProfiler.h"
 #include "src/GenericActivityProfiler.h"
 #include "src/SyncActivityProfilerHandler.h"
 
 using namespace std::chrono;
 using namespace KINETO_NAMESPACE;
 
+namespace {
+
+// A child profiler whose sessions take until release() to process a trace,
+// standing in for a trace that is slow to process.
+class SlowProfiler : public IActivityProfiler {
+ public:
+  class Session : public IActivityProfilerSession {
+   public:
+    explicit Session(std::shared_future<void> released)
+        : released_(std::move(released)) {}
+
+    void start() override {
+      status_ = TraceStatus::RECORDING;
+    }
+    void stop() override {
+      status_ = TraceStatus::PROCESSING;
+    }
+    std::vector<std::string> errors() override {
+      return {};
+    }
+    void processTrace(ActivityLogger& /*logger*/) override {
+      released_.wait();
+    }
+    std::unique_ptr<DeviceInfo> getDeviceInfo() override {
+      return {};
+    }
+    std::vector<ResourceInfo> getResourceInfos() override {
+      return {};
+    }
+    std::unique_ptr<CpuTraceBuffer> getTraceBuffer() override {
+      return {};
+    }
+
+   private:
+    std::shared_future<void> released_;
+  };
+
+  const std::string& name() const override {
+    static const std::string kName = "SlowProfiler";
+    return kName;
+  }
+  const std::set<ActivityType>& availableActivities() const override {
+    static const std::set<ActivityType> kActivities = {ActivityType::CPU_OP};
+    return kActivities;
+  }
+  std::unique_ptr<IActivityProfilerSession> configure(
+      const std::set<ActivityType>& /*activity_types*/,
+      const Config& /*config*/) override {
+    return std::make_unique<Session>(released_);
+  }
+  std::unique_ptr<IActivityProfilerSession> configure(
+      int64_t /*ts_ms*/,
+      int64_t /*duration_ms*/,
+      const std::set<ActivityType>& activity_types,
+      const Config& config) override {
+    return configure(activity_types, config);
+  }
+
+  // Lets the sessions finish processing, now or after a delay.
+  void release(milliseconds delay = milliseconds(0)) {
+    std::this_thread::sleep_for(delay);
+    release_.set_value();
+  }
+
+ private:
+  std::promise<void> release_;
+  std::shared_future<void> released_{release_.get_future().share()};
+};
+
+// Starts a trace with a SlowProfiler child.
+SlowProfiler& startSlowTrace(
+    GenericActivityProfiler& profiler,
+    SyncActivityProfilerHandler& handler) {
+  auto slow = std::make_unique<SlowProfiler>();
+  SlowProfiler& ref = *slow;
+  profiler.addChildActivityProfiler(std::move(slow));
+  Config cfg;
+  cfg.validate(system_clock::now());
+  handler.prepareTrace(cfg);
+  handler.startTrace();
+  return ref;
+}
+
+} // namespace
+
 TEST(SyncActivityProfilerHandler, Cancel) {
   GenericActivityProfiler profiler(/*cpu only*/ true);
   SyncActivityProfilerHandler handler(profiler);
@@ -34,3 +126,57 @@ TEST(SyncActivityProfilerHandler, Cancel) {
   handler.cancel();
   EXPECT_FALSE(handler.isSyncActive());
 }
+
+// The caller only waits for collection to stop, not for processing.
+TEST(SyncActivityProfilerHandler, StopTraceAsyncDefersProcessing) {
+  GenericActivityProfiler profiler(/*cpu only*/ true);
+  SyncActivityProfilerHandler handler(profiler);
+  SlowProfiler& slow = startSlowTrace(profiler, handler);
+
+  const auto start = steady_clock::now();
+  auto trace = handler.stopTraceAsync();
+  const auto stall = steady_clock::now() - start;
+  EXPECT_LT(stall, seconds(1));
+  EXPECT_EQ(trace.wait_for(milliseconds(50)), std::future_status::timeout);
+  // Busy until the trace has been processed.
+  EXPECT_TRUE(handler.isSyncActive());
+
+  slow.release();
+  EXPECT_NE(trace.get(), nullptr);
+  EXPECT_FALSE(handler.isSyncActive());
+}
+
+// The next trace waits for the previous one to be processed.
+TEST(SyncActivityProfilerHandler, PrepareTraceWaitsForProcessing) {
+  GenericActivityProfiler profiler(/*cpu only*/ true);
+  SyncActivityProfilerHandler handler(profiler);
+  SlowProfiler& slow = startSlowTrace(profiler, handler);
+
+  auto trace = handler.stopTraceAsync();
+  std::thread releaser([&slow]() { slow.release(milliseconds(50)); });
+  Config cfg;
+  cfg.validate(system_clock::now());
+  handler.prepareTrace(cfg);
+  EXPECT_EQ(trace.wait_for(seconds(0)), std::future_status::ready);
+  EXPECT_NE(trace.get(), nullptr);
+  EXPECT_TRUE(handler.isSyncActive());
+  releaser.join();
+
+  handler.startTrace();
+  EXPECT_NE(handler.stopTrace(), nullptr);
+  EXPECT_FALSE(handler.isSyncActive());
+}
+
+// A trace being processed is complete, and cancel() does not drop it.
+TEST(SyncActivityProfilerHandler, CancelWaitsForProcessing) {
+  GenericActivityProfiler profiler(/*cpu only*/ true);
+  SyncActivityProfilerHandler handler(profiler);
+  SlowProfiler& slow = startSlowTrace(profiler, handler);
+
+  auto trace = handler.stopTraceAsync();
+  std::thread releaser([&slow]() { slow.release(milliseconds(50)); });
+  handler.cancel();
+  EXPECT_FALSE(handler.isSyncActive());
+  EXPECT_NE(trace.get(), nullptr);
+  releaser.join();
+}
@@ -9,6 +9,7 @@
 #include "include/TypedMetadata.h"
 #include "include/TypedMetadataJson.h"
 
+#include <fmt/format.h>
 #include <gtest/gtest.h>
 #include <map>
 #include <string>
@@ -243,3 +244,18 @@ TEST(TypedMetadataVisitorTest, SerializesUInt64AndInputShapesToJson) {
       json.find("\"input_dims\": [[2, 2], [[4, 1], [4, 1]]]"),
       std::string::npos);
 }
+
+TEST(TypedMetadataVisitorTest, WritesSanitizedJsonIntoBuffer) {
+  fmt::memory_buffer out;
+  out.append(std::string_view{"\"first\": 1"});
+  internal::JsonTypedMetadataWriter<fmt::memory_buffer, /*Sanitize=*/true>
+      writer(out, /*leadingComma=*/true);
+  ITypedMetadataVisitor& visitor = writer;
+
+  visitor.visit(kLabel, std::string{"C:\\tmp\\a\nb"});
+  visitor.visit(kIds, std::vector<int64_t>{1, 2});
+
+  EXPECT_EQ(
+      std::string_view(out.data(), out.size()),
+      R"("first": 1,"label": "C:/tmp/ab", "ids": [1, 2])");
+}
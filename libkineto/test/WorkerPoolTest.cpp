@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "src/WorkerPool.h"
+
+using namespace KINETO_NAMESPACE;
+
+// Every task runs exactly once per run(), and the same threads serve every
+// run().
+TEST(WorkerPoolTest, RunsEveryTaskOnTheSameThreads) {
+  constexpr size_t kTasks = 100;
+  WorkerPool pool(/*numThreads=*/4);
+  std::mutex mutex;
+  std::set<std::thread::id> threads;
+  for (int run = 0; run < 10; run++) {
+    std::vector<std::atomic<int>> calls(kTasks);
+    pool.run(kTasks, [&](size_t i) {
+      calls[i]++;
+      std::scoped_lock lock(mutex);
+      threads.insert(std::this_thread::get_id());
+    });
+    for (const auto& count : calls) {
+      EXPECT_EQ(count, 1);
+    }
+  }
+  EXPECT_LE(threads.size(), 4);
+  EXPECT_FALSE(threads.contains(std::this_thread::get_id()));
+}
+
+TEST(WorkerPoolTest, SingleThreadRunsOnTheCaller) {
+  WorkerPool pool(/*numThreads=*/1);
+  const auto caller = std::this_thread::get_id();
+  std::vector<size_t> order;
+  pool.run(3, [&](size_t i) {
+    EXPECT_EQ(std::this_thread::get_id(), caller);
+    order.push_back(i);
+  });
+  EXPECT_EQ(order, (std::vector<size_t>{0, 1, 2}));
+}